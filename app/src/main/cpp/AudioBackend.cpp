@@ -0,0 +1,13 @@
+#include "AudioBackend.h"
+
+AudioBackend &AudioBackend::getDefault() {
+    static OboeBackend backend;
+    return backend;
+}
+
+oboe::Result OboeBackend::openStream(const oboe::AudioStreamBuilder &builder,
+                                     std::shared_ptr<oboe::AudioStream> &stream) {
+    // openStream() isn't const in Oboe; the builder is only a description
+    oboe::AudioStreamBuilder request(builder);
+    return request.openStream(stream);
+}
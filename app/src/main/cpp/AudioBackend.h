@@ -0,0 +1,40 @@
+#ifndef OBOESAMPLE_AUDIOBACKEND_H
+#define OBOESAMPLE_AUDIOBACKEND_H
+
+#include <oboe/Oboe.h>
+#include <memory>
+
+/**
+ * Where AudioRecorder and AudioPlayer get their device streams from.
+ *
+ * Both describe the stream they want with an oboe::AudioStreamBuilder (data
+ * callback included) and then only use the oboe::AudioStream they get back:
+ * its format, requestStart(), requestStop() and close(). A backend decides
+ * what is behind that stream and what calls its callback. OboeBackend opens
+ * real device streams and is the default; the host build adds
+ * HostTimerBackend, which calls the callback from a timer thread over a file
+ * or silence, so the whole record and play path runs off-device.
+ *
+ * A backend must outlive every stream it opened.
+ */
+class AudioBackend {
+public:
+    virtual ~AudioBackend() = default;
+
+    // Opens a stream as builder describes; the device picks whatever builder
+    // leaves unspecified. The stream doesn't call back before requestStart().
+    virtual oboe::Result openStream(const oboe::AudioStreamBuilder &builder,
+                                    std::shared_ptr<oboe::AudioStream> &stream) = 0;
+
+    // The process-wide OboeBackend
+    static AudioBackend &getDefault();
+};
+
+/** Device streams straight from Oboe */
+class OboeBackend : public AudioBackend {
+public:
+    oboe::Result openStream(const oboe::AudioStreamBuilder &builder,
+                            std::shared_ptr<oboe::AudioStream> &stream) override;
+};
+
+#endif //OBOESAMPLE_AUDIOBACKEND_H
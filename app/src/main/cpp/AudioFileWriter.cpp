@@ -0,0 +1,213 @@
+#include "AudioFileWriter.h"
+#include <android/log.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define LOG_TAG "AudioFileWriter"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Batches are written in page-aligned 32 KiB chunks
+constexpr size_t kBatchAlignment = 4096;
+constexpr size_t kBatchBytes = 32 * 1024;
+
+// The ring holds at least this much audio, and at least kMinBatchesInRing batches
+constexpr int32_t kRingSeconds = 2;
+constexpr size_t kMinBatchesInRing = 4;
+
+// How long the writer sleeps when less than a batch is queued
+constexpr auto kPollInterval = std::chrono::milliseconds(10);
+
+// How long writeBlocking() sleeps while the ring is full. The writer thread
+// drains a full ring without sleeping, so room appears quickly.
+constexpr auto kBlockingWaitInterval = std::chrono::milliseconds(1);
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void AudioFileWriter::FreeDeleter::operator()(uint8_t *ptr) const {
+    free(ptr);
+}
+
+AudioFileWriter::~AudioFileWriter() {
+    close();
+}
+
+bool AudioFileWriter::open(const std::string &path, int32_t sampleRate, int32_t channelCount,
+                           FileFormat format) {
+    close();
+
+    mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd < 0) {
+        LOGE("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    mChannelCount = std::max(1, channelCount);
+    mFormat = format;
+    mBytesPerSample = format == FileFormat::Float32 ? sizeof(float) : sizeof(int16_t);
+    mBytesPerFrame = mBytesPerSample * mChannelCount;
+    if (!mBatch) {
+        mBatch.reset(static_cast<uint8_t *>(aligned_alloc(kBatchAlignment, kBatchBytes)));
+    }
+
+    size_t ringBytes = std::max(static_cast<size_t>(sampleRate) * mBytesPerFrame * kRingSeconds,
+                                kBatchBytes * kMinBatchesInRing);
+    mRing.allocate(ringBytes);
+
+    mHighWaterMark.store(0, std::memory_order_relaxed);
+    mDroppedFrames.store(0, std::memory_order_relaxed);
+    mFramesWritten.store(0, std::memory_order_relaxed);
+    mBytesWritten.store(0, std::memory_order_relaxed);
+    mSampleBytesWritten = 0;
+
+    if (mFormat == FileFormat::Lossless) {
+        mEncoder.init(sampleRate, mChannelCount);
+        // Room for a batch that didn't compress at all, plus block headers
+        mEncoded.clear();
+        mEncoded.reserve(kBatchBytes * 2);
+        mEncoder.writeFileHeader(mEncoded);
+        writeToFile(mEncoded.data(), mEncoded.size());
+    }
+
+    mFlushComplete.store(true, std::memory_order_relaxed);
+    mStopRequested.store(false, std::memory_order_relaxed);
+
+    mWriterThread.start("AudioWriter", [this] { writerLoop(); });
+    mOpen.store(true, std::memory_order_release);
+
+    static const char *const kFormatNames[] = {"int16", "float", "lossless"};
+    LOGD("Writing %s (%s): ring %zu samples, batch %zu bytes", path.c_str(),
+         kFormatNames[static_cast<int>(mFormat)], getRingCapacity(), kBatchBytes);
+    return true;
+}
+
+bool AudioFileWriter::close(std::chrono::milliseconds flushTimeout) {
+    if (!mWriterThread.joinable()) {
+        return true;
+    }
+
+    mOpen.store(false, std::memory_order_release);
+    mFlushDeadlineNs.store(nowNs() + std::chrono::duration_cast<std::chrono::nanoseconds>(
+            flushTimeout).count(), std::memory_order_relaxed);
+    mStopRequested.store(true, std::memory_order_release);
+    mWriterThread.join();
+
+    ::close(mFd);
+    mFd = -1;
+
+    bool flushed = mFlushComplete.load(std::memory_order_relaxed);
+    LOGD("Closed: %lld frames written, %lld dropped, high-water mark %zu/%zu samples%s",
+         static_cast<long long>(getFramesWritten()), static_cast<long long>(getDroppedFrames()),
+         getHighWaterMark(), getRingCapacity(), flushed ? "" : " (flush timed out)");
+    if (mFormat == FileFormat::Lossless && getFramesWritten() > 0) {
+        LOGD("Compressed to %.1f%% of PCM", 100.0 * getBytesWritten() /
+                                              (getFramesWritten() * mChannelCount * 2.0));
+    }
+    return flushed;
+}
+
+bool AudioFileWriter::writeFrames(const void *data, int32_t numFrames) {
+    if (!mRing.write(static_cast<const uint8_t *>(data), numFrames * mBytesPerFrame)) {
+        mDroppedFrames.fetch_add(numFrames, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Only this thread raises the mark, so a plain load/store is enough
+    size_t queued = mRing.capacity() - mRing.availableToWrite();
+    if (queued > mHighWaterMark.load(std::memory_order_relaxed)) {
+        mHighWaterMark.store(queued, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool AudioFileWriter::writeFramesBlocking(const void *data, int32_t numFrames) {
+    const size_t numBytes = static_cast<size_t>(numFrames) * mBytesPerFrame;
+    if (numBytes > mRing.capacity()) {
+        LOGE("Blocking write of %d frames is larger than the ring", numFrames);
+        return false;
+    }
+    while (mRing.availableToWrite() < numBytes) {
+        if (!isOpen()) {
+            return false;
+        }
+        std::this_thread::sleep_for(kBlockingWaitInterval);
+    }
+    return writeFrames(data, numFrames);
+}
+
+void AudioFileWriter::writerLoop() {
+    uint8_t *batch = mBatch.get();
+
+    while (!mStopRequested.load(std::memory_order_acquire)) {
+        if (mRing.availableToRead() >= kBatchBytes) {
+            mRing.read(batch, kBatchBytes);
+            writeSamples(batch, kBatchBytes);
+        } else {
+            WorkerThread::sleepFor(kPollInterval);
+        }
+    }
+
+    // Bounded flush of whatever the callback queued before it stopped
+    int64_t deadline = mFlushDeadlineNs.load(std::memory_order_relaxed);
+    while (mRing.availableToRead() > 0) {
+        if (nowNs() > deadline) {
+            LOGE("Flush timed out, discarding %zu queued samples",
+                 mRing.availableToRead() / mBytesPerSample);
+            mFlushComplete.store(false, std::memory_order_relaxed);
+            break;
+        }
+        // Every sample size divides the batch size, so batches always hold
+        // whole samples (though not always whole frames)
+        size_t count = mRing.read(batch, kBatchBytes);
+        writeSamples(batch, count);
+    }
+
+    // The last, partial block
+    if (mFormat == FileFormat::Lossless) {
+        mEncoded.clear();
+        mEncoder.finish(mEncoded);
+        writeToFile(mEncoded.data(), mEncoded.size());
+    }
+}
+
+bool AudioFileWriter::writeSamples(const uint8_t *data, size_t numBytes) {
+    bool written;
+    if (mFormat == FileFormat::Lossless) {
+        // The batch buffer is page-aligned, so it can be read as int16
+        mEncoded.clear();
+        mEncoder.encode(reinterpret_cast<const int16_t *>(data), numBytes / sizeof(int16_t),
+                        mEncoded);
+        written = writeToFile(mEncoded.data(), mEncoded.size());
+    } else {
+        written = writeToFile(data, numBytes);
+    }
+    if (written) {
+        mSampleBytesWritten += numBytes;
+        mFramesWritten.store(static_cast<int64_t>(mSampleBytesWritten / mBytesPerFrame),
+                             std::memory_order_relaxed);
+    }
+    return written;
+}
+
+bool AudioFileWriter::writeToFile(const void *data, size_t numBytes) {
+    auto *bytes = static_cast<const char *>(data);
+    size_t remaining = numBytes;
+    while (remaining > 0) {
+        ssize_t written = ::write(mFd, bytes, remaining);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            LOGE("Write failed: %s", strerror(errno));
+            return false;
+        }
+        bytes += written;
+        remaining -= static_cast<size_t>(written);
+    }
+    mBytesWritten.fetch_add(static_cast<int64_t>(numBytes), std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,118 @@
+#ifndef OBOESAMPLE_AUDIOFILEWRITER_H
+#define OBOESAMPLE_AUDIOFILEWRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FileFormat.h"
+#include "LosslessCodec.h"
+#include "SpscRingBuffer.h"
+#include "WorkerThread.h"
+
+/**
+ * Writes interleaved audio to a file without blocking the audio thread.
+ *
+ * The audio callback pushes frames into a lock-free SPSC ring with write();
+ * a dedicated writer thread drains the ring to disk in large, page-aligned
+ * batches. If the ring is full (e.g. during a flash write stall) the whole
+ * callback buffer is dropped and counted rather than stalling the callback.
+ *
+ * For FileFormat::Lossless the writer thread compresses the audio on the way
+ * to disk (see LosslessCodec.h), so the callback's cost doesn't change.
+ */
+class AudioFileWriter {
+public:
+    AudioFileWriter() = default;
+    ~AudioFileWriter();
+
+    AudioFileWriter(const AudioFileWriter &) = delete;
+    AudioFileWriter &operator=(const AudioFileWriter &) = delete;
+
+    // Opens (truncates) the file, sizes the ring for the stream format and
+    // starts the writer thread. Not real-time safe.
+    bool open(const std::string &path, int32_t sampleRate, int32_t channelCount,
+              FileFormat format = FileFormat::Pcm16);
+
+    // Stops accepting data, lets the writer thread flush what's queued for at
+    // most flushTimeout, then closes the file. Returns false if queued audio had
+    // to be discarded because the flush ran out of time.
+    bool close(std::chrono::milliseconds flushTimeout = std::chrono::milliseconds(500));
+
+    bool isOpen() const { return mOpen.load(std::memory_order_acquire); }
+    FileFormat getFormat() const { return mFormat; }
+
+    // Audio thread: queues numFrames interleaved frames. Wait-free; returns
+    // false (and counts the frames as dropped) if the ring has no room. Use the
+    // int16 overload for Pcm16/Lossless files and the float one for Float32.
+    bool write(const int16_t *data, int32_t numFrames) { return writeFrames(data, numFrames); }
+    bool write(const float *data, int32_t numFrames) { return writeFrames(data, numFrames); }
+
+    // Producers that may block (offline processing): like write(), but waits
+    // for the writer thread to make room instead of dropping. numFrames must
+    // fit in the ring. Returns false only if the writer was closed.
+    bool writeBlocking(const int16_t *data, int32_t numFrames) {
+        return writeFramesBlocking(data, numFrames);
+    }
+    bool writeBlocking(const float *data, int32_t numFrames) {
+        return writeFramesBlocking(data, numFrames);
+    }
+
+    // Most samples ever queued at once, since open()
+    size_t getHighWaterMark() const {
+        return mHighWaterMark.load(std::memory_order_relaxed) / mBytesPerSample;
+    }
+    size_t getRingCapacity() const { return mRing.capacity() / mBytesPerSample; }
+    int64_t getDroppedFrames() const { return mDroppedFrames.load(std::memory_order_relaxed); }
+    int64_t getFramesWritten() const { return mFramesWritten.load(std::memory_order_relaxed); }
+    int64_t getBytesWritten() const { return mBytesWritten.load(std::memory_order_relaxed); }
+
+    // Scheduling and wake-ups of the writer thread
+    WorkerThread::Stats getThreadStats() const { return mWriterThread.getStats(); }
+
+private:
+    struct FreeDeleter {
+        void operator()(uint8_t *ptr) const;
+    };
+
+    bool writeFrames(const void *data, int32_t numFrames);
+    bool writeFramesBlocking(const void *data, int32_t numFrames);
+
+    void writerLoop();
+
+    // Writes numBytes of queued samples, compressing them for Lossless
+    bool writeSamples(const uint8_t *data, size_t numBytes);
+    bool writeToFile(const void *data, size_t numBytes);
+
+    // Queued samples, as bytes
+    SpscRingBuffer<uint8_t> mRing;
+    std::unique_ptr<uint8_t[], FreeDeleter> mBatch;
+
+    int mFd = -1;
+    int32_t mChannelCount = 1;
+    FileFormat mFormat = FileFormat::Pcm16;
+    size_t mBytesPerSample = sizeof(int16_t);
+    size_t mBytesPerFrame = sizeof(int16_t);
+    WorkerThread mWriterThread;
+
+    // Writer-thread state: uncompressed bytes taken off the ring so far, and
+    // the compressor
+    size_t mSampleBytesWritten = 0;
+    LosslessEncoder mEncoder;
+    std::vector<uint8_t> mEncoded;
+
+    std::atomic<bool> mOpen{false};
+    std::atomic<bool> mStopRequested{false};
+    std::atomic<int64_t> mFlushDeadlineNs{0};
+    std::atomic<bool> mFlushComplete{true};
+
+    // Statistics
+    std::atomic<size_t> mHighWaterMark{0};    // bytes
+    std::atomic<int64_t> mDroppedFrames{0};
+    std::atomic<int64_t> mFramesWritten{0};
+    std::atomic<int64_t> mBytesWritten{0};
+};
+
+#endif //OBOESAMPLE_AUDIOFILEWRITER_H
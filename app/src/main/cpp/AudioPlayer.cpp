@@ -1,22 +1,29 @@
 #include "AudioPlayer.h"
+#include "filter/SampleConversion.h"
 #include <android/log.h>
 #include <algorithm>
+#include <cstring>
 
 #define LOG_TAG "AudioPlayer"
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
-AudioPlayer::AudioPlayer() : mReadIndex(0) {
+// Block size the resampler is sized for if the stream reports neither a burst
+// size nor a capacity
+constexpr int32_t kDefaultBlockFrames = 4096;
+
+AudioPlayer::AudioPlayer(AudioBackend &backend) : mBackend(backend), mReadIndex(0) {
     // Determine the optimal sample rate from the device's default output stream
     oboe::AudioStreamBuilder builder;
     builder.setDirection(oboe::Direction::Output);
     std::shared_ptr<oboe::AudioStream> testStream;
-    oboe::Result result = builder.openStream(testStream);
+    oboe::Result result = mBackend.openStream(builder, testStream);
     if (result == oboe::Result::OK) {
         mSampleRate = testStream->getSampleRate();
         mChannelCount = testStream->getChannelCount();
         testStream->close();
     }
+    mDeviceSampleRate = mSampleRate;
     LOGD("Player initialized. Sample Rate: %d, Channels: %d", mSampleRate, mChannelCount);
 }
 
@@ -37,7 +44,7 @@ oboe::Result AudioPlayer::startPlayback(const std::vector<int16_t>& data) {
             ->setSampleRate(mSampleRate)
             ->setDataCallback(this);
 
-    oboe::Result result = builder.openStream(mPlaybackStream);
+    oboe::Result result = mBackend.openStream(builder, mPlaybackStream);
     if (result != oboe::Result::OK) {
         LOGE("Failed to open playback stream: %s", oboe::convertToText(result));
         return result;
@@ -46,6 +53,7 @@ oboe::Result AudioPlayer::startPlayback(const std::vector<int16_t>& data) {
     // Set sample rate to what the stream actually opened with
     mSampleRate = mPlaybackStream->getSampleRate();
 
+    mMetrics.reset();
     result = mPlaybackStream->requestStart();
     if (result != oboe::Result::OK) {
         LOGE("Failed to start playback stream: %s", oboe::convertToText(result));
@@ -57,37 +65,81 @@ oboe::Result AudioPlayer::startPlayback(const std::vector<int16_t>& data) {
 
 oboe::Result AudioPlayer::startPlaybackFromFile(const char* path) {
 
-    // 1. Open the file stream for reading
-    mAudioFile.open(path, std::ios::in | std::ios::binary);
-    if (!mAudioFile.is_open()) {
+    // 1. Map or start decoding the file, so its start is ready before the
+    // stream asks for data
+    mCompressed = CompressedAudioSource::isCompressedFile(path);
+    const bool floatFile = !mCompressed && mFileFormat == FileFormat::Float32;
+    const size_t bytesPerSample = floatFile ? sizeof(float) : sizeof(int16_t);
+    if (!(mCompressed ? mCompressedSource.open(path) : mSource.open(path, bytesPerSample))) {
         LOGE("Failed to open file for playback: %s", path);
         return oboe::Result::ErrorInternal;
     }
     LOGD("Playback file opened successfully: %s", path);
 
+    // A compressed recording knows its own format
+    int32_t fileSampleRate = mFileSampleRate > 0 ? mFileSampleRate : mDeviceSampleRate;
+    if (mCompressed) {
+        fileSampleRate = mCompressedSource.getSampleRate();
+        mChannelCount = mCompressedSource.getChannelCount();
+    }
+
     // 2. Configure and open the Oboe stream
     oboe::AudioStreamBuilder builder;
     builder.setDirection(oboe::Direction::Output)
             ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
             ->setSharingMode(oboe::SharingMode::Exclusive)
-            ->setFormat(oboe::AudioFormat::I16)
+            ->setFormat(floatFile ? oboe::AudioFormat::Float : oboe::AudioFormat::I16)
             ->setChannelCount(mChannelCount)
-            ->setSampleRate(mSampleRate)
+            ->setSampleRate(mDeviceSampleRate)
             ->setDataCallback(this);
 
-    oboe::Result result = builder.openStream(mPlaybackStream);
+    oboe::Result result = mBackend.openStream(builder, mPlaybackStream);
     if (result != oboe::Result::OK) {
         LOGE("Failed to open playback stream: %s", oboe::convertToText(result));
-        mAudioFile.close();
+        mSource.close();
+        mCompressedSource.close();
         return result;
     }
 
     mSampleRate = mPlaybackStream->getSampleRate();
 
+    // 3. Resample if the file isn't at the stream's rate, with every buffer
+    // sized here so the callback never allocates
+    mResampling = fileSampleRate != mSampleRate;
+    if (mResampling) {
+        int32_t blockFrames = std::max(mPlaybackStream->getFramesPerBurst(),
+                                       mPlaybackStream->getBufferCapacityInFrames());
+        if (blockFrames <= 0) {
+            blockFrames = kDefaultBlockFrames;
+        }
+        if (!mResampler.configure(fileSampleRate, mSampleRate, mChannelCount, blockFrames)) {
+            LOGE("Can't resample %d Hz to %d Hz", fileSampleRate, mSampleRate);
+            mPlaybackStream->close();
+            mPlaybackStream.reset();
+            mSource.close();
+            mCompressedSource.close();
+            return oboe::Result::ErrorInvalidRate;
+        }
+        // Enough input for a whole block from any filter state
+        mResampleInputFrames =
+                mResampler.getInputFramesNeeded(blockFrames) + mResampler.getTapsPerPhase();
+        const auto inputSamples = static_cast<size_t>(mResampleInputFrames) * mChannelCount;
+        mSourceBuffer.assign(inputSamples, 0);
+        mResampleInput.assign(inputSamples, 0.0f);
+        mResampled.assign(static_cast<size_t>(mResampler.getMaxOutputFrames(
+                mResampleInputFrames)) * mChannelCount, 0.0f);
+        mResampledStart = 0;
+        mResampledFrames = 0;
+        mSourceEnded = false;
+        LOGD("Resampling playback from %d Hz to %d Hz", fileSampleRate, mSampleRate);
+    }
+
+    mMetrics.reset();
     result = mPlaybackStream->requestStart();
     if (result != oboe::Result::OK) {
         LOGE("Failed to start playback stream: %s", oboe::convertToText(result));
-        mAudioFile.close();
+        mSource.close();
+        mCompressedSource.close();
     } else {
         LOGD("Playback started successfully. Reading from file.");
     }
@@ -100,48 +152,114 @@ void AudioPlayer::stopPlayback() {
         mPlaybackStream->close();
         mPlaybackStream.reset();
         LOGD("Playback stopped.");
+
+        char metrics[256];
+        mMetrics.snapshot().formatSummary(metrics, sizeof(metrics));
+        LOGD("Playback callbacks: %s", metrics);
     }
 
-    // Close the file stream
-    if (mAudioFile.is_open()) {
-        mAudioFile.close();
+    // Release the file now the callback can no longer read it
+    if (mSource.isOpen() || mCompressedSource.isOpen()) {
+        mSource.close();
+        mCompressedSource.close();
         LOGD("Audio playback file closed.");
     }
 }
 
 oboe::DataCallbackResult AudioPlayer::onAudioReady(oboe::AudioStream *oboeStream, void *audioData, int32_t numFrames) {
-    auto *outputData = static_cast<int16_t *>(audioData);
-    size_t numSamples = numFrames * oboeStream->getChannelCount();
-    size_t numBytes = numSamples * sizeof(int16_t);
+    CallbackMetrics::Scope timing(mMetrics, oboeStream, numFrames);
+    WorkerThread::noteCallbackCpu(CallbackStream::Player);
+    const bool floatOutput = oboeStream->getFormat() == oboe::AudioFormat::Float;
+    int32_t channelCount = oboeStream->getChannelCount();
+    size_t numSamples = numFrames * channelCount;
+    int64_t renderTimeNs = FarEndReference::nowNs();
+    oboe::DataCallbackResult result = oboe::DataCallbackResult::Continue;
 
-    if (mAudioFile.is_open()) {
-        // Read the requested number of bytes from the file directly into the output buffer
-        mAudioFile.read(static_cast<char *>(audioData), numBytes);
+    if ((mCompressed ? mCompressedSource.isOpen() : mSource.isOpen()) && mResampling) {
+        if (!renderResampled(audioData, numFrames, channelCount, floatOutput)) {
+            LOGD("Reached end of file during playback.");
+            result = oboe::DataCallbackResult::Stop;
+        }
+    } else if (mCompressed ? mCompressedSource.isOpen() : mSource.isOpen()) {
+        // Copy straight from the mapped file or the decoded ring; past the end
+        // read() pads with silence, and a short read means we're done
+        if (readSource(audioData, numSamples) < numSamples) {
+            LOGD("Reached end of file during playback.");
+            result = oboe::DataCallbackResult::Stop;
+        }
+    } else {
+        LOGE("Audio file is not open for playback, outputting silence.");
+        memset(audioData, 0, numSamples * (floatOutput ? sizeof(float) : sizeof(int16_t)));
+        result = oboe::DataCallbackResult::Stop;
+    }
 
-        // Get the number of bytes actually read (in case we hit EOF)
-        size_t bytesRead = mAudioFile.gcount();
-        size_t samplesRead = bytesRead / sizeof(int16_t);
+    // Hand what we rendered to the recorder's echo canceller
+    if (mFarEnd != nullptr) {
+        if (floatOutput) {
+            mFarEnd->write(static_cast<const float *>(audioData), numFrames, channelCount,
+                           oboeStream->getSampleRate(), renderTimeNs);
+        } else {
+            mFarEnd->write(static_cast<const int16_t *>(audioData), numFrames, channelCount,
+                           oboeStream->getSampleRate(), renderTimeNs);
+        }
+    }
+    return result;
+}
 
-        // Check if we hit the end of the file
-        if (mAudioFile.eof()) {
-            LOGD("Reached end of file during playback.");
+size_t AudioPlayer::readSource(void *dest, size_t numSamples) {
+    return mCompressed ? mCompressedSource.read(static_cast<int16_t *>(dest), numSamples)
+                       : mSource.read(dest, numSamples);
+}
 
-            // Fill any remaining space in the buffer with silence (0s)
-            size_t silenceSamples = numSamples - samplesRead;
-            if (silenceSamples > 0) {
-                memset(outputData + samplesRead, 0, silenceSamples * sizeof(int16_t));
+bool AudioPlayer::renderResampled(void *audioData, int32_t numFrames, int32_t channelCount,
+                                  bool floatOutput) {
+    const bool floatSource = !mCompressed && mFileFormat == FileFormat::Float32;
+    int32_t done = 0;
+    while (done < numFrames) {
+        if (mResampledFrames == 0) {
+            if (mSourceEnded) {
+                break;
             }
-
-            // Stop the playback stream
-            return oboe::DataCallbackResult::Stop;
+            // Pull only as much of the file as the rest of the block needs
+            const int32_t inputFrames = std::min(
+                    mResampleInputFrames, mResampler.getInputFramesNeeded(numFrames - done));
+            const auto numSamples = static_cast<size_t>(inputFrames) * channelCount;
+            size_t samplesRead;
+            if (floatSource) {
+                samplesRead = readSource(mResampleInput.data(), numSamples);
+            } else {
+                samplesRead = readSource(mSourceBuffer.data(), numSamples);
+                convertInt16ToFloat(mSourceBuffer.data(), mResampleInput.data(),
+                                    static_cast<int32_t>(numSamples));
+            }
+            // Past the end read() pads with silence, which flushes the filter
+            mSourceEnded = samplesRead < numSamples;
+            mResampledFrames = mResampler.process(mResampleInput.data(), inputFrames,
+                                                  mResampled.data());
+            mResampledStart = 0;
+            continue;
         }
 
-        // If we read the exact amount, continue
-        return oboe::DataCallbackResult::Continue;
+        const int32_t frames = std::min(mResampledFrames, numFrames - done);
+        const float *resampled = mResampled.data()
+                                 + static_cast<size_t>(mResampledStart) * channelCount;
+        const auto first = static_cast<size_t>(done) * channelCount;
+        if (floatOutput) {
+            memcpy(static_cast<float *>(audioData) + first, resampled,
+                   sizeof(float) * frames * channelCount);
+        } else {
+            convertFloatToInt16(resampled, static_cast<int16_t *>(audioData) + first,
+                                frames * channelCount);
+        }
+        done += frames;
+        mResampledStart += frames;
+        mResampledFrames -= frames;
+    }
 
-    } else {
-        LOGE("Audio file is not open for playback, outputting silence.");
-        memset(outputData, 0, numBytes);
-        return oboe::DataCallbackResult::Stop;
+    if (done < numFrames) {
+        const size_t bytesPerSample = floatOutput ? sizeof(float) : sizeof(int16_t);
+        memset(static_cast<uint8_t *>(audioData) + done * channelCount * bytesPerSample, 0,
+               (numFrames - done) * channelCount * bytesPerSample);
     }
-}
\ No newline at end of file
+    return !(mSourceEnded && mResampledFrames == 0);
+}
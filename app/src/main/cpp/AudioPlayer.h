@@ -4,12 +4,20 @@
 #include <oboe/Oboe.h>
 #include <vector>
 #include <atomic>
-#include <fstream> // New: Include fstream for file operations
 #include <string>
+#include "AudioBackend.h"
+#include "CallbackMetrics.h"
+#include "CompressedAudioSource.h"
+#include "FarEndReference.h"
+#include "FileFormat.h"
+#include "MappedAudioSource.h"
+#include "WorkerThread.h"
+#include "filter/PolyphaseResampler.h"
 
 class AudioPlayer : public oboe::AudioStreamDataCallback {
 public:
-    AudioPlayer();
+    // Streams come from backend, which must outlive the player
+    explicit AudioPlayer(AudioBackend &backend = AudioBackend::getDefault());
 
     oboe::Result startPlayback(const std::vector<int16_t>& data);
 
@@ -17,22 +25,76 @@ public:
     oboe::Result startPlaybackFromFile(const char* path);
     void stopPlayback();
 
+    // Everything rendered is also published here, as the recorder's echo
+    // reference. Set before starting playback.
+    void setFarEndReference(FarEndReference *reference) { mFarEnd = reference; }
+
+    // Sample format of raw recordings (compressed ones are detected from their
+    // header). Set before starting playback.
+    void setFileFormat(FileFormat format) { mFileFormat = format; }
+
+    // Sample rate of raw recordings, 0 for the device rate (compressed ones
+    // carry theirs). Files at another rate than the device are resampled.
+    // Set before starting playback.
+    void setFileSampleRate(int32_t sampleRate) { mFileSampleRate = sampleRate; }
+
+    // Callback timing for the current/last playback; safe from any thread
+    CallbackMetrics::Snapshot getCallbackMetrics() const { return mMetrics.snapshot(); }
+
+    // Scheduling and wake-ups of the thread feeding playback: the decoder for
+    // a compressed file, else the read-ahead thread
+    WorkerThread::Stats getSourceThreadStats() const {
+        return mCompressed ? mCompressedSource.getThreadStats() : mSource.getThreadStats();
+    }
+
     oboe::DataCallbackResult onAudioReady(oboe::AudioStream *oboeStream, void *audioData, int32_t numFrames) override;
 
 private:
+    AudioBackend &mBackend;
     std::shared_ptr<oboe::AudioStream> mPlaybackStream;
     std::vector<int16_t> mPlaybackBuffer;
     std::atomic<int64_t> mReadIndex;
 
-    // New: File stream and playback buffer
-    std::ifstream mAudioFile;
+    // Recording being played back: raw PCM memory-mapped, or a compressed
+    // recording decoded ahead on its own thread. Either way the callback only copies.
+    MappedAudioSource mSource;
+    CompressedAudioSource mCompressedSource;
+    bool mCompressed = false;
+    FileFormat mFileFormat = FileFormat::Pcm16;
+    int32_t mFileSampleRate = 0;
 
-    // Buffer for reading chunks from the file before playback
-    std::vector<int16_t> mReadBuffer;
+    // File rate -> stream rate, when they differ. The callback pulls just
+    // enough of the file through it for each block; the few frames a block
+    // can produce beyond what was asked for wait in mResampled.
+    PolyphaseResampler mResampler;
+    bool mResampling = false;
+    std::vector<int16_t> mSourceBuffer;  // int16 file samples, before conversion
+    std::vector<float> mResampleInput;   // float file samples
+    std::vector<float> mResampled;       // output at the stream rate
+    int32_t mResampledStart = 0;
+    int32_t mResampledFrames = 0;
+    int32_t mResampleInputFrames = 0;    // capacity of mResampleInput
+    bool mSourceEnded = false;
+
+    FarEndReference *mFarEnd = nullptr;
+
+    CallbackMetrics mMetrics;
 
     // Stream properties (should match recorder)
     int32_t mSampleRate = 48000;
     int32_t mChannelCount = 1;
+
+    // Rate of the device's default output stream, probed at construction
+    int32_t mDeviceSampleRate = 48000;
+
+    // Reads numSamples from whichever source is open into dest (int16 or
+    // float samples, as the source stores them). Returns the samples read.
+    size_t readSource(void *dest, size_t numSamples);
+
+    // Fills numFrames of audioData by resampling the file. Returns false once
+    // the file has run out (the rest of the block is silence).
+    bool renderResampled(void *audioData, int32_t numFrames, int32_t channelCount,
+                         bool floatOutput);
 };
 
 #endif //OBOESAMPLE_AUDIOPLAYER_H
\ No newline at end of file
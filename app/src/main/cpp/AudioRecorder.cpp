@@ -1,4 +1,5 @@
 #include "AudioRecorder.h"
+#include "filter/SampleConversion.h"
 #include <android/log.h>
 #include <unistd.h>
 
@@ -6,53 +7,99 @@
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
-AudioRecorder::AudioRecorder()
-        : mEchoCanceller(48000),
-          mNoiseReduction(5),    // 5-sample smoothing window
-          mPlaybackSuppressor(48000) {
+// Scratch size used if the stream reports neither a burst size nor a capacity
+constexpr int32_t kDefaultScratchFrames = 4096;
+
+AudioRecorder::AudioRecorder(AudioBackend &backend)
+        : mBackend(backend), mPendingGraph(DspGraph::fromParams(mPendingParams)) {
 
     oboe::AudioStreamBuilder recordingBuilder;
     recordingBuilder.setDirection(oboe::Direction::Input);
     std::shared_ptr<oboe::AudioStream> recordingStream;
-    if (recordingBuilder.openStream(recordingStream) == oboe::Result::OK) {
+    if (mBackend.openStream(recordingBuilder, recordingStream) == oboe::Result::OK) {
         mSampleRate = recordingStream->getSampleRate();
         mChannelCount = recordingStream->getChannelCount();
         recordingStream->close();
     }
     LOGD("Recorder initialized. Sample Rate: %d, Channels: %d", mSampleRate, mChannelCount);
 
-    // Initialize filters with default values
-    mBandpassFilter.setBandpass(mSampleRate, 1000.0f, 1.0f);
-    mHighShelfFilter.setHighShelf(mSampleRate, 8000.0f, 0.7f, 3.0f);
-    mPeakingFilter.setPeaking(mSampleRate, 3000.0f, 1.0f, 6.0f);
+    // Initialize all modules with the default parameters
+    mChain.prepare(mSampleRate, mChannelCount, 0, mPendingGraph);
+}
 
-    // Initialize noise gate
-    mNoiseGate.setThreshold(-40.0f);  // -40 dB
-    mNoiseGate.setRatio(4.0f);        // 4:1 ratio
-    mNoiseGate.setAttack(5.0f, mSampleRate);   // 5ms attack
-    mNoiseGate.setRelease(50.0f, mSampleRate); // 50ms release
+RecorderParams AudioRecorder::getParams() {
+    std::lock_guard<std::mutex> lock(mControlLock);
+    return mPendingParams;
+}
 
-    // Initialize noise reduction
-    mNoiseReduction.setReductionAmount(0.5f);
+DspGraph AudioRecorder::getGraph() {
+    std::lock_guard<std::mutex> lock(mControlLock);
+    return mPendingGraph;
+}
 
-    // Initialize echo canceller
-    mEchoCanceller.setEchoDelay(50.0f);
-    mEchoCanceller.setSuppressionAmount(0.7f);
-    mPlaybackSuppressor.setAggressiveness(0.8f);
+void AudioRecorder::setGraph(const DspGraph &graph) {
+    updateGraph([&](DspGraph &g) {
+        g = graph;
+        return true;
+    });
+    LOGD("Processing graph set: %d stages", graph.size());
 }
 
-void AudioRecorder::setPlaybackSuppressorEnabled(bool enabled) {
-    mPlaybackSuppressorEnabled = enabled;
-    if (enabled) {
-        mPlaybackSuppressor.reset();
-        LOGD("Playback suppressor enabled");
-    } else {
-        LOGD("Playback suppressor disabled");
+int32_t AudioRecorder::addStage(StageType type, int32_t position) {
+    int32_t id = -1;
+    updateGraph([&](DspGraph &g) {
+        id = g.addStage(type, position);
+        return id >= 0;
+    });
+    LOGD("Added stage %d of type %d at %d", id, static_cast<int>(type), position);
+    return id;
+}
+
+bool AudioRecorder::removeStage(int32_t id) {
+    return updateGraph([=](DspGraph &g) { return g.removeStage(id); });
+}
+
+bool AudioRecorder::moveStage(int32_t id, int32_t position) {
+    return updateGraph([=](DspGraph &g) { return g.moveStage(id, position); });
+}
+
+bool AudioRecorder::setStageEnabled(int32_t id, bool enabled) {
+    return updateGraph([=](DspGraph &g) {
+        StageConfig *stage = g.findStage(id);
+        if (stage == nullptr) return false;
+        stage->enabled = enabled;
+        return true;
+    });
+}
+
+bool AudioRecorder::setStageParam(int32_t id, StageParam param, float value) {
+    const bool updated = updateGraph([=](DspGraph &g) {
+        StageConfig *stage = g.findStage(id);
+        if (stage == nullptr) return false;
+        stage->set(param, value);
+        return true;
+    });
+    if (updated) {
+        LOGD("Stage %d: parameter %d set to %.3f", id, static_cast<int>(param), value);
     }
+    return updated;
+}
+
+void AudioRecorder::resetGraph() {
+    std::lock_guard<std::mutex> lock(mControlLock);
+    mPendingGraph = DspGraph::fromParams(mPendingParams);
+    mChain.setGraph(mPendingGraph);
+    LOGD("Processing graph reset to the classic chain");
+}
+
+void AudioRecorder::setPlaybackSuppressorEnabled(bool enabled) {
+    updateParams([=](RecorderParams &p) { p.playbackSuppressorEnabled = enabled; });
+    LOGD("Playback suppressor %s", enabled ? "enabled" : "disabled");
 }
 
 void AudioRecorder::configurePlaybackSuppressor(float aggressiveness) {
-    mPlaybackSuppressor.setAggressiveness(aggressiveness);
+    updateParams([=](RecorderParams &p) { p.suppressorAggressiveness = aggressiveness; });
+    LOGD("Playback suppressor aggressiveness: %.2f", aggressiveness);
 }
 
 void AudioRecorder::setStoragePath(const char *path) {
@@ -60,6 +107,21 @@ void AudioRecorder::setStoragePath(const char *path) {
     LOGD("Set recording path to: %s", mFilePath.c_str());
 }
 
+void AudioRecorder::setFileFormat(FileFormat format) {
+    mFileFormat = format;
+    LOGD("Recording file format set to: %d", static_cast<int>(format));
+}
+
+void AudioRecorder::setFloatCaptureEnabled(bool enabled) {
+    mFloatCaptureEnabled = enabled;
+    LOGD("Float capture %s", enabled ? "enabled" : "disabled");
+}
+
+void AudioRecorder::setTargetSampleRate(int32_t sampleRate) {
+    mTargetSampleRate = std::max(0, sampleRate);
+    LOGD("Recording sample rate set to: %d", mTargetSampleRate);
+}
+
 void AudioRecorder::setAudioSource(oboe::InputPreset preset) {
     mInputPreset = preset;
     LOGD("Audio source set to: %d", static_cast<int>(preset));
@@ -72,96 +134,111 @@ void AudioRecorder::setAndroidAECEnabled(bool enabled) {
 
 // Bandpass filter controls
 void AudioRecorder::setBandpassFilterEnabled(bool enabled) {
-    mBandpassEnabled = enabled;
-    if (enabled) {
-        mBandpassFilter.reset();
-        LOGD("Bandpass filter enabled");
-    } else {
-        LOGD("Bandpass filter disabled");
-    }
+    updateParams([=](RecorderParams &p) { p.bandpassEnabled = enabled; });
+    LOGD("Bandpass filter %s", enabled ? "enabled" : "disabled");
 }
 
 void AudioRecorder::configureBandpassFilter(float centerFreq, float Q) {
-    mBandpassFilter.setBandpass(mSampleRate, centerFreq, Q);
+    updateParams([=](RecorderParams &p) {
+        p.bandpassFreq = centerFreq;
+        p.bandpassQ = Q;
+    });
+    LOGD("Bandpass filter: %.1f Hz, Q %.2f", centerFreq, Q);
 }
 
 // High shelf filter controls
 void AudioRecorder::setHighShelfFilterEnabled(bool enabled) {
-    mHighShelfEnabled = enabled;
-    if (enabled) {
-        mHighShelfFilter.reset();
-        LOGD("High shelf filter enabled");
-    } else {
-        LOGD("High shelf filter disabled");
-    }
+    updateParams([=](RecorderParams &p) { p.highShelfEnabled = enabled; });
+    LOGD("High shelf filter %s", enabled ? "enabled" : "disabled");
 }
 
 void AudioRecorder::configureHighShelfFilter(float centerFreq, float Q, float gainDb) {
-    mHighShelfFilter.setHighShelf(mSampleRate, centerFreq, Q, gainDb);
+    updateParams([=](RecorderParams &p) {
+        p.highShelfFreq = centerFreq;
+        p.highShelfQ = Q;
+        p.highShelfGainDb = gainDb;
+    });
+    LOGD("High shelf filter: %.1f Hz, Q %.2f, %.1f dB", centerFreq, Q, gainDb);
 }
 
 // Peaking filter controls
 void AudioRecorder::setPeakingFilterEnabled(bool enabled) {
-    mPeakingEnabled = enabled;
-    if (enabled) {
-        mPeakingFilter.reset();
-        LOGD("Peaking filter enabled");
-    } else {
-        LOGD("Peaking filter disabled");
-    }
+    updateParams([=](RecorderParams &p) { p.peakingEnabled = enabled; });
+    LOGD("Peaking filter %s", enabled ? "enabled" : "disabled");
 }
 
 void AudioRecorder::configurePeakingFilter(float centerFreq, float Q, float gainDb) {
-    mPeakingFilter.setPeaking(mSampleRate, centerFreq, Q, gainDb);
+    updateParams([=](RecorderParams &p) {
+        p.peakingFreq = centerFreq;
+        p.peakingQ = Q;
+        p.peakingGainDb = gainDb;
+    });
+    LOGD("Peaking filter: %.1f Hz, Q %.2f, %.1f dB", centerFreq, Q, gainDb);
 }
 
 // Noise gate controls
 void AudioRecorder::setNoiseGateEnabled(bool enabled) {
-    mNoiseGateEnabled = enabled;
-    if (enabled) {
-        mNoiseGate.reset();
-        LOGD("Noise gate enabled");
-    } else {
-        LOGD("Noise gate disabled");
-    }
+    updateParams([=](RecorderParams &p) { p.noiseGateEnabled = enabled; });
+    LOGD("Noise gate %s", enabled ? "enabled" : "disabled");
 }
 
 void AudioRecorder::configureNoiseGate(float thresholdDb, float ratio, float attackMs, float releaseMs) {
-    mNoiseGate.setThreshold(thresholdDb);
-    mNoiseGate.setRatio(ratio);
-    mNoiseGate.setAttack(attackMs, mSampleRate);
-    mNoiseGate.setRelease(releaseMs, mSampleRate);
+    updateParams([=](RecorderParams &p) {
+        p.gateThresholdDb = thresholdDb;
+        p.gateRatio = ratio;
+        p.gateAttackMs = attackMs;
+        p.gateReleaseMs = releaseMs;
+    });
+    LOGD("Noise gate: threshold %.1f dB, ratio %.1f:1, attack %.1f ms, release %.1f ms",
+         thresholdDb, ratio, attackMs, releaseMs);
 }
 
 // Noise reduction controls
 void AudioRecorder::setNoiseReductionEnabled(bool enabled) {
-    mNoiseReductionEnabled = enabled;
-    if (enabled) {
-        mNoiseReduction.reset();
-        LOGD("Noise reduction enabled");
-    } else {
-        LOGD("Noise reduction disabled");
-    }
+    updateParams([=](RecorderParams &p) { p.noiseReductionEnabled = enabled; });
+    LOGD("Noise reduction %s", enabled ? "enabled" : "disabled");
 }
 
 void AudioRecorder::configureNoiseReduction(float amount) {
-    mNoiseReduction.setReductionAmount(amount);
+    updateParams([=](RecorderParams &p) { p.noiseReductionAmount = amount; });
+    LOGD("Noise reduction amount: %.2f", amount);
 }
 
 // Echo canceller controls
 void AudioRecorder::setEchoCancellerEnabled(bool enabled) {
-    mEchoCancellerEnabled = enabled;
-    if (enabled) {
-        mEchoCanceller.reset();
-        LOGD("Echo canceller enabled");
-    } else {
-        LOGD("Echo canceller disabled");
-    }
+    updateParams([=](RecorderParams &p) { p.echoCancellerEnabled = enabled; });
+    LOGD("Echo canceller %s", enabled ? "enabled" : "disabled");
 }
 
 void AudioRecorder::configureEchoCanceller(float delayMs, float suppressionAmount) {
-    mEchoCanceller.setEchoDelay(delayMs);
-    mEchoCanceller.setSuppressionAmount(suppressionAmount);
+    updateParams([=](RecorderParams &p) {
+        p.echoDelayMs = delayMs;
+        p.echoSuppression = suppressionAmount;
+    });
+    LOGD("Echo canceller: delay %.1f ms, suppression %.2f", delayMs, suppressionAmount);
+}
+
+// Automatic gain control and limiter
+void AudioRecorder::setAutoGainEnabled(bool enabled) {
+    updateParams([=](RecorderParams &p) { p.autoGainEnabled = enabled; });
+    LOGD("Auto gain %s", enabled ? "enabled" : "disabled");
+}
+
+void AudioRecorder::configureAutoGain(float targetDb, float maxGainDb) {
+    updateParams([=](RecorderParams &p) {
+        p.agcTargetDb = targetDb;
+        p.agcMaxGainDb = maxGainDb;
+    });
+    LOGD("Auto gain: target %.1f dBFS, max gain %.1f dB", targetDb, maxGainDb);
+}
+
+void AudioRecorder::configureLimiter(float ceilingDb) {
+    updateParams([=](RecorderParams &p) { p.limiterCeilingDb = ceilingDb; });
+    LOGD("Limiter ceiling: %.1f dBFS", ceilingDb);
+}
+
+void AudioRecorder::applyPendingParams() {
+    mChain.update();
 }
 
 oboe::Result AudioRecorder::startRecording() {
@@ -172,27 +249,11 @@ oboe::Result AudioRecorder::startRecording() {
         return oboe::Result::ErrorInternal;
     }
 
-    mAudioFile.open(mFilePath, std::ios::out | std::ios::binary | std::ios::trunc);
-    if (!mAudioFile.is_open()) {
-        LOGE("Failed to open file for recording: %s", mFilePath.c_str());
-        return oboe::Result::ErrorInternal;
-    }
-    LOGD("File opened successfully.");
-
-    // Reset all processing modules
-    if (mBandpassEnabled) mBandpassFilter.reset();
-    if (mHighShelfEnabled) mHighShelfFilter.reset();
-    if (mPeakingEnabled) mPeakingFilter.reset();
-    if (mNoiseGateEnabled) mNoiseGate.reset();
-    if (mNoiseReductionEnabled) mNoiseReduction.reset();
-    if (mEchoCancellerEnabled) mEchoCanceller.reset();
-    if (mPlaybackSuppressorEnabled) mPlaybackSuppressor.reset();  // NEW: Add this line
-
     oboe::AudioStreamBuilder builder;
     builder.setDirection(oboe::Direction::Input)
             ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
             ->setSharingMode(oboe::SharingMode::Exclusive)
-            ->setFormat(oboe::AudioFormat::I16)
+            ->setFormat(mFloatCaptureEnabled ? oboe::AudioFormat::Float : oboe::AudioFormat::I16)
             ->setChannelCount(mChannelCount)
             ->setSampleRate(mSampleRate)
             ->setInputPreset(mInputPreset)
@@ -200,40 +261,84 @@ oboe::Result AudioRecorder::startRecording() {
             ->setContentType(oboe::ContentType::Speech)   // NEW: Mark as speech content
             ->setDataCallback(this);
 
-    oboe::Result result = builder.openStream(mRecordingStream);
+    oboe::Result result = mBackend.openStream(builder, mRecordingStream);
     if (result != oboe::Result::OK) {
         LOGE("Failed to open recording stream: %s", oboe::convertToText(result));
-        mAudioFile.close();
         return result;
     }
 
     int32_t actualSampleRate = mRecordingStream->getSampleRate();
     if (actualSampleRate != mSampleRate) {
         mSampleRate = actualSampleRate;
-        // Reconfigure all filters with actual sample rate
-        if (mBandpassEnabled) configureBandpassFilter(1000.0f, 1.0f);
-        if (mHighShelfEnabled) configureHighShelfFilter(8000.0f, 0.7f, 3.0f);
-        if (mPeakingEnabled) configurePeakingFilter(3000.0f, 1.0f, 6.0f);
-        if (mNoiseGateEnabled) configureNoiseGate(-40.0f, 4.0f, 5.0f, 50.0f);
         LOGD("Updated sample rate to: %d", mSampleRate);
     }
 
+    // Size the scratch buffers once here so the callback never allocates. Oboe
+    // callbacks normally deliver a burst, but never more than the buffer capacity.
+    mScratchFrames = std::max(mRecordingStream->getFramesPerBurst(),
+                              mRecordingStream->getBufferCapacityInFrames());
+    if (mScratchFrames <= 0) {
+        mScratchFrames = kDefaultScratchFrames;
+    }
+    int32_t channelCount = mRecordingStream->getChannelCount();
+    mChannelCount = channelCount;
+    mProcessBuffer.assign(static_cast<size_t>(mScratchFrames) * channelCount, 0.0f);
+
+    const int32_t fileSampleRate = getFileSampleRate();
+    mResampling = fileSampleRate != mSampleRate;
+    int32_t outputFrames = mScratchFrames;
+    if (mResampling) {
+        if (!mResampler.configure(mSampleRate, fileSampleRate, channelCount, mScratchFrames)) {
+            LOGE("Can't resample %d Hz to %d Hz", mSampleRate, fileSampleRate);
+            mRecordingStream->close();
+            mRecordingStream.reset();
+            return oboe::Result::ErrorInvalidRate;
+        }
+        outputFrames = std::max(outputFrames, mResampler.getMaxOutputFrames(mScratchFrames));
+        mResampleBuffer.assign(static_cast<size_t>(outputFrames) * channelCount, 0.0f);
+    }
+    mOutputBuffer.assign(static_cast<size_t>(outputFrames) * channelCount, 0);
+
+    // The callback isn't running yet, so compile the latest graph for the
+    // actual sample rate and channel count (every stage starts from a clean
+    // state) and install it directly
+    DspGraph graph;
+    {
+        std::lock_guard<std::mutex> controlLock(mControlLock);
+        graph = mPendingGraph;
+        mChain.prepare(mSampleRate, channelCount, mScratchFrames, graph);
+    }
+    if (mFarEnd != nullptr) {
+        mFarEnd->resetReader();
+    }
+
+    mMetrics.reset();
+
+    // Size the writer's ring for the format the stream actually opened with
+    if (!mFileWriter.open(mFilePath, fileSampleRate, channelCount, mFileFormat)) {
+        LOGE("Failed to open file for recording: %s", mFilePath.c_str());
+        mRecordingStream->close();
+        mRecordingStream.reset();
+        return oboe::Result::ErrorInternal;
+    }
+    LOGD("File opened successfully.");
+
     result = mRecordingStream->requestStart();
     if (result != oboe::Result::OK) {
         LOGE("Failed to start recording stream: %s", oboe::convertToText(result));
-        mAudioFile.close();
+        mFileWriter.close();
     } else {
         LOGD("Recording started with processing chain:");
         LOGD("  InputPreset: %d, Usage: VoiceCommunication, Content: Speech",
              static_cast<int>(mInputPreset));
-        LOGD("  Bandpass: %s, HighShelf: %s, Peaking: %s",
-             mBandpassEnabled ? "ON" : "OFF",
-             mHighShelfEnabled ? "ON" : "OFF",
-             mPeakingEnabled ? "ON" : "OFF");
-        LOGD("  NoiseGate: %s, NoiseReduction: %s, Echo: %s",
-             mNoiseGateEnabled ? "ON" : "OFF",
-             mNoiseReductionEnabled ? "ON" : "OFF",
-             mEchoCancellerEnabled ? "ON" : "OFF");
+        LOGD("  Capture format: %s, file format: %d, %d Hz -> %d Hz",
+             mRecordingStream->getFormat() == oboe::AudioFormat::Float ? "float" : "int16",
+             static_cast<int>(mFileFormat), mSampleRate, fileSampleRate);
+        for (int32_t i = 0; i < graph.size(); i++) {
+            const StageConfig &stage = graph.stage(i);
+            LOGD("  Stage %d: id %d, type %d, %s", i, stage.id, static_cast<int>(stage.type),
+                 stage.enabled ? "ON" : "OFF");
+        }
     }
     return result;
 }
@@ -246,92 +351,121 @@ void AudioRecorder::stopRecording() {
         LOGD("Recording stream stopped.");
     }
 
-    if (mAudioFile.is_open()) {
-        mAudioFile.close();
-        LOGD("Audio file closed.");
+    // The callback has stopped producing; give the writer a bounded time to drain
+    if (mFileWriter.isOpen()) {
+        bool flushed = mFileWriter.close(std::chrono::milliseconds(500));
+        LOGD("Audio file closed%s. Dropped frames: %lld", flushed ? "" : " (flush timed out)",
+             static_cast<long long>(mFileWriter.getDroppedFrames()));
+    }
+
+    char metrics[256];
+    mMetrics.snapshot().formatSummary(metrics, sizeof(metrics));
+    LOGD("Recording callbacks: %s", metrics);
+
+    const VoiceActivity::Snapshot voice = getVoiceActivity();
+    if (voice.frames > 0) {
+        LOGD("Speech in %.1f%% of the recording", 100.0f * voice.speechShare());
     }
 }
 
 oboe::DataCallbackResult
 AudioRecorder::onAudioReady(oboe::AudioStream *oboeStream, void *audioData, int32_t numFrames) {
-    if (!mAudioFile.is_open()) {
+    CallbackMetrics::Scope timing(mMetrics, oboeStream, numFrames);
+    WorkerThread::noteCallbackCpu(CallbackStream::Recorder);
+
+    // Parameter changes only ever take effect here, between blocks
+    applyPendingParams();
+
+    if (!mFileWriter.isOpen()) {
         LOGE("Audio file is not open, cannot write data!");
         return oboe::DataCallbackResult::Continue;
     }
 
-    auto *inputData = static_cast<int16_t *>(audioData);
-    size_t numSamples = numFrames * oboeStream->getChannelCount();
-
-    // Check if any processing is enabled
-    bool anyProcessingEnabled = mBandpassEnabled || mHighShelfEnabled || mPeakingEnabled ||
-                                mNoiseGateEnabled || mNoiseReductionEnabled ||
-                                mEchoCancellerEnabled || mPlaybackSuppressorEnabled;  // NEW: Added
-
-    // Your gain factor (1.0f = normal, 2.0f = +6dB, 4.0f = +12dB, etc.)
-    const float gain = 2.0f;
-
-    if (anyProcessingEnabled) {
-        std::vector<int16_t> processedData(numSamples);
-
-        for (size_t i = 0; i < numSamples; i++) {
-            // Convert int16_t to float (-1.0 to 1.0)
-            float sample = static_cast<float>(inputData[i]) / 32768.0f;
-
-            sample *= gain;
-            if (sample > 1.0f) sample = 1.0f;
-            else if (sample < -1.0f) sample = -1.0f;
-
-            // Apply processing chain in order
-
-            // 1. Playback suppressor (NEW: Add as first software processing step)
-            //    This acts as a fallback if Android AEC doesn't work
-            if (mPlaybackSuppressorEnabled) {
-                sample = mPlaybackSuppressor.process(sample);
+    int32_t channelCount = oboeStream->getChannelCount();
+    const bool floatInput = oboeStream->getFormat() == oboe::AudioFormat::Float;
+    const bool floatFile = mFileWriter.getFormat() == FileFormat::Float32;
+    const auto *input16 = static_cast<const int16_t *>(audioData);
+    const auto *inputFloat = static_cast<const float *>(audioData);
+
+    const bool processing = mChain.isActive();
+    if (processing || mResampling) {
+        // The block just arrived, so its first frame was captured a block ago
+        const int64_t nsPerFrame = 1000000000LL / mSampleRate;
+        const int64_t captureTimeNs = FarEndReference::nowNs() - numFrames * nsPerFrame;
+
+        // Process through the preallocated scratch buffers, in chunks if Oboe
+        // ever hands us more frames than they were sized for
+        for (int32_t offset = 0; offset < numFrames; offset += mScratchFrames) {
+            int32_t frames = std::min(mScratchFrames, numFrames - offset);
+            size_t first = static_cast<size_t>(offset) * channelCount;
+            int32_t numSamples = frames * channelCount;
+
+            // Into the float working buffer, float input clipped to full scale.
+            // Level is the auto gain stage's job, not a fixed input gain.
+            if (floatInput) {
+                scaleAndClamp(inputFloat + first, mProcessBuffer.data(), numSamples);
+            } else {
+                convertInt16ToFloat(input16 + first, mProcessBuffer.data(), numSamples);
             }
-
-            // 1. Echo cancellation (first, to remove feedback)
-            if (mEchoCancellerEnabled) {
-                sample = mEchoCanceller.process(sample);
-            }
-
-            // 2. Noise reduction (remove background noise)
-            if (mNoiseReductionEnabled) {
-                sample = mNoiseReduction.process(sample);
-            }
-
-            // 3. Noise gate (cut very low signals)
-            if (mNoiseGateEnabled) {
-                sample = mNoiseGate.process(sample);
-            }
-
-            // 4. Bandpass filter (isolate voice frequencies)
-            if (mBandpassEnabled) {
-                sample = mBandpassFilter.process(sample);
+            if (processing) {
+                processBlock(frames, captureTimeNs + offset * nsPerFrame);
             }
 
-            // 5. Peaking EQ (boost presence)
-            if (mPeakingEnabled) {
-                sample = mPeakingFilter.process(sample);
-            }
-
-            // 6. High shelf (enhance clarity)
-            if (mHighShelfEnabled) {
-                sample = mHighShelfFilter.process(sample);
+            // Queue processed data for the writer thread
+            writeOutput(mProcessBuffer.data(), frames, channelCount);
+        }
+    } else if (floatInput == floatFile) {
+        // No processing: queue raw data directly
+        if (floatInput) {
+            mFileWriter.write(inputFloat, numFrames);
+        } else {
+            mFileWriter.write(input16, numFrames);
+        }
+    } else {
+        // No processing, only the file's sample format differs
+        for (int32_t offset = 0; offset < numFrames; offset += mScratchFrames) {
+            int32_t frames = std::min(mScratchFrames, numFrames - offset);
+            size_t first = static_cast<size_t>(offset) * channelCount;
+            int32_t numSamples = frames * channelCount;
+            if (floatInput) {
+                convertFloatToInt16(inputFloat + first, mOutputBuffer.data(), numSamples);
+                mFileWriter.write(mOutputBuffer.data(), frames);
+            } else {
+                convertInt16ToFloat(input16 + first, mProcessBuffer.data(), numSamples);
+                mFileWriter.write(mProcessBuffer.data(), frames);
             }
-
-            // Convert back to int16_t with clipping
-            sample = std::max(-1.0f, std::min(1.0f, sample));
-            processedData[i] = static_cast<int16_t>(sample * 32767.0f);
         }
+    }
+
+    return oboe::DataCallbackResult::Continue;
+}
 
-        // Write processed data to file
-        size_t numBytes = numSamples * sizeof(int16_t);
-        mAudioFile.write(reinterpret_cast<const char *>(processedData.data()), numBytes);
+void AudioRecorder::writeOutput(float *data, int32_t numFrames, int32_t channelCount) {
+    if (mResampling) {
+        numFrames = mResampler.process(data, numFrames, mResampleBuffer.data());
+        data = mResampleBuffer.data();
+    }
+    const int32_t numSamples = numFrames * channelCount;
+    if (mFileWriter.getFormat() == FileFormat::Float32) {
+        scaleAndClamp(data, data, numSamples);
+        mFileWriter.write(data, numFrames);
     } else {
-        // No processing: write raw data directly
-        size_t numBytes = numSamples * sizeof(int16_t);
-        mAudioFile.write(static_cast<const char *>(audioData), numBytes);
+        convertFloatToInt16(data, mOutputBuffer.data(), numSamples);
+        mFileWriter.write(mOutputBuffer.data(), numFrames);
+    }
+}
+
+void AudioRecorder::readFarEnd(int64_t captureTimeNs, int32_t numFrames) {
+    // Without a player the buffer just stays silent. Every channel's canceller
+    // takes the same mono far end.
+    if (mFarEnd != nullptr) {
+        mFarEnd->read(captureTimeNs, mSampleRate, mChain.getFarEndBuffer(), numFrames);
     }
+}
 
-    return oboe::DataCallbackResult::Continue;
-}
\ No newline at end of file
+void AudioRecorder::processBlock(int32_t numFrames, int64_t captureTimeNs) {
+    if (mChain.usesFarEnd()) {
+        readFarEnd(captureTimeNs, numFrames);
+    }
+    mChain.process(mProcessBuffer.data(), numFrames);
+}
@@ -4,22 +4,91 @@
 #include <oboe/Oboe.h>
 #include <vector>
 #include <mutex>
-#include <fstream>
-#include "filter/BiquadFilter.h"
-#include "filter/NoiseGate.h"
-#include "filter/NoiseReduction.h"
-#include "filter/EchoCanceller.h"
-#include "filter/PlaybackSuppressor.h"  // NEW: Add this
+#include "AudioBackend.h"
+#include "AudioFileWriter.h"
+#include "CallbackMetrics.h"
+#include "ChainProcessor.h"
+#include "DspGraph.h"
+#include "FarEndReference.h"
+#include "FileFormat.h"
+#include "RecorderParams.h"
+#include "WorkerThread.h"
+#include "filter/PolyphaseResampler.h"
 
 class AudioRecorder : public oboe::AudioStreamDataCallback {
 public:
-    AudioRecorder();
+    // Streams come from backend, which must outlive the recorder
+    explicit AudioRecorder(AudioBackend &backend = AudioBackend::getDefault());
 
     void setStoragePath(const char *path);
 
+    // How recordings are stored: raw int16, raw float or lossless compressed
+    // (call this before recording)
+    void setFileFormat(FileFormat format);
+
+    // Capture float samples from the device instead of int16, which skips
+    // the input conversion on HALs that are natively float (call this before
+    // recording)
+    void setFloatCaptureEnabled(bool enabled);
+
+    // Rate recordings are stored at, e.g. 16000 for the voice pipeline; the
+    // chain still runs at the device rate and the output is resampled before
+    // it is written. 0 stores at the device rate. Call this before recording.
+    void setTargetSampleRate(int32_t sampleRate);
+
+    // Rate of the current/last recording's file (the target rate, or the
+    // device rate if there is none)
+    int32_t getFileSampleRate() const {
+        return mTargetSampleRate > 0 ? mTargetSampleRate : mSampleRate;
+    }
+
     oboe::Result startRecording();
     void stopRecording();
 
+    // File writer statistics for the current/last recording
+    size_t getWriterHighWaterMark() const { return mFileWriter.getHighWaterMark(); }
+    size_t getWriterRingCapacity() const { return mFileWriter.getRingCapacity(); }
+    int64_t getDroppedFrames() const { return mFileWriter.getDroppedFrames(); }
+
+    // Callback timing for the current/last recording; safe from any thread
+    CallbackMetrics::Snapshot getCallbackMetrics() const { return mMetrics.snapshot(); }
+
+    // The playback suppressor's speech decisions for the current/last
+    // recording; safe from any thread
+    VoiceActivity::Snapshot getVoiceActivity() const {
+        return mChain.getVoiceActivity().snapshot();
+    }
+
+    // Scheduling and wake-ups of the file writer's thread
+    WorkerThread::Stats getWriterThreadStats() const { return mFileWriter.getThreadStats(); }
+
+    // Latest parameters requested through the per-type setters below. They
+    // reach the audio thread at the next callback boundary.
+    RecorderParams getParams();
+
+    // The processing graph: which stages run, in what order. It starts as the
+    // classic chain, whose stages the per-type setters below control; stages
+    // can be added (any type, any number of times), removed, reordered and
+    // configured by id. Edits reach the audio thread at the next callback
+    // boundary, and stages that stay in the graph keep their state.
+    DspGraph getGraph();
+    void setGraph(const DspGraph &graph);
+
+    // Adds a stage of type with default settings before position (the end if
+    // negative). Returns its id, or -1 if the graph is full.
+    int32_t addStage(StageType type, int32_t position);
+    bool removeStage(int32_t id);
+    bool moveStage(int32_t id, int32_t position);
+    bool setStageEnabled(int32_t id, bool enabled);
+    bool setStageParam(int32_t id, StageParam param, float value);
+
+    // Back to the classic chain, configured by the per-type setters' values
+    void resetGraph();
+
+    // Format of the stream the recorder last opened (or probed at construction)
+    int32_t getSampleRate() const { return mSampleRate; }
+    int32_t getChannelCount() const { return mChannelCount; }
+
     // Set audio source (call this before recording)
     void setAudioSource(oboe::InputPreset preset);
 
@@ -55,14 +124,33 @@ public:
     void setEchoCancellerEnabled(bool enabled);
     void configureEchoCanceller(float delayMs, float suppressionAmount);
 
+    // Automatic gain control and the look-ahead limiter after it (dBFS / dB)
+    void setAutoGainEnabled(bool enabled);
+    void configureAutoGain(float targetDb, float maxGainDb);
+    void configureLimiter(float ceilingDb);
+
+    // Where the echo canceller gets what the player rendered. Set before
+    // startRecording(); the reference must outlive the recording.
+    void setFarEndReference(FarEndReference *reference) { mFarEnd = reference; }
+
 private:
+    AudioBackend &mBackend;
     std::shared_ptr<oboe::AudioStream> mRecordingStream;
     std::mutex mBufferLock;
     int32_t mSampleRate = 48000;
     int32_t mChannelCount = 1;
 
-    std::fstream mAudioFile;
+    // Drains processed audio to mFilePath on its own thread
+    AudioFileWriter mFileWriter;
     std::string mFilePath;
+    FileFormat mFileFormat = FileFormat::Pcm16;
+    bool mFloatCaptureEnabled = false;
+    int32_t mTargetSampleRate = 0;
+
+    // Device rate -> target rate, applied after the chain; only used when the
+    // two differ
+    PolyphaseResampler mResampler;
+    bool mResampling = false;
 
     // Audio source preset
     oboe::InputPreset mInputPreset = oboe::InputPreset::VoiceCommunication;
@@ -70,23 +158,65 @@ private:
     // Flag for Android AEC
     bool mAndroidAECEnabled = true;
 
-    // Processing modules
-    BiquadFilter mBandpassFilter;
-    BiquadFilter mHighShelfFilter;
-    BiquadFilter mPeakingFilter;
-    NoiseGate mNoiseGate;
-    NoiseReduction mNoiseReduction;
-    EchoCanceller mEchoCanceller;
-    PlaybackSuppressor mPlaybackSuppressor;  // NEW: Add this
-
-    // Enable flags
-    bool mBandpassEnabled = false;
-    bool mHighShelfEnabled = false;
-    bool mPeakingEnabled = false;
-    bool mNoiseGateEnabled = false;
-    bool mNoiseReductionEnabled = false;
-    bool mEchoCancellerEnabled = false;
-    bool mPlaybackSuppressorEnabled = false;  // NEW: Add this
+    // The compiled graph, handed over to the audio thread by ChainProcessor
+    ChainProcessor mChain;
+
+    // Control plane: setters edit mPendingGraph (the per-type ones through
+    // mPendingParams) under mControlLock and pass it to mChain, which the
+    // audio thread updates from at the start of each callback without locking
+    std::mutex mControlLock;
+    RecorderParams mPendingParams;
+    DspGraph mPendingGraph;
+
+    // Scratch buffers sized in startRecording() from the stream's burst size and
+    // buffer capacity, so the steady-state callback never allocates
+    std::vector<float> mProcessBuffer;   // float working buffer, processed in place
+    std::vector<float> mResampleBuffer;  // resampled output, at the file rate
+    std::vector<int16_t> mOutputBuffer;  // int16 output queued to the writer
+    int32_t mScratchFrames = 0;
+
+    FarEndReference *mFarEnd = nullptr;
+
+    CallbackMetrics mMetrics;
+
+    // Applies change to the pending parameters and the classic stages they
+    // control, and publishes the graph (control threads)
+    template<typename Change>
+    void updateParams(Change &&change) {
+        std::lock_guard<std::mutex> lock(mControlLock);
+        const RecorderParams previous = mPendingParams;
+        change(mPendingParams);
+        mPendingGraph.applyClassicParams(previous, mPendingParams);
+        mChain.setGraph(mPendingGraph);
+    }
+
+    // Applies change to the pending graph and publishes it if change returns
+    // true (control threads)
+    template<typename Change>
+    bool updateGraph(Change &&change) {
+        std::lock_guard<std::mutex> lock(mControlLock);
+        if (!change(mPendingGraph)) {
+            return false;
+        }
+        mChain.setGraph(mPendingGraph);
+        return true;
+    }
+
+    // Audio thread: picks up a newly published graph, if any
+    void applyPendingParams();
+
+    // Runs the enabled chain in place over numFrames interleaved frames (at
+    // most mScratchFrames) in mProcessBuffer. captureTimeNs is when the first
+    // frame was captured, on the FarEndReference clock.
+    void processBlock(int32_t numFrames, int64_t captureTimeNs);
+
+    // Queues numFrames float frames (at the device rate) to the writer at the
+    // file's rate and in its sample format. May clamp data in place.
+    void writeOutput(float *data, int32_t numFrames, int32_t channelCount);
+
+    // Fills mChain.getFarEndBuffer() with the far end lined up with the block
+    // being processed
+    void readFarEnd(int64_t captureTimeNs, int32_t numFrames);
 };
 
 #endif //OBOESAMPLE_AUDIORECORDER_H
\ No newline at end of file
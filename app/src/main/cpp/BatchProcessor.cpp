@@ -0,0 +1,150 @@
+#include "BatchProcessor.h"
+#include "ChainProcessor.h"
+#include "CompressedAudioSource.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_TAG "BatchProcessor"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Smallest multiple of alignment that is at least frames
+static int64_t roundUp(int64_t frames, int64_t alignment) {
+    return (frames + alignment - 1) / alignment * alignment;
+}
+
+// Whether a file processed through graph in chunks, each after a warm-up,
+// comes out as it does in one go. The AGC and the playback suppressor hold
+// their gain while it's quiet, however long that goes on, so they never do.
+static bool splittable(const DspGraph &graph) {
+    return !graph.hasEnabled(StageType::AutoGain) &&
+           !graph.hasEnabled(StageType::PlaybackSuppressor);
+}
+
+BatchProcessor::BatchProcessor(int32_t numThreads) : mPool(numThreads) {
+    for (int32_t i = 0; i < mPool.getThreadCount(); i++) {
+        mProcessors.push_back(std::make_unique<OfflineProcessor>());
+    }
+}
+
+void BatchProcessor::setRawInputFormat(FileFormat format, int32_t sampleRate,
+                                       int32_t channelCount) {
+    mRawFormat = format;
+    mRawSampleRate = sampleRate;
+    mRawChannelCount = std::max(1, channelCount);
+}
+
+BatchProcessor::Result BatchProcessor::process(const std::vector<Job> &jobs) {
+    Result result;
+    const int64_t startNs = nowNs();
+    const int64_t stealsBefore = mPool.getSteals();
+    result.files = static_cast<int32_t>(jobs.size());
+    result.threads = mPool.getThreadCount();
+
+    for (auto &processor : mProcessors) {
+        processor->setGraph(mGraph);
+        processor->setRawInputFormat(mRawFormat, mRawSampleRate, mRawChannelCount);
+        processor->setOutputFormat(mOutputFormat);
+    }
+
+    std::vector<Task> tasks;
+    std::vector<bool> failed(jobs.size(), false);
+    const bool splitGraph = splittable(mGraph);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        struct stat info {};
+        if (stat(jobs[i].inputPath.c_str(), &info) != 0) {
+            LOGE("Can't read %s: %s", jobs[i].inputPath.c_str(), strerror(errno));
+            failed[i] = true;
+            continue;
+        }
+        const bool split = splitGraph && mOutputFormat != FileFormat::Lossless &&
+                           !CompressedAudioSource::isCompressedFile(jobs[i].inputPath);
+        if (!split || !addChunks(i, jobs[i], info.st_size, tasks)) {
+            tasks.push_back({i, -1, 0, 0, info.st_size});
+        }
+    }
+
+    // Longest first, so the stragglers at the end are short
+    std::stable_sort(tasks.begin(), tasks.end(),
+                     [](const Task &a, const Task &b) { return a.sizeBytes > b.sizeBytes; });
+
+    std::vector<OfflineProcessor::Result> taskResults(tasks.size());
+    std::vector<WorkStealingPool::Task> work;
+    work.reserve(tasks.size());
+    for (size_t t = 0; t < tasks.size(); t++) {
+        work.emplace_back([this, &jobs, &tasks, &taskResults, t](int32_t worker) {
+            const Task &task = tasks[t];
+            const Job &job = jobs[task.job];
+            OfflineProcessor &processor = *mProcessors[worker];
+            taskResults[t] = task.startFrame < 0
+                             ? processor.process(job.inputPath, job.outputPath)
+                             : processor.processRange(job.inputPath, job.outputPath,
+                                                      task.startFrame, task.endFrame,
+                                                      task.warmUpFrames);
+        });
+    }
+    mPool.run(std::move(work));
+
+    for (size_t t = 0; t < tasks.size(); t++) {
+        if (!taskResults[t].ok) {
+            failed[tasks[t].job] = true;
+        }
+        result.audioSeconds += taskResults[t].audioSeconds();
+    }
+    result.failedFiles = static_cast<int32_t>(std::count(failed.begin(), failed.end(), true));
+    result.tasks = static_cast<int32_t>(tasks.size());
+    result.steals = mPool.getSteals() - stealsBefore;
+    result.elapsedNs = nowNs() - startNs;
+
+    LOGD("%d files (%d failed) in %d tasks on %d threads: %.1f s of audio in %.3f s "
+         "(%.1fx real time), %lld steals", result.files, result.failedFiles, result.tasks,
+         result.threads, result.audioSeconds, static_cast<double>(result.elapsedNs) / 1e9,
+         result.speedFactor(), static_cast<long long>(result.steals));
+    return result;
+}
+
+bool BatchProcessor::addChunks(size_t job, const Job &paths, int64_t sizeBytes,
+                               std::vector<Task> &tasks) {
+    const auto inputFrameBytes =
+            static_cast<int64_t>(OfflineProcessor::bytesPerFrame(mRawFormat, mRawChannelCount));
+    const int64_t totalFrames = sizeBytes / inputFrameBytes;
+
+    // Chunks start, and their warm-ups too, on the modules' block grid
+    const int64_t alignment = ChainProcessor::getAlignmentFrames(mRawSampleRate);
+    const int64_t warmUpFrames =
+            roundUp(static_cast<int64_t>(kWarmUpSeconds * mRawSampleRate), alignment);
+    const int64_t chunkFrames = roundUp(
+            static_cast<int64_t>(std::max(mChunkSeconds, kWarmUpSeconds) * mRawSampleRate),
+            alignment);
+    if (totalFrames <= chunkFrames) {
+        return false;
+    }
+
+    // Chunks write into place, so the output has to exist at its full size
+    const auto outputBytes = static_cast<off_t>(
+            totalFrames * OfflineProcessor::bytesPerFrame(mOutputFormat, mRawChannelCount));
+    int fd = ::open(paths.outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, outputBytes) != 0) {
+        LOGE("Can't create %s: %s", paths.outputPath.c_str(), strerror(errno));
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    ::close(fd);
+
+    for (int64_t start = 0; start < totalFrames; start += chunkFrames) {
+        int64_t end = std::min(totalFrames, start + chunkFrames);
+        tasks.push_back({job, start, end, warmUpFrames, (end - start) * inputFrameBytes});
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+#ifndef OBOESAMPLE_BATCHPROCESSOR_H
+#define OBOESAMPLE_BATCHPROCESSOR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "DspGraph.h"
+#include "FileFormat.h"
+#include "OfflineProcessor.h"
+#include "RecorderParams.h"
+#include "WorkStealingPool.h"
+
+/**
+ * Reprocesses many recordings at once across all cores: OfflineProcessor
+ * spread over a WorkStealingPool.
+ *
+ * Every file is a task, and raw files longer than the chunk length are split
+ * into chunks that are processed independently and written in place into the
+ * output. Each chunk first runs the chain over kWarmUpSeconds of the audio
+ * before it, starting on the modules' block grid
+ * (ChainProcessor::getAlignmentFrames()), so the filter states, noise tracker
+ * and gate envelopes have settled to what a sequential run has there. The
+ * output matches processing the whole file in one go (see the batch-
+ * processing test).
+ *
+ * The AGC and the playback suppressor hold their gain through quiet stretches
+ * for however long those last, so no warm-up brings them to where a
+ * sequential run is. With either enabled in the graph every file is one
+ * task. So is a compressed input, or compressed output, since those can't be
+ * entered mid-stream or written in pieces.
+ *
+ * Each worker owns an OfflineProcessor, and so its own filter instances.
+ */
+class BatchProcessor {
+public:
+    // Audio each chunk runs through the chain before its first output frame.
+    // Covers the noise tracker's 1.5 s window with margin; the states of the
+    // other stages a chunk can run through settle within milliseconds.
+    static constexpr float kWarmUpSeconds = 2.5f;
+
+    // Default length raw files are split into
+    static constexpr float kDefaultChunkSeconds = 30.0f;
+
+    struct Job {
+        std::string inputPath;
+        std::string outputPath;
+    };
+
+    struct Result {
+        int32_t files = 0;
+        int32_t failedFiles = 0;
+        int32_t tasks = 0;
+        int32_t threads = 0;
+        int64_t steals = 0;
+        double audioSeconds = 0.0;
+        int64_t elapsedNs = 0;
+
+        // Audio duration / wall time over the whole batch
+        double speedFactor() const {
+            return elapsedNs > 0 ? audioSeconds * 1e9 / static_cast<double>(elapsedNs) : 0.0;
+        }
+    };
+
+    // numThreads workers, or one per core if 0
+    explicit BatchProcessor(int32_t numThreads = 0);
+
+    // Same settings as OfflineProcessor, applied to every file
+    void setGraph(const DspGraph &graph) { mGraph = graph; }
+    void setParams(const RecorderParams &params) { mGraph = DspGraph::fromParams(params); }
+    void setRawInputFormat(FileFormat format, int32_t sampleRate, int32_t channelCount);
+    void setOutputFormat(FileFormat format) { mOutputFormat = format; }
+
+    // Length raw files are split into (at least the warm-up)
+    void setChunkSeconds(float seconds) { mChunkSeconds = seconds; }
+
+    int32_t getThreadCount() const { return mPool.getThreadCount(); }
+
+    // Processes every job and returns once all are done. Not real-time safe.
+    Result process(const std::vector<Job> &jobs);
+
+private:
+    struct Task {
+        size_t job;
+        int64_t startFrame;  // -1 for a whole file
+        int64_t endFrame;
+        int64_t warmUpFrames;
+        int64_t sizeBytes;   // of input, for ordering
+    };
+
+    // Splits a raw job into chunk tasks and sizes its output. Returns false
+    // if the output can't be created.
+    bool addChunks(size_t job, const Job &paths, int64_t sizeBytes, std::vector<Task> &tasks);
+
+    DspGraph mGraph = DspGraph::fromParams(RecorderParams());
+    FileFormat mRawFormat = FileFormat::Pcm16;
+    int32_t mRawSampleRate = 48000;
+    int32_t mRawChannelCount = 1;
+    FileFormat mOutputFormat = FileFormat::Pcm16;
+    float mChunkSeconds = kDefaultChunkSeconds;
+
+    WorkStealingPool mPool;
+    std::vector<std::unique_ptr<OfflineProcessor>> mProcessors;  // one per worker
+};
+
+#endif //OBOESAMPLE_BATCHPROCESSOR_H
@@ -0,0 +1,172 @@
+#include "CallbackMetrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+CallbackMetrics::Scope::~Scope() {
+    int64_t endNs = nowNs();
+    int32_t xRunCount = mMetrics.mXRunCount.load(std::memory_order_relaxed);
+    oboe::ResultWithValue<int32_t> xRuns = mStream->getXRunCount();
+    if (xRuns) {
+        xRunCount = xRuns.value();
+    }
+    mMetrics.record(mStartNs, endNs, mNumFrames, mStream->getSampleRate(), xRunCount);
+}
+
+int64_t CallbackMetrics::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t CallbackMetrics::bucketStartNs(int bucket) {
+    if (bucket <= 0) {
+        return 0;
+    }
+    // kSubBuckets linear steps within each octave of microseconds
+    int octave = (bucket - 1) / kSubBuckets;
+    int step = (bucket - 1) % kSubBuckets;
+    return (static_cast<int64_t>(kSubBuckets + step) << octave) * 1000 / kSubBuckets;
+}
+
+int CallbackMetrics::bucketIndex(int64_t ns) {
+    if (ns < 1000) {
+        return 0;
+    }
+    // In units of 1/kSubBuckets us, so the kSubBuckets (4) steps of every
+    // octave are whole numbers: the top bit gives the octave, the next two the step
+    auto quarters = static_cast<uint64_t>(ns * kSubBuckets / 1000);
+    int topBit = 63 - __builtin_clzll(quarters);
+    int octave = topBit - 2;
+    if (octave >= kOctaves) {
+        return kNumBuckets - 1;
+    }
+    int step = static_cast<int>((quarters >> octave) & (kSubBuckets - 1));
+    return 1 + octave * kSubBuckets + step;
+}
+
+void CallbackMetrics::record(int64_t startNs, int64_t endNs, int32_t numFrames,
+                             int32_t sampleRate, int32_t xRunCount) {
+    const int64_t processingNs = std::max<int64_t>(0, endNs - startNs);
+    const int64_t budgetNs = sampleRate > 0 ? int64_t(numFrames) * 1000000000 / sampleRate : 0;
+    const int64_t callbacks = mCallbacks.load(std::memory_order_relaxed);
+
+    // Odd while the fields are being updated
+    const uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+    mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (callbacks > 0) {
+        const int64_t periodNs = startNs - mLastStartNs;
+        store(mPeriodSumNs, mPeriodSumNs.load(std::memory_order_relaxed) + periodNs);
+        store(mPeriodMaxNs, std::max(mPeriodMaxNs.load(std::memory_order_relaxed), periodNs));
+    }
+    mLastStartNs = startNs;
+
+    store(mCallbacks, callbacks + 1);
+    store(mFrames, mFrames.load(std::memory_order_relaxed) + numFrames);
+    store(mProcessingSumNs, mProcessingSumNs.load(std::memory_order_relaxed) + processingNs);
+    store(mProcessingMaxNs,
+          std::max(mProcessingMaxNs.load(std::memory_order_relaxed), processingNs));
+    store(mBudgetSumNs, mBudgetSumNs.load(std::memory_order_relaxed) + budgetNs);
+    store(mLastBudgetNs, budgetNs);
+    if (budgetNs > 0) {
+        float utilization = static_cast<float>(processingNs) / static_cast<float>(budgetNs);
+        store(mMaxUtilization,
+              std::max(mMaxUtilization.load(std::memory_order_relaxed), utilization));
+        if (processingNs > budgetNs) {
+            store(mOverruns, mOverruns.load(std::memory_order_relaxed) + 1);
+        }
+    }
+    store(mXRunCount, xRunCount);
+    std::atomic<int64_t> &bucket = mHistogram[bucketIndex(processingNs)];
+    store(bucket, bucket.load(std::memory_order_relaxed) + 1);
+
+    mSequence.store(sequence + 2, std::memory_order_release);
+}
+
+CallbackMetrics::Snapshot CallbackMetrics::snapshot() const {
+    Snapshot s;
+    uint32_t before;
+    uint32_t after;
+    do {
+        before = mSequence.load(std::memory_order_acquire);
+        if (before & 1u) {
+            continue;
+        }
+        s.callbacks = mCallbacks.load(std::memory_order_relaxed);
+        s.frames = mFrames.load(std::memory_order_relaxed);
+        s.processingSumNs = mProcessingSumNs.load(std::memory_order_relaxed);
+        s.processingMaxNs = mProcessingMaxNs.load(std::memory_order_relaxed);
+        s.periodSumNs = mPeriodSumNs.load(std::memory_order_relaxed);
+        s.periodMaxNs = mPeriodMaxNs.load(std::memory_order_relaxed);
+        s.budgetSumNs = mBudgetSumNs.load(std::memory_order_relaxed);
+        s.lastBudgetNs = mLastBudgetNs.load(std::memory_order_relaxed);
+        s.maxUtilization = mMaxUtilization.load(std::memory_order_relaxed);
+        s.overruns = mOverruns.load(std::memory_order_relaxed);
+        s.xRunCount = mXRunCount.load(std::memory_order_relaxed);
+        for (int b = 0; b < kNumBuckets; b++) {
+            s.histogram[b] = mHistogram[b].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = mSequence.load(std::memory_order_relaxed);
+    } while ((before & 1u) || before != after);
+    return s;
+}
+
+void CallbackMetrics::reset() {
+    mSequence.store(0, std::memory_order_relaxed);
+    mCallbacks.store(0, std::memory_order_relaxed);
+    mFrames.store(0, std::memory_order_relaxed);
+    mProcessingSumNs.store(0, std::memory_order_relaxed);
+    mProcessingMaxNs.store(0, std::memory_order_relaxed);
+    mPeriodSumNs.store(0, std::memory_order_relaxed);
+    mPeriodMaxNs.store(0, std::memory_order_relaxed);
+    mBudgetSumNs.store(0, std::memory_order_relaxed);
+    mLastBudgetNs.store(0, std::memory_order_relaxed);
+    mMaxUtilization.store(0.0f, std::memory_order_relaxed);
+    mOverruns.store(0, std::memory_order_relaxed);
+    mXRunCount.store(0, std::memory_order_relaxed);
+    for (auto &bucket : mHistogram) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    mLastStartNs = 0;
+}
+
+int64_t CallbackMetrics::Snapshot::meanProcessingNs() const {
+    return callbacks > 0 ? processingSumNs / callbacks : 0;
+}
+
+int64_t CallbackMetrics::Snapshot::meanPeriodNs() const {
+    return callbacks > 1 ? periodSumNs / (callbacks - 1) : 0;
+}
+
+float CallbackMetrics::Snapshot::meanUtilization() const {
+    return budgetSumNs > 0 ? static_cast<float>(processingSumNs) / budgetSumNs : 0.0f;
+}
+
+int64_t CallbackMetrics::Snapshot::percentileNs(double percentile) const {
+    if (callbacks <= 0) {
+        return 0;
+    }
+    auto rank = static_cast<int64_t>(percentile / 100.0 * static_cast<double>(callbacks));
+    rank = std::max<int64_t>(1, std::min(rank, callbacks));
+    int64_t seen = 0;
+    for (int b = 0; b < kNumBuckets; b++) {
+        seen += histogram[b];
+        if (seen >= rank) {
+            return b + 1 < kNumBuckets ? bucketStartNs(b + 1) : processingMaxNs;
+        }
+    }
+    return processingMaxNs;
+}
+
+void CallbackMetrics::Snapshot::formatSummary(char *out, size_t size) const {
+    snprintf(out, size,
+             "%lld callbacks, mean %lld us, p99 %lld us, max %lld us, period %lld us, "
+             "utilization %.0f%% (max %.0f%%), overruns %lld, xruns %d",
+             static_cast<long long>(callbacks), static_cast<long long>(meanProcessingNs() / 1000),
+             static_cast<long long>(percentileNs(99.0) / 1000),
+             static_cast<long long>(processingMaxNs / 1000),
+             static_cast<long long>(meanPeriodNs() / 1000), meanUtilization() * 100.0f,
+             maxUtilization * 100.0f, static_cast<long long>(overruns), xRunCount);
+}
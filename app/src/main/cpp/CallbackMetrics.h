@@ -0,0 +1,117 @@
+#ifndef OBOESAMPLE_CALLBACKMETRICS_H
+#define OBOESAMPLE_CALLBACKMETRICS_H
+
+#include <oboe/Oboe.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Lock-free timing statistics for one stream's data callback.
+ *
+ * For every callback the audio thread records how long it took, the period
+ * since the previous callback, its budget (the duration of the frames it was
+ * asked for) and the stream's xrun count. Processing times also go into a
+ * log-scale histogram with kSubBuckets buckets per octave, from 1 us to ~1 s.
+ *
+ * The audio thread is the only writer and never waits: every field is a
+ * relaxed atomic it just stores, bracketed by a sequence counter. snapshot()
+ * may be called from any thread and retries if a callback finished while it
+ * was copying, so it always returns the state after some whole callback.
+ */
+class CallbackMetrics {
+public:
+    static constexpr int kSubBuckets = 4;
+    static constexpr int kOctaves = 20;
+    // Bucket 0 holds everything under 1 us
+    static constexpr int kNumBuckets = 1 + kOctaves * kSubBuckets;
+
+    struct Snapshot {
+        int64_t callbacks = 0;
+        int64_t frames = 0;
+        int64_t processingSumNs = 0;
+        int64_t processingMaxNs = 0;
+        int64_t periodSumNs = 0;      // over callbacks - 1 periods
+        int64_t periodMaxNs = 0;
+        int64_t budgetSumNs = 0;
+        int64_t lastBudgetNs = 0;
+        float maxUtilization = 0.0f;  // worst processing / budget of one callback
+        int64_t overruns = 0;         // callbacks that took longer than their budget
+        int32_t xRunCount = 0;        // as last reported by the stream
+        int64_t histogram[kNumBuckets] = {};
+
+        int64_t meanProcessingNs() const;
+        int64_t meanPeriodNs() const;
+
+        // Processing time over the whole run as a fraction of the budget
+        float meanUtilization() const;
+
+        // Upper edge of the histogram bucket holding the given percentile
+        // (0..100) of processing times
+        int64_t percentileNs(double percentile) const;
+
+        // One-line summary for logs
+        void formatSummary(char *out, size_t size) const;
+    };
+
+    // Audio thread: records the callback it is constructed in when it goes
+    // out of scope
+    class Scope {
+    public:
+        Scope(CallbackMetrics &metrics, oboe::AudioStream *stream, int32_t numFrames)
+                : mMetrics(metrics), mStream(stream), mNumFrames(numFrames),
+                  mStartNs(nowNs()) {}
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        CallbackMetrics &mMetrics;
+        oboe::AudioStream *mStream;
+        int32_t mNumFrames;
+        int64_t mStartNs;
+    };
+
+    // Audio thread: one callback that ran from startNs to endNs over numFrames
+    // frames at sampleRate
+    void record(int64_t startNs, int64_t endNs, int32_t numFrames, int32_t sampleRate,
+                int32_t xRunCount);
+
+    // Any thread
+    Snapshot snapshot() const;
+
+    // Clears everything. Only call while no callback is running.
+    void reset();
+
+    // Lower edge of a histogram bucket
+    static int64_t bucketStartNs(int bucket);
+    static int bucketIndex(int64_t ns);
+
+    static int64_t nowNs();
+
+private:
+    // Audio thread: plain store of a value only it writes
+    template<typename T>
+    static void store(std::atomic<T> &field, T value) {
+        field.store(value, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint32_t> mSequence{0};
+    std::atomic<int64_t> mCallbacks{0};
+    std::atomic<int64_t> mFrames{0};
+    std::atomic<int64_t> mProcessingSumNs{0};
+    std::atomic<int64_t> mProcessingMaxNs{0};
+    std::atomic<int64_t> mPeriodSumNs{0};
+    std::atomic<int64_t> mPeriodMaxNs{0};
+    std::atomic<int64_t> mBudgetSumNs{0};
+    std::atomic<int64_t> mLastBudgetNs{0};
+    std::atomic<float> mMaxUtilization{0.0f};
+    std::atomic<int64_t> mOverruns{0};
+    std::atomic<int32_t> mXRunCount{0};
+    std::atomic<int64_t> mHistogram[kNumBuckets] = {};
+
+    int64_t mLastStartNs = 0;  // audio thread only
+};
+
+#endif //OBOESAMPLE_CALLBACKMETRICS_H
@@ -0,0 +1,92 @@
+#include "ChainProcessor.h"
+#include "filter/EchoCanceller.h"
+#include "filter/NoiseReduction.h"
+#include "filter/PlaybackSuppressor.h"
+#include <algorithm>
+#include <numeric>
+
+ChainProcessor::ChainProcessor() {
+    prepare(mSampleRate, 1, 0, DspGraph());
+}
+
+ChainProcessor::~ChainProcessor() {
+    collectRetired();
+    delete mPendingPlan.exchange(nullptr);
+    delete mActivePlan;
+}
+
+void ChainProcessor::prepare(int32_t sampleRate, int32_t channelCount, int32_t maxFrames,
+                             const DspGraph &graph) {
+    std::lock_guard<std::mutex> lock(mCompileLock);
+    mSampleRate = sampleRate;
+    mChannelCount = std::max(1, channelCount);
+    mMaxFrames = std::max(0, maxFrames);
+    mFarEndBuffer.assign(static_cast<size_t>(mMaxFrames), 0.0f);
+
+    // Nothing is processing, so every plan can go and the new one is active at once
+    collectRetired();
+    delete mPendingPlan.exchange(nullptr);
+    delete mActivePlan;
+    mActivePlan = ExecutionPlan::compile(graph, mSampleRate, mChannelCount, mMaxFrames,
+                                         nullptr).release();
+    mActivePlan->setVoiceActivity(&mVoiceActivity);
+    mVoiceActivity.reset();
+    mLatestPlan = mActivePlan;
+    mGraph = graph;
+    mGraphMailbox.write(graph);
+    mGraphMailbox.read();
+}
+
+void ChainProcessor::setGraph(const DspGraph &graph) {
+    std::lock_guard<std::mutex> lock(mCompileLock);
+    collectRetired();
+
+    // The settings go out first: update() configures a newly taken plan from
+    // the mailbox, and must not find the old graph there
+    const bool restructured = !graph.sameStructure(mGraph);
+    mGraph = graph;
+    mGraphMailbox.write(graph);
+
+    if (restructured) {
+        ExecutionPlan *plan = ExecutionPlan::compile(graph, mSampleRate, mChannelCount,
+                                                     mMaxFrames, mLatestPlan).release();
+        plan->setVoiceActivity(&mVoiceActivity);
+        mLatestPlan = plan;
+        // A plan the audio thread never took is dropped; the new one shares
+        // whatever it needs from it
+        delete mPendingPlan.exchange(plan, std::memory_order_acq_rel);
+    }
+}
+
+void ChainProcessor::update() {
+    if (ExecutionPlan *next = mPendingPlan.exchange(nullptr, std::memory_order_acq_rel)) {
+        ExecutionPlan *retired = mActivePlan;
+        retired->mNextRetired = mRetiredPlans.load(std::memory_order_relaxed);
+        while (!mRetiredPlans.compare_exchange_weak(retired->mNextRetired, retired,
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed)) {
+        }
+        mActivePlan = next;
+        // Shared stages still run with the settings of the plan they came from
+        mGraphMailbox.read();
+        mActivePlan->configure(mGraphMailbox.front());
+    } else if (mGraphMailbox.read()) {
+        mActivePlan->configure(mGraphMailbox.front());
+    }
+}
+
+void ChainProcessor::collectRetired() {
+    ExecutionPlan *plan = mRetiredPlans.exchange(nullptr, std::memory_order_acquire);
+    while (plan != nullptr) {
+        ExecutionPlan *next = plan->mNextRetired;
+        delete plan;
+        plan = next;
+    }
+}
+
+int32_t ChainProcessor::getAlignmentFrames(int32_t sampleRate) {
+    int32_t alignment = NoiseReduction(sampleRate).getPeriodFrames();
+    alignment = std::lcm(alignment, EchoCanceller(sampleRate).getBlockSize());
+    alignment = std::lcm(alignment, PlaybackSuppressor(sampleRate).getWindowSize());
+    return alignment;
+}
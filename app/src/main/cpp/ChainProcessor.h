@@ -0,0 +1,118 @@
+#ifndef OBOESAMPLE_CHAINPROCESSOR_H
+#define OBOESAMPLE_CHAINPROCESSOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "DspGraph.h"
+#include "ExecutionPlan.h"
+#include "TripleBuffer.h"
+#include "VoiceActivity.h"
+
+/**
+ * The recorder's processing chain: a DspGraph compiled into an ExecutionPlan,
+ * and the hand-over of new graphs from the control threads to the audio thread.
+ *
+ * AudioRecorder runs one from its data callback and OfflineProcessor runs one
+ * over files, so both give identical output for the same graph.
+ *
+ * prepare() compiles a graph for a stream and installs it directly; nothing
+ * may be processing at the time. While the stream runs, control threads call
+ * setGraph():
+ *  - A graph with the same structure as the last one (the same enabled stages
+ *    in the same order) only carries new settings. It is published through a
+ *    TripleBuffer and the audio thread reconfigures the affected stages itself.
+ *  - Any other graph is compiled right there, on the control thread, into a
+ *    new plan that shares the stages that kept their id and type with the
+ *    previous one. The plan is posted to a pending slot and the audio thread
+ *    swaps it in at its next block with a single exchange. The plan it
+ *    replaces is pushed onto a lock-free retired list, which the control
+ *    thread empties and deletes on its next setGraph() or prepare(), so the
+ *    audio thread never frees anything. A plan posted before the previous one
+ *    was taken simply replaces it.
+ *
+ * Every plan publishes its suppressors' decisions to the processor's
+ * VoiceActivity, which any thread may read.
+ *
+ * update() and process() never allocate, lock or free and are safe on the
+ * audio thread.
+ */
+class ChainProcessor {
+public:
+    ChainProcessor();
+    ~ChainProcessor();
+
+    ChainProcessor(const ChainProcessor &) = delete;
+    ChainProcessor &operator=(const ChainProcessor &) = delete;
+
+    // Compiles graph for channelCount channels at sampleRate, with room for
+    // blocks of up to maxFrames, and makes it active. Every stage starts from
+    // a clean state. Not while process() may be running.
+    void prepare(int32_t sampleRate, int32_t channelCount, int32_t maxFrames,
+                 const DspGraph &graph);
+
+    // Control threads: makes graph the one update() picks up next (see above)
+    void setGraph(const DspGraph &graph);
+
+    // Audio thread: swaps in a newly compiled plan and applies newly published
+    // settings, if there are any. Call at a block boundary, before process().
+    void update();
+
+    // Whether the active plan does anything / needs the far end
+    bool isActive() const { return !mActivePlan->isEmpty(); }
+    bool usesFarEnd() const { return mActivePlan->usesFarEnd(); }
+
+    // Speech decisions of the active plan's suppressor; cleared by prepare()
+    const VoiceActivity &getVoiceActivity() const { return mVoiceActivity; }
+
+    int32_t getSampleRate() const { return mSampleRate; }
+    int32_t getChannelCount() const { return mChannelCount; }
+    int32_t getMaxFrames() const { return mMaxFrames; }
+
+    // Least common multiple of the block, frame and window periods of the
+    // modules at sampleRate. Two runs over the same audio that start a multiple of this
+    // apart see the same block boundaries in every module, so their states
+    // converge once the warm-up has flushed the history.
+    static int32_t getAlignmentFrames(int32_t sampleRate);
+
+    // Mono far-end reference for the next process() call, one sample per
+    // frame, getMaxFrames() long. Stays silent unless the caller fills it.
+    float *getFarEndBuffer() { return mFarEndBuffer.data(); }
+
+    // Runs the active plan in place over numFrames (at most getMaxFrames())
+    // interleaved frames, one step at a time over the whole block, each
+    // channel on its own state
+    void process(float *buffer, int32_t numFrames) {
+        mActivePlan->process(buffer, numFrames, mFarEndBuffer.data());
+    }
+
+private:
+    // Control side: deletes the plans the audio thread has retired
+    void collectRetired();
+
+    int32_t mSampleRate = 48000;
+    int32_t mChannelCount = 1;
+    int32_t mMaxFrames = 0;
+
+    std::vector<float> mFarEndBuffer;  // mono far-end reference, one sample per frame
+    VoiceActivity mVoiceActivity;
+
+    // Control side, under mCompileLock: the last graph set and the plan
+    // compiled for its structure (active or still pending)
+    std::mutex mCompileLock;
+    DspGraph mGraph;
+    ExecutionPlan *mLatestPlan = nullptr;
+
+    // Audio thread's plan, and where plans change hands: the newest compiled
+    // plan not yet taken, and the head of the retired list (linked through
+    // ExecutionPlan::mNextRetired)
+    ExecutionPlan *mActivePlan = nullptr;
+    std::atomic<ExecutionPlan *> mPendingPlan{nullptr};
+    std::atomic<ExecutionPlan *> mRetiredPlans{nullptr};
+
+    // Settings for graphs that kept the structure
+    TripleBuffer<DspGraph> mGraphMailbox;
+};
+
+#endif //OBOESAMPLE_CHAINPROCESSOR_H
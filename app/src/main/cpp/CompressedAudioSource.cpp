@@ -0,0 +1,152 @@
+#include "CompressedAudioSource.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define LOG_TAG "CompressedAudioSource"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Decoded audio queued ahead of the callback
+constexpr int32_t kRingSeconds = 2;
+constexpr size_t kMinBlocksInRing = 4;
+
+// How long the decoder sleeps when the ring has no room for another block
+constexpr auto kPollInterval = std::chrono::milliseconds(10);
+
+CompressedAudioSource::~CompressedAudioSource() {
+    close();
+}
+
+bool CompressedAudioSource::isCompressedFile(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    uint8_t header[LosslessFormat::kFileHeaderBytes];
+    ssize_t count = ::read(fd, header, sizeof(header));
+    ::close(fd);
+    LosslessFormat format;
+    return count == static_cast<ssize_t>(sizeof(header)) &&
+           format.parseFileHeader(header, sizeof(header));
+}
+
+bool CompressedAudioSource::open(const std::string &path) {
+    close();
+
+    mFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFd < 0) {
+        LOGE("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    uint8_t header[LosslessFormat::kFileHeaderBytes];
+    LosslessFormat format;
+    if (!readFully(header, sizeof(header)) || !format.parseFileHeader(header, sizeof(header))) {
+        LOGE("%s is not a compressed recording", path.c_str());
+        ::close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    mDecoder.init(format);
+    size_t blockSamples = static_cast<size_t>(format.blockFrames) * format.channelCount;
+    mBlock.assign(blockSamples, 0);
+    mPayload.resize(format.maxPayloadBytes());
+    mRing.allocate(std::max(static_cast<size_t>(format.sampleRate) * format.channelCount *
+                            kRingSeconds, blockSamples * kMinBlocksInRing));
+    mUnderruns.store(0, std::memory_order_relaxed);
+
+    // Start with half the ring decoded
+    bool more = true;
+    while (more && mRing.availableToRead() < mRing.capacity() / 2) {
+        more = decodeNextBlock();
+    }
+    mDecodeDone.store(!more, std::memory_order_relaxed);
+
+    mStopRequested.store(false, std::memory_order_relaxed);
+    mDecoderThread.start("AudioDecoder", [this] { decoderLoop(); });
+    mOpen = true;
+
+    LOGD("Decoding %s: %d Hz, %d channels, %d-frame blocks", path.c_str(), format.sampleRate,
+         format.channelCount, format.blockFrames);
+    return true;
+}
+
+void CompressedAudioSource::close() {
+    if (!mOpen) {
+        return;
+    }
+    mStopRequested.store(true, std::memory_order_release);
+    mDecoderThread.join();
+
+    ::close(mFd);
+    mFd = -1;
+    mOpen = false;
+    LOGD("Closed, %lld underruns", static_cast<long long>(getUnderruns()));
+}
+
+size_t CompressedAudioSource::read(int16_t *dest, size_t numSamples) {
+    // Checked first: if decoding was done before the read, a short read is the end
+    bool done = mDecodeDone.load(std::memory_order_acquire);
+    size_t count = mRing.read(dest, numSamples);
+    if (count < numSamples) {
+        memset(dest + count, 0, (numSamples - count) * sizeof(int16_t));
+        if (!done) {
+            mUnderruns.fetch_add(1, std::memory_order_relaxed);
+            return numSamples;
+        }
+    }
+    return count;
+}
+
+void CompressedAudioSource::decoderLoop() {
+    const size_t blockSamples = mBlock.size();
+    while (!mStopRequested.load(std::memory_order_acquire) &&
+           !mDecodeDone.load(std::memory_order_relaxed)) {
+        if (mRing.availableToWrite() >= blockSamples) {
+            if (!decodeNextBlock()) {
+                mDecodeDone.store(true, std::memory_order_release);
+            }
+        } else {
+            WorkerThread::sleepFor(kPollInterval);
+        }
+    }
+}
+
+bool CompressedAudioSource::decodeNextBlock() {
+    const LosslessFormat &format = mDecoder.getFormat();
+    uint8_t header[LosslessFormat::kBlockHeaderBytes];
+    if (!readFully(header, sizeof(header))) {
+        return false;
+    }
+
+    int32_t frames;
+    uint32_t payloadBytes;
+    if (!format.parseBlockHeader(header, frames, payloadBytes) ||
+        !readFully(mPayload.data(), payloadBytes) ||
+        !mDecoder.decodeBlock(mPayload.data(), payloadBytes, frames, mBlock.data())) {
+        LOGE("Corrupt or truncated block, ending playback");
+        return false;
+    }
+    mRing.write(mBlock.data(), static_cast<size_t>(frames) * format.channelCount);
+    return true;
+}
+
+bool CompressedAudioSource::readFully(void *data, size_t numBytes) {
+    auto *bytes = static_cast<char *>(data);
+    while (numBytes > 0) {
+        ssize_t count = ::read(mFd, bytes, numBytes);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        numBytes -= static_cast<size_t>(count);
+    }
+    return true;
+}
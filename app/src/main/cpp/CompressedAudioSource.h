@@ -0,0 +1,84 @@
+#ifndef OBOESAMPLE_COMPRESSEDAUDIOSOURCE_H
+#define OBOESAMPLE_COMPRESSEDAUDIOSOURCE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "LosslessCodec.h"
+#include "SpscRingBuffer.h"
+#include "WorkerThread.h"
+
+/**
+ * Plays back a losslessly compressed recording (see LosslessCodec.h).
+ *
+ * A decoder thread reads the file block by block, decodes it and queues the
+ * PCM in an SPSC ring; the audio callback only copies out of the ring. open()
+ * decodes the first half of the ring itself, so playback starts with a cushion
+ * and the decoder only has to keep up with real time from there.
+ *
+ * If the decoder ever falls behind, the callback plays silence for what's
+ * missing and counts an underrun rather than waiting. A corrupt block ends
+ * the stream early.
+ */
+class CompressedAudioSource {
+public:
+    CompressedAudioSource() = default;
+    ~CompressedAudioSource();
+
+    CompressedAudioSource(const CompressedAudioSource &) = delete;
+    CompressedAudioSource &operator=(const CompressedAudioSource &) = delete;
+
+    // True if the file at path starts with a compressed-recording header
+    static bool isCompressedFile(const std::string &path);
+
+    // Opens the file, decodes the first stretch and starts the decoder
+    // thread. Not real-time safe.
+    bool open(const std::string &path);
+
+    // Stops the decoder thread and closes the file. Only call once the
+    // callback has stopped reading.
+    void close();
+
+    bool isOpen() const { return mOpen; }
+
+    int32_t getSampleRate() const { return mDecoder.getFormat().sampleRate; }
+    int32_t getChannelCount() const { return mDecoder.getFormat().channelCount; }
+
+    // Audio thread: copies numSamples samples into dest, padding with silence
+    // for whatever isn't decoded. Returns fewer than numSamples only once the
+    // whole stream has been played.
+    size_t read(int16_t *dest, size_t numSamples);
+
+    int64_t getUnderruns() const { return mUnderruns.load(std::memory_order_relaxed); }
+
+    // Scheduling and wake-ups of the decoder thread
+    WorkerThread::Stats getThreadStats() const { return mDecoderThread.getStats(); }
+
+private:
+    void decoderLoop();
+
+    // Decodes the next block into the ring. Returns false at the end of the
+    // stream (or on a corrupt block).
+    bool decodeNextBlock();
+
+    bool readFully(void *data, size_t numBytes);
+
+    int mFd = -1;
+    bool mOpen = false;
+
+    LosslessDecoder mDecoder;
+    std::vector<uint8_t> mPayload;
+    std::vector<int16_t> mBlock;
+
+    SpscRingBuffer<int16_t> mRing;
+    WorkerThread mDecoderThread;
+    std::atomic<bool> mStopRequested{false};
+    // Set once everything decodable is in the ring
+    std::atomic<bool> mDecodeDone{false};
+
+    std::atomic<int64_t> mUnderruns{0};
+};
+
+#endif //OBOESAMPLE_COMPRESSEDAUDIOSOURCE_H
@@ -0,0 +1,218 @@
+#include "DspGraph.h"
+#include <algorithm>
+
+void StageConfig::set(StageParam param, float value) {
+    switch (param) {
+        case StageParam::Amount: amount = value; break;
+        case StageParam::DelayMs: delayMs = value; break;
+        case StageParam::ThresholdDb: thresholdDb = value; break;
+        case StageParam::Ratio: ratio = value; break;
+        case StageParam::AttackMs: attackMs = value; break;
+        case StageParam::ReleaseMs: releaseMs = value; break;
+        case StageParam::Frequency: frequency = value; break;
+        case StageParam::Q: q = value; break;
+        case StageParam::GainDb: gainDb = value; break;
+        case StageParam::TargetDb: targetDb = value; break;
+        case StageParam::MaxGainDb: maxGainDb = value; break;
+        case StageParam::CeilingDb: ceilingDb = value; break;
+    }
+}
+
+// Every setting of a stage, for copying them one by one
+static constexpr float StageConfig::*kSettings[] = {
+        &StageConfig::amount, &StageConfig::delayMs, &StageConfig::thresholdDb,
+        &StageConfig::ratio, &StageConfig::attackMs, &StageConfig::releaseMs,
+        &StageConfig::frequency, &StageConfig::q, &StageConfig::gainDb,
+        &StageConfig::targetDb, &StageConfig::maxGainDb, &StageConfig::ceilingDb,
+};
+
+bool StageConfig::sameSettings(const StageConfig &other) const {
+    return amount == other.amount && delayMs == other.delayMs &&
+           thresholdDb == other.thresholdDb && ratio == other.ratio &&
+           attackMs == other.attackMs && releaseMs == other.releaseMs &&
+           frequency == other.frequency && q == other.q && gainDb == other.gainDb &&
+           targetDb == other.targetDb && maxGainDb == other.maxGainDb &&
+           ceilingDb == other.ceilingDb;
+}
+
+StageConfig StageConfig::defaults(StageType type) {
+    StageConfig stage = DspGraph::classicStage(RecorderParams(), type);
+    stage.id = 0;
+    stage.enabled = true;
+    return stage;
+}
+
+StageConfig DspGraph::classicStage(const RecorderParams &params, StageType type) {
+    StageConfig stage;
+    stage.id = classicStageId(type);
+    stage.type = type;
+    switch (type) {
+        case StageType::PlaybackSuppressor:
+            stage.enabled = params.playbackSuppressorEnabled;
+            stage.amount = params.suppressorAggressiveness;
+            break;
+        case StageType::EchoCanceller:
+            stage.enabled = params.echoCancellerEnabled;
+            stage.amount = params.echoSuppression;
+            stage.delayMs = params.echoDelayMs;
+            break;
+        case StageType::NoiseReduction:
+            stage.enabled = params.noiseReductionEnabled;
+            stage.amount = params.noiseReductionAmount;
+            break;
+        case StageType::NoiseGate:
+            stage.enabled = params.noiseGateEnabled;
+            stage.thresholdDb = params.gateThresholdDb;
+            stage.ratio = params.gateRatio;
+            stage.attackMs = params.gateAttackMs;
+            stage.releaseMs = params.gateReleaseMs;
+            break;
+        case StageType::Bandpass:
+            stage.enabled = params.bandpassEnabled;
+            stage.frequency = params.bandpassFreq;
+            stage.q = params.bandpassQ;
+            break;
+        case StageType::Peaking:
+            stage.enabled = params.peakingEnabled;
+            stage.frequency = params.peakingFreq;
+            stage.q = params.peakingQ;
+            stage.gainDb = params.peakingGainDb;
+            break;
+        case StageType::HighShelf:
+            stage.enabled = params.highShelfEnabled;
+            stage.frequency = params.highShelfFreq;
+            stage.q = params.highShelfQ;
+            stage.gainDb = params.highShelfGainDb;
+            break;
+        case StageType::AutoGain:
+            stage.enabled = params.autoGainEnabled;
+            stage.targetDb = params.agcTargetDb;
+            stage.maxGainDb = params.agcMaxGainDb;
+            stage.thresholdDb = params.agcNoiseFloorDb;
+            stage.attackMs = params.agcAttackMs;
+            stage.releaseMs = params.agcReleaseMs;
+            stage.ceilingDb = params.limiterCeilingDb;
+            break;
+    }
+    return stage;
+}
+
+DspGraph DspGraph::fromParams(const RecorderParams &params) {
+    DspGraph graph;
+    for (int32_t type = 0; type < kNumStageTypes; type++) {
+        graph.insertStage(classicStage(params, static_cast<StageType>(type)));
+    }
+    return graph;
+}
+
+int32_t DspGraph::addStage(StageType type, int32_t position) {
+    StageConfig stage = StageConfig::defaults(type);
+    stage.id = mNextId;
+    if (!insertStage(stage, position)) {
+        return -1;
+    }
+    return stage.id;
+}
+
+bool DspGraph::insertStage(const StageConfig &stage, int32_t position) {
+    if (mNumStages >= kMaxStages || findStage(stage.id) != nullptr) {
+        return false;
+    }
+    if (position < 0 || position > mNumStages) {
+        position = mNumStages;
+    }
+    std::copy_backward(mStages + position, mStages + mNumStages, mStages + mNumStages + 1);
+    mStages[position] = stage;
+    mNumStages++;
+    mNextId = std::max(mNextId, stage.id + 1);
+    return true;
+}
+
+bool DspGraph::removeStage(int32_t id) {
+    StageConfig *stage = findStage(id);
+    if (stage == nullptr) {
+        return false;
+    }
+    std::copy(stage + 1, mStages + mNumStages, stage);
+    mNumStages--;
+    return true;
+}
+
+bool DspGraph::moveStage(int32_t id, int32_t position) {
+    StageConfig *stage = findStage(id);
+    if (stage == nullptr) {
+        return false;
+    }
+    const auto from = static_cast<int32_t>(stage - mStages);
+    const int32_t to = std::clamp(position, 0, mNumStages - 1);
+    if (from < to) {
+        std::rotate(mStages + from, mStages + from + 1, mStages + to + 1);
+    } else if (to < from) {
+        std::rotate(mStages + to, mStages + from, mStages + from + 1);
+    }
+    return true;
+}
+
+StageConfig *DspGraph::findStage(int32_t id) {
+    for (int32_t i = 0; i < mNumStages; i++) {
+        if (mStages[i].id == id) return &mStages[i];
+    }
+    return nullptr;
+}
+
+const StageConfig *DspGraph::findStage(int32_t id) const {
+    return const_cast<DspGraph *>(this)->findStage(id);
+}
+
+bool DspGraph::anyEnabled() const {
+    for (int32_t i = 0; i < mNumStages; i++) {
+        if (mStages[i].enabled) return true;
+    }
+    return false;
+}
+
+bool DspGraph::hasEnabled(StageType type) const {
+    for (int32_t i = 0; i < mNumStages; i++) {
+        if (mStages[i].enabled && mStages[i].type == type) return true;
+    }
+    return false;
+}
+
+bool DspGraph::sameStructure(const DspGraph &other) const {
+    int32_t i = 0;
+    int32_t j = 0;
+    while (true) {
+        while (i < mNumStages && !mStages[i].enabled) i++;
+        while (j < other.mNumStages && !other.mStages[j].enabled) j++;
+        if (i == mNumStages || j == other.mNumStages) {
+            return i == mNumStages && j == other.mNumStages;
+        }
+        if (mStages[i].id != other.mStages[j].id || mStages[i].type != other.mStages[j].type) {
+            return false;
+        }
+        i++;
+        j++;
+    }
+}
+
+void DspGraph::applyClassicParams(const RecorderParams &previous, const RecorderParams &params) {
+    for (int32_t index = 0; index < kNumStageTypes; index++) {
+        const auto type = static_cast<StageType>(index);
+        StageConfig *stage = findStage(classicStageId(type));
+        if (stage == nullptr || stage->type != type) {
+            continue;
+        }
+        const StageConfig before = classicStage(previous, type);
+        const StageConfig after = classicStage(params, type);
+        if (before.enabled != after.enabled) {
+            stage->enabled = after.enabled;
+        }
+        // Only the settings the params changed; the rest may have been set
+        // through the stage API since
+        for (float StageConfig::*setting : kSettings) {
+            if (before.*setting != after.*setting) {
+                stage->*setting = after.*setting;
+            }
+        }
+    }
+}
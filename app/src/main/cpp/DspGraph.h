@@ -0,0 +1,134 @@
+#ifndef OBOESAMPLE_DSPGRAPH_H
+#define OBOESAMPLE_DSPGRAPH_H
+
+#include <cstdint>
+#include "RecorderParams.h"
+
+// Kinds of processing stage, matching the JNI type index
+enum class StageType : int32_t {
+    PlaybackSuppressor = 0,
+    EchoCanceller = 1,
+    NoiseReduction = 2,
+    NoiseGate = 3,
+    Bandpass = 4,
+    Peaking = 5,
+    HighShelf = 6,
+    AutoGain = 7,
+};
+
+constexpr int32_t kNumStageTypes = 8;
+
+// Stage settings that can be set by index, matching the JNI parameter index.
+// Each type only reads the ones that apply to it.
+enum class StageParam : int32_t {
+    Amount = 0,       // suppressor aggressiveness, echo suppression, noise reduction amount
+    DelayMs = 1,      // echo canceller
+    ThresholdDb = 2,  // noise gate; auto gain's noise floor
+    Ratio = 3,
+    AttackMs = 4,
+    ReleaseMs = 5,
+    Frequency = 6,    // filters
+    Q = 7,
+    GainDb = 8,
+    TargetDb = 9,     // automatic gain control
+    MaxGainDb = 10,
+    CeilingDb = 11,   // limiter
+};
+
+// Stages added by type get ids from here up; below it are the classic stages
+constexpr int32_t kFirstUserStageId = 100;
+
+// Id of the classic stage of a type: the one RecorderParams and the
+// recorder's per-type setters control
+constexpr int32_t classicStageId(StageType type) {
+    return 1 + static_cast<int32_t>(type);
+}
+
+// One stage of a graph: its identity, whether it runs, and its settings
+struct StageConfig {
+    int32_t id = 0;
+    StageType type = StageType::NoiseGate;
+    bool enabled = true;
+
+    float amount = 0.5f;
+    float delayMs = 50.0f;
+    float thresholdDb = -40.0f;
+    float ratio = 4.0f;
+    float attackMs = 5.0f;
+    float releaseMs = 50.0f;
+    float frequency = 1000.0f;
+    float q = 1.0f;
+    float gainDb = 0.0f;
+    float targetDb = -18.0f;
+    float maxGainDb = 12.0f;
+    float ceilingDb = -1.0f;
+
+    void set(StageParam param, float value);
+
+    // Whether the settings match, identity and enable flag aside
+    bool sameSettings(const StageConfig &other) const;
+
+    // Enabled stage of type with the recorder's default settings for it
+    static StageConfig defaults(StageType type);
+};
+
+/**
+ * Runtime description of a processing chain: an ordered list of stages, any
+ * type any number of times, each with a stable id.
+ *
+ * Stage order is processing order. Disabled stages stay in the list (and keep
+ * their place and settings) but don't run. A graph is a fixed-capacity value
+ * type with no heap storage, so it can be copied through a TripleBuffer to
+ * the audio thread; ChainProcessor compiles it into an ExecutionPlan.
+ *
+ * fromParams() builds the classic chain (suppressor -> echo -> noise
+ * reduction -> gate -> bandpass -> peaking -> high shelf -> auto gain) with the classic
+ * stage ids, so RecorderParams and the per-type setters keep working on any
+ * graph that still has those stages.
+ */
+class DspGraph {
+public:
+    static constexpr int32_t kMaxStages = 16;
+
+    // The classic chain configured from params
+    static DspGraph fromParams(const RecorderParams &params);
+
+    // The classic stage of type as params configure it
+    static StageConfig classicStage(const RecorderParams &params, StageType type);
+
+    // Adds an enabled stage of type with default settings before position
+    // (the end if negative or past it). Returns its new id, or -1 if full.
+    int32_t addStage(StageType type, int32_t position = -1);
+
+    // Adds stage as is before position. False if full or its id is taken.
+    bool insertStage(const StageConfig &stage, int32_t position = -1);
+
+    bool removeStage(int32_t id);
+
+    // Moves a stage so it ends up at position (clamped to the list)
+    bool moveStage(int32_t id, int32_t position);
+
+    StageConfig *findStage(int32_t id);
+    const StageConfig *findStage(int32_t id) const;
+
+    int32_t size() const { return mNumStages; }
+    const StageConfig &stage(int32_t index) const { return mStages[index]; }
+
+    bool anyEnabled() const;
+    bool hasEnabled(StageType type) const;
+
+    // Whether other has the same enabled stages (by id and type) in the same
+    // order. Such graphs compile to the same plan and differ only in settings.
+    bool sameStructure(const DspGraph &other) const;
+
+    // Copies whatever differs between previous and params to the classic
+    // stages still in the graph, leaving every other setting alone
+    void applyClassicParams(const RecorderParams &previous, const RecorderParams &params);
+
+private:
+    StageConfig mStages[kMaxStages];
+    int32_t mNumStages = 0;
+    int32_t mNextId = kFirstUserStageId;
+};
+
+#endif //OBOESAMPLE_DSPGRAPH_H
@@ -0,0 +1,428 @@
+#include "ExecutionPlan.h"
+#include "VoiceActivity.h"
+#include "filter/AutoGain.h"
+#include "filter/EchoCanceller.h"
+#include "filter/FastMath.h"
+#include "filter/NoiseGate.h"
+#include "filter/NoiseReduction.h"
+#include "filter/PlaybackSuppressor.h"
+#include "filter/SampleConversion.h"
+#include <algorithm>
+
+static bool isFilter(StageType type) {
+    return type == StageType::Bandpass || type == StageType::Peaking ||
+           type == StageType::HighShelf;
+}
+
+static bool isPerChannel(StageType type) {
+    return type == StageType::PlaybackSuppressor || type == StageType::EchoCanceller ||
+           type == StageType::NoiseReduction;
+}
+
+// The modules of one non-EQ stage, one per channel for the per-channel types
+struct ExecutionPlan::StageInstance {
+    StageInstance(int32_t id, StageType type, int32_t sampleRate, int32_t channelCount)
+            : id(id), type(type) {
+        for (int32_t c = 0; c < channelCount; c++) {
+            switch (type) {
+                case StageType::PlaybackSuppressor:
+                    // The graph decides whether the stage runs; its module
+                    // passes audio through untouched until enabled
+                    suppressors.emplace_back(sampleRate);
+                    suppressors.back().setEnabled(true);
+                    break;
+                case StageType::EchoCanceller:
+                    cancellers.emplace_back(sampleRate);
+                    break;
+                case StageType::NoiseReduction:
+                    reductions.emplace_back(sampleRate);
+                    break;
+                default:
+                    break;
+            }
+        }
+        gate.setChannelCount(channelCount);
+        gate.setRampTime(kGlideMs, static_cast<float>(sampleRate));
+        if (type == StageType::AutoGain) {
+            autoGain.prepare(sampleRate, channelCount);
+        }
+    }
+
+    // Reconfigures the modules for whatever differs between the settings
+    // they run with and stage (everything if force)
+    void apply(const StageConfig &stage, float sampleRate, bool force) {
+        const StageConfig &active = settings;
+        switch (type) {
+            case StageType::PlaybackSuppressor:
+                if (force || stage.amount != active.amount) {
+                    for (auto &suppressor : suppressors) suppressor.setAggressiveness(stage.amount);
+                }
+                break;
+            case StageType::EchoCanceller:
+                if (force || stage.delayMs != active.delayMs) {
+                    for (auto &canceller : cancellers) canceller.setEchoDelay(stage.delayMs);
+                }
+                if (force || stage.amount != active.amount) {
+                    for (auto &canceller : cancellers) canceller.setSuppressionAmount(stage.amount);
+                }
+                break;
+            case StageType::NoiseReduction:
+                if (force || stage.amount != active.amount) {
+                    for (auto &reduction : reductions) reduction.setReductionAmount(stage.amount);
+                }
+                break;
+            case StageType::NoiseGate:
+                if (force || stage.thresholdDb != active.thresholdDb) {
+                    gate.setThreshold(stage.thresholdDb);
+                }
+                if (force || stage.ratio != active.ratio) gate.setRatio(stage.ratio);
+                if (force || stage.attackMs != active.attackMs) {
+                    gate.setAttack(stage.attackMs, sampleRate);
+                }
+                if (force || stage.releaseMs != active.releaseMs) {
+                    gate.setRelease(stage.releaseMs, sampleRate);
+                }
+                // A new gate starts at its settings rather than gliding to them
+                if (force) gate.reset();
+                break;
+            case StageType::AutoGain:
+                if (force || stage.targetDb != active.targetDb) autoGain.setTarget(stage.targetDb);
+                if (force || stage.maxGainDb != active.maxGainDb) {
+                    autoGain.setMaxGain(stage.maxGainDb);
+                }
+                if (force || stage.thresholdDb != active.thresholdDb) {
+                    autoGain.setNoiseFloor(stage.thresholdDb);
+                }
+                if (force || stage.attackMs != active.attackMs) autoGain.setAttack(stage.attackMs);
+                if (force || stage.releaseMs != active.releaseMs) {
+                    autoGain.setRelease(stage.releaseMs);
+                }
+                if (force || stage.ceilingDb != active.ceilingDb) {
+                    autoGain.setCeiling(stage.ceilingDb);
+                }
+                break;
+            default:
+                break;
+        }
+        settings = stage;
+    }
+
+    void processPlane(int32_t c, float *plane, int32_t numFrames, const float *farEnd) {
+        switch (type) {
+            case StageType::PlaybackSuppressor:
+                suppressors[c].process(plane, plane, numFrames);
+                break;
+            case StageType::EchoCanceller:
+                cancellers[c].process(plane, farEnd, plane, numFrames);
+                break;
+            case StageType::NoiseReduction:
+                reductions[c].process(plane, plane, numFrames);
+                break;
+            default:
+                break;
+        }
+    }
+
+    const int32_t id;
+    const StageType type;
+
+    // What the modules run with
+    StageConfig settings;
+
+    std::vector<PlaybackSuppressor> suppressors;
+    std::vector<EchoCanceller> cancellers;
+    std::vector<NoiseReduction> reductions;
+    NoiseGate gate;
+    AutoGain autoGain;
+};
+
+ExecutionPlan::~ExecutionPlan() = default;
+
+std::unique_ptr<ExecutionPlan> ExecutionPlan::compile(const DspGraph &graph, int32_t sampleRate,
+                                                      int32_t channelCount, int32_t maxFrames,
+                                                      const ExecutionPlan *previous) {
+    std::unique_ptr<ExecutionPlan> plan(new ExecutionPlan());
+    plan->mSampleRate = sampleRate;
+    plan->mChannelCount = std::max(1, channelCount);
+    plan->mMaxFrames = std::max(0, maxFrames);
+    if (previous != nullptr && (previous->mSampleRate != plan->mSampleRate ||
+                                previous->mChannelCount != plan->mChannelCount)) {
+        previous = nullptr;
+    }
+
+    // The enabled stages in order
+    std::vector<const StageConfig *> stages;
+    for (int32_t i = 0; i < graph.size(); i++) {
+        if (graph.stage(i).enabled) stages.push_back(&graph.stage(i));
+    }
+
+    bool anyPlanar = false;
+    size_t index = 0;
+    while (index < stages.size()) {
+        const StageType type = stages[index]->type;
+
+        if (isFilter(type)) {
+            // The run of filters, up to one cascade's worth
+            Cascade cascade{nullptr, static_cast<int32_t>(plan->mFilters.size()), 0, false};
+            while (index < stages.size() && isFilter(stages[index]->type) &&
+                   cascade.numFilters < BiquadCascade::kMaxSections) {
+                plan->mFilters.push_back({stages[index]->id, stages[index]->type, *stages[index]});
+                cascade.numFilters++;
+                index++;
+            }
+
+            // Reuse a cascade made of exactly the same filters
+            std::shared_ptr<CascadeState> state;
+            if (previous != nullptr) {
+                for (size_t k = 0; k < previous->mCascades.size() && !state; k++) {
+                    const Cascade &old = previous->mCascades[k];
+                    bool same = old.numFilters == cascade.numFilters;
+                    for (int32_t f = 0; same && f < cascade.numFilters; f++) {
+                        same = previous->mFilters[old.firstFilter + f].id ==
+                               plan->mFilters[cascade.firstFilter + f].id;
+                    }
+                    if (same) state = previous->mCascadeStates[k];
+                }
+            }
+            if (state) {
+                plan->mCascadesPending = true;
+            } else {
+                // A new cascade starts clean, at this plan's settings
+                state = std::make_shared<CascadeState>();
+                const auto glideFrames = static_cast<int32_t>(kGlideMs * 0.001f * sampleRate);
+                BiquadCoefficients sections[BiquadCascade::kMaxSections];
+                for (int32_t f = 0; f < cascade.numFilters; f++) {
+                    const Filter &filter = plan->mFilters[cascade.firstFilter + f];
+                    FilterGlide &glide = state->glides[f];
+                    glide.octaves.setRampFrames(glideFrames);
+                    glide.q.setRampFrames(glideFrames);
+                    glide.gainDb.setRampFrames(glideFrames);
+                    glide.octaves.jump(fastmath::log2(filter.settings.frequency));
+                    glide.q.jump(filter.settings.q);
+                    glide.gainDb.jump(filter.settings.gainDb);
+                    sections[f] = plan->designFilter(filter, glide);
+                }
+                state->cascade.setChannelCount(plan->mChannelCount);
+                state->cascade.setSections(sections, cascade.numFilters);
+            }
+            cascade.state = state.get();
+            plan->mCascadeStates.push_back(std::move(state));
+            plan->mSteps.push_back({StepKind::Cascade,
+                                    static_cast<int32_t>(plan->mCascades.size()), 1});
+            plan->mCascades.push_back(cascade);
+            continue;
+        }
+
+        // Reuse the instance of the same stage, or create a clean one
+        const auto nextInstance = [&](const StageConfig &stage) {
+            if (previous != nullptr) {
+                for (const auto &old : previous->mStages) {
+                    if (old->id == stage.id && old->type == stage.type) return old;
+                }
+            }
+            auto instance = std::make_shared<StageInstance>(stage.id, stage.type, sampleRate,
+                                                            plan->mChannelCount);
+            instance->apply(stage, static_cast<float>(sampleRate), true);
+            return instance;
+        };
+
+        const StepKind kind = isPerChannel(type) ? StepKind::Planar
+                              : type == StageType::AutoGain ? StepKind::AutoGain
+                              : StepKind::Gate;
+        Step step{kind, static_cast<int32_t>(plan->mRun.size()), 0};
+        do {
+            const StageConfig &stage = *stages[index];
+            plan->mUsesFarEnd |= stage.type == StageType::EchoCanceller;
+            plan->mStages.push_back(nextInstance(stage));
+            plan->mRun.push_back(plan->mStages.back().get());
+            step.count++;
+            index++;
+        } while (step.kind == StepKind::Planar && index < stages.size() &&
+                 isPerChannel(stages[index]->type));
+        anyPlanar |= step.kind == StepKind::Planar;
+        plan->mSteps.push_back(step);
+    }
+
+    if (anyPlanar && plan->mChannelCount > 1) {
+        plan->mChannelPlanes.assign(static_cast<size_t>(plan->mMaxFrames) * plan->mChannelCount,
+                                    0.0f);
+    }
+    return plan;
+}
+
+BiquadCoefficients ExecutionPlan::designFilter(const Filter &filter,
+                                               const FilterGlide &glide) const {
+    const auto sampleRate = static_cast<float>(mSampleRate);
+    // Settled filters use their settings as given, so a glide lands exactly
+    // where a jump would have
+    const bool settled = !glide.octaves.isRamping() && !glide.q.isRamping() &&
+                         !glide.gainDb.isRamping();
+    const float frequency = settled ? filter.settings.frequency
+                                    : fastmath::exp2(glide.octaves.getValue());
+    const float q = settled ? filter.settings.q : glide.q.getValue();
+    const float gainDb = settled ? filter.settings.gainDb : glide.gainDb.getValue();
+    switch (filter.type) {
+        case StageType::Bandpass:
+            return BiquadFilter::designBandpass(sampleRate, frequency, q);
+        case StageType::Peaking:
+            return BiquadFilter::designPeaking(sampleRate, frequency, q, gainDb);
+        case StageType::HighShelf:
+            return BiquadFilter::designHighShelf(sampleRate, frequency, q, gainDb);
+        default:
+            return {};
+    }
+}
+
+void ExecutionPlan::loadCascade(const Cascade &cascade, int32_t rampFrames) {
+    BiquadCoefficients sections[BiquadCascade::kMaxSections];
+    for (int32_t f = 0; f < cascade.numFilters; f++) {
+        sections[f] = designFilter(mFilters[cascade.firstFilter + f], cascade.state->glides[f]);
+    }
+    cascade.state->cascade.rampCoefficients(sections, cascade.numFilters, rampFrames);
+}
+
+void ExecutionPlan::retarget(Cascade &cascade) {
+    bool gliding = false;
+    bool jumped = false;
+    for (int32_t f = 0; f < cascade.numFilters; f++) {
+        const StageConfig &settings = mFilters[cascade.firstFilter + f].settings;
+        FilterGlide &glide = cascade.state->glides[f];
+        const float octaves = fastmath::log2(settings.frequency);
+        const float before[] = {glide.octaves.getValue(), glide.q.getValue(),
+                                glide.gainDb.getValue()};
+        glide.octaves.setTarget(octaves);
+        glide.q.setTarget(settings.q);
+        glide.gainDb.setTarget(settings.gainDb);
+        gliding |= glide.octaves.isRamping() || glide.q.isRamping() || glide.gainDb.isRamping();
+        jumped |= before[0] != glide.octaves.getValue() || before[1] != glide.q.getValue() ||
+                  before[2] != glide.gainDb.getValue();
+    }
+    cascade.gliding = gliding;
+    if (jumped) {
+        loadCascade(cascade, 0);
+    }
+}
+
+void ExecutionPlan::configure(const DspGraph &graph) {
+    const auto sampleRate = static_cast<float>(mSampleRate);
+    for (StageInstance *instance : mRun) {
+        const StageConfig *stage = graph.findStage(instance->id);
+        if (stage != nullptr && stage->type == instance->type &&
+            !stage->sameSettings(instance->settings)) {
+            instance->apply(*stage, sampleRate, false);
+        }
+    }
+
+    for (Cascade &cascade : mCascades) {
+        bool changed = mCascadesPending;
+        for (int32_t f = 0; f < cascade.numFilters; f++) {
+            Filter &filter = mFilters[cascade.firstFilter + f];
+            const StageConfig *stage = graph.findStage(filter.id);
+            if (stage != nullptr && stage->type == filter.type &&
+                !stage->sameSettings(filter.settings)) {
+                filter.settings = *stage;
+                changed = true;
+            }
+        }
+        if (changed) {
+            retarget(cascade);
+        }
+    }
+    mCascadesPending = false;
+}
+
+void ExecutionPlan::runGliding(Cascade &cascade, float *buffer, int32_t numFrames) {
+    int32_t offset = 0;
+    while (offset < numFrames && cascade.gliding) {
+        const int32_t frames = std::min(kGlideBlockFrames, numFrames - offset);
+        bool gliding = false;
+        for (int32_t f = 0; f < cascade.numFilters; f++) {
+            FilterGlide &glide = cascade.state->glides[f];
+            glide.octaves.advance(frames);
+            glide.q.advance(frames);
+            glide.gainDb.advance(frames);
+            gliding |= glide.octaves.isRamping() || glide.q.isRamping() ||
+                       glide.gainDb.isRamping();
+        }
+        cascade.gliding = gliding;
+        loadCascade(cascade, frames);
+        float *block = buffer + static_cast<size_t>(offset) * mChannelCount;
+        cascade.state->cascade.process(block, block, frames);
+        offset += frames;
+    }
+    if (offset < numFrames) {
+        float *rest = buffer + static_cast<size_t>(offset) * mChannelCount;
+        cascade.state->cascade.process(rest, rest, numFrames - offset);
+    }
+}
+
+void ExecutionPlan::runPlanar(const Step &step, float *buffer, int32_t numFrames,
+                              const float *farEnd) {
+    // Mono is already a single plane
+    if (mChannelCount == 1) {
+        for (int32_t i = step.first; i < step.first + step.count; i++) {
+            mRun[i]->processPlane(0, buffer, numFrames, farEnd);
+        }
+        return;
+    }
+    deinterleave(buffer, mChannelPlanes.data(), mChannelCount, numFrames, mMaxFrames);
+    for (int32_t c = 0; c < mChannelCount; c++) {
+        float *plane = mChannelPlanes.data() + static_cast<size_t>(c) * mMaxFrames;
+        for (int32_t i = step.first; i < step.first + step.count; i++) {
+            mRun[i]->processPlane(c, plane, numFrames, farEnd);
+        }
+    }
+    interleave(mChannelPlanes.data(), buffer, mChannelCount, numFrames, mMaxFrames);
+}
+
+bool ExecutionPlan::updateVoice(const Step &step, Voice &voice) const {
+    bool heard = false;
+    for (int32_t i = step.first; i < step.first + step.count; i++) {
+        if (mRun[i]->type != StageType::PlaybackSuppressor) continue;
+        for (const PlaybackSuppressor &suppressor : mRun[i]->suppressors) {
+            voice.speech |= suppressor.getDetector().isSpeech();
+            voice.probability = std::max(voice.probability,
+                                         suppressor.getDetector().getSpeechProbability());
+        }
+        heard = true;
+    }
+    return heard;
+}
+
+void ExecutionPlan::process(float *buffer, int32_t numFrames, const float *farEnd) {
+    // The suppressors' decision for this block, across all of them
+    Voice voice;
+    bool heard = false;
+    for (const Step &step : mSteps) {
+        switch (step.kind) {
+            case StepKind::Planar:
+                runPlanar(step, buffer, numFrames, farEnd);
+                if (updateVoice(step, voice)) {
+                    heard = true;
+                    mVoiceActive = voice.speech;
+                }
+                break;
+            case StepKind::Gate:
+                mRun[step.first]->gate.process(buffer, buffer, numFrames);
+                break;
+            case StepKind::AutoGain: {
+                AutoGain &autoGain = mRun[step.first]->autoGain;
+                autoGain.setVoiceActive(mVoiceActive);
+                autoGain.process(buffer, buffer, numFrames);
+                break;
+            }
+            case StepKind::Cascade: {
+                Cascade &cascade = mCascades[step.first];
+                if (cascade.gliding) {
+                    runGliding(cascade, buffer, numFrames);
+                } else {
+                    cascade.state->cascade.process(buffer, buffer, numFrames);
+                }
+                break;
+            }
+        }
+    }
+    if (heard && mVoiceActivity != nullptr) {
+        mVoiceActivity->publish(voice.speech, voice.probability, numFrames);
+    }
+}
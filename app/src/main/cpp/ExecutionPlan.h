@@ -0,0 +1,191 @@
+#ifndef OBOESAMPLE_EXECUTIONPLAN_H
+#define OBOESAMPLE_EXECUTIONPLAN_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "DspGraph.h"
+#include "filter/BiquadCascade.h"
+#include "filter/BiquadFilter.h"
+#include "filter/ParamRamp.h"
+
+class VoiceActivity;
+
+/**
+ * A DspGraph compiled for one stream format into a flat list of steps.
+ *
+ * Only enabled stages make it into the plan, and neighbouring stages are
+ * fused into one step where they can share a pass over the block:
+ *  - consecutive per-channel stages (suppressor, echo canceller, noise
+ *    reduction) deinterleave the block once, run one after the other over
+ *    each channel's plane, one instance per channel, and interleave it back;
+ *  - consecutive EQ filters run as one BiquadCascade (up to its
+ *    kMaxSections; longer runs take several steps);
+ *  - a gate or an auto gain is a step of its own, on the interleaved frames.
+ * process() walks the step array in order, with no enable checks and no
+ * lookups: each step indexes straight into the plan's arrays.
+ *
+ * Everything, including the channel planes, is allocated by compile() on a
+ * control thread. configure() and process() never allocate, lock or log and are
+ * safe on the audio thread.
+ *
+ * Stage instances are reference counted so a plan compiled after an edit can
+ * share them with the plan it replaces: a stage whose id and type survive the
+ * edit keeps its state (an adapted echo filter, a noise estimate), and an EQ
+ * run made of the same filters keeps its cascade state. Only one of the two
+ * plans may be processing at a time.
+ *
+ * New settings for a running filter or gate glide in over kGlideMs rather
+ * than stepping, so live sweeps don't click. A gliding cascade runs in
+ * sub-blocks of kGlideBlockFrames: the coefficients where each sub-block ends
+ * are designed with the FastMath kernels, and the cascade ramps to them sample
+ * by sample. Frequency glides in octaves and gain in dB. Stages a plan
+ * creates start at their settings.
+ *
+ * After each block with suppressor stages, their detectors' decision (speech
+ * on any channel of any of them) goes to the plan's auto gain stages and,
+ * once per block, to the VoiceActivity set with setVoiceActivity(), if any.
+ */
+class ExecutionPlan {
+public:
+    static constexpr float kGlideMs = 20.0f;
+    static constexpr int32_t kGlideBlockFrames = 32;
+
+    ~ExecutionPlan();
+
+    ExecutionPlan(const ExecutionPlan &) = delete;
+    ExecutionPlan &operator=(const ExecutionPlan &) = delete;
+
+    // Compiles the enabled stages of graph for channelCount channels at
+    // sampleRate, in blocks of up to maxFrames. Stages and EQ runs of
+    // previous, if it was compiled for the same rate and channel count, are
+    // shared rather than created. New stages start from a clean state with
+    // the settings in graph; shared ones keep what they run with until the
+    // plan is configure()d. Allocates.
+    static std::unique_ptr<ExecutionPlan> compile(const DspGraph &graph, int32_t sampleRate,
+                                                  int32_t channelCount, int32_t maxFrames,
+                                                  const ExecutionPlan *previous);
+
+    // Reconfigures every stage whose settings differ from its entry in graph.
+    // Stages the graph no longer has keep theirs.
+    void configure(const DspGraph &graph);
+
+    // Where process() publishes the suppressors' decisions; may be null.
+    // Control side, before the plan first runs.
+    void setVoiceActivity(VoiceActivity *voiceActivity) { mVoiceActivity = voiceActivity; }
+
+    // Runs the steps in place over numFrames (at most getMaxFrames())
+    // interleaved frames. farEnd is the echo cancellers' mono reference, one
+    // sample per frame; it may be null if !usesFarEnd().
+    void process(float *buffer, int32_t numFrames, const float *farEnd);
+
+    bool isEmpty() const { return mSteps.empty(); }
+    bool usesFarEnd() const { return mUsesFarEnd; }
+    int32_t getNumSteps() const { return static_cast<int32_t>(mSteps.size()); }
+    int32_t getSampleRate() const { return mSampleRate; }
+    int32_t getChannelCount() const { return mChannelCount; }
+    int32_t getMaxFrames() const { return mMaxFrames; }
+
+private:
+    friend class ChainProcessor;
+
+    struct StageInstance;
+
+    enum class StepKind : int32_t {
+        Planar,   // mRun[first, first + count) over each channel's plane
+        Gate,     // mRun[first] on the interleaved frames
+        AutoGain, // mRun[first] on the interleaved frames
+        Cascade,  // mCascades[first] on the interleaved frames
+    };
+
+    struct Step {
+        StepKind kind;
+        int32_t first;
+        int32_t count;
+    };
+
+    // One EQ filter of a cascade and the settings it glides to
+    struct Filter {
+        int32_t id;
+        StageType type;
+        StageConfig settings;
+    };
+
+    // Where a filter's settings are on their way to its target: frequency in
+    // octaves (log2 Hz), Q, and gain in dB
+    struct FilterGlide {
+        ParamRamp octaves;
+        ParamRamp q;
+        ParamRamp gainDb;
+    };
+
+    // What plans with the same run of filters share: the cascade's history
+    // and where each of its filters has glided to
+    struct CascadeState {
+        BiquadCascade cascade;
+        FilterGlide glides[BiquadCascade::kMaxSections];
+    };
+
+    // A run of filters, mFilters[firstFilter, firstFilter + numFilters)
+    struct Cascade {
+        CascadeState *state;
+        int32_t firstFilter;
+        int32_t numFilters;
+        bool gliding;
+    };
+
+    ExecutionPlan() = default;
+
+    void runPlanar(const Step &step, float *buffer, int32_t numFrames, const float *farEnd);
+
+    // A block's speech decision: speech on any channel of any suppressor,
+    // and the highest speech probability
+    struct Voice {
+        bool speech = false;
+        float probability = 0.0f;
+    };
+
+    // Adds the decisions of the step's suppressors to voice; returns whether
+    // it has any
+    bool updateVoice(const Step &step, Voice &voice) const;
+
+    // Coefficients of filter where glide has got to
+    BiquadCoefficients designFilter(const Filter &filter, const FilterGlide &glide) const;
+
+    // Loads the cascade's coefficients from where its filters are, keeping its
+    // state: at once, or sample by sample over the next rampFrames frames
+    void loadCascade(const Cascade &cascade, int32_t rampFrames);
+
+    // Points the cascade's glides at its filters' settings
+    void retarget(Cascade &cascade);
+
+    // Runs a gliding cascade a sub-block at a time until its glides end
+    void runGliding(Cascade &cascade, float *buffer, int32_t numFrames);
+
+    int32_t mSampleRate = 0;
+    int32_t mChannelCount = 1;
+    int32_t mMaxFrames = 0;
+    bool mUsesFarEnd = false;
+
+    // Shared cascades have to pick up this plan's coefficients on the first configure()
+    bool mCascadesPending = false;
+
+    std::vector<Step> mSteps;
+    std::vector<StageInstance *> mRun;  // non-EQ stages in step order
+    std::vector<Cascade> mCascades;
+    std::vector<Filter> mFilters;
+    std::vector<float> mChannelPlanes;  // the block deinterleaved, mMaxFrames per channel
+
+    // The latest suppressor decision, and where it is published
+    bool mVoiceActive = true;
+    VoiceActivity *mVoiceActivity = nullptr;
+
+    // Next plan in ChainProcessor's retired list
+    ExecutionPlan *mNextRetired = nullptr;
+
+    // Keep the shared instances alive; parallel to mRun and mCascades
+    std::vector<std::shared_ptr<StageInstance>> mStages;
+    std::vector<std::shared_ptr<CascadeState>> mCascadeStates;
+};
+
+#endif //OBOESAMPLE_EXECUTIONPLAN_H
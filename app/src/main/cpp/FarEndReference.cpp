@@ -0,0 +1,98 @@
+#include "FarEndReference.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+// The reader re-aligns once its cursor is this far from the timestamped position
+constexpr int64_t kResyncMs = 20;
+
+FarEndReference::FarEndReference() : mBuffer(new float[kCapacityFrames]()) {
+}
+
+int64_t FarEndReference::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FarEndReference::write(const int16_t *data, int32_t numFrames, int32_t channelCount,
+                            int32_t sampleRate, int64_t timeNs) {
+    writeFrames(data, numFrames, channelCount, 1.0f / (32768.0f * std::max(1, channelCount)),
+                sampleRate, timeNs);
+}
+
+void FarEndReference::write(const float *data, int32_t numFrames, int32_t channelCount,
+                            int32_t sampleRate, int64_t timeNs) {
+    writeFrames(data, numFrames, channelCount, 1.0f / std::max(1, channelCount), sampleRate,
+                timeNs);
+}
+
+template<typename T>
+void FarEndReference::writeFrames(const T *data, int32_t numFrames, int32_t channelCount,
+                                  float scale, int32_t sampleRate, int64_t timeNs) {
+    const int64_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+    float *buffer = mBuffer.get();
+
+    for (int32_t i = 0; i < numFrames; i++) {
+        float sum = 0.0f;
+        for (int32_t c = 0; c < channelCount; c++) {
+            sum += static_cast<float>(data[static_cast<size_t>(i) * channelCount + c]);
+        }
+        buffer[(writeIndex + i) & kMask] = sum * scale;
+    }
+
+    mWriteIndex.store(writeIndex + numFrames, std::memory_order_release);
+
+    Anchor anchor;
+    anchor.frameIndex = writeIndex;
+    anchor.timeNs = timeNs;
+    anchor.sampleRate = sampleRate;
+    mAnchors.write(anchor);
+}
+
+int32_t FarEndReference::read(int64_t captureTimeNs, int32_t sampleRate, float *dest,
+                              int32_t numFrames) {
+    if (mAnchors.read()) {
+        mAnchor = mAnchors.front();
+    }
+    if (mAnchor.sampleRate == 0 || mAnchor.sampleRate != sampleRate) {
+        // Nothing rendered yet, or at a rate the canceller can't use
+        memset(dest, 0, numFrames * sizeof(float));
+        return 0;
+    }
+
+    // Frame the writer was rendering at the capture time
+    int64_t expected = mAnchor.frameIndex +
+                       (captureTimeNs - mAnchor.timeNs) * sampleRate / 1000000000;
+    if (!mSynced || std::llabs(mReadIndex - expected) > kResyncMs * sampleRate / 1000) {
+        if (mSynced) {
+            mResyncCount++;
+        }
+        mReadIndex = expected;
+        mSynced = true;
+    }
+
+    const float *buffer = mBuffer.get();
+    const int64_t start = mReadIndex;
+    const int64_t end = start + numFrames;
+    mReadIndex = end;
+
+    int64_t written = mWriteIndex.load(std::memory_order_acquire);
+    int64_t first = std::max(start, std::max<int64_t>(0, written - kCapacityFrames));
+    int64_t last = std::min(end, written);
+    if (first >= last) {
+        memset(dest, 0, numFrames * sizeof(float));
+        return 0;
+    }
+    for (int64_t i = first; i < last; i++) {
+        dest[i - start] = buffer[i & kMask];
+    }
+
+    // Anything the writer lapped while we copied is garbage
+    int64_t oldestValid = mWriteIndex.load(std::memory_order_acquire) - kCapacityFrames;
+    first = std::max(first, std::min(last, oldestValid));
+
+    std::fill(dest, dest + (first - start), 0.0f);
+    std::fill(dest + (last - start), dest + numFrames, 0.0f);
+    return static_cast<int32_t>(last - first);
+}
@@ -0,0 +1,86 @@
+#ifndef OBOESAMPLE_FARENDREFERENCE_H
+#define OBOESAMPLE_FARENDREFERENCE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "TripleBuffer.h"
+
+/**
+ * Lock-free, timestamped ring carrying what the player renders (the "far end")
+ * to the recorder, where the echo canceller uses it as its reference.
+ *
+ * The player's callback appends each rendered block as mono float samples and
+ * stamps it with the steady-clock time it was rendered. The recorder's callback
+ * asks for the far-end samples that line up with the capture time of its own
+ * block; it follows the ring with its own cursor and only jumps to the
+ * timestamped position when it starts or has drifted too far (player restart,
+ * clock drift).
+ *
+ * One writer (player callback) and one reader (recorder callback). The writer
+ * never waits for the reader: it overwrites the oldest samples, and samples the
+ * reader can't get (overwritten, not yet rendered, no player, rate mismatch)
+ * read as silence. Storage is allocated once in the constructor.
+ */
+class FarEndReference {
+public:
+    // About 2.7 s at 48 kHz
+    static constexpr int64_t kCapacityFrames = int64_t(1) << 17;
+
+    FarEndReference();
+
+    // Current steady-clock time, the clock both sides stamp with
+    static int64_t nowNs();
+
+    // --- Writer (player callback) ---
+
+    // Appends numFrames interleaved frames, downmixed to mono. timeNs is when
+    // the first of them was rendered.
+    void write(const int16_t *data, int32_t numFrames, int32_t channelCount, int32_t sampleRate,
+               int64_t timeNs);
+    void write(const float *data, int32_t numFrames, int32_t channelCount, int32_t sampleRate,
+               int64_t timeNs);
+
+    // --- Reader (recorder callback) ---
+
+    // Fills numFrames far-end samples lined up with a capture starting at
+    // captureTimeNs, at sampleRate. Returns how many were actually available;
+    // the rest are zero.
+    int32_t read(int64_t captureTimeNs, int32_t sampleRate, float *dest, int32_t numFrames);
+
+    // Makes the next read() line up from the timestamps again. Only call while
+    // the reader isn't running.
+    void resetReader() { mSynced = false; }
+
+    // Times the reader had to jump to re-align with the writer
+    int64_t getResyncCount() const { return mResyncCount; }
+
+private:
+    // Where the writer was at a given time
+    struct Anchor {
+        int64_t frameIndex = 0;
+        int64_t timeNs = 0;
+        int32_t sampleRate = 0;
+    };
+
+    static constexpr int64_t kMask = kCapacityFrames - 1;
+
+    // Shared by both write() overloads; scale maps a sum over channels to mono
+    template<typename T>
+    void writeFrames(const T *data, int32_t numFrames, int32_t channelCount, float scale,
+                     int32_t sampleRate, int64_t timeNs);
+
+    std::unique_ptr<float[]> mBuffer;
+
+    // Writer
+    alignas(64) std::atomic<int64_t> mWriteIndex{0};
+    TripleBuffer<Anchor> mAnchors;
+
+    // Reader-owned
+    Anchor mAnchor;
+    int64_t mReadIndex = 0;
+    bool mSynced = false;
+    int64_t mResyncCount = 0;
+};
+
+#endif //OBOESAMPLE_FARENDREFERENCE_H
@@ -0,0 +1,13 @@
+#ifndef OBOESAMPLE_FILEFORMAT_H
+#define OBOESAMPLE_FILEFORMAT_H
+
+// How a recording is stored on disk. Raw files carry no header, so the player
+// has to be told which of the two raw formats it is reading; Lossless files
+// identify themselves.
+enum class FileFormat {
+    Pcm16,      // raw interleaved int16
+    Float32,    // raw interleaved float
+    Lossless,   // int16 compressed with LosslessCodec
+};
+
+#endif //OBOESAMPLE_FILEFORMAT_H
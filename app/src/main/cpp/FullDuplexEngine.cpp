@@ -0,0 +1,340 @@
+#include "FullDuplexEngine.h"
+#include "WorkerThread.h"
+#include "filter/SampleConversion.h"
+#include <android/log.h>
+#include <cstring>
+
+#define LOG_TAG "FullDuplexEngine"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Scratch size used if the output reports neither a burst size nor a capacity
+constexpr int32_t kDefaultScratchFrames = 4096;
+
+FullDuplexEngine::FullDuplexEngine() {
+    oboe::AudioStreamBuilder builder;
+    builder.setDirection(oboe::Direction::Input);
+    std::shared_ptr<oboe::AudioStream> stream;
+    if (builder.openStream(stream) == oboe::Result::OK) {
+        mSampleRate = stream->getSampleRate();
+        mChannelCount = stream->getChannelCount();
+        stream->close();
+    }
+    LOGD("Full duplex initialized. Sample Rate: %d, Channels: %d", mSampleRate, mChannelCount);
+}
+
+FullDuplexEngine::~FullDuplexEngine() {
+    stop();
+}
+
+void FullDuplexEngine::setGraph(const DspGraph &graph) {
+    std::lock_guard<std::mutex> lock(mControlLock);
+    mGraph = graph;
+    mChain.setGraph(graph);
+}
+
+oboe::Result FullDuplexEngine::start() {
+    stop();
+
+    // The output's callback is the clock; the input is only ever read from it
+    oboe::AudioStreamBuilder outputBuilder;
+    outputBuilder.setDirection(oboe::Direction::Output)
+            ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
+            ->setSharingMode(oboe::SharingMode::Exclusive)
+            ->setFormat(oboe::AudioFormat::Float)
+            ->setChannelCount(mChannelCount)
+            ->setSampleRate(mSampleRate)
+            ->setDataCallback(this);
+    oboe::Result result = outputBuilder.openStream(mOutputStream);
+    if (result != oboe::Result::OK) {
+        LOGE("Failed to open output stream: %s", oboe::convertToText(result));
+        return result;
+    }
+
+    oboe::AudioStreamBuilder inputBuilder;
+    inputBuilder.setDirection(oboe::Direction::Input)
+            ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
+            ->setSharingMode(oboe::SharingMode::Exclusive)
+            ->setFormat(oboe::AudioFormat::Float)
+            ->setChannelCount(mChannelCount)
+            ->setSampleRate(mOutputStream->getSampleRate())
+            ->setInputPreset(mInputPreset);
+    result = inputBuilder.openStream(mInputStream);
+    if (result != oboe::Result::OK) {
+        LOGE("Failed to open input stream: %s", oboe::convertToText(result));
+        closeStreams();
+        return result;
+    }
+
+    // One clock only works if both directions run at the same rate
+    if (mInputStream->getSampleRate() != mOutputStream->getSampleRate()) {
+        LOGE("Input at %d Hz, output at %d Hz", mInputStream->getSampleRate(),
+             mOutputStream->getSampleRate());
+        closeStreams();
+        return oboe::Result::ErrorInvalidRate;
+    }
+    if (mInputStream->getFormat() != oboe::AudioFormat::Float ||
+        mOutputStream->getFormat() != oboe::AudioFormat::Float) {
+        LOGE("Full duplex needs float streams");
+        closeStreams();
+        return oboe::Result::ErrorInvalidFormat;
+    }
+    mSampleRate = mInputStream->getSampleRate();
+    mChannelCount = mInputStream->getChannelCount();
+
+    // Size everything the callback uses here, so it never allocates
+    mFramesPerBurst = std::max(1, mOutputStream->getFramesPerBurst());
+    mCushionFrames = mCushionBursts * mFramesPerBurst;
+    mScratchFrames = std::max(mOutputStream->getFramesPerBurst(),
+                              mOutputStream->getBufferCapacityInFrames());
+    if (mScratchFrames <= 0) {
+        mScratchFrames = kDefaultScratchFrames;
+    }
+    const auto scratchSamples = static_cast<size_t>(mScratchFrames) * mChannelCount;
+    mProcessBuffer.assign(scratchSamples, 0.0f);
+    mDiscardBuffer.assign(scratchSamples, 0.0f);
+    mOutputBuffer.assign(scratchSamples, 0);
+    size_t historyFrames = 1;
+    while (historyFrames < 2 * static_cast<size_t>(mCushionFrames + mScratchFrames)) {
+        historyFrames <<= 1;
+    }
+    mHistory.assign(historyFrames, 0.0f);
+    mHistoryMask = static_cast<int64_t>(historyFrames) - 1;
+
+    DspGraph graph;
+    {
+        std::lock_guard<std::mutex> lock(mControlLock);
+        graph = mGraph;
+        mChain.prepare(mSampleRate, mChannelCount, mScratchFrames, graph);
+    }
+
+    if (!mFilePath.empty() &&
+        !mFileWriter.open(mFilePath, mSampleRate, mChannelCount, mFileFormat)) {
+        LOGE("Failed to open file for recording: %s", mFilePath.c_str());
+        closeStreams();
+        return oboe::Result::ErrorInternal;
+    }
+
+    mPhase = Phase::Draining;
+    mDrainCallbacksLeft = kDrainCallbacks;
+    mOwedFrames = 0;
+    mOutputIndex = 0;
+    mLateFrames.store(0, std::memory_order_relaxed);
+    mResyncCount.store(0, std::memory_order_relaxed);
+    mSynchronized.store(false, std::memory_order_release);
+    mMetrics.reset();
+    mRunning.store(true, std::memory_order_release);
+
+    // Input first, so it is capturing by the time the output asks for data
+    result = mInputStream->requestStart();
+    if (result == oboe::Result::OK) {
+        result = mOutputStream->requestStart();
+    }
+    if (result != oboe::Result::OK) {
+        LOGE("Failed to start full duplex streams: %s", oboe::convertToText(result));
+        stop();
+        return result;
+    }
+    LOGD("Full duplex started: %d Hz, %d channels, burst %d, latency %d frames, %d stages",
+         mSampleRate, mChannelCount, mFramesPerBurst, mCushionFrames, graph.size());
+    return result;
+}
+
+void FullDuplexEngine::stop() {
+    if (!mOutputStream && !mInputStream) {
+        return;
+    }
+    closeStreams();
+    mRunning.store(false, std::memory_order_release);
+    mSynchronized.store(false, std::memory_order_release);
+
+    if (mFileWriter.isOpen()) {
+        bool flushed = mFileWriter.close(std::chrono::milliseconds(500));
+        LOGD("Full duplex file closed%s. Dropped frames: %lld", flushed ? "" : " (flush timed out)",
+             static_cast<long long>(mFileWriter.getDroppedFrames()));
+    }
+
+    char metrics[256];
+    mMetrics.snapshot().formatSummary(metrics, sizeof(metrics));
+    LOGD("Full duplex callbacks: %s, late frames %lld, resyncs %lld", metrics,
+         static_cast<long long>(getLateFrames()), static_cast<long long>(getResyncCount()));
+}
+
+void FullDuplexEngine::closeStreams() {
+    // The output first: once it stops, nothing reads the input any more
+    if (mOutputStream) {
+        mOutputStream->requestStop();
+        mOutputStream->close();
+        mOutputStream.reset();
+    }
+    if (mInputStream) {
+        mInputStream->requestStop();
+        mInputStream->close();
+        mInputStream.reset();
+    }
+}
+
+int32_t FullDuplexEngine::discardInput(int32_t numFrames) {
+    int32_t discarded = 0;
+    while (numFrames < 0 || discarded < numFrames) {
+        int32_t frames = mScratchFrames;
+        if (numFrames >= 0) {
+            frames = std::min(frames, numFrames - discarded);
+        }
+        oboe::ResultWithValue<int32_t> result = mInputStream->read(mDiscardBuffer.data(), frames, 0);
+        if (!result) {
+            return -1;
+        }
+        discarded += result.value();
+        if (result.value() < frames) {
+            break;
+        }
+    }
+    return discarded;
+}
+
+oboe::DataCallbackResult
+FullDuplexEngine::onAudioReady(oboe::AudioStream *outputStream, void *audioData,
+                               int32_t numFrames) {
+    CallbackMetrics::Scope timing(mMetrics, outputStream, numFrames);
+    WorkerThread::noteCallbackCpu(CallbackStream::Duplex);
+
+    auto *out = static_cast<float *>(audioData);
+    const int32_t outputChannels = outputStream->getChannelCount();
+
+    switch (mPhase) {
+        case Phase::Draining: {
+            memset(out, 0, sizeof(float) * numFrames * outputChannels);
+            const int32_t drained = discardInput(-1);
+            if (drained < 0) {
+                return oboe::DataCallbackResult::Stop;
+            }
+            if (drained > 0 && --mDrainCallbacksLeft == 0) {
+                mPhase = Phase::Cushion;
+            }
+            return oboe::DataCallbackResult::Continue;
+        }
+
+        case Phase::Cushion: {
+            memset(out, 0, sizeof(float) * numFrames * outputChannels);
+            oboe::ResultWithValue<int32_t> available = mInputStream->getAvailableFrames();
+            if (!available) {
+                return oboe::DataCallbackResult::Stop;
+            }
+            if (available.value() >= mCushionFrames) {
+                // Exactly the cushion stays queued, whatever the last bursts added
+                if (discardInput(available.value() - mCushionFrames) < 0) {
+                    return oboe::DataCallbackResult::Stop;
+                }
+                mPhase = Phase::Running;
+                mSynchronized.store(true, std::memory_order_release);
+            }
+            return oboe::DataCallbackResult::Continue;
+        }
+
+        case Phase::Running:
+            break;
+    }
+
+    // Graph changes only ever take effect here, between blocks
+    mChain.update();
+
+    // Frames that were played as silence have turned up; their slots are gone
+    if (mOwedFrames > 0) {
+        const int32_t dropped = discardInput(mOwedFrames);
+        if (dropped < 0) {
+            return oboe::DataCallbackResult::Stop;
+        }
+        mOwedFrames -= dropped;
+    }
+
+    for (int32_t offset = 0; offset < numFrames; offset += mScratchFrames) {
+        const int32_t frames = std::min(mScratchFrames, numFrames - offset);
+        if (!runBlock(out + static_cast<size_t>(offset) * outputChannels, frames,
+                      outputChannels)) {
+            return oboe::DataCallbackResult::Stop;
+        }
+    }
+
+    // The input got ahead of the output; cut it back to the cushion
+    oboe::ResultWithValue<int32_t> available = mInputStream->getAvailableFrames();
+    if (available &&
+        available.value() > mCushionFrames + kMaxExtraBursts * mFramesPerBurst) {
+        discardInput(available.value() - mCushionFrames);
+        mResyncCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return oboe::DataCallbackResult::Continue;
+}
+
+bool FullDuplexEngine::runBlock(float *out, int32_t numFrames, int32_t outputChannels) {
+    const int32_t channels = mChannelCount;
+    const int32_t numSamples = numFrames * channels;
+    float *buffer = mProcessBuffer.data();
+
+    oboe::ResultWithValue<int32_t> result = mInputStream->read(buffer, numFrames, 0);
+    if (!result) {
+        return false;
+    }
+    if (result.value() < numFrames) {
+        const int32_t missing = numFrames - result.value();
+        memset(buffer + static_cast<size_t>(result.value()) * channels, 0,
+               sizeof(float) * missing * channels);
+        mOwedFrames += missing;
+        mLateFrames.fetch_add(missing, std::memory_order_relaxed);
+    }
+
+    if (mChain.isActive()) {
+        scaleAndClamp(buffer, buffer, numSamples);
+        if (mChain.usesFarEnd()) {
+            // What played in this block's slot, a cushion ago; only a block
+            // longer than the cushion reaches output that isn't rendered yet
+            float *farEnd = mChain.getFarEndBuffer();
+            const int64_t slot = mOutputIndex - mCushionFrames;
+            for (int32_t i = 0; i < numFrames; i++) {
+                const int64_t index = slot + i;
+                farEnd[i] = index >= 0 && index < mOutputIndex ? mHistory[index & mHistoryMask]
+                                                                : 0.0f;
+            }
+        }
+        mChain.process(buffer, numFrames);
+    }
+
+    if (mFileWriter.isOpen()) {
+        if (mFileWriter.getFormat() == FileFormat::Float32) {
+            scaleAndClamp(buffer, buffer, numSamples);
+            mFileWriter.write(buffer, numFrames);
+        } else {
+            convertFloatToInt16(buffer, mOutputBuffer.data(), numSamples);
+            mFileWriter.write(mOutputBuffer.data(), numFrames);
+        }
+    }
+
+    // Monitor, with the input's channels spread over the output's
+    if (mMonitoring.load(std::memory_order_relaxed)) {
+        const float gain = mMonitorGain.load(std::memory_order_relaxed);
+        for (int32_t i = 0; i < numFrames; i++) {
+            const float *frame = buffer + static_cast<size_t>(i) * channels;
+            float *outFrame = out + static_cast<size_t>(i) * outputChannels;
+            for (int32_t c = 0; c < outputChannels; c++) {
+                outFrame[c] = frame[std::min(c, channels - 1)] * gain;
+            }
+        }
+    } else {
+        memset(out, 0, sizeof(float) * numFrames * outputChannels);
+    }
+    mixPlayback(out, numFrames, outputChannels);
+    scaleAndClamp(out, out, numFrames * outputChannels);
+
+    // Keep what played, mono, for the far end of the blocks a cushion from now
+    const float scale = 1.0f / static_cast<float>(outputChannels);
+    for (int32_t i = 0; i < numFrames; i++) {
+        const float *outFrame = out + static_cast<size_t>(i) * outputChannels;
+        float sum = 0.0f;
+        for (int32_t c = 0; c < outputChannels; c++) {
+            sum += outFrame[c];
+        }
+        mHistory[(mOutputIndex + i) & mHistoryMask] = sum * scale;
+    }
+    mOutputIndex += numFrames;
+    return true;
+}
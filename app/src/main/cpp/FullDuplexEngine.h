@@ -0,0 +1,194 @@
+#ifndef OBOESAMPLE_FULLDUPLEXENGINE_H
+#define OBOESAMPLE_FULLDUPLEXENGINE_H
+
+#include <oboe/Oboe.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "AudioFileWriter.h"
+#include "CallbackMetrics.h"
+#include "ChainProcessor.h"
+#include "DspGraph.h"
+#include "FileFormat.h"
+
+/**
+ * Records and monitors on one callback clock, in the style of Oboe's
+ * FullDuplexStream.
+ *
+ * AudioRecorder and AudioPlayer each run a stream with its own callback, so
+ * what is captured has no sample-accurate relation to what is played. Here the
+ * output stream's callback drives both: the input stream has no callback and
+ * is read from the output callback, without blocking, one input frame for
+ * every output frame. The two directions share a frame clock. Each callback:
+ *  - runs the input through the processing chain and queues it to the file;
+ *  - if monitoring is on, plays it back at the monitor gain, else silence;
+ *  - mixes in whatever a subclass plays through mixPlayback() (a cue, a
+ *    backing track), and clips the result to full scale.
+ *
+ * Start-up goes through three phases:
+ *  - Draining: whatever the input has queued is thrown away until
+ *    kDrainCallbacks callbacks have found some, so the streams have settled.
+ *  - Cushion: silence is played and nothing is read until the input has
+ *    queued getLatencyFrames() frames (a few bursts); any excess is dropped.
+ *  - Running: from here on the input backlog stays at exactly that cushion.
+ *    Input frame n is captured getLatencyFrames() frames, on the shared
+ *    clock, before output frame n + getLatencyFrames() plays, plus the
+ *    device's own input and output latency and whatever the chain adds.
+ *
+ * The backlog absorbs the jitter between the two directions:
+ *  - If a read comes up short, the missing frames are played and recorded as
+ *    silence. When they turn up late, they are dropped, which keeps the
+ *    frames that follow in their slots.
+ *  - If the input runs more than kMaxExtraBursts ahead of the cushion (clock
+ *    drift, a stall on the output side), the excess is dropped.
+ * Either way, the clock keeps its fixed latency.
+ *
+ * The echo canceller's far end is exact. For input frame n the chain gets
+ * output frame n, which played getLatencyFrames() before frame n was read, so
+ * the canceller's echo delay is just the device's round trip from output to
+ * input, as a loopback measurement gives it.
+ *
+ * Both streams are float. Files are stored at the device rate. start(),
+ * stop() and setGraph() are control-thread calls. The monitoring setters may
+ * be called at any time.
+ */
+class FullDuplexEngine : public oboe::AudioStreamDataCallback {
+public:
+    // Callbacks that must find input before the cushion starts to build
+    static constexpr int32_t kDrainCallbacks = 20;
+
+    static constexpr int32_t kDefaultCushionBursts = 2;
+
+    // How far the input may run ahead of the cushion, in bursts, before the
+    // excess is dropped
+    static constexpr int32_t kMaxExtraBursts = 2;
+
+    FullDuplexEngine();
+    virtual ~FullDuplexEngine();
+
+    // Where to record; an empty path only monitors. Call before start().
+    void setStoragePath(const char *path) { mFilePath = path; }
+    void setFileFormat(FileFormat format) { mFileFormat = format; }
+
+    // Input preset for the input stream. Call before start().
+    void setAudioSource(oboe::InputPreset preset) { mInputPreset = preset; }
+
+    // Latency between the directions, in bursts of the output stream. Call
+    // before start().
+    void setCushionBursts(int32_t bursts) { mCushionBursts = std::max(1, bursts); }
+
+    // Live monitoring of the processed input, at gain (linear)
+    void setMonitoringEnabled(bool enabled) {
+        mMonitoring.store(enabled, std::memory_order_relaxed);
+    }
+    void setMonitorGain(float gain) { mMonitorGain.store(gain, std::memory_order_relaxed); }
+    bool isMonitoringEnabled() const { return mMonitoring.load(std::memory_order_relaxed); }
+
+    // The processing graph. Edits while running reach the callback at its next
+    // block and stages that stay in the graph keep their state.
+    void setGraph(const DspGraph &graph);
+
+    oboe::Result start();
+    void stop();
+
+    bool isRunning() const { return mRunning.load(std::memory_order_acquire); }
+
+    // Streams of the current run, as Oboe's FullDuplexStream exposes them (a
+    // host driver uses them to play the device)
+    oboe::AudioStream *getInputStream() const { return mInputStream.get(); }
+    oboe::AudioStream *getOutputStream() const { return mOutputStream.get(); }
+
+    // Format both directions run at, and the fixed latency between them
+    int32_t getSampleRate() const { return mSampleRate; }
+    int32_t getChannelCount() const { return mChannelCount; }
+    int32_t getLatencyFrames() const { return mCushionFrames; }
+
+    // True once the cushion is built and input is flowing through
+    bool isSynchronized() const { return mSynchronized.load(std::memory_order_acquire); }
+
+    // Input frames that came too late for their slot, and the times the input
+    // ran too far ahead and was cut back to the cushion
+    int64_t getLateFrames() const { return mLateFrames.load(std::memory_order_relaxed); }
+    int64_t getResyncCount() const { return mResyncCount.load(std::memory_order_relaxed); }
+
+    int64_t getDroppedFrames() const { return mFileWriter.getDroppedFrames(); }
+    CallbackMetrics::Snapshot getCallbackMetrics() const { return mMetrics.snapshot(); }
+    VoiceActivity::Snapshot getVoiceActivity() const {
+        return mChain.getVoiceActivity().snapshot();
+    }
+    WorkerThread::Stats getWriterThreadStats() const { return mFileWriter.getThreadStats(); }
+
+    oboe::DataCallbackResult
+    onAudioReady(oboe::AudioStream *outputStream, void *audioData, int32_t numFrames) override;
+
+protected:
+    // Audio thread: adds whatever else should play to numFrames interleaved
+    // output frames, on top of the monitored input. It shares the clock with
+    // the recording and is part of the echo canceller's far end. Plays nothing
+    // by default.
+    virtual void mixPlayback(float * /*output*/, int32_t /*numFrames*/,
+                             int32_t /*channelCount*/) {}
+
+private:
+    enum class Phase : int32_t {
+        Draining,
+        Cushion,
+        Running,
+    };
+
+    // Throws away up to numFrames queued input frames (all of them if
+    // negative). Returns how many went, or -1 if the input failed.
+    int32_t discardInput(int32_t numFrames);
+
+    // Runs numFrames (at most mScratchFrames) through the slot that starts at
+    // output frame mOutputIndex: reads the input, processes, records, and
+    // renders the output to out
+    bool runBlock(float *out, int32_t numFrames, int32_t outputChannels);
+
+    void closeStreams();
+
+    std::shared_ptr<oboe::AudioStream> mInputStream;
+    std::shared_ptr<oboe::AudioStream> mOutputStream;
+    oboe::InputPreset mInputPreset = oboe::InputPreset::VoiceCommunication;
+    int32_t mSampleRate = 48000;
+    int32_t mChannelCount = 1;
+    int32_t mFramesPerBurst = 0;
+    int32_t mCushionBursts = kDefaultCushionBursts;
+    int32_t mCushionFrames = 0;
+
+    std::string mFilePath;
+    FileFormat mFileFormat = FileFormat::Pcm16;
+    AudioFileWriter mFileWriter;
+
+    std::mutex mControlLock;
+    DspGraph mGraph;
+    ChainProcessor mChain;
+
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mSynchronized{false};
+    std::atomic<bool> mMonitoring{false};
+    std::atomic<float> mMonitorGain{1.0f};
+
+    // Audio thread
+    Phase mPhase = Phase::Draining;
+    int32_t mDrainCallbacksLeft = 0;
+    int32_t mOwedFrames = 0;    // zero-filled input frames still to arrive
+    int64_t mOutputIndex = 0;   // frames played since Running began
+
+    // Preallocated in start()
+    int32_t mScratchFrames = 0;
+    std::vector<float> mProcessBuffer;   // the slot's input, processed in place
+    std::vector<float> mDiscardBuffer;   // sink for dropped input
+    std::vector<int16_t> mOutputBuffer;  // int16 queued to the writer
+    std::vector<float> mHistory;         // mono output by frame index, a power of two long
+    int64_t mHistoryMask = 0;
+
+    std::atomic<int64_t> mLateFrames{0};
+    std::atomic<int64_t> mResyncCount{0};
+
+    CallbackMetrics mMetrics;
+};
+
+#endif //OBOESAMPLE_FULLDUPLEXENGINE_H
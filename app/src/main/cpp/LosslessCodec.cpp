@@ -0,0 +1,565 @@
+#include "LosslessCodec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Subframe types (2 bits)
+constexpr uint32_t kSubframeConstant = 0;
+constexpr uint32_t kSubframeVerbatim = 1;
+constexpr uint32_t kSubframeLpc = 2;
+
+// Quantized predictor coefficients, sign included. With kMaxOrder taps and
+// 16-bit samples the prediction sum stays well inside int32.
+constexpr int kCoefPrecision = 12;
+constexpr int kMaxShift = 15;
+
+// Rice parameters fit in 5 bits; partition order in 4
+constexpr int kMaxRiceParam = 30;
+constexpr int kMaxPartitionOrder = 6;
+constexpr int32_t kMinPartitionSamples = 32;
+
+constexpr uint8_t kMagic[4] = {'O', 'S', 'L', 'C'};
+
+static void putLe16(uint8_t *p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+static void putLe32(uint8_t *p, uint32_t v) {
+    putLe16(p, v);
+    putLe16(p + 2, v >> 16);
+}
+
+static uint32_t getLe16(const uint8_t *p) {
+    return p[0] | (static_cast<uint32_t>(p[1]) << 8);
+}
+
+static uint32_t getLe32(const uint8_t *p) {
+    return getLe16(p) | (getLe16(p + 2) << 16);
+}
+
+static uint32_t zigzag(int32_t v) {
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t u) {
+    return static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+}
+
+static int32_t signExtend(uint32_t v, int bits) {
+    uint32_t m = 1u << (bits - 1);
+    return static_cast<int32_t>((v ^ m) - m);
+}
+
+/**
+ * MSB-first bit packer appending to a byte vector.
+ */
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t> &out) : mOut(out) {}
+
+    // bits <= 32
+    void write(uint32_t value, int bits) {
+        if (bits == 0) return;
+        mAccumulator = (mAccumulator << bits) | (value & (0xffffffffu >> (32 - bits)));
+        mCount += bits;
+        while (mCount >= 8) {
+            mCount -= 8;
+            mOut.push_back(static_cast<uint8_t>(mAccumulator >> mCount));
+        }
+    }
+
+    // q zeros, then a one, then the low k bits of u
+    void writeRice(uint32_t u, int k) {
+        uint32_t q = u >> k;
+        while (q >= 32) {
+            write(0, 32);
+            q -= 32;
+        }
+        if (q + 1 + k <= 32) {
+            write((1u << k) | (u & ((1u << k) - 1)), static_cast<int>(q) + 1 + k);
+        } else {
+            write(1, static_cast<int>(q) + 1);
+            write(u, k);
+        }
+    }
+
+    // Pads the last byte with zeros
+    void flush() {
+        if (mCount > 0) {
+            write(0, 8 - mCount);
+        }
+    }
+
+private:
+    std::vector<uint8_t> &mOut;
+    uint64_t mAccumulator = 0;
+    int mCount = 0;
+};
+
+/**
+ * MSB-first bit reader. Reading past the end yields zeros and sets overrun.
+ */
+class BitReader {
+public:
+    BitReader(const uint8_t *data, size_t size) : mData(data), mEnd(data + size) {}
+
+    // bits <= 32
+    uint32_t read(int bits) {
+        if (bits == 0) return 0;
+        if (mBits < bits) {
+            refill();
+            if (mBits < bits) {
+                mOverrun = true;
+                mCache = 0;
+                mBits = 0;
+                return 0;
+            }
+        }
+        auto value = static_cast<uint32_t>(mCache >> (64 - bits));
+        mCache <<= bits;
+        mBits -= bits;
+        return value;
+    }
+
+    // Counts zeros up to the next one, and consumes the one
+    uint32_t readUnary() {
+        uint32_t count = 0;
+        while (true) {
+            if (mCache == 0) {
+                count += static_cast<uint32_t>(mBits);
+                mBits = 0;
+                refill();
+                if (mBits == 0) {
+                    mOverrun = true;
+                    return count;
+                }
+                continue;
+            }
+            // Bits below mBits are always zero, so the one is a valid bit
+            int zeros = __builtin_clzll(mCache);
+            count += static_cast<uint32_t>(zeros);
+            mCache = zeros == 63 ? 0 : mCache << (zeros + 1);
+            mBits -= zeros + 1;
+            return count;
+        }
+    }
+
+    uint32_t readRice(int k) {
+        uint32_t q = readUnary();
+        return (q << k) | read(k);
+    }
+
+    bool overrun() const { return mOverrun; }
+
+private:
+    void refill() {
+        while (mBits <= 56 && mData < mEnd) {
+            mCache |= static_cast<uint64_t>(*mData++) << (56 - mBits);
+            mBits += 8;
+        }
+    }
+
+    const uint8_t *mData;
+    const uint8_t *mEnd;
+    uint64_t mCache = 0;  // left-aligned, unused low bits zero
+    int mBits = 0;
+    bool mOverrun = false;
+};
+
+// --- Format ---
+
+bool LosslessFormat::parseFileHeader(const uint8_t *data, size_t size) {
+    if (size < kFileHeaderBytes || memcmp(data, kMagic, sizeof(kMagic)) != 0 ||
+        data[4] != kVersion || getLe16(data + 6) != 16) {
+        return false;
+    }
+    int32_t channels = data[5];
+    auto rate = static_cast<int32_t>(getLe32(data + 8));
+    auto frames = static_cast<int32_t>(getLe32(data + 12));
+    if (channels < 1 || channels > kMaxChannels || rate <= 0 || frames <= 0 ||
+        frames > (1 << 20)) {
+        return false;
+    }
+    channelCount = channels;
+    sampleRate = rate;
+    blockFrames = frames;
+    return true;
+}
+
+bool LosslessFormat::parseBlockHeader(const uint8_t *data, int32_t &frames,
+                                      uint32_t &payloadBytes) const {
+    uint32_t count = getLe32(data);
+    payloadBytes = getLe32(data + 4);
+    frames = static_cast<int32_t>(count);
+    return count > 0 && count <= static_cast<uint32_t>(blockFrames) &&
+           payloadBytes <= maxPayloadBytes();
+}
+
+// --- Encoder ---
+
+// Levinson-Durbin over autocorrelation r[0..maxOrder]. coefs[m] holds the
+// order m+1 predictor (x[n] ~ sum coefs[m][j] * x[n-1-j]) and errors[m] its
+// prediction error. Returns the highest order it could solve.
+static int levinsonDurbin(const double *r, int maxOrder,
+                          double coefs[][LosslessFormat::kMaxOrder], double *errors) {
+    double a[LosslessFormat::kMaxOrder] = {};
+    double previous[LosslessFormat::kMaxOrder];
+    double error = r[0];
+    for (int m = 0; m < maxOrder; m++) {
+        if (error <= 0.0) {
+            return m;
+        }
+        double acc = r[m + 1];
+        for (int j = 0; j < m; j++) {
+            acc -= a[j] * r[m - j];
+        }
+        double k = acc / error;
+
+        std::copy(a, a + m, previous);
+        for (int j = 0; j < m; j++) {
+            a[j] = previous[j] - k * previous[m - 1 - j];
+        }
+        a[m] = k;
+        error *= 1.0 - k * k;
+
+        std::copy(a, a + m + 1, coefs[m]);
+        errors[m] = error;
+    }
+    return maxOrder;
+}
+
+// Quantizes order coefficients to kCoefPrecision bits, carrying the rounding
+// error forward (as FLAC does). Returns the shift, or -1 if they're all zero.
+static int quantizeCoefs(const double *coefs, int order, int32_t *quantized) {
+    double cmax = 0.0;
+    for (int j = 0; j < order; j++) {
+        cmax = std::max(cmax, std::fabs(coefs[j]));
+    }
+    if (cmax <= 0.0) {
+        return -1;
+    }
+    int log2cmax;
+    std::frexp(cmax, &log2cmax);
+    // |coef| < 2^log2cmax; scale the largest to just under 2^(precision - 1)
+    int shift = std::clamp(kCoefPrecision - 1 - log2cmax, 0, kMaxShift);
+
+    const int32_t qmax = (1 << (kCoefPrecision - 1)) - 1;
+    const int32_t qmin = -(1 << (kCoefPrecision - 1));
+    double carry = 0.0;
+    for (int j = 0; j < order; j++) {
+        carry += coefs[j] * static_cast<double>(1 << shift);
+        auto q = static_cast<int32_t>(std::lround(carry));
+        q = std::clamp(q, qmin, qmax);
+        carry -= q;
+        quantized[j] = q;
+    }
+    return shift;
+}
+
+// Bits to Rice-code count values summing to sum with parameter k (estimate:
+// the sum of quotients is taken as sum >> k)
+static uint64_t riceBitsEstimate(uint64_t sum, uint32_t count, int k) {
+    return static_cast<uint64_t>(count) * (k + 1) + (sum >> k);
+}
+
+static int bestRiceParam(uint64_t sum, uint32_t count, uint64_t &bits) {
+    int k = 0;
+    if (count > 0) {
+        uint64_t mean = sum / count;
+        while (k < kMaxRiceParam && (uint64_t(1) << (k + 1)) <= mean) k++;
+    }
+    bits = riceBitsEstimate(sum, count, k);
+    if (k < kMaxRiceParam) {
+        uint64_t up = riceBitsEstimate(sum, count, k + 1);
+        if (up < bits) {
+            bits = up;
+            k++;
+        }
+    }
+    return k;
+}
+
+void LosslessEncoder::init(int32_t sampleRate, int32_t channelCount, int32_t blockFrames) {
+    mFormat.sampleRate = sampleRate;
+    mFormat.channelCount = std::clamp(channelCount, 1, LosslessFormat::kMaxChannels);
+    mFormat.blockFrames = std::max(blockFrames, 1);
+    mBlock.assign(static_cast<size_t>(mFormat.blockFrames) * mFormat.channelCount, 0);
+    mBlockFill = 0;
+    mChannel.assign(mFormat.blockFrames, 0);
+    mWindowed.assign(mFormat.blockFrames, 0.0);
+    mResidual.assign(mFormat.blockFrames, 0);
+}
+
+void LosslessEncoder::writeFileHeader(std::vector<uint8_t> &out) const {
+    uint8_t header[LosslessFormat::kFileHeaderBytes];
+    memcpy(header, kMagic, sizeof(kMagic));
+    header[4] = LosslessFormat::kVersion;
+    header[5] = static_cast<uint8_t>(mFormat.channelCount);
+    putLe16(header + 6, 16);
+    putLe32(header + 8, static_cast<uint32_t>(mFormat.sampleRate));
+    putLe32(header + 12, static_cast<uint32_t>(mFormat.blockFrames));
+    out.insert(out.end(), header, header + sizeof(header));
+}
+
+void LosslessEncoder::encode(const int16_t *data, size_t numSamples, std::vector<uint8_t> &out) {
+    while (numSamples > 0) {
+        size_t count = std::min(numSamples, mBlock.size() - mBlockFill);
+        memcpy(mBlock.data() + mBlockFill, data, count * sizeof(int16_t));
+        mBlockFill += count;
+        data += count;
+        numSamples -= count;
+        if (mBlockFill == mBlock.size()) {
+            encodeBlock(mFormat.blockFrames, out);
+            mBlockFill = 0;
+        }
+    }
+}
+
+void LosslessEncoder::finish(std::vector<uint8_t> &out) {
+    auto frames = static_cast<int32_t>(mBlockFill / mFormat.channelCount);
+    if (frames > 0) {
+        encodeBlock(frames, out);
+    }
+    mBlockFill = 0;
+}
+
+void LosslessEncoder::encodeBlock(int32_t n, std::vector<uint8_t> &out) {
+    const int32_t channels = mFormat.channelCount;
+
+    // Block header, payload size patched in at the end
+    size_t headerPos = out.size();
+    out.resize(headerPos + LosslessFormat::kBlockHeaderBytes);
+    putLe32(out.data() + headerPos, static_cast<uint32_t>(n));
+
+    BitWriter bits(out);
+    int32_t *x = mChannel.data();
+    for (int32_t c = 0; c < channels; c++) {
+        for (int32_t i = 0; i < n; i++) {
+            x[i] = mBlock[static_cast<size_t>(i) * channels + c];
+        }
+
+        if (std::all_of(x + 1, x + n, [&](int32_t v) { return v == x[0]; })) {
+            bits.write(kSubframeConstant, 2);
+            bits.write(static_cast<uint32_t>(x[0]), 16);
+            continue;
+        }
+
+        // Welch-windowed autocorrelation
+        int maxOrder = std::min(LosslessFormat::kMaxOrder, n - 1);
+        double r[LosslessFormat::kMaxOrder + 1] = {};
+        const double half = 0.5 * (n - 1);
+        const double width = 0.5 * (n + 1);
+        for (int32_t i = 0; i < n; i++) {
+            double t = (i - half) / width;
+            mWindowed[i] = x[i] * (1.0 - t * t);
+        }
+        for (int lag = 0; lag <= maxOrder; lag++) {
+            double sum = 0.0;
+            for (int32_t i = lag; i < n; i++) {
+                sum += mWindowed[i] * mWindowed[i - lag];
+            }
+            r[lag] = sum;
+        }
+
+        // Pick the order with the fewest estimated bits: residual bits from the
+        // prediction error, plus coefficients and warm-up samples
+        double coefs[LosslessFormat::kMaxOrder][LosslessFormat::kMaxOrder];
+        double errors[LosslessFormat::kMaxOrder];
+        int solved = maxOrder > 0 ? levinsonDurbin(r, maxOrder, coefs, errors) : 0;
+        int order = 0;
+        double bestBits = 1e300;
+        for (int m = 0; m < solved; m++) {
+            double bitsPerSample = errors[m] > 0.0
+                                   ? std::max(0.0, 0.5 * std::log2(0.5 * errors[m] / n))
+                                   : 0.0;
+            double estimate = bitsPerSample * (n - m - 1) + (m + 1) * (kCoefPrecision + 16);
+            if (estimate < bestBits) {
+                bestBits = estimate;
+                order = m + 1;
+            }
+        }
+
+        int32_t q[LosslessFormat::kMaxOrder];
+        int shift = order > 0 ? quantizeCoefs(coefs[order - 1], order, q) : -1;
+        uint64_t lpcBits = UINT64_MAX;
+        int partitionOrder = 0;
+        int riceParams[1 << kMaxPartitionOrder];
+
+        if (shift >= 0) {
+            // Residual of the quantized predictor, the same the decoder inverts
+            for (int32_t i = order; i < n; i++) {
+                int32_t prediction = 0;
+                for (int j = 0; j < order; j++) {
+                    prediction += q[j] * x[i - 1 - j];
+                }
+                mResidual[i] = zigzag(x[i] - (prediction >> shift));
+            }
+
+            // Finest useful partitioning: partitions tile the block, the first
+            // one minus the warm-up samples
+            int maxPartitionOrder = 0;
+            while (maxPartitionOrder < kMaxPartitionOrder &&
+                   n % (2 << maxPartitionOrder) == 0 &&
+                   (n >> (maxPartitionOrder + 1)) >= std::max(kMinPartitionSamples, order + 1)) {
+                maxPartitionOrder++;
+            }
+            uint64_t sums[1 << kMaxPartitionOrder];
+            int partitions = 1 << maxPartitionOrder;
+            int32_t size = n >> maxPartitionOrder;
+            for (int p = 0; p < partitions; p++) {
+                uint64_t sum = 0;
+                for (int32_t i = std::max(p * size, order); i < (p + 1) * size; i++) {
+                    sum += mResidual[i];
+                }
+                sums[p] = sum;
+            }
+
+            // Coarser orders by merging neighbours; keep the cheapest
+            uint64_t fixedBits = 2 + 4 + 4 + 5 + 4 +
+                                 static_cast<uint64_t>(order) * (kCoefPrecision + 16);
+            for (int po = maxPartitionOrder; po >= 0; po--) {
+                int count = 1 << po;
+                int32_t partSize = n >> po;
+                uint64_t total = fixedBits;
+                int params[1 << kMaxPartitionOrder];
+                for (int p = 0; p < count; p++) {
+                    auto samples = static_cast<uint32_t>(partSize - (p == 0 ? order : 0));
+                    uint64_t partBits;
+                    params[p] = bestRiceParam(sums[p], samples, partBits);
+                    total += 5 + partBits;
+                }
+                if (total < lpcBits) {
+                    lpcBits = total;
+                    partitionOrder = po;
+                    std::copy(params, params + count, riceParams);
+                }
+                for (int p = 0; p < count / 2; p++) {
+                    sums[p] = sums[2 * p] + sums[2 * p + 1];
+                }
+            }
+
+            // The estimate can be a little short; decide against verbatim on
+            // the exact size
+            lpcBits = fixedBits;
+            int32_t partSize = n >> partitionOrder;
+            for (int p = 0; p < (1 << partitionOrder); p++) {
+                int k = riceParams[p];
+                lpcBits += 5;
+                for (int32_t i = std::max(p * partSize, order); i < (p + 1) * partSize; i++) {
+                    lpcBits += (mResidual[i] >> k) + k + 1;
+                }
+            }
+        }
+
+        if (lpcBits >= static_cast<uint64_t>(n) * 16) {
+            bits.write(kSubframeVerbatim, 2);
+            for (int32_t i = 0; i < n; i++) {
+                bits.write(static_cast<uint32_t>(x[i]), 16);
+            }
+            continue;
+        }
+
+        bits.write(kSubframeLpc, 2);
+        bits.write(static_cast<uint32_t>(order - 1), 4);
+        bits.write(static_cast<uint32_t>(kCoefPrecision - 1), 4);
+        bits.write(static_cast<uint32_t>(shift), 5);
+        for (int j = 0; j < order; j++) {
+            bits.write(static_cast<uint32_t>(q[j]), kCoefPrecision);
+        }
+        for (int j = 0; j < order; j++) {
+            bits.write(static_cast<uint32_t>(x[j]), 16);
+        }
+        bits.write(static_cast<uint32_t>(partitionOrder), 4);
+        int32_t partSize = n >> partitionOrder;
+        for (int p = 0; p < (1 << partitionOrder); p++) {
+            int k = riceParams[p];
+            bits.write(static_cast<uint32_t>(k), 5);
+            for (int32_t i = std::max(p * partSize, order); i < (p + 1) * partSize; i++) {
+                bits.writeRice(mResidual[i], k);
+            }
+        }
+    }
+    bits.flush();
+
+    size_t payloadBytes = out.size() - headerPos - LosslessFormat::kBlockHeaderBytes;
+    putLe32(out.data() + headerPos + 4, static_cast<uint32_t>(payloadBytes));
+}
+
+// --- Decoder ---
+
+void LosslessDecoder::init(const LosslessFormat &format) {
+    mFormat = format;
+    mChannel.assign(mFormat.blockFrames, 0);
+}
+
+bool LosslessDecoder::decodeBlock(const uint8_t *payload, size_t payloadBytes, int32_t n,
+                                  int16_t *out) {
+    if (n <= 0 || n > mFormat.blockFrames) {
+        return false;
+    }
+    const int32_t channels = mFormat.channelCount;
+    BitReader bits(payload, payloadBytes);
+    int16_t *x = mChannel.data();
+
+    for (int32_t c = 0; c < channels; c++) {
+        uint32_t type = bits.read(2);
+        if (type == kSubframeConstant) {
+            std::fill(x, x + n, static_cast<int16_t>(bits.read(16)));
+        } else if (type == kSubframeVerbatim) {
+            for (int32_t i = 0; i < n; i++) {
+                x[i] = static_cast<int16_t>(bits.read(16));
+            }
+        } else if (type == kSubframeLpc) {
+            int order = static_cast<int>(bits.read(4)) + 1;
+            int precision = static_cast<int>(bits.read(4)) + 1;
+            int shift = static_cast<int>(bits.read(5));
+            if (order > LosslessFormat::kMaxOrder || order >= n || precision > kCoefPrecision) {
+                return false;
+            }
+            int32_t q[LosslessFormat::kMaxOrder];
+            for (int j = 0; j < order; j++) {
+                q[j] = signExtend(bits.read(precision), precision);
+            }
+            for (int j = 0; j < order; j++) {
+                x[j] = static_cast<int16_t>(bits.read(16));
+            }
+
+            int partitionOrder = static_cast<int>(bits.read(4));
+            if (partitionOrder > kMaxPartitionOrder || n % (1 << partitionOrder) != 0 ||
+                (n >> partitionOrder) < order) {
+                return false;
+            }
+            int32_t partSize = n >> partitionOrder;
+            for (int p = 0; p < (1 << partitionOrder); p++) {
+                int k = static_cast<int>(bits.read(5));
+                if (k > kMaxRiceParam) {
+                    return false;
+                }
+                for (int32_t i = std::max(p * partSize, order); i < (p + 1) * partSize; i++) {
+                    // Samples are int16, so with precision <= 12 the sum can't overflow
+                    int32_t prediction = 0;
+                    for (int j = 0; j < order; j++) {
+                        prediction += q[j] * x[i - 1 - j];
+                    }
+                    int64_t sample = static_cast<int64_t>(unzigzag(bits.readRice(k))) +
+                                     (prediction >> shift);
+                    x[i] = static_cast<int16_t>(sample);
+                }
+                if (bits.overrun()) {
+                    return false;
+                }
+            }
+        } else {
+            return false;
+        }
+        if (bits.overrun()) {
+            return false;
+        }
+
+        for (int32_t i = 0; i < n; i++) {
+            out[static_cast<size_t>(i) * channels + c] = x[i];
+        }
+    }
+    return true;
+}
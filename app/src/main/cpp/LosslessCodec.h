@@ -0,0 +1,102 @@
+#ifndef OBOESAMPLE_LOSSLESSCODEC_H
+#define OBOESAMPLE_LOSSLESSCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Streaming lossless codec for int16 recordings, after FLAC.
+ *
+ * Audio is cut into blocks of kBlockFrames frames and each channel of a block
+ * is coded on its own as one of:
+ *  - constant: one sample value (digital silence, a closed noise gate)
+ *  - LPC: a quantized linear predictor (order 1..kMaxOrder, picked per block
+ *    from the Levinson-Durbin prediction error), the first order samples
+ *    verbatim, then the prediction residual Rice-coded in 2^p partitions, each
+ *    with its own Rice parameter
+ *  - verbatim: raw samples, for blocks that don't predict (white noise)
+ *
+ * File layout, little endian:
+ *   header  "OSLC", u8 version, u8 channels, u16 bits per sample (16),
+ *           u32 sample rate, u32 block frames
+ *   blocks  u32 frames, u32 payload bytes, payload (bit-packed, MSB first)
+ *
+ * Every block stands alone, so a reader can decode a file block by block as it
+ * streams in. The encoder and decoder allocate only in init(); the encoder's
+ * output vector grows as needed.
+ */
+
+// Format constants and the header parsing shared by encoder and decoder
+struct LosslessFormat {
+    static constexpr uint8_t kVersion = 1;
+    static constexpr size_t kFileHeaderBytes = 16;
+    static constexpr size_t kBlockHeaderBytes = 8;
+
+    // 85 ms at 48 kHz: long enough to amortize the predictor, short enough to
+    // track speech
+    static constexpr int32_t kBlockFrames = 4096;
+    static constexpr int kMaxOrder = 12;
+    static constexpr int kMaxChannels = 8;
+
+    int32_t sampleRate = 0;
+    int32_t channelCount = 0;
+    int32_t blockFrames = 0;
+
+    // True if data (size bytes) starts with a valid file header; fills in the format
+    bool parseFileHeader(const uint8_t *data, size_t size);
+
+    // Largest payload a block can have: the encoder never codes a channel
+    // bigger than verbatim plus an LPC subframe header
+    size_t maxPayloadBytes() const {
+        return (static_cast<size_t>(blockFrames) * 2 + 128) * channelCount;
+    }
+
+    // Reads a block header; false if it's malformed for this format
+    bool parseBlockHeader(const uint8_t *data, int32_t &frames, uint32_t &payloadBytes) const;
+};
+
+class LosslessEncoder {
+public:
+    // Sizes the block buffers for the stream. Allocates.
+    void init(int32_t sampleRate, int32_t channelCount,
+              int32_t blockFrames = LosslessFormat::kBlockFrames);
+
+    // Appends the file header to out
+    void writeFileHeader(std::vector<uint8_t> &out) const;
+
+    // Takes numSamples interleaved samples (whole frames) and appends every
+    // block they complete to out
+    void encode(const int16_t *data, size_t numSamples, std::vector<uint8_t> &out);
+
+    // Encodes whatever is left as a final, shorter block
+    void finish(std::vector<uint8_t> &out);
+
+private:
+    void encodeBlock(int32_t frames, std::vector<uint8_t> &out);
+
+    LosslessFormat mFormat;
+    std::vector<int16_t> mBlock;      // interleaved frames being collected
+    size_t mBlockFill = 0;
+    std::vector<int32_t> mChannel;    // one channel of the block
+    std::vector<double> mWindowed;
+    std::vector<uint32_t> mResidual;  // zigzag-mapped prediction residual
+};
+
+class LosslessDecoder {
+public:
+    // Sizes the block buffers for a stream. Allocates.
+    void init(const LosslessFormat &format);
+
+    const LosslessFormat &getFormat() const { return mFormat; }
+
+    // Decodes one block payload into frames interleaved frames at out.
+    // Returns false if the payload is corrupt.
+    bool decodeBlock(const uint8_t *payload, size_t payloadBytes, int32_t frames, int16_t *out);
+
+private:
+    LosslessFormat mFormat;
+    std::vector<int16_t> mChannel;
+};
+
+#endif //OBOESAMPLE_LOSSLESSCODEC_H
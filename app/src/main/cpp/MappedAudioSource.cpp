@@ -0,0 +1,163 @@
+#include "MappedAudioSource.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_TAG "MappedAudioSource"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// How far ahead of the playback position pages are kept resident (~2.7 s of
+// 48 kHz stereo)
+constexpr size_t kReadAheadBytes = 512 * 1024;
+
+// The helper refills the window once it has shrunk by this much, so each pass
+// issues one decent-sized madvise rather than one per callback
+constexpr size_t kRefillBytes = 64 * 1024;
+
+// How far behind the playback position pages are kept before being dropped
+constexpr size_t kKeepBehindBytes = 256 * 1024;
+
+// How often the helper checks the playback position
+constexpr auto kPollInterval = std::chrono::milliseconds(10);
+
+MappedAudioSource::~MappedAudioSource() {
+    close();
+}
+
+bool MappedAudioSource::open(const std::string &path, size_t bytesPerSample) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        LOGE("Failed to stat %s: %s", path.c_str(), strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    // A trailing partial sample is never copied
+    mBytesPerSample = std::max<size_t>(bytesPerSample, 1);
+    auto fileBytes = static_cast<size_t>(st.st_size);
+    mSizeBytes = fileBytes - fileBytes % mBytesPerSample;
+    mData = nullptr;
+    if (mSizeBytes > 0) {
+        void *mapped = mmap(nullptr, mSizeBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            LOGE("Failed to map %s: %s", path.c_str(), strerror(errno));
+            ::close(fd);
+            mSizeBytes = 0;
+            return false;
+        }
+        mData = static_cast<const uint8_t *>(mapped);
+        madvise(mapped, mSizeBytes, MADV_SEQUENTIAL);
+    }
+    // The mapping keeps the file referenced
+    ::close(fd);
+
+    long pageSize = sysconf(_SC_PAGESIZE);
+    mPageSize = pageSize > 0 ? static_cast<size_t>(pageSize) : 4096;
+
+    mPosition.store(0, std::memory_order_relaxed);
+    mPrefaulted.store(0, std::memory_order_relaxed);
+    mReleased = 0;
+    mPrefaultMisses.store(0, std::memory_order_relaxed);
+
+    // The first callbacks must not wait for the helper
+    prefaultTo(kReadAheadBytes);
+
+    mStopRequested.store(false, std::memory_order_relaxed);
+    mHelperThread.start("AudioPrefetch", [this] { helperLoop(); });
+    mOpen = true;
+
+    LOGD("Mapped %s: %zu samples", path.c_str(), getTotalSamples());
+    return true;
+}
+
+void MappedAudioSource::close() {
+    if (!mOpen) {
+        return;
+    }
+    mStopRequested.store(true, std::memory_order_release);
+    mHelperThread.join();
+
+    if (mData != nullptr) {
+        munmap(const_cast<uint8_t *>(mData), mSizeBytes);
+        mData = nullptr;
+    }
+    LOGD("Unmapped after %zu/%zu samples, %lld prefault misses", getPosition(),
+         getTotalSamples(), static_cast<long long>(getPrefaultMisses()));
+    mSizeBytes = 0;
+    mOpen = false;
+}
+
+size_t MappedAudioSource::read(void *dest, size_t numSamples) {
+    auto *bytes = static_cast<uint8_t *>(dest);
+    size_t position = mPosition.load(std::memory_order_relaxed);
+    size_t requested = numSamples * mBytesPerSample;
+    size_t numBytes = std::min(requested, mSizeBytes - position);
+
+    if (position + numBytes > mPrefaulted.load(std::memory_order_acquire)) {
+        mPrefaultMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (numBytes > 0) {
+        memcpy(bytes, mData + position, numBytes);
+        mPosition.store(position + numBytes, std::memory_order_relaxed);
+    }
+
+    // All-zero bytes are silence for int16 and float alike
+    if (numBytes < requested) {
+        memset(bytes + numBytes, 0, requested - numBytes);
+    }
+    return numBytes / mBytesPerSample;
+}
+
+void MappedAudioSource::helperLoop() {
+    while (!mStopRequested.load(std::memory_order_acquire)) {
+        size_t position = mPosition.load(std::memory_order_relaxed);
+
+        if (mPrefaulted.load(std::memory_order_relaxed) < mSizeBytes &&
+            mPrefaulted.load(std::memory_order_relaxed) < position + kReadAheadBytes - kRefillBytes) {
+            prefaultTo(position + kReadAheadBytes);
+        }
+
+        // Drop what's been played, a page-aligned stretch at a time
+        if (position > mReleased + kKeepBehindBytes + kRefillBytes) {
+            size_t end = (position - kKeepBehindBytes) & ~(mPageSize - 1);
+            madvise(const_cast<uint8_t *>(mData) + mReleased, end - mReleased, MADV_DONTNEED);
+            mReleased = end;
+        }
+
+        WorkerThread::sleepFor(kPollInterval);
+    }
+}
+
+void MappedAudioSource::prefaultTo(size_t end) {
+    end = std::min(end, mSizeBytes);
+    size_t start = mPrefaulted.load(std::memory_order_relaxed);
+    if (start >= end) {
+        return;
+    }
+
+    // Start async readahead for the whole stretch, then block on it here
+    size_t alignedStart = start & ~(mPageSize - 1);
+    madvise(const_cast<uint8_t *>(mData) + alignedStart, end - alignedStart, MADV_WILLNEED);
+
+    // Volatile so the touches aren't optimized away
+    for (size_t offset = alignedStart; offset < end; offset += mPageSize) {
+        static_cast<void>(*static_cast<const volatile uint8_t *>(mData + offset));
+    }
+
+    mPrefaulted.store(end, std::memory_order_release);
+}
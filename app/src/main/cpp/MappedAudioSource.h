@@ -0,0 +1,82 @@
+#ifndef OBOESAMPLE_MAPPEDAUDIOSOURCE_H
+#define OBOESAMPLE_MAPPEDAUDIOSOURCE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "WorkerThread.h"
+
+/**
+ * Plays back a raw interleaved file (int16 or float samples) from a read-only
+ * memory mapping so the audio callback never makes a syscall.
+ *
+ * open() maps the whole file and faults in the first kReadAheadBytes before
+ * returning. From then on a helper thread keeps the window ahead of the
+ * playback position resident: it issues MADV_WILLNEED for the next stretch and
+ * touches one byte per page so the callback's memcpy only ever hits pages that
+ * are already mapped. Pages well behind the position are dropped again with
+ * MADV_DONTNEED, so long recordings don't pin their whole length in memory.
+ *
+ * The sample count is fixed at open(), so the callback detects the end of the
+ * file with a single comparison; read() zero-fills past it.
+ */
+class MappedAudioSource {
+public:
+    MappedAudioSource() = default;
+    ~MappedAudioSource();
+
+    MappedAudioSource(const MappedAudioSource &) = delete;
+    MappedAudioSource &operator=(const MappedAudioSource &) = delete;
+
+    // Maps the file of bytesPerSample-sized samples, prefaults its start and
+    // starts the helper thread. Not real-time safe.
+    bool open(const std::string &path, size_t bytesPerSample = sizeof(int16_t));
+
+    // Stops the helper thread and unmaps the file. Only call once the callback
+    // has stopped reading.
+    void close();
+
+    bool isOpen() const { return mOpen; }
+
+    // Audio thread: copies up to numSamples samples into dest and zero-fills
+    // the rest. Returns how many came from the file; fewer than numSamples
+    // means the end was reached.
+    size_t read(void *dest, size_t numSamples);
+
+    size_t getTotalSamples() const { return mSizeBytes / mBytesPerSample; }
+    size_t getPosition() const {
+        return mPosition.load(std::memory_order_relaxed) / mBytesPerSample;
+    }
+
+    // Reads that ran past the prefaulted window and may have page-faulted
+    int64_t getPrefaultMisses() const { return mPrefaultMisses.load(std::memory_order_relaxed); }
+
+    // Scheduling and wake-ups of the read-ahead thread
+    WorkerThread::Stats getThreadStats() const { return mHelperThread.getStats(); }
+
+private:
+    void helperLoop();
+
+    // Faults in [mPrefaulted, end) and advances mPrefaulted
+    void prefaultTo(size_t end);
+
+    const uint8_t *mData = nullptr;
+    size_t mSizeBytes = 0;
+    size_t mBytesPerSample = sizeof(int16_t);
+    size_t mPageSize = 4096;
+    bool mOpen = false;
+
+    WorkerThread mHelperThread;
+    std::atomic<bool> mStopRequested{false};
+
+    // Byte offset of the next sample the callback reads
+    alignas(64) std::atomic<size_t> mPosition{0};
+    // Everything before this offset has been touched by the helper
+    alignas(64) std::atomic<size_t> mPrefaulted{0};
+    size_t mReleased = 0;         // helper-owned: pages before this were dropped
+
+    std::atomic<int64_t> mPrefaultMisses{0};
+};
+
+#endif //OBOESAMPLE_MAPPEDAUDIOSOURCE_H
@@ -0,0 +1,294 @@
+#include "OfflineProcessor.h"
+#include "AudioFileWriter.h"
+#include "CompressedAudioSource.h"
+#include "filter/SampleConversion.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define LOG_TAG "OfflineProcessor"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Nothing is waiting on the output in real time, so let the final flush take
+// as long as the disk needs
+constexpr auto kFlushTimeout = std::chrono::seconds(30);
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+OfflineProcessor::~OfflineProcessor() {
+    closeInput();
+}
+
+void OfflineProcessor::setRawInputFormat(FileFormat format, int32_t sampleRate,
+                                         int32_t channelCount) {
+    mRawFormat = format == FileFormat::Float32 ? FileFormat::Float32 : FileFormat::Pcm16;
+    mRawSampleRate = sampleRate;
+    mRawChannelCount = channelCount;
+}
+
+OfflineProcessor::Result OfflineProcessor::process(const std::string &inputPath,
+                                                   const std::string &outputPath) {
+    Result result;
+    const int64_t startNs = nowNs();
+    if (!openInput(inputPath)) {
+        return result;
+    }
+    result.sampleRate = mSampleRate;
+    result.channelCount = mChannelCount;
+    prepare();
+
+    AudioFileWriter writer;
+    if (!writer.open(outputPath, mSampleRate, mChannelCount, mOutputFormat)) {
+        LOGE("Failed to open %s for output", outputPath.c_str());
+        closeInput();
+        return result;
+    }
+
+    bool written = true;
+    int32_t frames;
+    while (written && (frames = readInput(kBlockFrames)) > 0) {
+        const void *output = processBlock(frames);
+        if (mOutputFormat == FileFormat::Float32) {
+            written = writer.writeBlocking(static_cast<const float *>(output), frames);
+        } else {
+            written = writer.writeBlocking(static_cast<const int16_t *>(output), frames);
+        }
+        result.frames += frames;
+    }
+    closeInput();
+
+    bool flushed = writer.close(kFlushTimeout);
+    result.elapsedNs = nowNs() - startNs;
+    result.ok = written && flushed && writer.getFramesWritten() == result.frames;
+    if (!result.ok) {
+        LOGE("Output incomplete: %lld of %lld frames written",
+             static_cast<long long>(writer.getFramesWritten()),
+             static_cast<long long>(result.frames));
+    }
+    LOGD("Processed %.1f s of audio in %.3f s (%.1fx real time)", result.audioSeconds(),
+         static_cast<double>(result.elapsedNs) / 1e9, result.speedFactor());
+    return result;
+}
+
+OfflineProcessor::Result OfflineProcessor::processRange(const std::string &inputPath,
+                                                        const std::string &outputPath,
+                                                        int64_t startFrame, int64_t endFrame,
+                                                        int64_t warmUpFrames) {
+    Result result;
+    const int64_t startNs = nowNs();
+    if (mOutputFormat == FileFormat::Lossless || !openInput(inputPath)) {
+        return result;
+    }
+    if (mInputFormat == FileFormat::Lossless) {
+        LOGE("Can't process a range of compressed %s", inputPath.c_str());
+        closeInput();
+        return result;
+    }
+    result.sampleRate = mSampleRate;
+    result.channelCount = mChannelCount;
+    prepare();
+
+    const size_t inputFrameBytes = bytesPerFrame(mInputFormat, mChannelCount);
+    const size_t outputFrameBytes = bytesPerFrame(mOutputFormat, mChannelCount);
+    int64_t position = std::max<int64_t>(0, startFrame - warmUpFrames);
+    int outputFd = ::open(outputPath.c_str(), O_WRONLY | O_CLOEXEC);
+    if (outputFd < 0 || lseek(mFd, static_cast<off_t>(position * inputFrameBytes), SEEK_SET) < 0) {
+        LOGE("Failed to set up range of %s: %s", inputPath.c_str(), strerror(errno));
+        if (outputFd >= 0) ::close(outputFd);
+        closeInput();
+        return result;
+    }
+
+    bool written = true;
+    while (written && position < endFrame) {
+        auto wanted = static_cast<int32_t>(std::min<int64_t>(kBlockFrames, endFrame - position));
+        int32_t frames = readInput(wanted);
+        if (frames == 0) {
+            break;
+        }
+        const auto *output = static_cast<const char *>(processBlock(frames));
+
+        // Warm-up frames only settle the chain
+        const auto skip = static_cast<int32_t>(
+                std::min<int64_t>(frames, std::max<int64_t>(0, startFrame - position)));
+        size_t remaining = (frames - skip) * outputFrameBytes;
+        const char *bytes = output + skip * outputFrameBytes;
+        auto offset = static_cast<off_t>((position + skip) * outputFrameBytes);
+        while (remaining > 0) {
+            ssize_t count = pwrite(outputFd, bytes, remaining, offset);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) {
+                LOGE("Write to %s failed: %s", outputPath.c_str(), strerror(errno));
+                written = false;
+                break;
+            }
+            bytes += count;
+            offset += count;
+            remaining -= static_cast<size_t>(count);
+        }
+        result.frames += frames - skip;
+        position += frames;
+    }
+    closeInput();
+    ::close(outputFd);
+
+    result.elapsedNs = nowNs() - startNs;
+    result.ok = written && position >= endFrame;
+    return result;
+}
+
+void OfflineProcessor::prepare() {
+    const size_t blockSamples = static_cast<size_t>(kBlockFrames) * mChannelCount;
+    mInput16.resize(blockSamples);
+    mInputFloat.resize(blockSamples);
+    mProcessBuffer.resize(blockSamples);
+    mOutputBuffer.resize(blockSamples);
+    mChain.prepare(mSampleRate, mChannelCount, kBlockFrames, mGraph);
+}
+
+const void *OfflineProcessor::processBlock(int32_t numFrames) {
+    const int32_t numSamples = numFrames * mChannelCount;
+    const bool processing = mChain.isActive();
+    float *buffer = mProcessBuffer.data();
+
+    // Same path as the recorder callback: clip, the chain, then conversion
+    // to the file's sample format
+    if (mInputFormat == FileFormat::Float32) {
+        scaleAndClamp(mInputFloat.data(), buffer, numSamples);
+    } else {
+        convertInt16ToFloat(mInput16.data(), buffer, numSamples);
+    }
+    if (processing) {
+        mChain.process(buffer, numFrames);
+    }
+    if (mOutputFormat == FileFormat::Float32) {
+        scaleAndClamp(buffer, buffer, numSamples);
+        return buffer;
+    }
+    convertFloatToInt16(buffer, mOutputBuffer.data(), numSamples);
+    return mOutputBuffer.data();
+}
+
+bool OfflineProcessor::openInput(const std::string &path) {
+    closeInput();
+
+    const bool compressed = CompressedAudioSource::isCompressedFile(path);
+    mFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFd < 0) {
+        LOGE("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    posix_fadvise(mFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (compressed) {
+        uint8_t header[LosslessFormat::kFileHeaderBytes];
+        LosslessFormat format;
+        if (!readFully(header, sizeof(header)) ||
+            !format.parseFileHeader(header, sizeof(header))) {
+            LOGE("%s has a corrupt header", path.c_str());
+            closeInput();
+            return false;
+        }
+        mDecoder.init(format);
+        mBlock.assign(static_cast<size_t>(format.blockFrames) * format.channelCount, 0);
+        mPayload.resize(format.maxPayloadBytes());
+        mBlockSamples = 0;
+        mBlockPosition = 0;
+        mInputFormat = FileFormat::Lossless;
+        mSampleRate = format.sampleRate;
+        mChannelCount = format.channelCount;
+    } else {
+        mInputFormat = mRawFormat;
+        mSampleRate = mRawSampleRate;
+        mChannelCount = std::max(1, mRawChannelCount);
+    }
+    LOGD("Processing %s: %d Hz, %d channels, format %d", path.c_str(), mSampleRate,
+         mChannelCount, static_cast<int>(mInputFormat));
+    return true;
+}
+
+void OfflineProcessor::closeInput() {
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+}
+
+int32_t OfflineProcessor::readInput(int32_t numFrames) {
+    const size_t numSamples = static_cast<size_t>(numFrames) * mChannelCount;
+
+    if (mInputFormat == FileFormat::Lossless) {
+        // Blocks hold whole frames, and so does every read
+        size_t count = 0;
+        while (count < numSamples) {
+            if (mBlockPosition == mBlockSamples && !decodeNextBlock()) {
+                break;
+            }
+            size_t chunk = std::min(numSamples - count, mBlockSamples - mBlockPosition);
+            memcpy(mInput16.data() + count, mBlock.data() + mBlockPosition,
+                   chunk * sizeof(int16_t));
+            count += chunk;
+            mBlockPosition += chunk;
+        }
+        return static_cast<int32_t>(count / mChannelCount);
+    }
+
+    // Raw: whatever the file holds, dropping a partial frame at its end
+    const size_t frameBytes = bytesPerFrame(mInputFormat, mChannelCount);
+    auto *bytes = mInputFormat == FileFormat::Float32
+                  ? reinterpret_cast<char *>(mInputFloat.data())
+                  : reinterpret_cast<char *>(mInput16.data());
+    const size_t wanted = numFrames * frameBytes;
+    size_t count = 0;
+    while (count < wanted) {
+        ssize_t n = ::read(mFd, bytes + count, wanted - count);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            break;
+        }
+        count += static_cast<size_t>(n);
+    }
+    return static_cast<int32_t>(count / frameBytes);
+}
+
+bool OfflineProcessor::decodeNextBlock() {
+    const LosslessFormat &format = mDecoder.getFormat();
+    uint8_t header[LosslessFormat::kBlockHeaderBytes];
+    if (!readFully(header, sizeof(header))) {
+        return false;
+    }
+
+    int32_t frames;
+    uint32_t payloadBytes;
+    if (!format.parseBlockHeader(header, frames, payloadBytes) ||
+        !readFully(mPayload.data(), payloadBytes) ||
+        !mDecoder.decodeBlock(mPayload.data(), payloadBytes, frames, mBlock.data())) {
+        LOGE("Corrupt or truncated block, ending the input early");
+        return false;
+    }
+    mBlockSamples = static_cast<size_t>(frames) * format.channelCount;
+    mBlockPosition = 0;
+    return true;
+}
+
+bool OfflineProcessor::readFully(void *data, size_t numBytes) {
+    auto *bytes = static_cast<char *>(data);
+    while (numBytes > 0) {
+        ssize_t count = ::read(mFd, bytes, numBytes);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        numBytes -= static_cast<size_t>(count);
+    }
+    return true;
+}
@@ -0,0 +1,134 @@
+#ifndef OBOESAMPLE_OFFLINEPROCESSOR_H
+#define OBOESAMPLE_OFFLINEPROCESSOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ChainProcessor.h"
+#include "DspGraph.h"
+#include "FileFormat.h"
+#include "LosslessCodec.h"
+#include "RecorderParams.h"
+
+/**
+ * Runs the recorder's processing chain over an existing recording as fast as
+ * the CPU allows, e.g. to reprocess an archive with new filter settings.
+ *
+ * The input goes through exactly what AudioRecorder does to a live stream
+ * (clipping, ChainProcessor, output conversion), so the output matches what
+ * recording with the same parameters would have produced, with no far end
+ * (there's no player to cancel). Instead of callback-sized bursts it works in
+ * blocks of kBlockFrames, and the output goes through AudioFileWriter with
+ * writeBlocking(): compression and disk writes overlap with processing, but
+ * nothing is ever dropped.
+ *
+ * Compressed input is detected from its header. Raw files have none, so their
+ * sample format, rate and channel count come from setRawInputFormat().
+ *
+ * process() blocks until the output is complete; call it off the UI thread.
+ */
+class OfflineProcessor {
+public:
+    // Frames processed per block (~340 ms at 48 kHz)
+    static constexpr int32_t kBlockFrames = 16384;
+
+    struct Result {
+        bool ok = false;
+        int64_t frames = 0;
+        int32_t sampleRate = 0;
+        int32_t channelCount = 0;
+        int64_t elapsedNs = 0;   // wall time, including the final flush
+
+        double audioSeconds() const {
+            return sampleRate > 0 ? static_cast<double>(frames) / sampleRate : 0.0;
+        }
+
+        // Audio duration / wall time: how many times faster than real time
+        double speedFactor() const {
+            return elapsedNs > 0 ? audioSeconds() * 1e9 / static_cast<double>(elapsedNs) : 0.0;
+        }
+    };
+
+    OfflineProcessor() = default;
+    ~OfflineProcessor();
+
+    OfflineProcessor(const OfflineProcessor &) = delete;
+    OfflineProcessor &operator=(const OfflineProcessor &) = delete;
+
+    // Chain to run, typically AudioRecorder::getGraph()
+    void setGraph(const DspGraph &graph) { mGraph = graph; }
+
+    // The classic chain configured from params
+    void setParams(const RecorderParams &params) { mGraph = DspGraph::fromParams(params); }
+
+    // How to read headerless input files
+    void setRawInputFormat(FileFormat format, int32_t sampleRate, int32_t channelCount);
+
+    // Format of the processed file
+    void setOutputFormat(FileFormat format) { mOutputFormat = format; }
+
+    // Processes inputPath into outputPath (truncated). Not real-time safe.
+    Result process(const std::string &inputPath, const std::string &outputPath);
+
+    // Processes frames [startFrame, endFrame) of a raw input into the same
+    // frames of an existing raw output, which must already be large enough.
+    // The chain first runs over up to warmUpFrames of the input before
+    // startFrame, whose output is discarded, so its state has settled by the
+    // time the range starts. Used to split long files across threads
+    // (BatchProcessor). Neither file may be compressed.
+    Result processRange(const std::string &inputPath, const std::string &outputPath,
+                        int64_t startFrame, int64_t endFrame, int64_t warmUpFrames);
+
+    static size_t bytesPerFrame(FileFormat format, int32_t channelCount) {
+        return (format == FileFormat::Float32 ? sizeof(float) : sizeof(int16_t)) * channelCount;
+    }
+
+private:
+    // Opens the input and works out its format, rate and channel count
+    bool openInput(const std::string &path);
+    void closeInput();
+
+    // Reads up to numFrames frames into mInput16 (Pcm16/Lossless) or
+    // mInputFloat (Float32). Returns how many, 0 at the end of the input.
+    int32_t readInput(int32_t numFrames);
+
+    // Sizes the buffers and the chain for the open input
+    void prepare();
+
+    // Runs the numFrames just read through the clip and the chain into
+    // mProcessBuffer, then converts them to the output format. Returns the
+    // converted frames.
+    const void *processBlock(int32_t numFrames);
+
+    // Decodes the next compressed block into mBlock. False at the end.
+    bool decodeNextBlock();
+
+    bool readFully(void *data, size_t numBytes);
+
+    DspGraph mGraph = DspGraph::fromParams(RecorderParams());
+    FileFormat mRawFormat = FileFormat::Pcm16;
+    int32_t mRawSampleRate = 48000;
+    int32_t mRawChannelCount = 1;
+    FileFormat mOutputFormat = FileFormat::Pcm16;
+
+    // The open input
+    int mFd = -1;
+    FileFormat mInputFormat = FileFormat::Pcm16;
+    int32_t mSampleRate = 0;
+    int32_t mChannelCount = 0;
+
+    // Compressed input: the current decoded block and how much of it is used
+    LosslessDecoder mDecoder;
+    std::vector<uint8_t> mPayload;
+    std::vector<int16_t> mBlock;
+    size_t mBlockSamples = 0;
+    size_t mBlockPosition = 0;
+
+    ChainProcessor mChain;
+    std::vector<int16_t> mInput16;
+    std::vector<float> mInputFloat;
+    std::vector<float> mProcessBuffer;
+    std::vector<int16_t> mOutputBuffer;
+};
+
+#endif //OBOESAMPLE_OFFLINEPROCESSOR_H
@@ -0,0 +1,72 @@
+#ifndef OBOESAMPLE_RECORDERPARAMS_H
+#define OBOESAMPLE_RECORDERPARAMS_H
+
+/**
+ * Settings of the classic processing chain, one stage of each type, as the
+ * recorder's per-type setters change them.
+ *
+ * DspGraph::fromParams() turns them into a graph, and the setters copy what
+ * they change onto the graph's classic stages. Defaults match the values the
+ * recorder has always started with.
+ */
+struct RecorderParams {
+    // Enable flags
+    bool playbackSuppressorEnabled = false;
+    bool echoCancellerEnabled = false;
+    bool noiseReductionEnabled = false;
+    bool noiseGateEnabled = false;
+    bool bandpassEnabled = false;
+    bool peakingEnabled = false;
+    bool highShelfEnabled = false;
+    bool autoGainEnabled = false;
+
+    // Playback suppressor
+    float suppressorAggressiveness = 0.8f;
+
+    // Echo canceller
+    float echoDelayMs = 50.0f;
+    float echoSuppression = 0.7f;
+
+    // Noise reduction
+    float noiseReductionAmount = 0.5f;
+
+    // Noise gate
+    float gateThresholdDb = -40.0f;
+    float gateRatio = 4.0f;
+    float gateAttackMs = 5.0f;
+    float gateReleaseMs = 50.0f;
+
+    // Bandpass filter
+    float bandpassFreq = 1000.0f;
+    float bandpassQ = 1.0f;
+
+    // Peaking filter
+    float peakingFreq = 3000.0f;
+    float peakingQ = 1.0f;
+    float peakingGainDb = 6.0f;
+
+    // High shelf filter
+    float highShelfFreq = 8000.0f;
+    float highShelfQ = 0.7f;
+    float highShelfGainDb = 3.0f;
+
+    // Automatic gain control and look-ahead limiter
+    float agcTargetDb = -18.0f;
+    float agcMaxGainDb = 12.0f;
+    float agcNoiseFloorDb = -50.0f;
+    float agcAttackMs = 300.0f;
+    float agcReleaseMs = 2000.0f;
+    float limiterCeilingDb = -1.0f;
+
+    bool anyProcessingEnabled() const {
+        return playbackSuppressorEnabled || echoCancellerEnabled || noiseReductionEnabled ||
+               noiseGateEnabled || bandpassEnabled || peakingEnabled || highShelfEnabled ||
+               autoGainEnabled;
+    }
+
+    bool anyEqEnabled() const {
+        return bandpassEnabled || peakingEnabled || highShelfEnabled;
+    }
+};
+
+#endif //OBOESAMPLE_RECORDERPARAMS_H
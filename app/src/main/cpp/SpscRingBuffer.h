@@ -0,0 +1,101 @@
+#ifndef OBOESAMPLE_SPSCRINGBUFFER_H
+#define OBOESAMPLE_SPSCRINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+/**
+ * Wait-free single-producer/single-consumer ring buffer.
+ *
+ * One thread may call the producer side (write, availableToWrite) while another
+ * calls the consumer side (read, availableToRead). Neither side blocks, locks
+ * or allocates, so the producer can be a real-time audio callback.
+ *
+ * Read/write indices increase monotonically and are masked into a power-of-two
+ * buffer, so "full" and "empty" never need a spare slot to tell apart.
+ */
+template<typename T>
+class SpscRingBuffer {
+public:
+    // Allocates storage for at least minCapacity elements (rounded up to a
+    // power of two). Not real-time safe; call while neither side is running.
+    void allocate(size_t minCapacity) {
+        size_t capacity = 1;
+        while (capacity < minCapacity) capacity <<= 1;
+        mBuffer.reset(new T[capacity]);
+        mCapacity = capacity;
+        mMask = capacity - 1;
+        clear();
+    }
+
+    // Discards all content. Only call while neither side is running.
+    void clear() {
+        mWriteIndex.store(0, std::memory_order_relaxed);
+        mReadIndex.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mCapacity; }
+
+    // --- Producer side ---
+
+    size_t availableToWrite() const {
+        size_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+        size_t readIndex = mReadIndex.load(std::memory_order_acquire);
+        return mCapacity - (writeIndex - readIndex);
+    }
+
+    // Writes all count elements, or nothing if they don't fit
+    bool write(const T *data, size_t count) {
+        size_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+        size_t readIndex = mReadIndex.load(std::memory_order_acquire);
+        if (count > mCapacity - (writeIndex - readIndex)) {
+            return false;
+        }
+
+        size_t offset = writeIndex & mMask;
+        size_t firstPart = std::min(count, mCapacity - offset);
+        memcpy(mBuffer.get() + offset, data, firstPart * sizeof(T));
+        memcpy(mBuffer.get(), data + firstPart, (count - firstPart) * sizeof(T));
+
+        mWriteIndex.store(writeIndex + count, std::memory_order_release);
+        return true;
+    }
+
+    // --- Consumer side ---
+
+    size_t availableToRead() const {
+        size_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+        size_t writeIndex = mWriteIndex.load(std::memory_order_acquire);
+        return writeIndex - readIndex;
+    }
+
+    // Reads up to count elements, returns how many were read
+    size_t read(T *data, size_t count) {
+        size_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+        size_t writeIndex = mWriteIndex.load(std::memory_order_acquire);
+        count = std::min(count, writeIndex - readIndex);
+
+        size_t offset = readIndex & mMask;
+        size_t firstPart = std::min(count, mCapacity - offset);
+        memcpy(data, mBuffer.get() + offset, firstPart * sizeof(T));
+        memcpy(data + firstPart, mBuffer.get(), (count - firstPart) * sizeof(T));
+
+        mReadIndex.store(readIndex + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    std::unique_ptr<T[]> mBuffer;
+    size_t mCapacity = 0;
+    size_t mMask = 0;
+
+    // Keep the two indices on separate cache lines so producer and consumer
+    // don't false-share
+    alignas(64) std::atomic<size_t> mWriteIndex{0};
+    alignas(64) std::atomic<size_t> mReadIndex{0};
+};
+
+#endif //OBOESAMPLE_SPSCRINGBUFFER_H
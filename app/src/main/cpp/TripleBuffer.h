@@ -0,0 +1,51 @@
+#ifndef OBOESAMPLE_TRIPLEBUFFER_H
+#define OBOESAMPLE_TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Wait-free "latest value" mailbox between one writer and one reader thread.
+ *
+ * The writer fills a private back slot and publishes it by swapping it with
+ * the shared middle slot; the reader swaps the middle slot into its private
+ * front slot when a new value has been published. Neither side ever blocks or
+ * sees a partially written value, and intermediate values the reader never
+ * got to are simply skipped. T must be copyable; no allocation happens after
+ * construction.
+ */
+template<typename T>
+class TripleBuffer {
+public:
+    // Writer: publishes a copy of value
+    void write(const T &value) {
+        mSlots[mBackIndex] = value;
+        uint32_t previous = mMiddle.exchange(mBackIndex | kDirtyBit, std::memory_order_acq_rel);
+        mBackIndex = previous & kIndexMask;
+    }
+
+    // Reader: returns true and updates the front value if something new was
+    // published since the last call
+    bool read() {
+        if ((mMiddle.load(std::memory_order_relaxed) & kDirtyBit) == 0) {
+            return false;
+        }
+        uint32_t previous = mMiddle.exchange(mFrontIndex, std::memory_order_acq_rel);
+        mFrontIndex = previous & kIndexMask;
+        return true;
+    }
+
+    // Reader: the most recently read value
+    const T &front() const { return mSlots[mFrontIndex]; }
+
+private:
+    static constexpr uint32_t kDirtyBit = 0x4;
+    static constexpr uint32_t kIndexMask = 0x3;
+
+    T mSlots[3];
+    uint32_t mFrontIndex = 0;   // reader-owned
+    uint32_t mBackIndex = 2;    // writer-owned
+    alignas(64) std::atomic<uint32_t> mMiddle{1};
+};
+
+#endif //OBOESAMPLE_TRIPLEBUFFER_H
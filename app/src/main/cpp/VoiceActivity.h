@@ -0,0 +1,75 @@
+#ifndef OBOESAMPLE_VOICEACTIVITY_H
+#define OBOESAMPLE_VOICEACTIVITY_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * The voice activity decisions of a running chain, for anyone to read.
+ *
+ * After every block a playback suppressor ran on, the audio thread publishes
+ * whether any channel's detector says speech, the highest speech probability,
+ * and adds the block to the running counts of frames and of frames that
+ * ended in speech. Later stages of the same plan get the decision directly;
+ * the recorder and the UI read it from here.
+ *
+ * The audio thread is the only writer and every field is a relaxed atomic
+ * it just stores, so publish() is a handful of plain stores. A snapshot()
+ * taken from another thread may mix fields of two consecutive blocks, which
+ * is all a meter or a log needs.
+ */
+class VoiceActivity {
+public:
+    struct Snapshot {
+        bool speech = false;
+        float probability = 0.0f;
+        int64_t frames = 0;
+        int64_t speechFrames = 0;
+
+        // Share of the frames so far that were speech, 0..1
+        float speechShare() const {
+            return frames > 0 ? static_cast<float>(speechFrames) / static_cast<float>(frames)
+                              : 0.0f;
+        }
+    };
+
+    // Audio thread: the decision at the end of a block of numFrames frames
+    void publish(bool speech, float probability, int32_t numFrames) {
+        mSpeech.store(speech, std::memory_order_relaxed);
+        mProbability.store(probability, std::memory_order_relaxed);
+        mFrames.store(mFrames.load(std::memory_order_relaxed) + numFrames,
+                      std::memory_order_relaxed);
+        if (speech) {
+            mSpeechFrames.store(mSpeechFrames.load(std::memory_order_relaxed) + numFrames,
+                                std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread
+    bool isSpeech() const { return mSpeech.load(std::memory_order_relaxed); }
+
+    Snapshot snapshot() const {
+        Snapshot snapshot;
+        snapshot.speech = mSpeech.load(std::memory_order_relaxed);
+        snapshot.probability = mProbability.load(std::memory_order_relaxed);
+        snapshot.frames = mFrames.load(std::memory_order_relaxed);
+        snapshot.speechFrames = mSpeechFrames.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    // Clears everything. Only call while nothing publishes.
+    void reset() {
+        mSpeech.store(false, std::memory_order_relaxed);
+        mProbability.store(0.0f, std::memory_order_relaxed);
+        mFrames.store(0, std::memory_order_relaxed);
+        mSpeechFrames.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> mSpeech{false};
+    std::atomic<float> mProbability{0.0f};
+    std::atomic<int64_t> mFrames{0};
+    std::atomic<int64_t> mSpeechFrames{0};
+};
+
+#endif //OBOESAMPLE_VOICEACTIVITY_H
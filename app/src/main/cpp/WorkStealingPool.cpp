@@ -0,0 +1,96 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(int32_t numThreads) {
+    if (numThreads <= 0) {
+        numThreads = std::max(1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+    }
+    for (int32_t i = 0; i < numThreads; i++) {
+        mQueues.push_back(std::make_unique<Queue>());
+    }
+    for (int32_t i = 0; i < numThreads; i++) {
+        mThreads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopRequested = true;
+    }
+    mWorkAvailable.notify_all();
+    for (auto &thread : mThreads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::run(std::vector<Task> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    // Set before dealing: a worker still finishing the previous run may pick
+    // up the first tasks before it is woken
+    mRemaining.store(static_cast<int64_t>(tasks.size()), std::memory_order_relaxed);
+    const size_t numQueues = mQueues.size();
+    for (size_t i = 0; i < tasks.size(); i++) {
+        Queue &queue = *mQueues[i % numQueues];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        // Workers pop from the back, so the first task dealt must end up there
+        queue.tasks.push_front(std::move(tasks[i]));
+    }
+
+    std::unique_lock<std::mutex> lock(mLock);
+    mGeneration++;
+    mWorkAvailable.notify_all();
+    mRunFinished.wait(lock, [this] { return mRemaining.load(std::memory_order_acquire) == 0; });
+}
+
+void WorkStealingPool::workerLoop(int32_t index) {
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mWorkAvailable.wait(lock, [&] { return mStopRequested || mGeneration != generation; });
+            if (mStopRequested) {
+                return;
+            }
+            generation = mGeneration;
+        }
+
+        // Tasks don't add tasks, so once there's nothing left to take this
+        // worker is done with the run
+        Task task;
+        while (takeTask(index, task)) {
+            task(index);
+            task = nullptr;
+            if (mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mLock);
+                mRunFinished.notify_all();
+            }
+        }
+    }
+}
+
+bool WorkStealingPool::takeTask(int32_t index, Task &task) {
+    {
+        Queue &own = *mQueues[index];
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    const auto numQueues = static_cast<int32_t>(mQueues.size());
+    for (int32_t offset = 1; offset < numQueues; offset++) {
+        Queue &victim = *mQueues[(index + offset) % numQueues];
+        std::lock_guard<std::mutex> lock(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            mSteals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
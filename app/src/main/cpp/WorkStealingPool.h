@@ -0,0 +1,76 @@
+#ifndef OBOESAMPLE_WORKSTEALINGPOOL_H
+#define OBOESAMPLE_WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads for batches of independent, coarse tasks
+ * (whole files or chunks of them, see BatchProcessor).
+ *
+ * run() deals the tasks round-robin onto per-worker queues. Each worker takes
+ * from the back of its own queue, in dealing order, and once that is empty,
+ * steals from the front of the others'. The front holds the tasks dealt
+ * last: the shortest when they are dealt longest first, so a thief takes as
+ * little as possible from the worker it robs. Uneven task lengths even out
+ * without a shared queue every worker contends on. Tasks get the index of the worker running
+ * them, which lets callers keep per-worker state (filter instances, buffers)
+ * without locking.
+ *
+ * Tasks are milliseconds to seconds long, so each queue is a plain mutex and
+ * deque rather than a lock-free deque.
+ */
+class WorkStealingPool {
+public:
+    using Task = std::function<void(int32_t worker)>;
+
+    // Starts numThreads workers, or one per core if 0
+    explicit WorkStealingPool(int32_t numThreads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    int32_t getThreadCount() const { return static_cast<int32_t>(mThreads.size()); }
+
+    // Runs every task and returns once all have finished. Tasks are dealt in
+    // order, so put the longest first. Only one run() at a time.
+    void run(std::vector<Task> tasks);
+
+    // Tasks taken from another worker's queue, over all runs
+    int64_t getSteals() const { return mSteals.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(int32_t index);
+
+    // The next task for worker index: the next one dealt to it, else the last
+    // one dealt to the first other queue that has one
+    bool takeTask(int32_t index, Task &task);
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::thread> mThreads;
+
+    // Wakes the workers for a new run and the caller when it's done
+    std::mutex mLock;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mRunFinished;
+    uint64_t mGeneration = 0;
+    bool mStopRequested = false;
+
+    std::atomic<int64_t> mRemaining{0};
+    std::atomic<int64_t> mSteals{0};
+};
+
+#endif //OBOESAMPLE_WORKSTEALINGPOOL_H
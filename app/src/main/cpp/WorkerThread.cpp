@@ -0,0 +1,315 @@
+#include "WorkerThread.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define LOG_TAG "WorkerThread"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Cores beyond this aren't represented in the masks
+constexpr int kMaxCores = 64;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static pid_t currentTid() {
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+// The WorkerThread running on this thread, for sleepFor()
+static thread_local WorkerThread *tCurrent = nullptr;
+
+static std::mutex sDefaultLock;
+static ThreadScheduling sDefaultScheduling;
+
+// Last core of each CallbackStream's callback, -1 until it has run, and how
+// many times each has called noteCallbackCpu()
+static std::atomic<int32_t> sCallbackCpus[3] = {{-1}, {-1}, {-1}};
+static std::atomic<uint32_t> sCallbackCounts[3] = {{0}, {0}, {0}};
+
+static uint64_t callbackCoreMask() {
+    uint64_t mask = 0;
+    for (const auto &cpu : sCallbackCpus) {
+        int32_t core = cpu.load(std::memory_order_relaxed);
+        if (core >= 0 && core < kMaxCores) {
+            mask |= uint64_t(1) << core;
+        }
+    }
+    return mask;
+}
+
+namespace {
+
+struct CoreTopology {
+    uint64_t all = 0;
+    uint64_t big = 0;
+    uint64_t little = 0;
+
+    CoreTopology() {
+        const int numCores = std::min(kMaxCores, static_cast<int>(sysconf(_SC_NPROCESSORS_CONF)));
+        long maxFreq[kMaxCores] = {};
+        long highest = 0;
+        long lowest = 0;
+        for (int core = 0; core < numCores; core++) {
+            all |= uint64_t(1) << core;
+            char path[96];
+            snprintf(path, sizeof(path),
+                     "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", core);
+            if (FILE *file = fopen(path, "r")) {
+                if (fscanf(file, "%ld", &maxFreq[core]) != 1) {
+                    maxFreq[core] = 0;
+                }
+                fclose(file);
+            }
+            if (maxFreq[core] > 0) {
+                highest = std::max(highest, maxFreq[core]);
+                lowest = lowest == 0 ? maxFreq[core] : std::min(lowest, maxFreq[core]);
+            }
+        }
+        for (int core = 0; core < numCores; core++) {
+            if (maxFreq[core] > 0 && maxFreq[core] == highest) big |= uint64_t(1) << core;
+            if (maxFreq[core] > 0 && maxFreq[core] == lowest) little |= uint64_t(1) << core;
+        }
+        // Symmetric, or no cpufreq: no distinction
+        if (highest == lowest) {
+            big = all;
+            little = all;
+        }
+        LOGD("Cores: all 0x%llx, big 0x%llx, little 0x%llx", static_cast<unsigned long long>(all),
+             static_cast<unsigned long long>(big), static_cast<unsigned long long>(little));
+    }
+};
+
+} // namespace
+
+uint64_t WorkerThread::getCoreMask(CoreSelection cores) {
+    static const CoreTopology topology;
+    switch (cores) {
+        case CoreSelection::Big:
+            return topology.big;
+        case CoreSelection::Little:
+            return topology.little;
+        case CoreSelection::Any:
+        default:
+            return topology.all;
+    }
+}
+
+void WorkerThread::setDefaultScheduling(const ThreadScheduling &scheduling) {
+    std::lock_guard<std::mutex> lock(sDefaultLock);
+    sDefaultScheduling = scheduling;
+    LOGD("Default worker scheduling: %s %d, cores %d%s", scheduling.fifo ? "FIFO" : "nice",
+         scheduling.fifo ? scheduling.fifoPriority : scheduling.nice,
+         static_cast<int>(scheduling.cores),
+         scheduling.avoidCallbackCores ? ", off the callback cores" : "");
+}
+
+ThreadScheduling WorkerThread::getDefaultScheduling() {
+    std::lock_guard<std::mutex> lock(sDefaultLock);
+    return sDefaultScheduling;
+}
+
+void WorkerThread::noteCallbackCpu(CallbackStream stream) {
+    // Only the stream's callback writes its count
+    std::atomic<uint32_t> &count = sCallbackCounts[static_cast<int32_t>(stream)];
+    const uint32_t calls = count.load(std::memory_order_relaxed);
+    count.store(calls + 1, std::memory_order_relaxed);
+    if (calls % kCpuSamplePeriod != 0) {
+        return;
+    }
+    const int32_t cpu = sched_getcpu();
+    std::atomic<int32_t> &slot = sCallbackCpus[static_cast<int32_t>(stream)];
+    if (slot.load(std::memory_order_relaxed) != cpu) {
+        slot.store(cpu, std::memory_order_relaxed);
+    }
+}
+
+WorkerThread::~WorkerThread() {
+    join();
+}
+
+void WorkerThread::start(const char *name, std::function<void()> body) {
+    start(name, std::move(body), getDefaultScheduling());
+}
+
+void WorkerThread::start(const char *name, std::function<void()> body,
+                         const ThreadScheduling &scheduling) {
+    join();
+    strncpy(mName, name, sizeof(mName) - 1);
+    mName[sizeof(mName) - 1] = '\0';
+
+    mFifo.store(false, std::memory_order_relaxed);
+    mPriority.store(0, std::memory_order_relaxed);
+    mCoreMask.store(0, std::memory_order_relaxed);
+    mLastCpu.store(-1, std::memory_order_relaxed);
+    mWakeUps.store(0, std::memory_order_relaxed);
+    mWakeLatencySumNs.store(0, std::memory_order_relaxed);
+    mWakeLatencyMaxNs.store(0, std::memory_order_relaxed);
+    mMigrations.store(0, std::memory_order_relaxed);
+    mInvoluntarySwitches.store(0, std::memory_order_relaxed);
+    mRunning.store(true, std::memory_order_relaxed);
+
+    mThread = std::thread(&WorkerThread::run, this, std::move(body), scheduling);
+}
+
+void WorkerThread::join() {
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void WorkerThread::run(std::function<void()> body, ThreadScheduling scheduling) {
+    tCurrent = this;
+    mScheduling = scheduling;
+    pthread_setname_np(pthread_self(), mName);
+    applyPriority(scheduling);
+    applyAffinity();
+    mLastCpu.store(sched_getcpu(), std::memory_order_relaxed);
+
+    Stats stats = getStats();
+    LOGD("%s: %s %d, cores 0x%llx", mName, stats.fifo ? "FIFO" : "nice", stats.priority,
+         static_cast<unsigned long long>(stats.coreMask));
+
+    body();
+
+    recordWakeUp(-1);
+    mRunning.store(false, std::memory_order_relaxed);
+    char summary[256];
+    getStats().formatSummary(summary, sizeof(summary));
+    LOGD("%s finished: %s", mName, summary);
+    tCurrent = nullptr;
+}
+
+void WorkerThread::applyPriority(const ThreadScheduling &scheduling) {
+    if (scheduling.fifo) {
+        sched_param param {};
+        param.sched_priority = std::clamp(scheduling.fifoPriority,
+                                          sched_get_priority_min(SCHED_FIFO),
+                                          sched_get_priority_max(SCHED_FIFO));
+        int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (error == 0) {
+            mFifo.store(true, std::memory_order_relaxed);
+            mPriority.store(param.sched_priority, std::memory_order_relaxed);
+            return;
+        }
+        LOGE("%s: SCHED_FIFO %d refused (%s), using nice %d", mName, param.sched_priority,
+             strerror(error), scheduling.nice);
+    }
+
+    const pid_t tid = currentTid();
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), scheduling.nice) != 0) {
+        LOGE("%s: nice %d refused (%s)", mName, scheduling.nice, strerror(errno));
+    }
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, static_cast<id_t>(tid));
+    mPriority.store(errno == 0 ? nice : 0, std::memory_order_relaxed);
+}
+
+void WorkerThread::applyAffinity() {
+    const uint64_t callbackCores = callbackCoreMask();
+    uint64_t mask = getCoreMask(mScheduling.cores);
+    if (mScheduling.avoidCallbackCores && (mask & ~callbackCores) != 0) {
+        mask &= ~callbackCores;
+    }
+    mAppliedCallbackCores = callbackCores;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core = 0; core < kMaxCores; core++) {
+        if (mask & (uint64_t(1) << core)) {
+            CPU_SET(core, &set);
+        }
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        LOGE("%s: can't set core mask 0x%llx (%s)", mName,
+             static_cast<unsigned long long>(mask), strerror(errno));
+    }
+
+    // Report what the kernel actually allows
+    uint64_t achieved = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int core = 0; core < kMaxCores; core++) {
+            if (CPU_ISSET(core, &set)) {
+                achieved |= uint64_t(1) << core;
+            }
+        }
+    }
+    mCoreMask.store(achieved, std::memory_order_relaxed);
+}
+
+void WorkerThread::sleepFor(std::chrono::nanoseconds duration) {
+    WorkerThread *self = tCurrent;
+    if (self == nullptr) {
+        std::this_thread::sleep_for(duration);
+        return;
+    }
+
+    const int64_t startNs = nowNs();
+    std::this_thread::sleep_for(duration);
+    self->recordWakeUp(std::max<int64_t>(0, nowNs() - startNs - duration.count()));
+
+    // A callback moved onto one of our cores since the mask was applied
+    if (self->mScheduling.avoidCallbackCores &&
+        callbackCoreMask() != self->mAppliedCallbackCores) {
+        self->applyAffinity();
+    }
+}
+
+void WorkerThread::recordWakeUp(int64_t latencyNs) {
+    if (latencyNs >= 0) {
+        mWakeUps.store(mWakeUps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        mWakeLatencySumNs.store(mWakeLatencySumNs.load(std::memory_order_relaxed) + latencyNs,
+                                std::memory_order_relaxed);
+        if (latencyNs > mWakeLatencyMaxNs.load(std::memory_order_relaxed)) {
+            mWakeLatencyMaxNs.store(latencyNs, std::memory_order_relaxed);
+        }
+    }
+
+    const int32_t cpu = sched_getcpu();
+    if (cpu != mLastCpu.load(std::memory_order_relaxed)) {
+        mMigrations.store(mMigrations.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+        mLastCpu.store(cpu, std::memory_order_relaxed);
+    }
+
+    rusage usage {};
+    if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+        mInvoluntarySwitches.store(usage.ru_nivcsw, std::memory_order_relaxed);
+    }
+}
+
+WorkerThread::Stats WorkerThread::getStats() const {
+    Stats stats;
+    stats.running = mRunning.load(std::memory_order_relaxed);
+    stats.fifo = mFifo.load(std::memory_order_relaxed);
+    stats.priority = mPriority.load(std::memory_order_relaxed);
+    stats.coreMask = mCoreMask.load(std::memory_order_relaxed);
+    stats.lastCpu = mLastCpu.load(std::memory_order_relaxed);
+    stats.wakeUps = mWakeUps.load(std::memory_order_relaxed);
+    stats.wakeLatencySumNs = mWakeLatencySumNs.load(std::memory_order_relaxed);
+    stats.wakeLatencyMaxNs = mWakeLatencyMaxNs.load(std::memory_order_relaxed);
+    stats.migrations = mMigrations.load(std::memory_order_relaxed);
+    stats.involuntarySwitches = mInvoluntarySwitches.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void WorkerThread::Stats::formatSummary(char *out, size_t size) const {
+    snprintf(out, size,
+             "%s %d, cores 0x%llx, %lld wake-ups (late by %.1f us mean, %.1f us max), "
+             "%lld migrations, %lld involuntary switches",
+             fifo ? "FIFO" : "nice", priority, static_cast<unsigned long long>(coreMask),
+             static_cast<long long>(wakeUps), meanWakeLatencyNs() / 1000.0,
+             wakeLatencyMaxNs / 1000.0, static_cast<long long>(migrations),
+             static_cast<long long>(involuntarySwitches));
+}
@@ -0,0 +1,141 @@
+#ifndef OBOESAMPLE_WORKERTHREAD_H
+#define OBOESAMPLE_WORKERTHREAD_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+// Which cores a worker may run on. On big.LITTLE devices the classes come from
+// each core's maximum frequency; where they can't be told apart both mean
+// every core.
+enum class CoreSelection : int32_t {
+    Any = 0,
+    Little = 1,
+    Big = 2,
+};
+
+// Data callbacks whose core workers stay off, matching the JNI stream index
+enum class CallbackStream : int32_t {
+    Recorder = 0,
+    Player = 1,
+    Duplex = 2,
+};
+
+struct ThreadScheduling {
+    // SCHED_FIFO at fifoPriority (1-99) if allowed, else SCHED_OTHER at nice
+    bool fifo = false;
+    int32_t fifoPriority = 2;
+    int32_t nice = -10;
+    CoreSelection cores = CoreSelection::Any;
+    // Keep off the cores the data callbacks last ran on, if that leaves any
+    bool avoidCallbackCores = true;
+};
+
+/**
+ * Thread for the work around the audio callbacks (file writer, decoder, page
+ * prefetcher) with controlled scheduling.
+ *
+ * The thread applies its ThreadScheduling as it starts: name, SCHED_FIFO or
+ * nice priority, and a core mask. A FIFO request the system refuses (the
+ * usual case for apps) falls back to the nice priority, so getStats() reports
+ * what was achieved rather than what was asked for.
+ *
+ * Workers poll by sleeping, and doing that through sleepFor() measures how
+ * late each wake-up is, counts moves to another core, and moves the thread
+ * off a core a data callback has since started running on. The callbacks
+ * report their core with noteCallbackCpu().
+ *
+ * Statistics are relaxed atomics written by the worker only, so getStats()
+ * can be called from any thread while it runs and after it has finished.
+ */
+class WorkerThread {
+public:
+    struct Stats {
+        bool running = false;
+        bool fifo = false;          // achieved policy
+        int32_t priority = 0;       // FIFO priority, or the nice value
+        uint64_t coreMask = 0;      // cores the thread may run on (first 64)
+        int32_t lastCpu = -1;
+        int64_t wakeUps = 0;
+        int64_t wakeLatencySumNs = 0;  // time slept beyond what was asked
+        int64_t wakeLatencyMaxNs = 0;
+        int64_t migrations = 0;        // changes of core seen across wake-ups
+        int64_t involuntarySwitches = 0;
+
+        int64_t meanWakeLatencyNs() const {
+            return wakeUps > 0 ? wakeLatencySumNs / wakeUps : 0;
+        }
+
+        // One-line summary for logs
+        void formatSummary(char *out, size_t size) const;
+    };
+
+    WorkerThread() = default;
+    ~WorkerThread();
+
+    WorkerThread(const WorkerThread &) = delete;
+    WorkerThread &operator=(const WorkerThread &) = delete;
+
+    // Runs body on a new thread named name (at most 15 characters shown)
+    // with the default scheduling
+    void start(const char *name, std::function<void()> body);
+    void start(const char *name, std::function<void()> body, const ThreadScheduling &scheduling);
+
+    bool joinable() const { return mThread.joinable(); }
+    void join();
+
+    Stats getStats() const;
+
+    // Worker thread: sleeps for duration, recording the wake-up. Outside a
+    // WorkerThread it just sleeps.
+    static void sleepFor(std::chrono::nanoseconds duration);
+
+    // Scheduling for workers started without their own
+    static void setDefaultScheduling(const ThreadScheduling &scheduling);
+    static ThreadScheduling getDefaultScheduling();
+
+    // Audio thread: records the core the stream's callback is running on,
+    // looked up on every kCpuSamplePeriod-th call. sched_getcpu() is a vDSO
+    // call on x86 but a real syscall on arm64, which has no vDSO getcpu, so
+    // the other calls only count; workers follow a callback that moved within
+    // that many callbacks.
+    static void noteCallbackCpu(CallbackStream stream);
+    static constexpr uint32_t kCpuSamplePeriod = 16;
+
+    // Cores of a class, as a mask of the first 64
+    static uint64_t getCoreMask(CoreSelection cores);
+
+private:
+    void run(std::function<void()> body, ThreadScheduling scheduling);
+
+    // Worker thread: applies priority, then the core mask for where the
+    // callbacks currently run
+    void applyPriority(const ThreadScheduling &scheduling);
+    void applyAffinity();
+
+    // Worker thread: updates the wake-up statistics after a sleep
+    void recordWakeUp(int64_t latencyNs);
+
+    std::thread mThread;
+    char mName[16] = {};
+
+    // Worker thread only
+    ThreadScheduling mScheduling;
+    uint64_t mAppliedCallbackCores = 0;
+
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mFifo{false};
+    std::atomic<int32_t> mPriority{0};
+    std::atomic<uint64_t> mCoreMask{0};
+    std::atomic<int32_t> mLastCpu{-1};
+    std::atomic<int64_t> mWakeUps{0};
+    std::atomic<int64_t> mWakeLatencySumNs{0};
+    std::atomic<int64_t> mWakeLatencyMaxNs{0};
+    std::atomic<int64_t> mMigrations{0};
+    std::atomic<int64_t> mInvoluntarySwitches{0};
+};
+
+#endif //OBOESAMPLE_WORKERTHREAD_H
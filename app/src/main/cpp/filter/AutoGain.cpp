@@ -0,0 +1,222 @@
+#include "AutoGain.h"
+#include "FastMath.h"
+#include "SimdFloat4.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cmath>
+
+#define LOG_TAG "AutoGain"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+
+using simd::float4;
+
+constexpr int32_t kLanes = 4;
+
+// Time constant of the level the AGC follows
+constexpr float kLevelMs = 200.0f;
+
+void AutoGain::prepare(int32_t sampleRate, int32_t channelCount) {
+    mSampleRate = std::max(1, sampleRate);
+    mChannelCount = std::max(1, channelCount);
+
+    // Whole sub-blocks of look-ahead, plus the sub-block being filled
+    const auto lookahead = static_cast<int32_t>(
+            std::ceil(mSampleRate * kLookaheadMs / 1000.0f / kBlockFrames));
+    mWindowBlocks = std::max(1, lookahead) + 1;
+    mDelayFrames = mWindowBlocks * kBlockFrames;
+    mDelay.assign(static_cast<size_t>(mDelayFrames) * mChannelCount, 0.0f);
+    mWindowBlock.assign(static_cast<size_t>(mWindowBlocks), 0);
+    mWindowPeak.assign(static_cast<size_t>(mWindowBlocks), 0.0f);
+
+    mLevelCoeff = blockCoeff(kLevelMs);
+    mLimiterReleaseCoeff = blockCoeff(kLimiterReleaseMs);
+    setAttack(mAttackMs);
+    setRelease(mReleaseMs);
+    reset();
+    LOGD("AutoGain: %d channels, %d-frame look-ahead", mChannelCount, mDelayFrames);
+}
+
+float AutoGain::blockCoeff(float timeMs) const {
+    if (timeMs <= 0.0f) return 1.0f;
+    return 1.0f - fastmath::exp(-kBlockFrames / (timeMs * 0.001f * mSampleRate));
+}
+
+void AutoGain::setTarget(float targetDb) {
+    // A power, so twice the dB of a gain
+    mTargetPower = fastmath::dbToGain(2.0f * targetDb);
+}
+
+void AutoGain::setMaxGain(float maxGainDb) {
+    mMaxGainDb = std::max(kMinGainDb, maxGainDb);
+}
+
+void AutoGain::setNoiseFloor(float noiseFloorDb) {
+    mNoiseFloorPower = fastmath::dbToGain(2.0f * noiseFloorDb);
+}
+
+void AutoGain::setAttack(float attackMs) {
+    mAttackMs = attackMs;
+    mAttackCoeff = blockCoeff(attackMs);
+}
+
+void AutoGain::setRelease(float releaseMs) {
+    mReleaseMs = releaseMs;
+    mReleaseCoeff = blockCoeff(releaseMs);
+}
+
+void AutoGain::setCeiling(float ceilingDb) {
+    mCeiling = fastmath::dbToGain(std::min(0.0f, ceilingDb));
+}
+
+void AutoGain::reset() {
+    std::fill(mDelay.begin(), mDelay.end(), 0.0f);
+    mDelayPosition = 0;
+    mWindowHead = 0;
+    mWindowSize = 0;
+    mBlockNumber = 0;
+    mBlockFill = 0;
+    mBlockPeak = 0.0f;
+    mBlockPower = 0.0f;
+    mLevel = 0.0f;
+    mAgcGainDb = 0.0f;
+    mGain = 1.0f;
+    mGainEnd = 1.0f;
+    mGainStep = 0.0f;
+}
+
+float AutoGain::getGainDb() const {
+    return mAgcGainDb;
+}
+
+float AutoGain::getGainReductionDb() const {
+    return std::max(0.0f, mAgcGainDb - 20.0f * std::log10(std::max(mGainEnd, 1e-9f)));
+}
+
+void AutoGain::process(const float *in, float *out, int32_t numFrames) {
+    const int32_t channels = mChannelCount;
+    int32_t done = 0;
+    while (done < numFrames) {
+        // Up to the end of the sub-block, which never crosses the end of the delay line
+        const int32_t frames = std::min(kBlockFrames - mBlockFill, numFrames - done);
+        const int32_t numSamples = frames * channels;
+        const float *src = in + static_cast<size_t>(done) * channels;
+        float *dst = out + static_cast<size_t>(done) * channels;
+        float *delayed = mDelay.data() + static_cast<size_t>(mDelayPosition) * channels;
+
+        // Peak and power of what comes in: max-reduction and sum of squares
+        // over the vector lanes, folded together at the end
+        float4 peak4 = simd::zero();
+        float4 power4 = simd::zero();
+        int32_t i = 0;
+        for (; i + kLanes <= numSamples; i += kLanes) {
+            const float4 x = simd::load(src + i);
+            peak4 = simd::max(peak4, simd::abs(x));
+            power4 = simd::madd(power4, x, x);
+        }
+        float peak = std::max(mBlockPeak, simd::horizontalMax(peak4));
+        float power = mBlockPower + simd::horizontalSum(power4);
+        for (; i < numSamples; i++) {
+            peak = std::max(peak, std::abs(src[i]));
+            power += src[i] * src[i];
+        }
+        mBlockPeak = peak;
+        mBlockPower = power;
+
+        // Swap the block into the delay line, and play out what it replaces
+        // on the ramp. src is read before dst is written, so in place is fine.
+        const float start = mGain + static_cast<float>(mBlockFill) * mGainStep;
+        if (kLanes % channels == 0) {
+            // A vector holds whole frames (1, 2 or 4 channels): its lanes
+            // carry the gains of the frames they belong to
+            const int32_t framesPerVector = kLanes / channels;
+            float lanes[kLanes];
+            for (int32_t k = 0; k < kLanes; k++) {
+                lanes[k] = start + static_cast<float>(k / channels) * mGainStep;
+            }
+            float4 gain = simd::load(lanes);
+            const float4 step = simd::set1(static_cast<float>(framesPerVector) * mGainStep);
+            i = 0;
+            for (; i + kLanes <= numSamples; i += kLanes) {
+                const float4 x = simd::load(src + i);
+                const float4 d = simd::load(delayed + i);
+                simd::store(delayed + i, x);
+                simd::store(dst + i, simd::mul(d, gain));
+                gain = simd::add(gain, step);
+            }
+            for (; i < numSamples; i++) {
+                const float x = src[i];
+                dst[i] = delayed[i] * (start + static_cast<float>(i / channels) * mGainStep);
+                delayed[i] = x;
+            }
+        } else {
+            for (int32_t f = 0; f < frames; f++) {
+                const float gain = start + static_cast<float>(f) * mGainStep;
+                const size_t first = static_cast<size_t>(f) * channels;
+                for (int32_t c = 0; c < channels; c++) {
+                    const float x = src[first + c];
+                    dst[first + c] = delayed[first + c] * gain;
+                    delayed[first + c] = x;
+                }
+            }
+        }
+
+        done += frames;
+        mBlockFill += frames;
+        mDelayPosition += frames;
+        if (mDelayPosition == mDelayFrames) {
+            mDelayPosition = 0;
+        }
+        if (mBlockFill == kBlockFrames) {
+            endBlock();
+        }
+    }
+}
+
+void AutoGain::endBlock() {
+    // Sliding-window maximum: drop the peaks that left the window, and those
+    // the new one outranks, so the head holds the window's peak
+    const int64_t block = mBlockNumber++;
+    while (mWindowSize > 0 && mWindowBlock[mWindowHead] <= block - mWindowBlocks) {
+        mWindowHead = (mWindowHead + 1) % mWindowBlocks;
+        mWindowSize--;
+    }
+    while (mWindowSize > 0) {
+        const int32_t tail = (mWindowHead + mWindowSize - 1) % mWindowBlocks;
+        if (mWindowPeak[tail] > mBlockPeak) break;
+        mWindowSize--;
+    }
+    const int32_t slot = (mWindowHead + mWindowSize) % mWindowBlocks;
+    mWindowBlock[slot] = block;
+    mWindowPeak[slot] = mBlockPeak;
+    mWindowSize++;
+    const float windowPeak = mWindowPeak[mWindowHead];
+
+    // AGC: towards the gain that brings the level to the target, unless the
+    // level is down at the noise floor or isn't speech
+    const float power = mBlockPower / static_cast<float>(kBlockFrames * mChannelCount);
+    mLevel += mLevelCoeff * (power - mLevel);
+    if (mLevel > mNoiseFloorPower && mVoiceActive) {
+        const float desiredDb = std::clamp(0.5f * fastmath::gainToDb(mTargetPower / mLevel),
+                                           kMinGainDb, mMaxGainDb);
+        const float coeff = desiredDb < mAgcGainDb ? mAttackCoeff : mReleaseCoeff;
+        mAgcGainDb += coeff * (desiredDb - mAgcGainDb);
+    }
+    float target = fastmath::dbToGain(mAgcGainDb);
+
+    // Limiter: everything in the delay line, which the next sub-blocks play
+    // out, must stay under the ceiling. Coming down happens within the next
+    // sub-block; going back up with the release.
+    if (windowPeak * target > mCeiling) {
+        target = mCeiling / windowPeak;
+    }
+    const float next = target < mGainEnd
+                       ? target
+                       : mGainEnd + mLimiterReleaseCoeff * (target - mGainEnd);
+    mGain = mGainEnd;
+    mGainStep = (next - mGainEnd) / kBlockFrames;
+    mGainEnd = next;
+
+    mBlockFill = 0;
+    mBlockPeak = 0.0f;
+    mBlockPower = 0.0f;
+}
@@ -0,0 +1,134 @@
+#ifndef OBOESAMPLE_AUTOGAIN_H
+#define OBOESAMPLE_AUTOGAIN_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Automatic gain control followed by a look-ahead brickwall limiter.
+ *
+ * Blocks are interleaved frames of the channel count given to prepare(). All
+ * channels of a frame get the same gain, so the stereo image holds. The
+ * stream is handled in sub-blocks of kBlockFrames, whatever the call sizes:
+ *  - Each sub-block's peak (the largest magnitude over every sample) is found
+ *    with a SIMD max-reduction, along with its power.
+ *  - The AGC follows the smoothed power. Above the noise floor it moves its
+ *    gain towards whatever brings that level to the target, no higher than the
+ *    maximum gain. It comes down with the attack time and goes up with the
+ *    release time. Below the noise floor it holds its gain, so pauses and
+ *    room noise aren't pumped up, and so it does while setVoiceActive(false)
+ *    says what it hears isn't speech.
+ *  - The output is delayed by getLatencyFrames(). A sliding-window maximum
+ *    over the sub-block peaks in the delay line gives the peak of everything
+ *    yet to be played out. The total gain (the AGC's, limited) comes down to
+ *    ceiling / that peak by the end of the next sub-block, so a peak is always
+ *    fully covered before it leaves the delay line. After a peak it recovers
+ *    with kLimiterReleaseMs.
+ *  - Within each sub-block the gain ramps linearly from one value to the next,
+ *    so neither gain ever steps. With 1, 2 or 4 channels the ramp is applied
+ *    four samples at a time; other channel counts go frame by frame.
+ * The output never exceeds the ceiling.
+ *
+ * prepare() allocates and logs. The setters, process() and reset() do
+ * neither, and are safe on the audio thread.
+ */
+class AutoGain {
+public:
+    static constexpr int32_t kBlockFrames = 32;
+    static constexpr float kLookaheadMs = 5.0f;
+    static constexpr float kLimiterReleaseMs = 50.0f;
+
+    // Floor of the AGC's own gain; it never attenuates more than this
+    static constexpr float kMinGainDb = -12.0f;
+
+    AutoGain() = default;
+
+    // Sizes the delay line for channelCount channels at sampleRate and
+    // clears the state
+    void prepare(int32_t sampleRate, int32_t channelCount);
+
+    // AGC: level it aims for (RMS, dBFS) and the most gain it may apply
+    void setTarget(float targetDb);
+    void setMaxGain(float maxGainDb);
+
+    // Level below which the AGC holds its gain (dBFS)
+    void setNoiseFloor(float noiseFloorDb);
+
+    // Whether a voice activity detector upstream hears speech; the AGC holds
+    // its gain while it doesn't. Without a detector this stays true.
+    void setVoiceActive(bool active) { mVoiceActive = active; }
+
+    // How fast the AGC's gain comes down and goes up
+    void setAttack(float attackMs);
+    void setRelease(float releaseMs);
+
+    // Peak the limiter lets through (dBFS, at most 0)
+    void setCeiling(float ceilingDb);
+
+    // Process numFrames interleaved frames; in and out may point to the same buffer
+    void process(const float *in, float *out, int32_t numFrames);
+
+    void reset();
+
+    int32_t getLatencyFrames() const { return mDelayFrames; }
+
+    // The AGC's gain, and how far the limiter holds the total below it, in dB
+    float getGainDb() const;
+    float getGainReductionDb() const;
+
+private:
+    // Ends a sub-block: updates the AGC and the window, and sets the ramp the
+    // next sub-block plays out with
+    void endBlock();
+
+    // Coefficient of a one-pole smoother updated once per sub-block
+    float blockCoeff(float timeMs) const;
+
+    int32_t mSampleRate = 48000;
+    int32_t mChannelCount = 1;
+    int32_t mDelayFrames = 0;
+    int32_t mWindowBlocks = 0;
+
+    // Settings; the defaults are -18 dBFS target, 12 dB max gain, -50 dBFS
+    // noise floor, 300/2000 ms attack/release and a -1 dBFS ceiling
+    float mTargetPower = 0.0158f;     // target level, as mean square
+    float mMaxGainDb = 12.0f;
+    float mNoiseFloorPower = 1e-5f;
+    float mCeiling = 0.891f;
+    float mAttackMs = 300.0f;
+    float mReleaseMs = 2000.0f;
+    bool mVoiceActive = true;
+    float mAttackCoeff = 0.0f;   // per sub-block
+    float mReleaseCoeff = 0.0f;
+    float mLevelCoeff = 0.0f;
+    float mLimiterReleaseCoeff = 0.0f;
+
+    // Delay line of mDelayFrames interleaved frames
+    std::vector<float> mDelay;
+    int32_t mDelayPosition = 0;  // frame index, a multiple of kBlockFrames at sub-block starts
+
+    // Sliding-window maximum of the last mWindowBlocks sub-block peaks: a
+    // ring of (block number, peak) pairs whose peaks decrease from the head
+    std::vector<int64_t> mWindowBlock;
+    std::vector<float> mWindowPeak;
+    int32_t mWindowHead = 0;
+    int32_t mWindowSize = 0;
+    int64_t mBlockNumber = 0;
+
+    // The sub-block being filled
+    int32_t mBlockFill = 0;
+    float mBlockPeak = 0.0f;
+    float mBlockPower = 0.0f;    // sum of squares
+
+    // AGC state
+    float mLevel = 0.0f;         // smoothed mean square
+    float mAgcGainDb = 0.0f;
+
+    // Total gain: where the current ramp starts and ends, and how much it
+    // moves per frame
+    float mGain = 1.0f;
+    float mGainEnd = 1.0f;
+    float mGainStep = 0.0f;
+};
+
+#endif //OBOESAMPLE_AUTOGAIN_H
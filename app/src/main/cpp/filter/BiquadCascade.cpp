@@ -0,0 +1,266 @@
+#include "BiquadCascade.h"
+#include "SimdFloat4.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cstring>
+
+#define LOG_TAG "BiquadCascade"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+
+using simd::float4;
+
+BiquadCascade::BiquadCascade() {
+    setSections(nullptr, 0);
+}
+
+void BiquadCascade::setSections(const BiquadCoefficients *sections, int numSections) {
+    loadCoefficients(sections, numSections);
+    reset();
+    LOGD("Cascade: %d sections", mNumSections);
+}
+
+void BiquadCascade::updateCoefficients(const BiquadCoefficients *sections, int numSections) {
+    if (std::max(0, std::min(numSections, kMaxSections)) != mNumSections) {
+        setSections(sections, numSections);
+        return;
+    }
+    loadCoefficients(sections, numSections);
+}
+
+void BiquadCascade::rampCoefficients(const BiquadCoefficients *sections, int numSections,
+                                     int32_t numFrames) {
+    if (numFrames <= 0 || std::max(0, std::min(numSections, kMaxSections)) != mNumSections) {
+        mRampFrames = 0;
+        updateCoefficients(sections, numSections);
+        return;
+    }
+    const float scale = 1.0f / static_cast<float>(numFrames);
+    for (int k = 0; k < mNumSections; k++) {
+        const BiquadCoefficients &c = sections[k];
+        mStepB0[k] = (c.b0 - mB0[k]) * scale;
+        mStepB1[k] = (c.b1 - mB1[k]) * scale;
+        mStepB2[k] = (c.b2 - mB2[k]) * scale;
+        mStepA1[k] = (c.a1 - mA1[k]) * scale;
+        mStepA2[k] = (c.a2 - mA2[k]) * scale;
+        mRampEnd[k] = c;
+    }
+    mRampFrames = numFrames;
+}
+
+void BiquadCascade::loadCoefficients(const BiquadCoefficients *sections, int numSections) {
+    mRampFrames = 0;
+    mNumSections = std::max(0, std::min(numSections, kMaxSections));
+    for (int k = 0; k < kMaxSections; k++) {
+        BiquadCoefficients c = k < mNumSections ? sections[k] : BiquadCoefficients();
+        mB0[k] = c.b0;
+        mB1[k] = c.b1;
+        mB2[k] = c.b2;
+        mA1[k] = c.a1;
+        mA2[k] = c.a2;
+        // Padding sections never ramp
+        mStepB0[k] = 0.0f;
+        mStepB1[k] = 0.0f;
+        mStepB2[k] = 0.0f;
+        mStepA1[k] = 0.0f;
+        mStepA2[k] = 0.0f;
+    }
+}
+
+void BiquadCascade::setChannelCount(int channelCount) {
+    mChannelCount = std::max(1, channelCount);
+    reset();
+}
+
+void BiquadCascade::reset() {
+    memset(mLaneZ1, 0, sizeof(mLaneZ1));
+    memset(mLaneZ2, 0, sizeof(mLaneZ2));
+    memset(mSkewZ1, 0, sizeof(mSkewZ1));
+    memset(mSkewZ2, 0, sizeof(mSkewZ2));
+    memset(mSkewPipe, 0, sizeof(mSkewPipe));
+}
+
+void BiquadCascade::process(const float *in, float *out, int32_t numFrames) {
+    if (in != out) {
+        memcpy(out, in, static_cast<size_t>(numFrames) * mChannelCount * sizeof(float));
+    }
+    if (mNumSections == 0 || numFrames <= 0) {
+        return;
+    }
+
+    int32_t done = 0;
+    if (mRampFrames > 0) {
+        done = std::min(mRampFrames, numFrames);
+        processBlock<true>(out, done);
+        mRampFrames -= done;
+        if (mRampFrames == 0) {
+            loadCoefficients(mRampEnd, mNumSections);
+        } else {
+            const auto frames = static_cast<float>(done);
+            for (int k = 0; k < mNumSections; k++) {
+                mB0[k] += mStepB0[k] * frames;
+                mB1[k] += mStepB1[k] * frames;
+                mB2[k] += mStepB2[k] * frames;
+                mA1[k] += mStepA1[k] * frames;
+                mA2[k] += mStepA2[k] * frames;
+            }
+        }
+    }
+    if (done < numFrames) {
+        processBlock<false>(out + static_cast<size_t>(done) * mChannelCount, numFrames - done);
+    }
+}
+
+template<bool kRamp>
+void BiquadCascade::processBlock(float *buffer, int32_t numFrames) {
+    // Both kernels run in place
+    if (mChannelCount % kLanes == 0) {
+        processChannelLanes<kRamp>(buffer, buffer, numFrames);
+    } else {
+        processSkewed<kRamp>(buffer, buffer, numFrames);
+    }
+}
+
+// One transposed Direct Form II step for four independent lanes
+static inline float4 tdf2Step(float4 x, float4 b0, float4 b1, float4 b2, float4 a1, float4 a2,
+                              float4 &z1, float4 &z2) {
+    float4 y = simd::madd(z1, b0, x);
+    z1 = simd::msub(simd::madd(z2, b1, x), a1, y);
+    z2 = simd::msub(simd::mul(b2, x), a2, y);
+    return y;
+}
+
+template<bool kRamp>
+void BiquadCascade::processChannelLanes(const float *in, float *out, int32_t numFrames) {
+    const int stride = mChannelCount;
+    const int channels = std::min(mChannelCount, kMaxChannels);
+    const int numSections = mNumSections;
+
+    float4 db0[kMaxSections], db1[kMaxSections], db2[kMaxSections];
+    float4 da1[kMaxSections], da2[kMaxSections];
+    if (kRamp) {
+        for (int k = 0; k < numSections; k++) {
+            db0[k] = simd::set1(mStepB0[k]);
+            db1[k] = simd::set1(mStepB1[k]);
+            db2[k] = simd::set1(mStepB2[k]);
+            da1[k] = simd::set1(mStepA1[k]);
+            da2[k] = simd::set1(mStepA2[k]);
+        }
+    }
+
+    for (int c = 0; c < channels; c += kLanes) {
+        // Every group of channels starts the ramp from the same place
+        float4 b0[kMaxSections], b1[kMaxSections], b2[kMaxSections];
+        float4 a1[kMaxSections], a2[kMaxSections];
+        float4 z1[kMaxSections], z2[kMaxSections];
+        for (int k = 0; k < numSections; k++) {
+            b0[k] = simd::set1(mB0[k]);
+            b1[k] = simd::set1(mB1[k]);
+            b2[k] = simd::set1(mB2[k]);
+            a1[k] = simd::set1(mA1[k]);
+            a2[k] = simd::set1(mA2[k]);
+            z1[k] = simd::load(&mLaneZ1[k][c]);
+            z2[k] = simd::load(&mLaneZ2[k][c]);
+        }
+
+        const float *src = in + c;
+        float *dst = out + c;
+        for (int32_t i = 0; i < numFrames; i++) {
+            float4 v = simd::load(src + static_cast<size_t>(i) * stride);
+            for (int k = 0; k < numSections; k++) {
+                if (kRamp) {
+                    b0[k] = simd::add(b0[k], db0[k]);
+                    b1[k] = simd::add(b1[k], db1[k]);
+                    b2[k] = simd::add(b2[k], db2[k]);
+                    a1[k] = simd::add(a1[k], da1[k]);
+                    a2[k] = simd::add(a2[k], da2[k]);
+                }
+                v = tdf2Step(v, b0[k], b1[k], b2[k], a1[k], a2[k], z1[k], z2[k]);
+            }
+            simd::store(dst + static_cast<size_t>(i) * stride, v);
+        }
+
+        for (int k = 0; k < numSections; k++) {
+            simd::store(&mLaneZ1[k][c], z1[k]);
+            simd::store(&mLaneZ2[k][c], z2[k]);
+        }
+    }
+}
+
+template<bool kRamp>
+void BiquadCascade::processSkewed(const float *in, float *out, int32_t numFrames) {
+    // Lane k of the pipeline holds section (group * 4 + k) and lags lane k-1 by
+    // one sample, so the step at time t emits sample t - kDepth from lane 3.
+    constexpr int32_t kDepth = kLanes - 1;
+
+    const int stride = mChannelCount;
+    const int channels = std::min(mChannelCount, kMaxChannels);
+    const int numGroups = (mNumSections + kLanes - 1) / kLanes;
+
+    for (int g = 0; g < numGroups; g++) {
+        const int s = g * kLanes;
+        const float4 db0 = simd::load(&mStepB0[s]);
+        const float4 db1 = simd::load(&mStepB1[s]);
+        const float4 db2 = simd::load(&mStepB2[s]);
+        const float4 da1 = simd::load(&mStepA1[s]);
+        const float4 da2 = simd::load(&mStepA2[s]);
+
+        for (int c = 0; c < channels; c++) {
+            // Every channel starts the ramp from the same place. A ramp steps
+            // all lanes together, so a section's ramp runs as many samples
+            // behind as the section does in the pipeline.
+            float4 b0 = simd::load(&mB0[s]);
+            float4 b1 = simd::load(&mB1[s]);
+            float4 b2 = simd::load(&mB2[s]);
+            float4 a1 = simd::load(&mA1[s]);
+            float4 a2 = simd::load(&mA2[s]);
+            const auto stepCoefficients = [&]() {
+                if (kRamp) {
+                    b0 = simd::add(b0, db0);
+                    b1 = simd::add(b1, db1);
+                    b2 = simd::add(b2, db2);
+                    a1 = simd::add(a1, da1);
+                    a2 = simd::add(a2, da2);
+                }
+            };
+
+            // Group 0 reads the input; later groups refine the previous group's output
+            const float *src = (g == 0 ? in : out) + c;
+            float *dst = out + c;
+
+            float4 z1 = simd::load(&mSkewZ1[c][s]);
+            float4 z2 = simd::load(&mSkewZ2[c][s]);
+            float4 y = simd::load(&mSkewPipe[c][s]);
+
+            // The first kDepth outputs belong to the previous block, which
+            // already emitted them while draining
+            int32_t warmup = std::min(kDepth, numFrames);
+            for (int32_t i = 0; i < warmup; i++) {
+                stepCoefficients();
+                y = tdf2Step(simd::shiftIn(y, src[static_cast<size_t>(i) * stride]),
+                             b0, b1, b2, a1, a2, z1, z2);
+            }
+            for (int32_t i = warmup; i < numFrames; i++) {
+                stepCoefficients();
+                y = tdf2Step(simd::shiftIn(y, src[static_cast<size_t>(i) * stride]),
+                             b0, b1, b2, a1, a2, z1, z2);
+                dst[static_cast<size_t>(i - kDepth) * stride] = simd::lane3(y);
+            }
+
+            simd::store(&mSkewZ1[c][s], z1);
+            simd::store(&mSkewZ2[c][s], z2);
+            simd::store(&mSkewPipe[c][s], y);
+
+            // Drain the samples still in flight through a throwaway copy of the
+            // pipeline. Lane 0 sees dummy input, but its output never reaches
+            // lane 3 within the drain. The saved state keeps them in flight
+            // for the next block.
+            for (int32_t j = 0; j < kDepth; j++) {
+                y = tdf2Step(simd::shiftIn(y, 0.0f), b0, b1, b2, a1, a2, z1, z2);
+                int32_t index = numFrames + j - kDepth;
+                if (index >= 0) {
+                    dst[static_cast<size_t>(index) * stride] = simd::lane3(y);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef OBOESAMPLE_BIQUADCASCADE_H
+#define OBOESAMPLE_BIQUADCASCADE_H
+
+#include <cstdint>
+#include "BiquadFilter.h"
+
+/**
+ * Runs up to kMaxSections biquad sections in series as one fused pass,
+ * using transposed Direct Form II and 4-lane SIMD (NEON/SSE).
+ *
+ * Two kernels are used depending on the channel count:
+ *  - Channel count a multiple of 4: lanes hold 4 channels, each section is one
+ *    vector step per frame.
+ *  - Otherwise (mono, stereo, ...): each channel runs a time-skewed pipeline
+ *    where lane k evaluates section k one sample behind lane k-1, so up to
+ *    four sections cost a single vector step per sample. Eight sections cost
+ *    two steps.
+ *
+ * Channels beyond kMaxChannels are passed through unchanged.
+ *
+ * rampCoefficients() retunes without a step: over the frames it's given,
+ * every coefficient moves a little each sample, and the ramp ends exactly on
+ * the new sections. Any point between two stable biquads is stable, so the
+ * filter stays stable throughout.
+ */
+class BiquadCascade {
+public:
+    static constexpr int kMaxSections = 8;
+    static constexpr int kMaxChannels = 8;
+
+    BiquadCascade();
+
+    // Replaces all sections (clamped to kMaxSections) and clears the state
+    void setSections(const BiquadCoefficients *sections, int numSections);
+
+    // Like setSections, but keeps the filter state if the number of sections is
+    // unchanged, so coefficients can be retuned mid-stream
+    void updateCoefficients(const BiquadCoefficients *sections, int numSections);
+
+    // Like updateCoefficients, but the coefficients get to sections linearly
+    // over the next numFrames processed frames instead of at once. A ramp
+    // replaces any ramp still running, from where it got to.
+    void rampCoefficients(const BiquadCoefficients *sections, int numSections, int32_t numFrames);
+
+    bool isRamping() const { return mRampFrames > 0; }
+
+    // Sets the interleaved channel count of the processed stream and clears the state
+    void setChannelCount(int channelCount);
+
+    int getNumSections() const { return mNumSections; }
+
+    // Clears the filter history
+    void reset();
+
+    // Processes numFrames interleaved frames; in and out may point to the same buffer
+    void process(const float *in, float *out, int32_t numFrames);
+
+private:
+    static constexpr int kLanes = 4;
+    static constexpr int kMaxGroups = kMaxSections / kLanes;
+
+    void loadCoefficients(const BiquadCoefficients *sections, int numSections);
+
+    // The kernels; with kRamp, the coefficients take a step every frame and
+    // are left where numFrames of steps get them
+    template<bool kRamp>
+    void processBlock(float *buffer, int32_t numFrames);
+    template<bool kRamp>
+    void processChannelLanes(const float *in, float *out, int32_t numFrames);
+    template<bool kRamp>
+    void processSkewed(const float *in, float *out, int32_t numFrames);
+
+    int mNumSections = 0;
+    int mChannelCount = 1;
+
+    // Coefficients by section; sections past mNumSections (up to the next
+    // multiple of kLanes) are identity so padded pipeline lanes pass through
+    alignas(16) float mB0[kMaxSections];
+    alignas(16) float mB1[kMaxSections];
+    alignas(16) float mB2[kMaxSections];
+    alignas(16) float mA1[kMaxSections];
+    alignas(16) float mA2[kMaxSections];
+
+    // The running ramp: per-frame steps, frames left and where it ends
+    alignas(16) float mStepB0[kMaxSections];
+    alignas(16) float mStepB1[kMaxSections];
+    alignas(16) float mStepB2[kMaxSections];
+    alignas(16) float mStepA1[kMaxSections];
+    alignas(16) float mStepA2[kMaxSections];
+    int32_t mRampFrames = 0;
+    BiquadCoefficients mRampEnd[kMaxSections];
+
+    // Channel-lane state: [section][channel]
+    alignas(16) float mLaneZ1[kMaxSections][kMaxChannels];
+    alignas(16) float mLaneZ2[kMaxSections][kMaxChannels];
+
+    // Time-skewed state: [channel][section], plus each lane's last output
+    alignas(16) float mSkewZ1[kMaxChannels][kMaxSections];
+    alignas(16) float mSkewZ2[kMaxChannels][kMaxSections];
+    alignas(16) float mSkewPipe[kMaxChannels][kMaxSections];
+};
+
+#endif //OBOESAMPLE_BIQUADCASCADE_H
@@ -1,4 +1,5 @@
 #include "BiquadFilter.h"
+#include "FastMath.h"
 #include <android/log.h>
 
 #define LOG_TAG "BiquadFilter"
@@ -8,68 +9,92 @@ void BiquadFilter::reset() {
     x1 = x2 = y1 = y2 = 0.0f;
 }
 
-// Bandpass filter (already implemented)
-void BiquadFilter::setBandpass(float sampleRate, float centerFreq, float Q) {
-    reset();
+void BiquadFilter::setCoefficients(const BiquadCoefficients &c) {
+    b0 = c.b0;
+    b1 = c.b1;
+    b2 = c.b2;
+    a1 = c.a1;
+    a2 = c.a2;
+}
+
+// Bandpass filter
+BiquadCoefficients BiquadFilter::designBandpass(float sampleRate, float centerFreq, float Q) {
     centerFreq = std::min(centerFreq, sampleRate / 2.0f - 1.0f);
     Q = std::max(Q, 0.1f);
 
-    float w0 = 2.0f * M_PI * centerFreq / sampleRate;
-    float alpha = std::sin(w0) / (2.0f * Q);
-    float cos_w0 = std::cos(w0);
+    float sin_w0, cos_w0;
+    fastmath::sinCos(2.0f * fastmath::kPi * centerFreq / sampleRate, sin_w0, cos_w0);
+    float alpha = sin_w0 / (2.0f * Q);
 
     float a0 = 1.0f + alpha;
-    b0 = alpha / a0;
-    b1 = 0.0f;
-    b2 = -alpha / a0;
-    a1 = (-2.0f * cos_w0) / a0;
-    a2 = (1.0f - alpha) / a0;
-
-    LOGD("Bandpass Filter: F=%.1f Hz, Q=%.2f", centerFreq, Q);
+    BiquadCoefficients c;
+    c.b0 = alpha / a0;
+    c.b1 = 0.0f;
+    c.b2 = -alpha / a0;
+    c.a1 = (-2.0f * cos_w0) / a0;
+    c.a2 = (1.0f - alpha) / a0;
+    return c;
 }
 
 // High Shelf filter - Boosts/cuts high frequencies
-void BiquadFilter::setHighShelf(float sampleRate, float centerFreq, float Q, float gainDb) {
-    reset();
+BiquadCoefficients BiquadFilter::designHighShelf(float sampleRate, float centerFreq, float Q,
+                                                 float gainDb) {
     centerFreq = std::min(centerFreq, sampleRate / 2.0f - 1.0f);
     Q = std::max(Q, 0.1f);
 
-    float A = std::pow(10.0f, gainDb / 40.0f); // Amplitude
-    float w0 = 2.0f * M_PI * centerFreq / sampleRate;
-    float alpha = std::sin(w0) / (2.0f * Q);
-    float cos_w0 = std::cos(w0);
+    float A = fastmath::dbToGain(gainDb / 2.0f); // Amplitude, 10^(gainDb / 40)
+    float sin_w0, cos_w0;
+    fastmath::sinCos(2.0f * fastmath::kPi * centerFreq / sampleRate, sin_w0, cos_w0);
     float beta = std::sqrt(A) / Q;
 
-    float a0 = (A + 1.0f) - (A - 1.0f) * cos_w0 + beta * std::sin(w0);
-
-    b0 = (A * ((A + 1.0f) + (A - 1.0f) * cos_w0 + beta * std::sin(w0))) / a0;
-    b1 = (-2.0f * A * ((A - 1.0f) + (A + 1.0f) * cos_w0)) / a0;
-    b2 = (A * ((A + 1.0f) + (A - 1.0f) * cos_w0 - beta * std::sin(w0))) / a0;
-    a1 = (2.0f * ((A - 1.0f) - (A + 1.0f) * cos_w0)) / a0;
-    a2 = ((A + 1.0f) - (A - 1.0f) * cos_w0 - beta * std::sin(w0)) / a0;
+    float a0 = (A + 1.0f) - (A - 1.0f) * cos_w0 + beta * sin_w0;
 
-    LOGD("High Shelf Filter: F=%.1f Hz, Q=%.2f, Gain=%.1f dB", centerFreq, Q, gainDb);
+    BiquadCoefficients c;
+    c.b0 = (A * ((A + 1.0f) + (A - 1.0f) * cos_w0 + beta * sin_w0)) / a0;
+    c.b1 = (-2.0f * A * ((A - 1.0f) + (A + 1.0f) * cos_w0)) / a0;
+    c.b2 = (A * ((A + 1.0f) + (A - 1.0f) * cos_w0 - beta * sin_w0)) / a0;
+    c.a1 = (2.0f * ((A - 1.0f) - (A + 1.0f) * cos_w0)) / a0;
+    c.a2 = ((A + 1.0f) - (A - 1.0f) * cos_w0 - beta * sin_w0) / a0;
+    return c;
 }
 
 // Peaking EQ filter - Boosts/cuts at specific frequency
-void BiquadFilter::setPeaking(float sampleRate, float centerFreq, float Q, float gainDb) {
-    reset();
+BiquadCoefficients BiquadFilter::designPeaking(float sampleRate, float centerFreq, float Q,
+                                               float gainDb) {
     centerFreq = std::min(centerFreq, sampleRate / 2.0f - 1.0f);
     Q = std::max(Q, 0.1f);
 
-    float A = std::pow(10.0f, gainDb / 40.0f); // Amplitude
-    float w0 = 2.0f * M_PI * centerFreq / sampleRate;
-    float alpha = std::sin(w0) / (2.0f * Q);
-    float cos_w0 = std::cos(w0);
+    float A = fastmath::dbToGain(gainDb / 2.0f); // Amplitude, 10^(gainDb / 40)
+    float sin_w0, cos_w0;
+    fastmath::sinCos(2.0f * fastmath::kPi * centerFreq / sampleRate, sin_w0, cos_w0);
+    float alpha = sin_w0 / (2.0f * Q);
 
     float a0 = 1.0f + alpha / A;
 
-    b0 = (1.0f + alpha * A) / a0;
-    b1 = (-2.0f * cos_w0) / a0;
-    b2 = (1.0f - alpha * A) / a0;
-    a1 = (-2.0f * cos_w0) / a0;
-    a2 = (1.0f - alpha / A) / a0;
+    BiquadCoefficients c;
+    c.b0 = (1.0f + alpha * A) / a0;
+    c.b1 = (-2.0f * cos_w0) / a0;
+    c.b2 = (1.0f - alpha * A) / a0;
+    c.a1 = (-2.0f * cos_w0) / a0;
+    c.a2 = (1.0f - alpha / A) / a0;
+    return c;
+}
+
+void BiquadFilter::setBandpass(float sampleRate, float centerFreq, float Q) {
+    reset();
+    setCoefficients(designBandpass(sampleRate, centerFreq, Q));
+    LOGD("Bandpass Filter: F=%.1f Hz, Q=%.2f", centerFreq, Q);
+}
+
+void BiquadFilter::setHighShelf(float sampleRate, float centerFreq, float Q, float gainDb) {
+    reset();
+    setCoefficients(designHighShelf(sampleRate, centerFreq, Q, gainDb));
+    LOGD("High Shelf Filter: F=%.1f Hz, Q=%.2f, Gain=%.1f dB", centerFreq, Q, gainDb);
+}
 
+void BiquadFilter::setPeaking(float sampleRate, float centerFreq, float Q, float gainDb) {
+    reset();
+    setCoefficients(designPeaking(sampleRate, centerFreq, Q, gainDb));
     LOGD("Peaking Filter: F=%.1f Hz, Q=%.2f, Gain=%.1f dB", centerFreq, Q, gainDb);
 }
 
@@ -82,4 +107,25 @@ float BiquadFilter::process(float in) {
     y1 = out;
 
     return out;
-}
\ No newline at end of file
+}
+
+void BiquadFilter::process(const float *in, float *out, int32_t numSamples) {
+    // Work on local copies so the state stays in registers across the block
+    const float cb0 = b0, cb1 = b1, cb2 = b2, ca1 = a1, ca2 = a2;
+    float sx1 = x1, sx2 = x2, sy1 = y1, sy2 = y2;
+
+    for (int32_t i = 0; i < numSamples; i++) {
+        float x = in[i];
+        float y = cb0 * x + cb1 * sx1 + cb2 * sx2 - ca1 * sy1 - ca2 * sy2;
+        sx2 = sx1;
+        sx1 = x;
+        sy2 = sy1;
+        sy1 = y;
+        out[i] = y;
+    }
+
+    x1 = sx1;
+    x2 = sx2;
+    y1 = sy1;
+    y2 = sy2;
+}
@@ -3,20 +3,45 @@
 
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
+
+// Normalized biquad coefficients (a0 == 1)
+struct BiquadCoefficients {
+    float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f;
+    float a1 = 0.0f, a2 = 0.0f;
+};
 
 class BiquadFilter {
 public:
-    // Coefficient setters based on filter type
+    // Coefficient designs by filter type. They use the FastMath kernels and
+    // neither log nor touch any state, so they're cheap enough to rerun every
+    // block while a parameter glides.
+    static BiquadCoefficients designBandpass(float sampleRate, float centerFreq, float Q);
+    static BiquadCoefficients designHighShelf(float sampleRate, float centerFreq, float Q,
+                                              float gainDb);
+    static BiquadCoefficients designPeaking(float sampleRate, float centerFreq, float Q,
+                                            float gainDb);
+
+    // Coefficient setters based on filter type; these clear the history
     void setBandpass(float sampleRate, float centerFreq, float Q);
     void setHighShelf(float sampleRate, float centerFreq, float Q, float gainDb);
     void setPeaking(float sampleRate, float centerFreq, float Q, float gainDb);
 
+    // Retunes the filter, keeping its history
+    void setCoefficients(const BiquadCoefficients &c);
+
     // Processes a single sample
     float process(float in);
 
+    // Processes a block of samples; in and out may point to the same buffer
+    void process(const float *in, float *out, int32_t numSamples);
+
     // Clears the filter history
     void reset();
 
+    // Current coefficients, e.g. to load into a BiquadCascade
+    BiquadCoefficients getCoefficients() const { return {b0, b1, b2, a1, a2}; }
+
 private:
     // Biquad coefficients
     float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f;
@@ -1,63 +1,304 @@
 #include "EchoCanceller.h"
+#include "SimdFloat4.h"
 #include <android/log.h>
 #include <algorithm>
+#include <cstring>
 
 #define LOG_TAG "EchoCanceller"
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 
-EchoCanceller::EchoCanceller(int sampleRate)
-        : mSampleRate(sampleRate),
-          mDelayInSamples(0),
-          mWriteIndex(0),
-          mSuppressionAmount(0.7f),
-          mAdaptiveCoeff(0.5f) {
-    // Default 50ms delay buffer
-    setEchoDelay(50.0f);
+using simd::float4;
+
+// Blocks cover at least this much audio
+constexpr float kBlockSeconds = 0.005f;
+
+// Normalized step size of the frequency-domain NLMS update
+constexpr float kStepSize = 0.5f;
+
+// Smoothing of the per-bin far-end power used to normalize the step
+constexpr float kPowerSmoothing = 0.9f;
+
+// Keeps the step bounded when the far end is (nearly) silent, as a per-sample
+// power floor
+constexpr float kRegularization = 1e-6f;
+
+// Two-filter control: smoothing of the per-block residual energies, and how
+// much harder resetting the adaptive filter is than promoting it
+constexpr float kErrorSmoothing = 0.7f;
+constexpr float kBacktrackRatio = 4.0f;
+
+// Far-end peaks below this are treated as silence: nothing to adapt on
+constexpr float kSilencePeak = 1e-4f;
+
+EchoCanceller::EchoCanceller(int sampleRate) {
+    setSampleRate(sampleRate);
     LOGD("EchoCanceller initialized at %d Hz", sampleRate);
 }
 
+void EchoCanceller::setSampleRate(int sampleRate) {
+    mSampleRate = std::max(1, sampleRate);
+
+    int blockSize = 32;
+    while (blockSize < mSampleRate * kBlockSeconds) {
+        blockSize <<= 1;
+    }
+    mBlockSize = blockSize;
+    mFft.init(2 * blockSize);
+    mNumBins = mFft.getNumBins();
+    mPaddedBins = (mNumBins + 3) & ~3;
+    mNumPartitions = std::max(1, static_cast<int>(
+            std::ceil(kTailMs / 1000.0f * mSampleRate / blockSize)));
+
+    int delayCapacity = 1;
+    while (delayCapacity < kMaxEchoDelayMs / 1000.0f * mSampleRate + 2 * blockSize) {
+        delayCapacity <<= 1;
+    }
+    mDelayLine.assign(delayCapacity, 0.0f);
+    mDelayMask = delayCapacity - 1;
+
+    mNearBlock.assign(blockSize, 0.0f);
+    mOutputBlock.assign(blockSize, 0.0f);
+    mRefFrame.assign(2 * blockSize, 0.0f);
+    mFrame.assign(2 * blockSize, 0.0f);
+
+    const size_t bins = mPaddedBins;
+    const size_t partitionBins = bins * mNumPartitions;
+    mEchoRe.assign(bins, 0.0f);
+    mEchoIm.assign(bins, 0.0f);
+    mErrorRe.assign(bins, 0.0f);
+    mErrorIm.assign(bins, 0.0f);
+    mXRe.assign(partitionBins, 0.0f);
+    mXIm.assign(partitionBins, 0.0f);
+    mWRe.assign(partitionBins, 0.0f);
+    mWIm.assign(partitionBins, 0.0f);
+    mForegroundRe.assign(partitionBins, 0.0f);
+    mForegroundIm.assign(partitionBins, 0.0f);
+    mBackgroundEcho.assign(blockSize, 0.0f);
+    mForegroundEcho.assign(blockSize, 0.0f);
+    mRefPower.assign(bins, 0.0f);
+    mRefPeaks.assign(mNumPartitions, 0.0f);
+
+    setEchoDelay(mDelayMs);
+    reset();
+    LOGD("Echo canceller: %d-sample blocks, %d partitions (%.0f ms tail)", mBlockSize,
+         mNumPartitions, 1000.0f * mNumPartitions * mBlockSize / mSampleRate);
+}
+
 void EchoCanceller::setEchoDelay(float delayMs) {
-    mDelayInSamples = static_cast<int>((delayMs / 1000.0f) * mSampleRate);
-    mDelayBuffer.resize(mDelayInSamples, 0.0f);
-    mWriteIndex = 0;
-    LOGD("Echo Delay: %.1f ms (%d samples)", delayMs, mDelayInSamples);
+    mDelayMs = std::max(0.0f, std::min(kMaxEchoDelayMs, delayMs));
+    float bulkMs = std::max(0.0f, mDelayMs - kDelayMarginMs);
+    mBulkDelay = static_cast<int>((bulkMs / 1000.0f) * mSampleRate);
 }
 
 void EchoCanceller::setSuppressionAmount(float amount) {
     mSuppressionAmount = std::max(0.0f, std::min(1.0f, amount));
-    LOGD("Echo Suppression: %.2f", mSuppressionAmount);
 }
 
-float EchoCanceller::process(float input) {
-    if (mDelayInSamples == 0) {
-        return input;
+void EchoCanceller::process(const float *in, const float *reference, float *out,
+                            int32_t numSamples) {
+    const int blockSize = mBlockSize;
+    float *delayLine = mDelayLine.data();
+
+    int32_t i = 0;
+    while (i < numSamples) {
+        int32_t count = std::min(numSamples - i, static_cast<int32_t>(blockSize - mBlockPosition));
+
+        for (int32_t j = 0; j < count; j++) {
+            delayLine[(mDelayWrite + j) & mDelayMask] = reference[i + j];
+        }
+        mDelayWrite = (mDelayWrite + count) & mDelayMask;
+
+        // Take the input before writing the output, so in == out works
+        memcpy(mNearBlock.data() + mBlockPosition, in + i, count * sizeof(float));
+        memcpy(out + i, mOutputBlock.data() + mBlockPosition, count * sizeof(float));
+
+        mBlockPosition += count;
+        i += count;
+        if (mBlockPosition == blockSize) {
+            processBlock();
+            mBlockPosition = 0;
+        }
+    }
+}
+
+void EchoCanceller::estimateEcho(const float *weightsRe, const float *weightsIm, float *echo) {
+    const int blockSize = mBlockSize;
+    const int numPartitions = mNumPartitions;
+    const int bins = mPaddedBins;
+    float *echoRe = mEchoRe.data();
+    float *echoIm = mEchoIm.data();
+
+    // Sum over partitions of W[p] * X[p]
+    std::fill(echoRe, echoRe + bins, 0.0f);
+    std::fill(echoIm, echoIm + bins, 0.0f);
+    for (int p = 0; p < numPartitions; p++) {
+        size_t x = static_cast<size_t>((mNewestPartition + p) % numPartitions) * bins;
+        size_t w = static_cast<size_t>(p) * bins;
+        for (int k = 0; k < bins; k += 4) {
+            float4 xr = simd::load(&mXRe[x + k]);
+            float4 xi = simd::load(&mXIm[x + k]);
+            float4 wr = simd::load(&weightsRe[w + k]);
+            float4 wi = simd::load(&weightsIm[w + k]);
+            float4 yr = simd::load(&echoRe[k]);
+            float4 yi = simd::load(&echoIm[k]);
+            yr = simd::msub(simd::madd(yr, wr, xr), wi, xi);
+            yi = simd::madd(simd::madd(yi, wr, xi), wi, xr);
+            simd::store(&echoRe[k], yr);
+            simd::store(&echoIm[k], yi);
+        }
+    }
+
+    // Overlap-save: only the second half is the linear convolution
+    mFft.inverse(echoRe, echoIm, mFrame.data());
+    memcpy(echo, mFrame.data() + blockSize, blockSize * sizeof(float));
+}
+
+void EchoCanceller::processBlock() {
+    const int blockSize = mBlockSize;
+    const int numPartitions = mNumPartitions;
+    const int bins = mPaddedBins;
+    const size_t weightCount = static_cast<size_t>(numPartitions) * bins;
+    float *refFrame = mRefFrame.data();
+    float *frame = mFrame.data();
+
+    // Slide the delayed reference into the second half of the overlap-save frame
+    memmove(refFrame, refFrame + blockSize, blockSize * sizeof(float));
+    int readStart = mDelayWrite - mBulkDelay - blockSize;
+    float refPeak = 0.0f;
+    for (int n = 0; n < blockSize; n++) {
+        float x = mDelayLine[(readStart + n) & mDelayMask];
+        refFrame[blockSize + n] = x;
+        refPeak = std::max(refPeak, std::fabs(x));
+    }
+
+    // The newest spectrum replaces the oldest; partition p pairs with the
+    // spectrum p blocks old
+    mNewestPartition = (mNewestPartition + numPartitions - 1) % numPartitions;
+    mRefPeaks[mNewestPartition] = refPeak;
+    float *newestRe = &mXRe[static_cast<size_t>(mNewestPartition) * bins];
+    float *newestIm = &mXIm[static_cast<size_t>(mNewestPartition) * bins];
+    mFft.forward(refFrame, newestRe, newestIm);
+
+    float *refPower = mRefPower.data();
+    for (int k = 0; k < mNumBins; k++) {
+        float power = newestRe[k] * newestRe[k] + newestIm[k] * newestIm[k];
+        refPower[k] = kPowerSmoothing * refPower[k] + (1.0f - kPowerSmoothing) * power;
     }
 
-    // Get delayed sample (estimated echo)
-    int readIndex = (mWriteIndex - mDelayInSamples + mDelayBuffer.size()) % mDelayBuffer.size();
-    float delayedSample = mDelayBuffer[readIndex];
+    float *background = mBackgroundEcho.data();
+    float *foreground = mForegroundEcho.data();
+    estimateEcho(mWRe.data(), mWIm.data(), background);
+    estimateEcho(mForegroundRe.data(), mForegroundIm.data(), foreground);
 
-    // Adaptive echo estimation
-    float estimatedEcho = delayedSample * mAdaptiveCoeff;
+    float backgroundEnergy = 0.0f;
+    float foregroundEnergy = 0.0f;
+    float differenceEnergy = 0.0f;
+    for (int n = 0; n < blockSize; n++) {
+        float near = mNearBlock[n];
+        float eb = near - background[n];
+        float ef = near - foreground[n];
+        float diff = background[n] - foreground[n];
+        backgroundEnergy += eb * eb;
+        foregroundEnergy += ef * ef;
+        differenceEnergy += diff * diff;
+    }
+    mBackgroundError = kErrorSmoothing * mBackgroundError +
+                       (1.0f - kErrorSmoothing) * backgroundEnergy;
+    mForegroundError = kErrorSmoothing * mForegroundError +
+                       (1.0f - kErrorSmoothing) * foregroundEnergy;
+    mFilterDifference = kErrorSmoothing * mFilterDifference +
+                        (1.0f - kErrorSmoothing) * differenceEnergy;
+
+    // Promote the adaptive filter once it beats the output filter by a margin
+    // that is large next to how far the two estimates differ; near-end speech
+    // inflates both residuals, so it makes promotion harder. Pull the adaptive
+    // filter back when it loses by a similar margin.
+    const float gain = mForegroundError - mBackgroundError;
+    const float margin = mForegroundError * mFilterDifference;
+    bool adapt = true;
+    if (gain > 0.0f && gain * gain > margin) {
+        memcpy(mForegroundRe.data(), mWRe.data(), weightCount * sizeof(float));
+        memcpy(mForegroundIm.data(), mWIm.data(), weightCount * sizeof(float));
+        memcpy(foreground, background, blockSize * sizeof(float));
+        mForegroundError = mBackgroundError;
+    } else if (gain < 0.0f && gain * gain > kBacktrackRatio * margin) {
+        memcpy(mWRe.data(), mForegroundRe.data(), weightCount * sizeof(float));
+        memcpy(mWIm.data(), mForegroundIm.data(), weightCount * sizeof(float));
+        mBackgroundError = mForegroundError;
+        adapt = false;
+    }
 
-    // Subtract estimated echo from input
-    float output = input - (estimatedEcho * mSuppressionAmount);
+    // Subtract the (scaled) foreground estimate for the output; the background
+    // filter adapts on its own full residual
+    const float amount = mSuppressionAmount;
+    for (int n = 0; n < blockSize; n++) {
+        float near = mNearBlock[n];
+        mOutputBlock[n] = near - amount * foreground[n];
+        frame[blockSize + n] = near - background[n];
+    }
+    std::fill(frame, frame + blockSize, 0.0f);
 
-    // Update adaptive coefficient based on correlation
-    // This is a simplified LMS (Least Mean Squares) approach
-    float error = output;
-    mAdaptiveCoeff += 0.001f * error * delayedSample;
-    mAdaptiveCoeff = std::max(-1.0f, std::min(1.0f, mAdaptiveCoeff));
+    float farPeak = *std::max_element(mRefPeaks.begin(), mRefPeaks.end());
+    if (!adapt || farPeak < kSilencePeak) {
+        return;
+    }
 
-    // Store current input in delay buffer
-    mDelayBuffer[mWriteIndex] = input;
-    mWriteIndex = (mWriteIndex + 1) % mDelayBuffer.size();
+    // Normalized gradient step: W[p] += mu / (P * S_x + delta) * conj(X[p]) * E,
+    // where P * S_x stands in for the far-end power across the whole filter
+    float *errorRe = mErrorRe.data();
+    float *errorIm = mErrorIm.data();
+    mFft.forward(frame, errorRe, errorIm);
+    const float regularization = kRegularization * 2.0f * blockSize;
+    for (int k = 0; k < mNumBins; k++) {
+        float step = kStepSize / (numPartitions * refPower[k] + regularization);
+        errorRe[k] *= step;
+        errorIm[k] *= step;
+    }
+    for (int p = 0; p < numPartitions; p++) {
+        size_t x = static_cast<size_t>((mNewestPartition + p) % numPartitions) * bins;
+        size_t w = static_cast<size_t>(p) * bins;
+        for (int k = 0; k < bins; k += 4) {
+            float4 xr = simd::load(&mXRe[x + k]);
+            float4 xi = simd::load(&mXIm[x + k]);
+            float4 er = simd::load(&errorRe[k]);
+            float4 ei = simd::load(&errorIm[k]);
+            float4 wr = simd::load(&mWRe[w + k]);
+            float4 wi = simd::load(&mWIm[w + k]);
+            wr = simd::madd(simd::madd(wr, xr, er), xi, ei);
+            wi = simd::msub(simd::madd(wi, xr, ei), xi, er);
+            simd::store(&mWRe[w + k], wr);
+            simd::store(&mWIm[w + k], wi);
+        }
+    }
 
-    return output;
+    // Gradient constraint on one partition per block: its impulse response
+    // must fit in the first half of the frame
+    float *constrainRe = &mWRe[static_cast<size_t>(mConstrainPartition) * bins];
+    float *constrainIm = &mWIm[static_cast<size_t>(mConstrainPartition) * bins];
+    mFft.inverse(constrainRe, constrainIm, frame);
+    std::fill(frame + blockSize, frame + 2 * blockSize, 0.0f);
+    mFft.forward(frame, constrainRe, constrainIm);
+    mConstrainPartition = (mConstrainPartition + 1) % numPartitions;
 }
 
 void EchoCanceller::reset() {
-    std::fill(mDelayBuffer.begin(), mDelayBuffer.end(), 0.0f);
-    mWriteIndex = 0;
-    mAdaptiveCoeff = 0.5f;
-}
\ No newline at end of file
+    std::fill(mDelayLine.begin(), mDelayLine.end(), 0.0f);
+    std::fill(mNearBlock.begin(), mNearBlock.end(), 0.0f);
+    std::fill(mOutputBlock.begin(), mOutputBlock.end(), 0.0f);
+    std::fill(mRefFrame.begin(), mRefFrame.end(), 0.0f);
+    std::fill(mXRe.begin(), mXRe.end(), 0.0f);
+    std::fill(mXIm.begin(), mXIm.end(), 0.0f);
+    std::fill(mWRe.begin(), mWRe.end(), 0.0f);
+    std::fill(mWIm.begin(), mWIm.end(), 0.0f);
+    std::fill(mForegroundRe.begin(), mForegroundRe.end(), 0.0f);
+    std::fill(mForegroundIm.begin(), mForegroundIm.end(), 0.0f);
+    std::fill(mRefPower.begin(), mRefPower.end(), 0.0f);
+    std::fill(mRefPeaks.begin(), mRefPeaks.end(), 0.0f);
+    mDelayWrite = 0;
+    mBlockPosition = 0;
+    mNewestPartition = 0;
+    mConstrainPartition = 0;
+    mBackgroundError = 0.0f;
+    mForegroundError = 0.0f;
+    mFilterDifference = 0.0f;
+}
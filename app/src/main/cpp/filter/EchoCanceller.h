@@ -3,33 +3,123 @@
 
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include "RealFFT.h"
 
-// Simple echo suppression using adaptive filtering
+/**
+ * Acoustic echo canceller: a partitioned-block frequency-domain adaptive filter
+ * (PBFDAF, overlap-save) that models the path from the far-end reference (what
+ * the player rendered) to the microphone and subtracts its estimate.
+ *
+ * The filter runs on blocks of ~5 ms (a power of two; 256 samples at 48 kHz)
+ * and is split into as many block-sized partitions as it takes to cover
+ * kTailMs of echo, so one block costs a handful of FFTs plus two complex
+ * multiply-adds per partition and bin (4-lane SIMD). Each bin's step is
+ * normalized by the smoothed far-end power in that bin. The time-domain
+ * constraint that keeps the partitions causal is applied to one partition per
+ * block in rotation.
+ *
+ * Double talk is handled with two filters: the background filter always adapts,
+ * and the foreground filter that produces the output only takes its weights
+ * once they clearly cancel better. A background filter thrown off by near-end
+ * speech is reset from the foreground instead of leaking into the output.
+ *
+ * The output is delayed by getLatencyFrames() samples (one block). All buffers
+ * are sized by the constructor and setSampleRate(); process() never allocates.
+ * setEchoDelay() and setSuppressionAmount() neither allocate nor log, and may
+ * be called from the audio thread between blocks.
+ */
 class EchoCanceller {
 public:
-    EchoCanceller(int sampleRate);
+    // Echo tail the adaptive filter covers
+    static constexpr float kTailMs = 400.0f;
 
-    // Set echo delay in milliseconds
+    // Longest supported echo delay; the reference delay line is allocated for
+    // it up front so setEchoDelay() never allocates
+    static constexpr float kMaxEchoDelayMs = 1000.0f;
+
+    explicit EchoCanceller(int sampleRate);
+
+    // Resizes the filter for a new sample rate and clears the state. Allocates;
+    // don't call while the stream is running.
+    void setSampleRate(int sampleRate);
+
+    // Set the expected echo delay in milliseconds (clamped to kMaxEchoDelayMs).
+    // The adaptive filter window opens kDelayMarginMs before it and spans kTailMs.
     void setEchoDelay(float delayMs);
 
-    // Set echo suppression amount (0.0 to 1.0)
+    // Set echo suppression amount (0.0 to 1.0): how much of the echo estimate
+    // is subtracted. The filter always adapts on the full residual.
     void setSuppressionAmount(float amount);
 
-    // Process a single sample
-    float process(float input);
+    // Cancels the echo of reference from in. reference holds the far-end samples
+    // lined up with the capture time of in; in and out may point to the same buffer.
+    void process(const float *in, const float *reference, float *out, int32_t numSamples);
 
     // Reset state
     void reset();
 
+    int getBlockSize() const { return mBlockSize; }
+    int getNumPartitions() const { return mNumPartitions; }
+
+    // Delay between a sample going in and its processed version coming out
+    int getLatencyFrames() const { return mBlockSize; }
+
 private:
-    std::vector<float> mDelayBuffer;
-    int mSampleRate;
-    int mDelayInSamples;
-    int mWriteIndex;
-    float mSuppressionAmount;
-
-    // Adaptive filter coefficient
-    float mAdaptiveCoeff;
+    // How far before the expected echo delay the filter window opens
+    static constexpr float kDelayMarginMs = 50.0f;
+
+    // Runs one block of the adaptive filter over mNearBlock and the delayed
+    // reference, and refills mOutputBlock
+    void processBlock();
+
+    // Time-domain echo estimate (one block) of the filter with the given weights
+    void estimateEcho(const float *weightsRe, const float *weightsIm, float *echo);
+
+    int mSampleRate = 0;
+    int mBlockSize = 0;
+    int mNumPartitions = 0;
+    int mNumBins = 0;
+    int mPaddedBins = 0;          // mNumBins rounded up to the SIMD width
+
+    float mSuppressionAmount = 0.7f;
+    float mDelayMs = 50.0f;
+    int mBulkDelay = 0;           // reference delay ahead of the filter window
+
+    RealFFT mFft;
+
+    // Reference delay line, power-of-two sized
+    std::vector<float> mDelayLine;
+    int mDelayMask = 0;
+    int mDelayWrite = 0;
+
+    // Block FIFOs
+    std::vector<float> mNearBlock;    // mic samples of the block being filled
+    std::vector<float> mOutputBlock;  // finished samples being played out
+    int mBlockPosition = 0;
+
+    // Overlap-save frames (2 blocks) and spectra
+    std::vector<float> mRefFrame;     // previous + current delayed reference block
+    std::vector<float> mFrame;
+    std::vector<float> mEchoRe, mEchoIm;
+    std::vector<float> mErrorRe, mErrorIm;
+
+    // Per partition: reference spectra (newest at mNewestPartition), adaptive
+    // (background) weights and output (foreground) weights
+    std::vector<float> mXRe, mXIm;
+    std::vector<float> mWRe, mWIm;
+    std::vector<float> mForegroundRe, mForegroundIm;
+    std::vector<float> mBackgroundEcho, mForegroundEcho;
+    float mBackgroundError = 0.0f;    // smoothed residual energy per block
+    float mForegroundError = 0.0f;
+    float mFilterDifference = 0.0f;   // smoothed energy between the two estimates
+    int mNewestPartition = 0;
+    int mConstrainPartition = 0;
+
+    std::vector<float> mRefPower;     // smoothed far-end power per bin
+
+    // Far-end peak of each block in the tail, to skip adapting on silence
+    std::vector<float> mRefPeaks;
 };
 
-#endif //OBOESAMPLE_ECHOCANCELLER_H
\ No newline at end of file
+#endif //OBOESAMPLE_ECHOCANCELLER_H
@@ -0,0 +1,129 @@
+#ifndef OBOESAMPLE_FASTMATH_H
+#define OBOESAMPLE_FASTMATH_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Fast approximations of the transcendental functions used to recompute
+ * coefficients while parameters glide: sin/cos, exp/exp2, log2 and the dB
+ * conversions.
+ *
+ * They're branch-light polynomials after range reduction, with no tables, so
+ * they cost a few tens of cycles on any core and are safe on the audio thread.
+ * Accuracy, against the exact values:
+ *  - sin/cos: within 5e-7 absolute for |x| <= 2 pi (the range reduction is
+ *    plain float, so larger arguments lose what their rounding loses);
+ *  - exp2/exp/dbToGain: within 3e-7 relative over the float range (results
+ *    bottom out at 2^-126, never 0 or denormal, and saturate at 2^127);
+ *  - log2: within 2e-7 relative (or absolute, below 1) for normal x > 0;
+ *    anything else gives -126. gainToDb is within 2e-5 dB.
+ * That's below the rounding of the biquad kernels themselves.
+ */
+namespace fastmath {
+
+constexpr float kPi = 3.14159265358979f;
+constexpr float kLog2E = 1.44269504088896f;
+constexpr float kLog2Of10 = 3.32192809488736f;
+
+// 2^n for an integer n in [-126, 127]
+inline float pow2i(int32_t n) {
+    const uint32_t bits = static_cast<uint32_t>(n + 127) << 23;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+inline float exp2(float x) {
+    x = std::fmax(-126.0f, std::fmin(127.0f, x));
+    const float n = std::nearbyint(x);
+    const float f = x - n;  // [-0.5, 0.5]
+    // Taylor series of 2^f, to f^6
+    float p = 1.540353e-4f;
+    p = p * f + 1.333355e-3f;
+    p = p * f + 9.618129e-3f;
+    p = p * f + 5.550411e-2f;
+    p = p * f + 2.402265e-1f;
+    p = p * f + 6.931472e-1f;
+    p = p * f + 1.0f;
+    return p * pow2i(static_cast<int32_t>(n));
+}
+
+inline float exp(float x) {
+    return exp2(x * kLog2E);
+}
+
+inline float log2(float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    if (x <= 0.0f || (bits >> 23) == 0) return -126.0f;
+    int32_t exponent = static_cast<int32_t>(bits >> 23) - 127;
+    // Mantissa in [sqrt(0.5), sqrt(2)), so the series below converges fast
+    bits = (bits & 0x007fffffu) | 0x3f800000u;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+    if (m > 1.41421356f) {
+        m *= 0.5f;
+        exponent++;
+    }
+    // log2(m) = 2 / ln(2) * atanh(t), t = (m - 1) / (m + 1)
+    const float t = (m - 1.0f) / (m + 1.0f);
+    const float t2 = t * t;
+    float p = 1.0f / 9.0f;
+    p = p * t2 + 1.0f / 7.0f;
+    p = p * t2 + 1.0f / 5.0f;
+    p = p * t2 + 1.0f / 3.0f;
+    p = p * t2 + 1.0f;
+    return static_cast<float>(exponent) + 2.0f * kLog2E * t * p;
+}
+
+// Amplitude <-> dB (20 log10)
+inline float dbToGain(float db) {
+    return exp2(db * (kLog2Of10 / 20.0f));
+}
+
+inline float gainToDb(float gain) {
+    return log2(gain) * (20.0f / kLog2Of10);
+}
+
+// Both at once; the range reduction is shared
+inline void sinCos(float x, float &sine, float &cosine) {
+    // x = quadrant * pi/2 + r, |r| <= pi/4; pi/2 in two parts keeps r exact
+    const float quadrant = std::nearbyint(x * (2.0f / kPi));
+    const float r = (x - quadrant * 1.57079637f) + quadrant * 4.37113883e-8f;
+    const float r2 = r * r;
+
+    float s = -1.0f / 5040.0f;
+    s = s * r2 + 1.0f / 120.0f;
+    s = s * r2 - 1.0f / 6.0f;
+    s = (s * r2) * r + r;
+    float c = 1.0f / 40320.0f;
+    c = c * r2 - 1.0f / 720.0f;
+    c = c * r2 + 1.0f / 24.0f;
+    c = c * r2 - 0.5f;
+    c = c * r2 + 1.0f;
+
+    switch (static_cast<int32_t>(quadrant) & 3) {
+        case 0: sine = s; cosine = c; break;
+        case 1: sine = c; cosine = -s; break;
+        case 2: sine = -s; cosine = -c; break;
+        default: sine = -c; cosine = s; break;
+    }
+}
+
+inline float sin(float x) {
+    float s, c;
+    sinCos(x, s, c);
+    return s;
+}
+
+inline float cos(float x) {
+    float s, c;
+    sinCos(x, s, c);
+    return c;
+}
+
+} // namespace fastmath
+
+#endif //OBOESAMPLE_FASTMATH_H
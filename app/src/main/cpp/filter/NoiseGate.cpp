@@ -1,60 +1,84 @@
 #include "NoiseGate.h"
-#include <android/log.h>
+#include "FastMath.h"
+#include "SimdFloat4.h"
+#include <cstring>
 
-#define LOG_TAG "NoiseGate"
-#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+using simd::float4;
+
+constexpr int kLanes = 4;
 
 NoiseGate::NoiseGate()
         : mThreshold(0.01f), // Default -40 dB
           mRatio(4.0f),
           mAttackCoeff(0.0f),
-          mReleaseCoeff(0.0f),
-          mEnvelope(0.0f) {
+          mReleaseCoeff(0.0f) {
+    mThresholdDb.jump(-40.0f);
+    mRatioRamp.jump(mRatio);
+    reset();
 }
 
 void NoiseGate::setThreshold(float thresholdDb) {
-    // Convert dB to linear
-    mThreshold = std::pow(10.0f, thresholdDb / 20.0f);
-    LOGD("Noise Gate Threshold: %.1f dB (%.6f linear)", thresholdDb, mThreshold);
+    mThresholdDb.setTarget(thresholdDb);
+    if (!mThresholdDb.isRamping()) {
+        mThreshold = fastmath::dbToGain(thresholdDb);
+    }
 }
 
 void NoiseGate::setRatio(float ratio) {
-    mRatio = std::max(1.0f, ratio);
-    LOGD("Noise Gate Ratio: %.1f:1", mRatio);
+    ratio = std::max(1.0f, ratio);
+    mRatioRamp.setTarget(ratio);
+    if (!mRatioRamp.isRamping()) {
+        mRatio = ratio;
+    }
+}
+
+void NoiseGate::setRampTime(float rampMs, float sampleRate) {
+    const auto frames = static_cast<int32_t>(std::max(0.0f, rampMs) * 0.001f * sampleRate);
+    mThresholdDb.setRampFrames(frames);
+    mRatioRamp.setRampFrames(frames);
 }
 
 void NoiseGate::setAttack(float attackMs, float sampleRate) {
     mAttackCoeff = calculateCoeff(attackMs, sampleRate);
-    LOGD("Noise Gate Attack: %.1f ms", attackMs);
 }
 
 void NoiseGate::setRelease(float releaseMs, float sampleRate) {
     mReleaseCoeff = calculateCoeff(releaseMs, sampleRate);
-    LOGD("Noise Gate Release: %.1f ms", releaseMs);
+}
+
+void NoiseGate::setChannelCount(int channelCount) {
+    mChannelCount = std::max(1, channelCount);
+    reset();
 }
 
 float NoiseGate::calculateCoeff(float timeMs, float sampleRate) {
     // Convert milliseconds to samples and calculate exponential coefficient
     if (timeMs <= 0.0f) return 0.0f;
-    return std::exp(-1.0f / (timeMs * 0.001f * sampleRate));
+    return fastmath::exp(-1.0f / (timeMs * 0.001f * sampleRate));
 }
 
 float NoiseGate::process(float input) {
+    if (mThresholdDb.isRamping() || mRatioRamp.isRamping()) {
+        mThreshold = fastmath::dbToGain(mThresholdDb.advance(1));
+        mRatio = mRatioRamp.advance(1);
+    }
+
     // Get input level (absolute value)
     float inputLevel = std::abs(input);
 
     // Smooth envelope follower
-    if (inputLevel > mEnvelope) {
-        mEnvelope = mAttackCoeff * mEnvelope + (1.0f - mAttackCoeff) * inputLevel;
+    float &envelope = mEnvelope[0];
+    if (inputLevel > envelope) {
+        envelope = mAttackCoeff * envelope + (1.0f - mAttackCoeff) * inputLevel;
     } else {
-        mEnvelope = mReleaseCoeff * mEnvelope + (1.0f - mReleaseCoeff) * inputLevel;
+        envelope = mReleaseCoeff * envelope + (1.0f - mReleaseCoeff) * inputLevel;
     }
 
     // Calculate gain reduction
     float gain = 1.0f;
-    if (mEnvelope < mThreshold) {
+    if (envelope < mThreshold) {
         // Below threshold: apply expansion
-        float diff = mThreshold - mEnvelope;
+        float diff = mThreshold - envelope;
         float reduction = diff * (mRatio - 1.0f) / mRatio;
         gain = std::max(0.0f, (mThreshold - reduction) / mThreshold);
     }
@@ -62,6 +86,111 @@ float NoiseGate::process(float input) {
     return input * gain;
 }
 
+void NoiseGate::process(const float *in, float *out, int32_t numFrames) {
+    int32_t offset = 0;
+    while (offset < numFrames) {
+        int32_t frames = numFrames - offset;
+        Curve curve{mThreshold, slopeOf(mThreshold, mRatio), 0.0f, 0.0f};
+        if (mThresholdDb.isRamping() || mRatioRamp.isRamping()) {
+            // Across the sub-block the curve moves to where the glides get to
+            frames = std::min(kRampBlockFrames, frames);
+            mThreshold = fastmath::dbToGain(mThresholdDb.advance(frames));
+            mRatio = mRatioRamp.advance(frames);
+            curve.thresholdStep = (mThreshold - curve.threshold) / static_cast<float>(frames);
+            curve.slopeStep = (slopeOf(mThreshold, mRatio) - curve.slope) /
+                              static_cast<float>(frames);
+        }
+        const size_t first = static_cast<size_t>(offset) * mChannelCount;
+        processBlock(in + first, out + first, frames, curve);
+        offset += frames;
+    }
+}
+
+void NoiseGate::processBlock(const float *in, float *out, int32_t numFrames,
+                             const Curve &curve) {
+    const int channels = std::min(mChannelCount, kMaxChannels);
+    if (in != out && channels < mChannelCount) {
+        memcpy(out, in, static_cast<size_t>(numFrames) * mChannelCount * sizeof(float));
+    }
+
+    int c = 0;
+    for (; c + kLanes <= channels; c += kLanes) {
+        processChannelLanes(in, out, numFrames, c, curve);
+    }
+    for (; c < channels; c++) {
+        processChannel(in, out, numFrames, c, curve);
+    }
+}
+
+// Below the threshold the gain is 1 - (threshold - envelope) * slope, which is
+// the expansion curve; above it the same expression exceeds 1 and is clamped.
+// Both kernels use this form so a channel gets the same output either way.
+
+void NoiseGate::processChannelLanes(const float *in, float *out, int32_t numFrames,
+                                    int firstChannel, const Curve &curve) {
+    const int stride = mChannelCount;
+    float4 threshold = simd::set1(curve.threshold);
+    float4 slope = simd::set1(curve.slope);
+    const float4 thresholdStep = simd::set1(curve.thresholdStep);
+    const float4 slopeStep = simd::set1(curve.slopeStep);
+    const float4 attackCoeff = simd::set1(mAttackCoeff);
+    const float4 releaseCoeff = simd::set1(mReleaseCoeff);
+    const float4 one = simd::set1(1.0f);
+    const float4 zero = simd::zero();
+    float4 envelope = simd::load(&mEnvelope[firstChannel]);
+
+    const float *src = in + firstChannel;
+    float *dst = out + firstChannel;
+    for (int32_t i = 0; i < numFrames; i++) {
+        float4 input = simd::load(src + static_cast<size_t>(i) * stride);
+        float4 inputLevel = simd::abs(input);
+        threshold = simd::add(threshold, thresholdStep);
+        slope = simd::add(slope, slopeStep);
+
+        float4 coeff = simd::select(simd::greaterThan(inputLevel, envelope), attackCoeff,
+                                    releaseCoeff);
+        envelope = simd::madd(simd::mul(coeff, envelope), simd::sub(one, coeff), inputLevel);
+
+        float4 gain = simd::msub(one, simd::sub(threshold, envelope), slope);
+        gain = simd::max(zero, simd::min(one, gain));
+        simd::store(dst + static_cast<size_t>(i) * stride, simd::mul(input, gain));
+    }
+
+    simd::store(&mEnvelope[firstChannel], envelope);
+}
+
+void NoiseGate::processChannel(const float *in, float *out, int32_t numFrames, int channel,
+                               const Curve &curve) {
+    const int stride = mChannelCount;
+    float threshold = curve.threshold;
+    float slope = curve.slope;
+    const float attackCoeff = mAttackCoeff;
+    const float releaseCoeff = mReleaseCoeff;
+    float envelope = mEnvelope[channel];
+
+    for (int32_t i = 0; i < numFrames; i++) {
+        const size_t index = static_cast<size_t>(i) * stride + channel;
+        float input = in[index];
+        float inputLevel = std::abs(input);
+        threshold += curve.thresholdStep;
+        slope += curve.slopeStep;
+
+        float coeff = inputLevel > envelope ? attackCoeff : releaseCoeff;
+        envelope = coeff * envelope + (1.0f - coeff) * inputLevel;
+
+        float gain = 1.0f - (threshold - envelope) * slope;
+        gain = std::max(0.0f, std::min(1.0f, gain));
+
+        out[index] = input * gain;
+    }
+
+    mEnvelope[channel] = envelope;
+}
+
 void NoiseGate::reset() {
-    mEnvelope = 0.0f;
-}
\ No newline at end of file
+    memset(mEnvelope, 0, sizeof(mEnvelope));
+    mThresholdDb.jump(mThresholdDb.getTarget());
+    mRatioRamp.jump(mRatioRamp.getTarget());
+    mThreshold = fastmath::dbToGain(mThresholdDb.getValue());
+    mRatio = mRatioRamp.getValue();
+}
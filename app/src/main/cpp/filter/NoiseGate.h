@@ -2,10 +2,31 @@
 #define OBOESAMPLE_NOISEGATE_H
 
 #include <cmath>
+#include <cstdint>
 #include <algorithm>
+#include "ParamRamp.h"
 
+/**
+ * Downward expander with an envelope follower per channel.
+ *
+ * Blocks are interleaved frames of setChannelCount() channels, each gated on
+ * its own level. Groups of four channels run in the lanes of one SIMD vector;
+ * any remaining channels run one at a time. Channels beyond kMaxChannels are
+ * passed through unchanged.
+ *
+ * With a ramp time set, threshold and ratio changes glide in (the threshold in
+ * dB) instead of stepping the gain: the block runs in sub-blocks of
+ * kRampBlockFrames, and within each the expansion curve moves a little every
+ * sample.
+ *
+ * Nothing here allocates or logs; the setters may be called from the audio
+ * thread between blocks.
+ */
 class NoiseGate {
 public:
+    static constexpr int kMaxChannels = 8;
+    static constexpr int32_t kRampBlockFrames = 32;
+
     NoiseGate();
 
     // Configure noise gate parameters
@@ -14,18 +35,52 @@ public:
     void setAttack(float attackMs, float sampleRate);   // How fast gate closes
     void setRelease(float releaseMs, float sampleRate); // How fast gate opens
 
-    // Process a single sample
+    // How long threshold and ratio changes take to glide in; 0 (the default)
+    // applies them at once
+    void setRampTime(float rampMs, float sampleRate);
+
+    // Sets the interleaved channel count of the processed stream and clears the state
+    void setChannelCount(int channelCount);
+
+    // Process a single sample (of the first channel)
     float process(float input);
 
-    // Reset gate state
+    // Process numFrames interleaved frames; in and out may point to the same buffer
+    void process(const float *in, float *out, int32_t numFrames);
+
+    // Reset gate state; glides jump to their targets
     void reset();
 
 private:
-    float mThreshold;      // Linear threshold
-    float mRatio;          // Expansion ratio
+    // Below the threshold the gain is 1 - (threshold - envelope) * slope. Each
+    // frame moves threshold and slope by their steps before using them.
+    struct Curve {
+        float threshold;
+        float slope;
+        float thresholdStep;
+        float slopeStep;
+    };
+
+    void processBlock(const float *in, float *out, int32_t numFrames, const Curve &curve);
+    void processChannelLanes(const float *in, float *out, int32_t numFrames, int firstChannel,
+                             const Curve &curve);
+    void processChannel(const float *in, float *out, int32_t numFrames, int channel,
+                        const Curve &curve);
+
+    float slopeOf(float threshold, float ratio) const {
+        return (ratio - 1.0f) / (ratio * threshold);
+    }
+
+    ParamRamp mThresholdDb;
+    ParamRamp mRatioRamp;
+    float mThreshold;      // Linear threshold, where the glide is
+    float mRatio;          // Expansion ratio, where the glide is
     float mAttackCoeff;    // Attack time coefficient
     float mReleaseCoeff;   // Release time coefficient
-    float mEnvelope;       // Current envelope level
+    int mChannelCount = 1;
+
+    // Current envelope level per channel
+    alignas(16) float mEnvelope[kMaxChannels];
 
     // Helper to calculate time coefficients
     float calculateCoeff(float timeMs, float sampleRate);
@@ -1,45 +1,202 @@
 #include "NoiseReduction.h"
+#include "FastMath.h"
 #include <android/log.h>
 #include <algorithm>
+#include <cstring>
 
 #define LOG_TAG "NoiseReduction"
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 
-NoiseReduction::NoiseReduction(int smoothingWindow)
-        : mWindowSize(smoothingWindow),
-          mIndex(0),
-          mReductionAmount(0.5f),
-          mSum(0.0f) {
-    mBuffer.resize(mWindowSize, 0.0f);
-    LOGD("NoiseReduction initialized with window size: %d", mWindowSize);
+// Frames cover at least this much audio
+constexpr float kFrameSeconds = 0.010f;
+
+// Recursive smoothing of the periodogram before the minimum search
+constexpr float kPowerSmoothing = 0.8f;
+
+// The noise floor is the minimum over kNumSubwindows subwindows spanning
+// kTrackingSeconds; older subwindows drop out as new ones complete
+constexpr int kNumSubwindows = 8;
+constexpr float kTrackingSeconds = 1.5f;
+
+// The minimum of a smoothed periodogram sits below the mean noise power
+constexpr float kMinimumBias = 2.0f;
+
+// Weight of the previous frame's clean estimate in the decision-directed a priori SNR
+constexpr float kDecisionDirected = 0.98f;
+
+constexpr float kMinPower = 1e-12f;
+
+NoiseReduction::NoiseReduction(int sampleRate) {
+    setSampleRate(sampleRate);
+    setReductionAmount(mReductionAmount);
+}
+
+void NoiseReduction::setSampleRate(int sampleRate) {
+    mSampleRate = std::max(1, sampleRate);
+    mFft.init(static_cast<int>(std::ceil(mSampleRate * kFrameSeconds)));
+    mFrameSize = mFft.getSize();
+    mHopSize = mFrameSize / 2;
+    mNumBins = mFft.getNumBins();
+
+    // Periodic Hann, square-rooted: applied on analysis and synthesis, its
+    // square sums to exactly one at 50% overlap
+    mWindow.resize(mFrameSize);
+    for (int n = 0; n < mFrameSize; n++) {
+        double hann = 0.5 - 0.5 * std::cos(2.0 * M_PI * n / mFrameSize);
+        mWindow[n] = static_cast<float>(std::sqrt(hann));
+    }
+
+    mInputFrame.resize(mFrameSize);
+    mOverlap.resize(mFrameSize);
+    mOutputHop.resize(mHopSize);
+    mFrame.resize(mFrameSize);
+    mRe.resize(mNumBins);
+    mIm.resize(mNumBins);
+
+    mSmoothedPower.resize(mNumBins);
+    mNoisePower.resize(mNumBins);
+    mSubwindowMin.resize(mNumBins);
+    mMinHistory.resize(static_cast<size_t>(kNumSubwindows) * mNumBins);
+    mPrevCleanPower.resize(mNumBins);
+
+    float hopSeconds = static_cast<float>(mHopSize) / mSampleRate;
+    mSubwindowFrames = std::max(1, static_cast<int>(
+            std::lround(kTrackingSeconds / kNumSubwindows / hopSeconds)));
+
+    reset();
+    LOGD("NoiseReduction: %d-point frames, hop %d, latency %d samples",
+         mFrameSize, mHopSize, getLatencyFrames());
 }
 
 void NoiseReduction::setReductionAmount(float amount) {
     mReductionAmount = std::max(0.0f, std::min(1.0f, amount));
-    LOGD("Noise Reduction Amount: %.2f", mReductionAmount);
+    mGainFloor = fastmath::dbToGain(-mReductionAmount * kMaxAttenuationDb);
 }
 
 float NoiseReduction::process(float input) {
-    // Remove oldest sample from sum
-    mSum -= mBuffer[mIndex];
+    float output;
+    process(&input, &output, 1);
+    return output;
+}
+
+void NoiseReduction::process(const float *in, float *out, int32_t numSamples) {
+    const int hop = mHopSize;
+    float *pending = mInputFrame.data() + (mFrameSize - hop);
+
+    int32_t i = 0;
+    while (i < numSamples) {
+        int32_t count = std::min(numSamples - i, static_cast<int32_t>(hop - mHopPosition));
+
+        // Take the input before writing the output, so in == out works
+        memcpy(pending + mHopPosition, in + i, count * sizeof(float));
+        memcpy(out + i, mOutputHop.data() + mHopPosition, count * sizeof(float));
+
+        mHopPosition += count;
+        i += count;
+        if (mHopPosition == hop) {
+            processFrame();
+            mHopPosition = 0;
+        }
+    }
+}
 
-    // Add new sample
-    mBuffer[mIndex] = input;
-    mSum += input;
+void NoiseReduction::processFrame() {
+    const int frameSize = mFrameSize;
+    const int hop = mHopSize;
+    const int numBins = mNumBins;
+    const float *window = mWindow.data();
+    float *frame = mFrame.data();
+    float *re = mRe.data();
+    float *im = mIm.data();
 
-    // Move to next position
-    mIndex = (mIndex + 1) % mWindowSize;
+    for (int n = 0; n < frameSize; n++) {
+        frame[n] = mInputFrame[n] * window[n];
+    }
+    memmove(mInputFrame.data(), mInputFrame.data() + hop, (frameSize - hop) * sizeof(float));
 
-    // Calculate moving average
-    float average = mSum / mWindowSize;
+    mFft.forward(frame, re, im);
 
-    // Blend between original and smoothed based on reduction amount
-    // This reduces high-frequency noise while preserving signal
-    return input * (1.0f - mReductionAmount) + average * mReductionAmount;
+    float *smoothed = mSmoothedPower.data();
+    float *subMin = mSubwindowMin.data();
+    float *noise = mNoisePower.data();
+    float *prevClean = mPrevCleanPower.data();
+
+    if (mSeedFrames > 0) {
+        // Seed the tracker from the first frames so it starts from a sane floor.
+        // The first frame after a reset is half silence, so the second one
+        // seeds it again.
+        for (int k = 0; k < numBins; k++) {
+            float power = re[k] * re[k] + im[k] * im[k] + kMinPower;
+            smoothed[k] = power;
+            subMin[k] = power;
+            prevClean[k] = power;
+        }
+        for (int s = 0; s < kNumSubwindows; s++) {
+            memcpy(&mMinHistory[static_cast<size_t>(s) * numBins], smoothed, numBins * sizeof(float));
+        }
+        mSeedFrames--;
+    }
+
+    // Minimum statistics: running minimum of the smoothed power within the
+    // current subwindow, combined with the minima of the previous ones
+    for (int k = 0; k < numBins; k++) {
+        float power = re[k] * re[k] + im[k] * im[k] + kMinPower;
+        smoothed[k] = kPowerSmoothing * smoothed[k] + (1.0f - kPowerSmoothing) * power;
+        subMin[k] = std::min(subMin[k], smoothed[k]);
+    }
+    for (int k = 0; k < numBins; k++) {
+        float minimum = subMin[k];
+        for (int s = 0; s < kNumSubwindows; s++) {
+            minimum = std::min(minimum, mMinHistory[static_cast<size_t>(s) * numBins + k]);
+        }
+        noise[k] = kMinimumBias * minimum;
+    }
+    if (++mFrameInSubwindow == mSubwindowFrames) {
+        memcpy(&mMinHistory[static_cast<size_t>(mHistoryIndex) * numBins], subMin,
+               numBins * sizeof(float));
+        mHistoryIndex = (mHistoryIndex + 1) % kNumSubwindows;
+        memcpy(subMin, smoothed, numBins * sizeof(float));
+        mFrameInSubwindow = 0;
+    }
+
+    // Wiener gain from the decision-directed a priori SNR, floored by the
+    // reduction amount
+    const float floor = mGainFloor;
+    for (int k = 0; k < numBins; k++) {
+        float power = re[k] * re[k] + im[k] * im[k];
+        float invNoise = 1.0f / noise[k];
+        float posterior = power * invNoise;
+        float prior = kDecisionDirected * prevClean[k] * invNoise +
+                      (1.0f - kDecisionDirected) * std::max(posterior - 1.0f, 0.0f);
+        float gain = std::max(prior / (1.0f + prior), floor);
+        prevClean[k] = gain * gain * power;
+        re[k] *= gain;
+        im[k] *= gain;
+    }
+
+    mFft.inverse(re, im, frame);
+
+    // Overlap-add; the first hop of the accumulator is now complete
+    float *overlap = mOverlap.data();
+    for (int n = 0; n < frameSize; n++) {
+        overlap[n] += frame[n] * window[n];
+    }
+    memcpy(mOutputHop.data(), overlap, hop * sizeof(float));
+    memmove(overlap, overlap + hop, (frameSize - hop) * sizeof(float));
+    std::fill(overlap + (frameSize - hop), overlap + frameSize, 0.0f);
 }
 
 void NoiseReduction::reset() {
-    std::fill(mBuffer.begin(), mBuffer.end(), 0.0f);
-    mIndex = 0;
-    mSum = 0.0f;
-}
\ No newline at end of file
+    std::fill(mInputFrame.begin(), mInputFrame.end(), 0.0f);
+    std::fill(mOverlap.begin(), mOverlap.end(), 0.0f);
+    std::fill(mOutputHop.begin(), mOutputHop.end(), 0.0f);
+    std::fill(mSmoothedPower.begin(), mSmoothedPower.end(), 0.0f);
+    std::fill(mNoisePower.begin(), mNoisePower.end(), 0.0f);
+    std::fill(mSubwindowMin.begin(), mSubwindowMin.end(), 0.0f);
+    std::fill(mMinHistory.begin(), mMinHistory.end(), 0.0f);
+    std::fill(mPrevCleanPower.begin(), mPrevCleanPower.end(), 0.0f);
+    mHopPosition = 0;
+    mFrameInSubwindow = 0;
+    mHistoryIndex = 0;
+    mSeedFrames = 2;
+}
@@ -3,27 +3,91 @@
 
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include "RealFFT.h"
 
-// Simple noise reduction using moving average smoothing
+/**
+ * Spectral noise suppression on a short-time Fourier transform.
+ *
+ * The signal is cut into sqrt-Hann windowed frames at 50% overlap (the frame
+ * is the smallest power of two covering 10 ms), and each frame's spectrum is
+ * scaled by a per-bin Wiener gain before overlap-add resynthesis. The noise
+ * power in each bin is tracked by minimum statistics: the minimum of the
+ * smoothed periodogram over the last ~1.5 s, so it follows stationary noise
+ * while speech comes and goes. The a priori SNR uses the decision-directed
+ * estimate, which keeps musical noise down.
+ *
+ * The output is delayed by getLatencyFrames() samples (one frame). All buffers
+ * are sized by the constructor and setSampleRate(); process() never allocates.
+ * setReductionAmount() neither allocates nor logs, and may be called from the
+ * audio thread between blocks.
+ */
 class NoiseReduction {
 public:
-    NoiseReduction(int smoothingWindow = 5);
+    // Strongest attenuation applied to a noise-only bin, at amount 1.0
+    static constexpr float kMaxAttenuationDb = 30.0f;
 
-    // Set noise reduction strength (0.0 to 1.0)
+    explicit NoiseReduction(int sampleRate = 48000);
+
+    // Resizes the frame for a new sample rate and clears the state. Allocates;
+    // don't call while the stream is running.
+    void setSampleRate(int sampleRate);
+
+    // Set noise reduction strength (0.0 to 1.0): how far noise-only bins may be
+    // attenuated, from nothing up to kMaxAttenuationDb
     void setReductionAmount(float amount);
 
     // Process a single sample
     float process(float input);
 
+    // Process a block of samples; in and out may point to the same buffer
+    void process(const float *in, float *out, int32_t numSamples);
+
     // Reset state
     void reset();
 
+    int getFrameSize() const { return mFrameSize; }
+    int getHopSize() const { return mHopSize; }
+
+    // Delay between a sample going in and its processed version coming out
+    int getLatencyFrames() const { return mFrameSize; }
+
+    // Samples after which both the STFT frame grid and the noise tracker's
+    // subwindow boundaries repeat
+    int getPeriodFrames() const { return mHopSize * mSubwindowFrames; }
+
 private:
-    std::vector<float> mBuffer;
-    int mWindowSize;
-    int mIndex;
-    float mReductionAmount;
-    float mSum;
+    // Runs one STFT frame over mInputFrame and refills mOutputHop
+    void processFrame();
+
+    int mSampleRate = 0;
+    int mFrameSize = 0;
+    int mHopSize = 0;
+    int mNumBins = 0;
+
+    float mReductionAmount = 0.5f;
+    float mGainFloor = 1.0f;
+
+    RealFFT mFft;
+    std::vector<float> mWindow;       // sqrt-Hann, for analysis and synthesis
+    std::vector<float> mInputFrame;   // last mFrameSize input samples
+    std::vector<float> mOverlap;      // overlap-add accumulator
+    std::vector<float> mOutputHop;    // finished samples being played out
+    std::vector<float> mFrame;        // windowed frame / resynthesized frame
+    std::vector<float> mRe;
+    std::vector<float> mIm;
+    int mHopPosition = 0;
+
+    // Noise tracking, per bin
+    std::vector<float> mSmoothedPower;
+    std::vector<float> mNoisePower;
+    std::vector<float> mSubwindowMin;
+    std::vector<float> mMinHistory;   // kNumSubwindows x mNumBins past minima
+    std::vector<float> mPrevCleanPower;
+    int mSubwindowFrames = 1;
+    int mFrameInSubwindow = 0;
+    int mHistoryIndex = 0;
+    int mSeedFrames = 2;
 };
 
-#endif //OBOESAMPLE_NOISEREDUCTION_H
\ No newline at end of file
+#endif //OBOESAMPLE_NOISEREDUCTION_H
@@ -0,0 +1,68 @@
+#ifndef OBOESAMPLE_PARAMRAMP_H
+#define OBOESAMPLE_PARAMRAMP_H
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * A parameter that glides linearly to each new target over a fixed number of
+ * frames, for click-free automation. A new target taken mid-glide starts a
+ * fresh glide from wherever the value is.
+ *
+ * Glide in the domain the parameter is heard in (octaves for a frequency, dB
+ * for a gain) so sweeps sound even. Everything is inline and allocation free.
+ */
+class ParamRamp {
+public:
+    // How long a glide takes; 0 makes setTarget() jump
+    void setRampFrames(int32_t frames) { mRampFrames = std::max(0, frames); }
+
+    // Glides from the current value to target
+    void setTarget(float target) {
+        mTarget = target;
+        if (mRampFrames == 0 || target == mValue) {
+            jump(target);
+            return;
+        }
+        mRemaining = mRampFrames;
+        mStep = (target - mValue) / static_cast<float>(mRampFrames);
+    }
+
+    // Goes straight to value, ending any glide
+    void jump(float value) {
+        mValue = value;
+        mTarget = value;
+        mStep = 0.0f;
+        mRemaining = 0;
+    }
+
+    // Moves numFrames along the glide and returns the new value
+    float advance(int32_t numFrames) {
+        if (mRemaining > 0) {
+            if (numFrames >= mRemaining) {
+                mValue = mTarget;
+                mRemaining = 0;
+            } else {
+                mValue += mStep * static_cast<float>(numFrames);
+                mRemaining -= numFrames;
+            }
+        }
+        return mValue;
+    }
+
+    // Per-frame change while gliding, 0 otherwise
+    float getStep() const { return mRemaining > 0 ? mStep : 0.0f; }
+
+    bool isRamping() const { return mRemaining > 0; }
+    float getValue() const { return mValue; }
+    float getTarget() const { return mTarget; }
+
+private:
+    float mValue = 0.0f;
+    float mTarget = 0.0f;
+    float mStep = 0.0f;
+    int32_t mRemaining = 0;
+    int32_t mRampFrames = 0;
+};
+
+#endif //OBOESAMPLE_PARAMRAMP_H
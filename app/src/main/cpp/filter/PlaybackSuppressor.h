@@ -1,18 +1,32 @@
 #ifndef OBOESAMPLE_PLAYBACKSUPPRESSOR_H
 #define OBOESAMPLE_PLAYBACKSUPPRESSOR_H
 
-#include <vector>
-#include <cmath>
-#include <algorithm>
+#include <cstdint>
+#include "VoiceActivityDetector.h"
 
 /**
- * Aggressively suppresses music/playback audio by detecting
- * non-voice characteristics and attenuating them.
- * * Uses simple time-domain heuristics (Energy and Zero Crossing Rate)
- * to differentiate voice from sustained/stable playback.
+ * Suppresses music/playback audio by attenuating everything that stands out
+ * from the noise floor but isn't speech.
+ *
+ * A VoiceActivityDetector decides once per 10 ms frame. After each decision
+ * the gain heads for:
+ *  - 1 while the detector says speech (hangover included);
+ *  - 1 - aggressiveness when the frame was active but not speech;
+ *  - wherever it was going, for frames down at the noise floor, so quiet
+ *    gaps in playback don't let it back in.
+ * The gain follows its target sample by sample with a one-pole envelope: it
+ * comes down over kReleaseMs, so a missed syllable isn't chopped, and goes
+ * back up within kAttackMs when speech starts. A decision applies from the
+ * frame after the one it was made on.
+ *
+ * The constructor allocates; nothing else does. setAggressiveness(),
+ * process() and reset() don't log either and are safe on the audio thread.
  */
 class PlaybackSuppressor {
 public:
+    static constexpr float kAttackMs = 5.0f;
+    static constexpr float kReleaseMs = 50.0f;
+
     PlaybackSuppressor(int sampleRate);
 
     // Enable/disable the suppression filter
@@ -24,30 +38,39 @@ public:
     // Process a single sample
     float process(float input);
 
+    // Process a block of samples; in and out may point to the same buffer
+    void process(const float *in, float *out, int32_t numSamples);
+
     // Reset all internal state buffers
     void reset();
 
-private:
-    int mSampleRate;
-    bool mEnabled;
-    float mAggressiveness;
+    // Samples per analysis window; the gain decision is made once per window
+    int getWindowSize() const { return mDetector.getFrameSize(); }
 
-    // --- State for Energy and Zero Crossing Rate (ZCR) Analysis ---
+    // The decisions the gain follows; while enabled they are made even at
+    // aggressiveness 0
+    const VoiceActivityDetector &getDetector() const { return mDetector; }
+
+    // Where the gain envelope is
+    float getGain() const { return mGain; }
+
+private:
+    // Sets the gain's target from the detector's latest decision
+    void decide();
 
-    // Buffer to hold squared amplitude (energy) of recent samples
-    std::vector<float> mEnergyHistory;
-    int mHistoryIndex;
-    float mEnergySum;
+    // Applies the gain envelope to numSamples samples
+    void applyGain(const float *in, float *out, int32_t numSamples);
 
-    // State for ZCR calculation
-    float mPrevInput;
-    int mZeroCrossingCount;
+    VoiceActivityDetector mDetector;
+    bool mEnabled = false;
+    float mAggressiveness = 0.0f;
 
-    // Previous ZCR value for potential stabilization logic
-    float mPrevZeroCrossing;
+    // Envelope coefficients, per sample
+    float mAttackCoeff = 0.0f;
+    float mReleaseCoeff = 0.0f;
 
-    // Threshold for energy detection
-    float mVoiceThreshold;
+    float mGain = 1.0f;
+    float mTargetGain = 1.0f;
 };
 
-#endif //OBOESAMPLE_PLAYBACKSUPPRESSOR_H
\ No newline at end of file
+#endif //OBOESAMPLE_PLAYBACKSUPPRESSOR_H
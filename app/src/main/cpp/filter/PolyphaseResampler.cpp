@@ -0,0 +1,199 @@
+#include "PolyphaseResampler.h"
+#include "SampleConversion.h"
+#include "SimdFloat4.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#define LOG_TAG "PolyphaseResampler"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+using simd::float4;
+
+constexpr int kLanes = 4;
+
+// Kaiser beta and taps per phase (at 1:1) for ~80 dB stopband across a
+// transition of 0.1 of the lower rate, centred on its Nyquist frequency
+constexpr double kKaiserBeta = 8.0;
+constexpr double kTapsPerPhase = 52.0;
+
+// Zeroth-order modified Bessel function of the first kind
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    const double halfX = x / 2.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+bool PolyphaseResampler::configure(int32_t inputRate, int32_t outputRate, int32_t channelCount,
+                                   int32_t maxInputFrames) {
+    if (inputRate <= 0 || outputRate <= 0) {
+        LOGE("Invalid rates %d -> %d", inputRate, outputRate);
+        return false;
+    }
+    const int32_t divisor = std::gcd(inputRate, outputRate);
+    const int32_t interpolation = outputRate / divisor;
+    const int32_t decimation = inputRate / divisor;
+    if (interpolation > kMaxPhases) {
+        LOGE("%d -> %d needs %d phases, at most %d supported", inputRate, outputRate,
+             interpolation, kMaxPhases);
+        return false;
+    }
+
+    mInputRate = inputRate;
+    mOutputRate = outputRate;
+    mChannelCount = std::max(1, channelCount);
+    mMaxInputFrames = std::max(1, maxInputFrames);
+    mInterpolation = interpolation;
+    mDecimation = decimation;
+
+    if (inputRate == outputRate) {
+        // A single unit tap: copies the input through
+        mTapsPerPhase = 0;
+        mCoefficients.clear();
+        mPlanes.clear();
+        mPlaneStride = 0;
+        reset();
+        return true;
+    }
+
+    // Longer when decimating: the transition band is fixed relative to the
+    // output rate, not the input rate
+    const double ratio = std::max(1.0, static_cast<double>(decimation) / interpolation);
+    const auto taps = static_cast<int32_t>(std::ceil(kTapsPerPhase * ratio));
+    mTapsPerPhase = (taps + 2 * kLanes - 1) / (2 * kLanes) * (2 * kLanes);
+
+    // Prototype lowpass at interpolation * inputRate
+    const int32_t length = mTapsPerPhase * interpolation;
+    const double prototypeRate = static_cast<double>(interpolation) * inputRate;
+    const double cutoff = 0.5 * std::min(inputRate, outputRate) / prototypeRate;
+    const double centre = (length - 1) / 2.0;
+    const double windowNorm = besselI0(kKaiserBeta);
+    std::vector<double> prototype(length);
+    double sum = 0.0;
+    for (int32_t k = 0; k < length; k++) {
+        const double t = k - centre;
+        const double x = 2.0 * M_PI * cutoff * t;
+        const double sinc = t == 0.0 ? 1.0 : std::sin(x) / x;
+        const double r = t / centre;
+        const double window = besselI0(kKaiserBeta * std::sqrt(std::max(0.0, 1.0 - r * r)))
+                              / windowNorm;
+        prototype[k] = 2.0 * cutoff * sinc * window;
+        sum += prototype[k];
+    }
+
+    // Each phase sees one in interpolation prototype taps, so unity gain
+    // needs the prototype to sum to interpolation
+    const double scale = interpolation / sum;
+    mCoefficients.assign(static_cast<size_t>(length), 0.0f);
+    for (int32_t p = 0; p < interpolation; p++) {
+        float *phase = mCoefficients.data() + static_cast<size_t>(p) * mTapsPerPhase;
+        for (int32_t j = 0; j < mTapsPerPhase; j++) {
+            phase[mTapsPerPhase - 1 - j] =
+                    static_cast<float>(prototype[j * interpolation + p] * scale);
+        }
+    }
+
+    mPlaneStride = mTapsPerPhase - 1 + mMaxInputFrames;
+    mPlanes.assign(static_cast<size_t>(mPlaneStride) * mChannelCount, 0.0f);
+    reset();
+
+    LOGD("%d -> %d Hz (%d/%d), %d taps per phase, %d channels", inputRate, outputRate,
+         interpolation, decimation, mTapsPerPhase, mChannelCount);
+    return true;
+}
+
+void PolyphaseResampler::reset() {
+    std::fill(mPlanes.begin(), mPlanes.end(), 0.0f);
+    mInputOffset = mTapsPerPhase > 0 ? -(mTapsPerPhase - 1) : 0;
+    mPhase = 0;
+}
+
+int32_t PolyphaseResampler::getMaxOutputFrames(int32_t numInputFrames) const {
+    if (mTapsPerPhase == 0) {
+        return numInputFrames;
+    }
+    const int64_t scaled = static_cast<int64_t>(numInputFrames) * mInterpolation;
+    return static_cast<int32_t>((scaled + mDecimation - 1) / mDecimation) + 1;
+}
+
+int32_t PolyphaseResampler::getInputFramesNeeded(int32_t numOutputFrames) const {
+    if (numOutputFrames <= 0) {
+        return 0;
+    }
+    if (mTapsPerPhase == 0) {
+        return numOutputFrames;
+    }
+    // Window start of the last output wanted, which has to fit in the block
+    const int64_t advance =
+            (mPhase + static_cast<int64_t>(numOutputFrames - 1) * mDecimation) / mInterpolation;
+    const int64_t needed = mInputOffset + advance + mTapsPerPhase;
+    return static_cast<int32_t>(std::max<int64_t>(0, needed));
+}
+
+double PolyphaseResampler::getDelayFrames() const {
+    if (mTapsPerPhase == 0) {
+        return 0.0;
+    }
+    return (static_cast<double>(mTapsPerPhase) * mInterpolation - 1.0)
+           / (2.0 * mInterpolation);
+}
+
+int32_t PolyphaseResampler::process(const float *in, int32_t numInputFrames, float *out) {
+    if (mTapsPerPhase == 0) {
+        memcpy(out, in, sizeof(float) * numInputFrames * mChannelCount);
+        return numInputFrames;
+    }
+
+    const int32_t taps = mTapsPerPhase;
+    const int32_t history = taps - 1;
+    int32_t written = 0;
+
+    for (int32_t start = 0; start < numInputFrames; start += mMaxInputFrames) {
+        const int32_t numFrames = std::min(mMaxInputFrames, numInputFrames - start);
+        deinterleave(in + static_cast<size_t>(start) * mChannelCount, mPlanes.data() + history,
+                     mChannelCount, numFrames, mPlaneStride);
+
+        while (mInputOffset + taps <= numFrames) {
+            const float *coefficients =
+                    mCoefficients.data() + static_cast<size_t>(mPhase) * taps;
+            float *frame = out + static_cast<size_t>(written) * mChannelCount;
+            for (int32_t c = 0; c < mChannelCount; c++) {
+                const float *window = mPlanes.data() + static_cast<size_t>(c) * mPlaneStride
+                                      + history + mInputOffset;
+                float4 acc0 = simd::zero();
+                float4 acc1 = simd::zero();
+                for (int32_t j = 0; j < taps; j += 2 * kLanes) {
+                    acc0 = simd::madd(acc0, simd::load(window + j),
+                                      simd::load(coefficients + j));
+                    acc1 = simd::madd(acc1, simd::load(window + j + kLanes),
+                                      simd::load(coefficients + j + kLanes));
+                }
+                frame[c] = simd::horizontalSum(simd::add(acc0, acc1));
+            }
+            written++;
+
+            mPhase += mDecimation;
+            mInputOffset += mPhase / mInterpolation;
+            mPhase %= mInterpolation;
+        }
+
+        // Keep the last taps - 1 frames as the next block's history
+        for (int32_t c = 0; c < mChannelCount; c++) {
+            float *plane = mPlanes.data() + static_cast<size_t>(c) * mPlaneStride;
+            memmove(plane, plane + numFrames, sizeof(float) * history);
+        }
+        mInputOffset -= numFrames;
+    }
+    return written;
+}
@@ -0,0 +1,83 @@
+#ifndef OBOESAMPLE_POLYPHASERESAMPLER_H
+#define OBOESAMPLE_POLYPHASERESAMPLER_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Sample-rate converter for any rational ratio, e.g. storing 48 kHz capture
+ * at 16 kHz or playing a 16 kHz file on a 48 kHz device.
+ *
+ * The ratio is reduced to L/M (output/input). A Kaiser-windowed sinc lowpass,
+ * designed at L times the input rate with its cutoff (-6 dB) at the Nyquist
+ * frequency of the lower of the two rates and a transition band 0.1 of that
+ * rate wide around it, is split into L phases of getTapsPerPhase() taps each.
+ * Every output sample is one phase's dot product with the most recent input,
+ * 8 taps per step (4-lane SIMD, two accumulators). The filter gets longer as
+ * the ratio goes down, so the transition band stays the same width relative
+ * to the output rate. Stopband is ~80 dB from 0.55 of the lower rate, so
+ * the top of the transition band, just above Nyquist, aliases attenuated.
+ *
+ * State is kept per channel, and the output doesn't depend on how the input
+ * is split into blocks. configure() allocates; process() never does.
+ */
+class PolyphaseResampler {
+public:
+    // Largest L supported; covers 44.1 <-> 48 kHz (160/147)
+    static constexpr int32_t kMaxPhases = 1024;
+
+    PolyphaseResampler() = default;
+
+    // Designs the filter for inputRate -> outputRate and sizes the state for
+    // blocks of up to maxInputFrames. Returns false if the reduced ratio needs
+    // more than kMaxPhases phases. Allocates.
+    bool configure(int32_t inputRate, int32_t outputRate, int32_t channelCount,
+                   int32_t maxInputFrames);
+
+    // Resamples numInputFrames (at most the configured maximum) interleaved
+    // frames into out and returns how many frames it wrote, at most
+    // getMaxOutputFrames(numInputFrames).
+    int32_t process(const float *in, int32_t numInputFrames, float *out);
+
+    // Input frames the next process() call needs to produce exactly
+    // numOutputFrames, for pulling a fixed number of frames (playback)
+    int32_t getInputFramesNeeded(int32_t numOutputFrames) const;
+
+    int32_t getMaxOutputFrames(int32_t numInputFrames) const;
+
+    // Clears the history
+    void reset();
+
+    int32_t getInputRate() const { return mInputRate; }
+    int32_t getOutputRate() const { return mOutputRate; }
+    int32_t getTapsPerPhase() const { return mTapsPerPhase; }
+    int32_t getMaxInputFrames() const { return mMaxInputFrames; }
+
+    // Filter delay in input frames
+    double getDelayFrames() const;
+
+private:
+    int32_t mInputRate = 0;
+    int32_t mOutputRate = 0;
+    int32_t mChannelCount = 1;
+    int32_t mMaxInputFrames = 0;
+
+    int32_t mInterpolation = 1;  // L
+    int32_t mDecimation = 1;     // M
+    int32_t mTapsPerPhase = 0;   // N, a multiple of 8
+
+    // Phase p's taps in mCoefficients[p * N ...], reversed so they line up
+    // with the input oldest first
+    std::vector<float> mCoefficients;
+
+    // Per channel, at c * mPlaneStride: N - 1 frames of history, then the block
+    std::vector<float> mPlanes;
+    int32_t mPlaneStride = 0;
+
+    // First input frame of the next output's window, relative to the start of
+    // the next block (negative: still in the history), and its phase
+    int32_t mInputOffset = 0;
+    int32_t mPhase = 0;
+};
+
+#endif //OBOESAMPLE_POLYPHASERESAMPLER_H
@@ -0,0 +1,130 @@
+#include "RealFFT.h"
+#include <cmath>
+
+void RealFFT::init(int size) {
+    int n = 4;
+    while (n < size) {
+        n <<= 1;
+    }
+    mSize = n;
+    mHalf = n / 2;
+
+    int bits = 0;
+    while ((1 << bits) < mHalf) {
+        bits++;
+    }
+    mBitReverse.resize(mHalf);
+    for (int i = 0; i < mHalf; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        mBitReverse[i] = r;
+    }
+
+    // One table of N-th roots serves both the N/2-point butterflies (every
+    // other entry) and the real-spectrum split
+    mCos.resize(mHalf);
+    mSin.resize(mHalf);
+    for (int k = 0; k < mHalf; k++) {
+        double phase = 2.0 * M_PI * k / n;
+        mCos[k] = static_cast<float>(std::cos(phase));
+        mSin[k] = static_cast<float>(std::sin(phase));
+    }
+
+    mWorkRe.assign(mHalf, 0.0f);
+    mWorkIm.assign(mHalf, 0.0f);
+}
+
+void RealFFT::complexTransform() {
+    float *re = mWorkRe.data();
+    float *im = mWorkIm.data();
+    const float *cosTable = mCos.data();
+    const float *sinTable = mSin.data();
+    const int half = mHalf;
+
+    for (int len = 2; len <= half; len <<= 1) {
+        const int span = len / 2;
+        const int step = mSize / len;
+        for (int start = 0; start < half; start += len) {
+            for (int j = 0; j < span; j++) {
+                // w = exp(-2*pi*i*j/len)
+                float wr = cosTable[j * step];
+                float wi = -sinTable[j * step];
+                int a = start + j;
+                int b = a + span;
+                float tr = wr * re[b] - wi * im[b];
+                float ti = wr * im[b] + wi * re[b];
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+void RealFFT::forward(const float *input, float *re, float *im) {
+    const int half = mHalf;
+    float *zr = mWorkRe.data();
+    float *zi = mWorkIm.data();
+
+    // Pack even/odd samples as one complex sequence, in bit-reversed order
+    for (int n = 0; n < half; n++) {
+        int r = mBitReverse[n];
+        zr[r] = input[2 * n];
+        zi[r] = input[2 * n + 1];
+    }
+    complexTransform();
+
+    re[0] = zr[0] + zi[0];
+    im[0] = 0.0f;
+    re[half] = zr[0] - zi[0];
+    im[half] = 0.0f;
+
+    // Split Z into the spectra of the even (Fe) and odd (Fo) samples and
+    // recombine: X[k] = Fe[k] + exp(-2*pi*i*k/N) * Fo[k]
+    for (int k = 1; k < half; k++) {
+        float ar = zr[k], ai = zi[k];
+        float br = zr[half - k], bi = -zi[half - k];
+        float feRe = 0.5f * (ar + br);
+        float feIm = 0.5f * (ai + bi);
+        float foRe = 0.5f * (ai - bi);
+        float foIm = -0.5f * (ar - br);
+        float c = mCos[k], s = mSin[k];
+        re[k] = feRe + c * foRe + s * foIm;
+        im[k] = feIm + c * foIm - s * foRe;
+    }
+}
+
+void RealFFT::inverse(const float *re, const float *im, float *output) {
+    const int half = mHalf;
+    float *zr = mWorkRe.data();
+    float *zi = mWorkIm.data();
+
+    // Rebuild Z[k] = Fe[k] + i * Fo[k] and store its conjugate bit-reversed, so
+    // the forward butterflies compute the inverse transform
+    zr[mBitReverse[0]] = 0.5f * (re[0] + re[half]);
+    zi[mBitReverse[0]] = -0.5f * (re[0] - re[half]);
+    for (int k = 1; k < half; k++) {
+        float ar = re[k], ai = im[k];
+        float br = re[half - k], bi = -im[half - k];
+        float feRe = 0.5f * (ar + br);
+        float feIm = 0.5f * (ai + bi);
+        float dr = 0.5f * (ar - br);
+        float di = 0.5f * (ai - bi);
+        float c = mCos[k], s = mSin[k];
+        float foRe = c * dr - s * di;
+        float foIm = c * di + s * dr;
+        int r = mBitReverse[k];
+        zr[r] = feRe - foIm;
+        zi[r] = -(feIm + foRe);
+    }
+    complexTransform();
+
+    const float scale = 1.0f / static_cast<float>(half);
+    for (int n = 0; n < half; n++) {
+        output[2 * n] = zr[n] * scale;
+        output[2 * n + 1] = -zi[n] * scale;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef OBOESAMPLE_REALFFT_H
+#define OBOESAMPLE_REALFFT_H
+
+#include <vector>
+
+/**
+ * Real-input FFT of a fixed power-of-two size N.
+ *
+ * The N real samples are packed into an N/2-point complex FFT (even samples in
+ * the real part, odd samples in the imaginary part) and the two interleaved
+ * spectra are separated afterwards, so a real transform costs about half a
+ * complex one. All tables and work buffers are built by init(); forward() and
+ * inverse() never allocate and are safe to call from the audio callback.
+ *
+ * The spectrum is returned as N/2 + 1 bins in split real/imaginary arrays.
+ */
+class RealFFT {
+public:
+    RealFFT() = default;
+    explicit RealFFT(int size) { init(size); }
+
+    // Builds the tables for an N-point transform (N rounded up to a power of
+    // two, at least 4). Allocates; don't call from the audio callback.
+    void init(int size);
+
+    int getSize() const { return mSize; }
+    int getNumBins() const { return mSize / 2 + 1; }
+
+    // input: N samples -> re, im: N/2 + 1 bins each
+    void forward(const float *input, float *re, float *im);
+
+    // re, im: N/2 + 1 bins -> output: N samples, scaled so inverse(forward(x)) == x.
+    // The imaginary parts of the DC and Nyquist bins are ignored.
+    void inverse(const float *re, const float *im, float *output);
+
+private:
+    // In-place N/2-point complex FFT of mWorkRe/mWorkIm (forward direction)
+    void complexTransform();
+
+    int mSize = 0;
+    int mHalf = 0;
+
+    std::vector<int> mBitReverse;   // N/2 entries
+    std::vector<float> mCos;        // cos(2*pi*k/N), k < N/2
+    std::vector<float> mSin;        // sin(2*pi*k/N), k < N/2
+    std::vector<float> mWorkRe;
+    std::vector<float> mWorkIm;
+};
+
+#endif //OBOESAMPLE_REALFFT_H
@@ -0,0 +1,176 @@
+#include "SampleConversion.h"
+#include "SimdFloat4.h"
+#include <algorithm>
+
+using simd::float4;
+
+static inline float clampUnit(float x) {
+    return std::max(-1.0f, std::min(1.0f, x));
+}
+
+void convertInt16ToFloat(const int16_t *in, float *out, int32_t numSamples, float gain) {
+    const float scale = gain / 32768.0f;
+    int32_t i = 0;
+
+#if defined(OBOESAMPLE_SIMD_NEON) || defined(OBOESAMPLE_SIMD_SSE)
+    const float4 vScale = simd::set1(scale);
+    const float4 lo = simd::set1(-1.0f);
+    const float4 hi = simd::set1(1.0f);
+    for (; i + 8 <= numSamples; i += 8) {
+#if defined(OBOESAMPLE_SIMD_NEON)
+        int16x8_t x = vld1q_s16(in + i);
+        float4 a = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+        float4 b = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+#else
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        // Sign-extend by placing each int16 in the top half of an int32
+        float4 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+        float4 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+#endif
+        simd::store(out + i, simd::max(simd::min(simd::mul(a, vScale), hi), lo));
+        simd::store(out + i + 4, simd::max(simd::min(simd::mul(b, vScale), hi), lo));
+    }
+#endif
+
+    for (; i < numSamples; i++) {
+        out[i] = clampUnit(static_cast<float>(in[i]) * scale);
+    }
+}
+
+void convertFloatToInt16(const float *in, int16_t *out, int32_t numSamples) {
+    int32_t i = 0;
+
+#if defined(OBOESAMPLE_SIMD_NEON) || defined(OBOESAMPLE_SIMD_SSE)
+    const float4 scale = simd::set1(32767.0f);
+    const float4 lo = simd::set1(-1.0f);
+    const float4 hi = simd::set1(1.0f);
+    for (; i + 8 <= numSamples; i += 8) {
+        float4 a = simd::mul(simd::max(simd::min(simd::load(in + i), hi), lo), scale);
+        float4 b = simd::mul(simd::max(simd::min(simd::load(in + i + 4), hi), lo), scale);
+#if defined(OBOESAMPLE_SIMD_NEON)
+        int16x8_t x = vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b)));
+        vst1q_s16(out + i, x);
+#else
+        __m128i x = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), x);
+#endif
+    }
+#endif
+
+    for (; i < numSamples; i++) {
+        out[i] = static_cast<int16_t>(clampUnit(in[i]) * 32767.0f);
+    }
+}
+
+void scaleAndClamp(const float *in, float *out, int32_t numSamples, float gain) {
+    const float4 vGain = simd::set1(gain);
+    const float4 lo = simd::set1(-1.0f);
+    const float4 hi = simd::set1(1.0f);
+    int32_t i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        simd::store(out + i, simd::max(simd::min(simd::mul(simd::load(in + i), vGain), hi), lo));
+    }
+    for (; i < numSamples; i++) {
+        out[i] = clampUnit(in[i] * gain);
+    }
+}
+
+void deinterleave(const float *in, float *out, int32_t channelCount, int32_t numFrames,
+                  int32_t planeStride) {
+    int32_t i = 0;
+
+#if defined(OBOESAMPLE_SIMD_NEON) || defined(OBOESAMPLE_SIMD_SSE)
+    if (channelCount == 2) {
+        float *left = out;
+        float *right = out + planeStride;
+        for (; i + 4 <= numFrames; i += 4) {
+#if defined(OBOESAMPLE_SIMD_NEON)
+            float32x4x2_t x = vld2q_f32(in + i * 2);
+            simd::store(left + i, x.val[0]);
+            simd::store(right + i, x.val[1]);
+#else
+            float4 a = simd::load(in + i * 2);
+            float4 b = simd::load(in + i * 2 + 4);
+            simd::store(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            simd::store(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+#endif
+        }
+    } else if (channelCount == 4) {
+        for (; i + 4 <= numFrames; i += 4) {
+#if defined(OBOESAMPLE_SIMD_NEON)
+            float32x4x4_t x = vld4q_f32(in + i * 4);
+            for (int c = 0; c < 4; c++) {
+                simd::store(out + c * planeStride + i, x.val[c]);
+            }
+#else
+            float4 r0 = simd::load(in + i * 4);
+            float4 r1 = simd::load(in + i * 4 + 4);
+            float4 r2 = simd::load(in + i * 4 + 8);
+            float4 r3 = simd::load(in + i * 4 + 12);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            simd::store(out + i, r0);
+            simd::store(out + planeStride + i, r1);
+            simd::store(out + 2 * planeStride + i, r2);
+            simd::store(out + 3 * planeStride + i, r3);
+#endif
+        }
+    }
+#endif
+
+    for (int32_t c = 0; c < channelCount; c++) {
+        float *plane = out + static_cast<size_t>(c) * planeStride;
+        for (int32_t j = i; j < numFrames; j++) {
+            plane[j] = in[static_cast<size_t>(j) * channelCount + c];
+        }
+    }
+}
+
+void interleave(const float *in, float *out, int32_t channelCount, int32_t numFrames,
+                int32_t planeStride) {
+    int32_t i = 0;
+
+#if defined(OBOESAMPLE_SIMD_NEON) || defined(OBOESAMPLE_SIMD_SSE)
+    if (channelCount == 2) {
+        const float *left = in;
+        const float *right = in + planeStride;
+        for (; i + 4 <= numFrames; i += 4) {
+#if defined(OBOESAMPLE_SIMD_NEON)
+            float32x4x2_t x = {{simd::load(left + i), simd::load(right + i)}};
+            vst2q_f32(out + i * 2, x);
+#else
+            float4 l = simd::load(left + i);
+            float4 r = simd::load(right + i);
+            simd::store(out + i * 2, _mm_unpacklo_ps(l, r));
+            simd::store(out + i * 2 + 4, _mm_unpackhi_ps(l, r));
+#endif
+        }
+    } else if (channelCount == 4) {
+        for (; i + 4 <= numFrames; i += 4) {
+#if defined(OBOESAMPLE_SIMD_NEON)
+            float32x4x4_t x;
+            for (int c = 0; c < 4; c++) {
+                x.val[c] = simd::load(in + c * planeStride + i);
+            }
+            vst4q_f32(out + i * 4, x);
+#else
+            float4 r0 = simd::load(in + i);
+            float4 r1 = simd::load(in + planeStride + i);
+            float4 r2 = simd::load(in + 2 * planeStride + i);
+            float4 r3 = simd::load(in + 3 * planeStride + i);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            simd::store(out + i * 4, r0);
+            simd::store(out + i * 4 + 4, r1);
+            simd::store(out + i * 4 + 8, r2);
+            simd::store(out + i * 4 + 12, r3);
+#endif
+        }
+    }
+#endif
+
+    for (int32_t c = 0; c < channelCount; c++) {
+        const float *plane = in + static_cast<size_t>(c) * planeStride;
+        for (int32_t j = i; j < numFrames; j++) {
+            out[static_cast<size_t>(j) * channelCount + c] = plane[j];
+        }
+    }
+}
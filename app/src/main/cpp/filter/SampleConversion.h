@@ -0,0 +1,34 @@
+#ifndef OBOESAMPLE_SAMPLECONVERSION_H
+#define OBOESAMPLE_SAMPLECONVERSION_H
+
+#include <cstdint>
+
+/**
+ * Sample format and layout conversion kernels for the recorder.
+ *
+ * All of them saturate: floats are clamped to [-1, 1] and int16 output never
+ * wraps. The int16 <-> float pair uses the same scaling as the scalar code it
+ * replaces (in / 32768 going in, out * 32767 truncated coming out), so the two
+ * paths produce identical samples. NEON on ARM, SSE2 on x86, 8 samples per
+ * step with a scalar tail.
+ */
+
+// out = clamp(in / 32768 * gain, -1, 1)
+void convertInt16ToFloat(const int16_t *in, float *out, int32_t numSamples, float gain = 1.0f);
+
+// out = int16(clamp(in, -1, 1) * 32767), truncated toward zero
+void convertFloatToInt16(const float *in, int16_t *out, int32_t numSamples);
+
+// out = clamp(in * gain, -1, 1). in and out may point to the same buffer.
+void scaleAndClamp(const float *in, float *out, int32_t numSamples, float gain = 1.0f);
+
+// Splits numFrames interleaved frames into one plane per channel: channel c
+// goes to out + c * planeStride. Stereo and 4-channel use SIMD shuffles.
+void deinterleave(const float *in, float *out, int32_t channelCount, int32_t numFrames,
+                  int32_t planeStride);
+
+// Inverse of deinterleave()
+void interleave(const float *in, float *out, int32_t channelCount, int32_t numFrames,
+                int32_t planeStride);
+
+#endif //OBOESAMPLE_SAMPLECONVERSION_H
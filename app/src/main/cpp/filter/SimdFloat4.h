@@ -0,0 +1,180 @@
+#ifndef OBOESAMPLE_SIMDFLOAT4_H
+#define OBOESAMPLE_SIMDFLOAT4_H
+
+/**
+ * Minimal 4-lane float vector abstraction shared by the DSP kernels.
+ *
+ * Maps to NEON on ARM (armeabi-v7a with NEON, arm64-v8a), SSE2 on x86/x86_64,
+ * and a plain struct elsewhere. Only the handful of operations the kernels
+ * actually need are provided.
+ */
+
+#include <cstdint>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OBOESAMPLE_SIMD_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OBOESAMPLE_SIMD_SSE 1
+#endif
+
+namespace simd {
+
+#if defined(OBOESAMPLE_SIMD_NEON)
+
+typedef float32x4_t float4;
+
+inline float4 load(const float *p) { return vld1q_f32(p); }
+inline void store(float *p, float4 v) { vst1q_f32(p, v); }
+inline float4 set1(float x) { return vdupq_n_f32(x); }
+inline float4 zero() { return vdupq_n_f32(0.0f); }
+inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+inline float4 sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+inline float4 min(float4 a, float4 b) { return vminq_f32(a, b); }
+inline float4 max(float4 a, float4 b) { return vmaxq_f32(a, b); }
+inline float4 abs(float4 a) { return vabsq_f32(a); }
+
+// All-ones lanes where a > b, for select()
+inline float4 greaterThan(float4 a, float4 b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+
+// Lanes of a where mask is set, b elsewhere
+inline float4 select(float4 mask, float4 a, float4 b) {
+    return vbslq_f32(vreinterpretq_u32_f32(mask), a, b);
+}
+
+// a + b * c
+inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(a, b, c); }
+
+// a - b * c
+inline float4 msub(float4 a, float4 b, float4 c) { return vmlsq_f32(a, b, c); }
+
+// Shifts v up one lane and inserts x in lane 0: {x, v0, v1, v2}
+inline float4 shiftIn(float4 v, float x) { return vextq_f32(vdupq_n_f32(x), v, 3); }
+
+inline float lane3(float4 v) { return vgetq_lane_f32(v, 3); }
+
+inline float horizontalMax(float4 v) {
+#if defined(__aarch64__)
+    return vmaxvq_f32(v);
+#else
+    float32x2_t m = vmax_f32(vget_low_f32(v), vget_high_f32(v));
+    m = vpmax_f32(m, m);
+    return vget_lane_f32(m, 0);
+#endif
+}
+
+inline float horizontalSum(float4 v) {
+#if defined(__aarch64__)
+    return vaddvq_f32(v);
+#else
+    float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    s = vpadd_f32(s, s);
+    return vget_lane_f32(s, 0);
+#endif
+}
+
+#elif defined(OBOESAMPLE_SIMD_SSE)
+
+typedef __m128 float4;
+
+inline float4 load(const float *p) { return _mm_loadu_ps(p); }
+inline void store(float *p, float4 v) { _mm_storeu_ps(p, v); }
+inline float4 set1(float x) { return _mm_set1_ps(x); }
+inline float4 zero() { return _mm_setzero_ps(); }
+inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+inline float4 sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+inline float4 min(float4 a, float4 b) { return _mm_min_ps(a, b); }
+inline float4 max(float4 a, float4 b) { return _mm_max_ps(a, b); }
+inline float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+// All-ones lanes where a > b, for select()
+inline float4 greaterThan(float4 a, float4 b) { return _mm_cmpgt_ps(a, b); }
+
+// Lanes of a where mask is set, b elsewhere
+inline float4 select(float4 mask, float4 a, float4 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// a + b * c
+inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+
+// a - b * c
+inline float4 msub(float4 a, float4 b, float4 c) { return _mm_sub_ps(a, _mm_mul_ps(b, c)); }
+
+// Shifts v up one lane and inserts x in lane 0: {x, v0, v1, v2}
+inline float4 shiftIn(float4 v, float x) {
+    return _mm_move_ss(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 1, 0, 0)), _mm_set_ss(x));
+}
+
+inline float lane3(float4 v) {
+    return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+
+inline float horizontalMax(float4 v) {
+    float4 m = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(m);
+}
+
+inline float horizontalSum(float4 v) {
+    float4 s = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(s);
+}
+
+#else
+
+struct float4 {
+    float v[4];
+};
+
+inline float4 load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store(float *p, float4 a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+inline float4 set1(float x) { return {{x, x, x, x}}; }
+inline float4 zero() { return set1(0.0f); }
+
+#define OBOESAMPLE_SIMD_BINARY(name, expr) \
+    inline float4 name(float4 a, float4 b) { \
+        float4 r; \
+        for (int i = 0; i < 4; i++) r.v[i] = (expr); \
+        return r; \
+    }
+OBOESAMPLE_SIMD_BINARY(add, a.v[i] + b.v[i])
+OBOESAMPLE_SIMD_BINARY(sub, a.v[i] - b.v[i])
+OBOESAMPLE_SIMD_BINARY(mul, a.v[i] * b.v[i])
+OBOESAMPLE_SIMD_BINARY(min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+OBOESAMPLE_SIMD_BINARY(max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+OBOESAMPLE_SIMD_BINARY(greaterThan, a.v[i] > b.v[i] ? 1.0f : 0.0f)
+#undef OBOESAMPLE_SIMD_BINARY
+
+inline float4 select(float4 mask, float4 a, float4 b) {
+    for (int i = 0; i < 4; i++) a.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i];
+    return a;
+}
+
+inline float4 abs(float4 a) {
+    for (int i = 0; i < 4; i++) a.v[i] = a.v[i] < 0.0f ? -a.v[i] : a.v[i];
+    return a;
+}
+
+inline float4 madd(float4 a, float4 b, float4 c) { return add(a, mul(b, c)); }
+inline float4 msub(float4 a, float4 b, float4 c) { return sub(a, mul(b, c)); }
+inline float4 shiftIn(float4 v, float x) { return {{x, v.v[0], v.v[1], v.v[2]}}; }
+inline float lane3(float4 v) { return v.v[3]; }
+
+inline float horizontalMax(float4 v) {
+    float m = v.v[0];
+    for (int i = 1; i < 4; i++) m = v.v[i] > m ? v.v[i] : m;
+    return m;
+}
+
+inline float horizontalSum(float4 v) { return (v.v[0] + v.v[2]) + (v.v[1] + v.v[3]); }
+
+#endif
+
+} // namespace simd
+
+#endif //OBOESAMPLE_SIMDFLOAT4_H
@@ -0,0 +1,145 @@
+#include "VoiceActivityDetector.h"
+#include "FastMath.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define LOG_TAG "VoiceActivityDetector"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+
+// Speech's range of each feature
+constexpr float kMinFlatness = 1e-3f;
+constexpr float kMaxFlatness = 0.35f;
+constexpr float kMinVoiceBandRatio = 0.6f;
+
+// Below this a frame is silence whatever the noise floor
+constexpr float kMinLevelDb = -65.0f;
+
+// Smoothing of the speech probability, per frame
+constexpr float kProbabilityCoeff = 0.2f;
+
+static float powerToDb(float power) {
+    return fastmath::log2(std::max(power, 1e-12f)) * (10.0f / fastmath::kLog2Of10);
+}
+
+VoiceActivityDetector::VoiceActivityDetector(int32_t sampleRate) {
+    sampleRate = std::max(1000, sampleRate);
+    mFrameSize = static_cast<int32_t>(sampleRate * kFrameMs / 1000.0f);
+
+    // The smallest power of two covering the frame, zero padded
+    int fftSize = 4;
+    while (fftSize < mFrameSize) fftSize *= 2;
+    mFft.init(fftSize);
+    mFrame.assign(static_cast<size_t>(fftSize), 0.0f);
+    mRe.resize(static_cast<size_t>(mFft.getNumBins()));
+    mIm.resize(static_cast<size_t>(mFft.getNumBins()));
+
+    mWindow.resize(static_cast<size_t>(mFrameSize));
+    for (int32_t n = 0; n < mFrameSize; n++) {
+        mWindow[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * n / mFrameSize));
+    }
+
+    const auto binOf = [&](float frequency) {
+        const float bin = frequency * static_cast<float>(fftSize) / static_cast<float>(sampleRate);
+        return std::min(mFft.getNumBins() - 1, static_cast<int32_t>(std::lround(bin)));
+    };
+    mBandFirst = std::max(1, binOf(100.0f));
+    mBandLast = binOf(8000.0f);
+    mVoiceFirst = binOf(300.0f);
+    mVoiceLast = binOf(3400.0f);
+
+    reset();
+    LOGD("VAD: %d-sample frames, %d-point FFT, bins %d..%d (voice %d..%d)", mFrameSize,
+         fftSize, mBandFirst, mBandLast, mVoiceFirst, mVoiceLast);
+}
+
+void VoiceActivityDetector::reset() {
+    std::fill(mFrame.begin(), mFrame.end(), 0.0f);
+    mFill = 0;
+    std::fill(mSubwindowMin, mSubwindowMin + kNoiseSubwindows, kInitialNoiseDb);
+    mSubwindow = 0;
+    mSubwindowFill = 0;
+    mCurrentMin = kInitialNoiseDb;
+    mFeatures = Features();
+    mPreviousCandidate = false;
+    mHangover = 0;
+    mProbability = 0.0f;
+    mFrameCount = 0;
+    mSpeechFrameCount = 0;
+}
+
+int32_t VoiceActivityDetector::process(const float *in, int32_t numSamples) {
+    int32_t frames = 0;
+    int32_t done = 0;
+    while (done < numSamples) {
+        const int32_t count = std::min(mFrameSize - mFill, numSamples - done);
+        memcpy(mFrame.data() + mFill, in + done, static_cast<size_t>(count) * sizeof(float));
+        mFill += count;
+        done += count;
+        if (mFill == mFrameSize) {
+            analyzeFrame();
+            mFill = 0;
+            frames++;
+        }
+    }
+    return frames;
+}
+
+void VoiceActivityDetector::analyzeFrame() {
+    float *frame = mFrame.data();
+    const float *window = mWindow.data();
+    float sumSquares = 0.0f;
+    for (int32_t n = 0; n < mFrameSize; n++) {
+        sumSquares += frame[n] * frame[n];
+        frame[n] *= window[n];
+    }
+    mFft.forward(frame, mRe.data(), mIm.data());
+
+    // Flatness and voice band share over the analysis band
+    float bandPower = 0.0f;
+    float voicePower = 0.0f;
+    float logSum = 0.0f;
+    for (int32_t k = mBandFirst; k <= mBandLast; k++) {
+        const float power = mRe[k] * mRe[k] + mIm[k] * mIm[k] + 1e-20f;
+        bandPower += power;
+        logSum += fastmath::log2(power);
+        if (k >= mVoiceFirst && k <= mVoiceLast) voicePower += power;
+    }
+    const auto numBins = static_cast<float>(mBandLast - mBandFirst + 1);
+    const float flatness = fastmath::exp2(logSum / numBins) / (bandPower / numBins);
+
+    // Minimum statistics: the floor is the lowest frame energy of the last
+    // kNoiseSubwindows subwindows, this one included
+    const float energyDb = powerToDb(sumSquares / static_cast<float>(mFrameSize));
+    mCurrentMin = std::min(mCurrentMin, energyDb);
+    float noiseDb = mCurrentMin;
+    for (float subwindowMin : mSubwindowMin) noiseDb = std::min(noiseDb, subwindowMin);
+    if (++mSubwindowFill == kNoiseSubwindowFrames) {
+        mSubwindowMin[mSubwindow] = mCurrentMin;
+        mSubwindow = (mSubwindow + 1) % kNoiseSubwindows;
+        mSubwindowFill = 0;
+        mCurrentMin = energyDb;
+    }
+
+    mFeatures.energyDb = energyDb;
+    mFeatures.noiseDb = noiseDb;
+    mFeatures.flatness = flatness;
+    mFeatures.voiceBandRatio = bandPower > 0.0f ? voicePower / bandPower : 0.0f;
+    mFeatures.tonal = energyDb > kMinLevelDb && flatness < kMinFlatness;
+
+    const bool candidate = energyDb > kMinLevelDb && energyDb - noiseDb >= kMinSnrDb &&
+                           flatness >= kMinFlatness && flatness <= kMaxFlatness &&
+                           mFeatures.voiceBandRatio >= kMinVoiceBandRatio;
+    mFeatures.voiced = candidate && mPreviousCandidate;
+    mPreviousCandidate = candidate;
+
+    if (mFeatures.voiced) {
+        mHangover = kHangoverFrames;
+    } else if (mHangover > 0) {
+        mHangover--;
+    }
+    mProbability += kProbabilityCoeff * ((mFeatures.voiced ? 1.0f : 0.0f) - mProbability);
+    mFrameCount++;
+    if (isSpeech()) mSpeechFrameCount++;
+}
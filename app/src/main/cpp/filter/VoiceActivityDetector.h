@@ -0,0 +1,112 @@
+#ifndef OBOESAMPLE_VOICEACTIVITYDETECTOR_H
+#define OBOESAMPLE_VOICEACTIVITYDETECTOR_H
+
+#include <cstdint>
+#include <vector>
+#include "RealFFT.h"
+
+/**
+ * Frame-based voice activity detector.
+ *
+ * The signal is cut into 10 ms frames and each frame gets one decision, from
+ * features of its Hann-windowed spectrum between 100 Hz and 8 kHz:
+ *  - energy, against a noise floor tracked by minimum statistics (the lowest
+ *    frame energy over the last ~1.6 s), so steady noise and steady playback
+ *    sink into the floor while speech, which pauses, stays above it;
+ *  - spectral flatness (geometric over arithmetic mean of the power), near 0
+ *    for tones and a sustained chord, high for noise, in between for speech;
+ *    an audible frame below speech's range is tonal;
+ *  - the share of the energy in the voice band, 300 Hz to 3.4 kHz.
+ * A frame is voiced when it stands kMinSnrDb above the floor, its flatness
+ * and voice band share are in speech's range, and so was the frame before it
+ * (a single voiced frame is usually a transient). The speech decision holds
+ * for kHangoverFrames after the last voiced frame, so word endings and the
+ * gaps between words stay in. getSpeechProbability() is the share of recent
+ * frames that were voiced, smoothed over ~50 ms.
+ *
+ * The constructor allocates; process() and reset() don't, and are safe on
+ * the audio thread.
+ */
+class VoiceActivityDetector {
+public:
+    static constexpr float kFrameMs = 10.0f;
+    static constexpr int32_t kHangoverFrames = 20;
+    static constexpr float kMinSnrDb = 9.0f;
+
+    // What a frame's decision was made from
+    struct Features {
+        float energyDb = -120.0f;    // mean square, dBFS
+        float noiseDb = -120.0f;     // the noise floor it was held against
+        float flatness = 0.0f;
+        float voiceBandRatio = 0.0f;
+        bool tonal = false;          // audible, and more tonal than speech ever is
+        bool voiced = false;
+    };
+
+    explicit VoiceActivityDetector(int32_t sampleRate);
+
+    // Analyzes numSamples more samples; returns how many frames they completed
+    int32_t process(const float *in, int32_t numSamples);
+
+    // Samples until the current frame is complete and decided
+    int32_t getSamplesToDecision() const { return mFrameSize - mFill; }
+
+    void reset();
+
+    int32_t getFrameSize() const { return mFrameSize; }
+
+    // The latest decision, hangover included
+    bool isSpeech() const { return mHangover > 0; }
+    float getSpeechProbability() const { return mProbability; }
+
+    // Whether the latest frame was anything but the noise floor: above it, or
+    // tonal, which sustained playback stays even once it has become the floor
+    bool isActive() const {
+        return mFeatures.tonal || mFeatures.energyDb - mFeatures.noiseDb >= kMinSnrDb;
+    }
+
+    const Features &getFeatures() const { return mFeatures; }
+
+    // Frames decided since the last reset(), and how many of them were speech
+    int64_t getFrameCount() const { return mFrameCount; }
+    int64_t getSpeechFrameCount() const { return mSpeechFrameCount; }
+
+private:
+    void analyzeFrame();
+
+    // Empty subwindows hold full scale, so until the ring has filled the floor
+    // is the quietest frame seen so far
+    static constexpr float kInitialNoiseDb = 0.0f;
+    static constexpr int32_t kNoiseSubwindows = 8;
+    static constexpr int32_t kNoiseSubwindowFrames = 20;
+
+    int32_t mFrameSize;
+    RealFFT mFft;
+    std::vector<float> mWindow;     // periodic Hann over the frame
+    std::vector<float> mFrame;      // the frame being filled, zero padded to the FFT size
+    std::vector<float> mRe;
+    std::vector<float> mIm;
+    int32_t mFill = 0;
+
+    // FFT bins of the analysis band [100 Hz, 8 kHz] and of the voice band
+    int32_t mBandFirst = 0;
+    int32_t mBandLast = 0;
+    int32_t mVoiceFirst = 0;
+    int32_t mVoiceLast = 0;
+
+    // Minimum statistics: the minimum frame energy of each subwindow in a
+    // ring, and of the one being filled
+    float mSubwindowMin[kNoiseSubwindows];
+    int32_t mSubwindow = 0;
+    int32_t mSubwindowFill = 0;
+    float mCurrentMin = kInitialNoiseDb;
+
+    Features mFeatures;
+    bool mPreviousCandidate = false;
+    int32_t mHangover = 0;
+    float mProbability = 0.0f;
+    int64_t mFrameCount = 0;
+    int64_t mSpeechFrameCount = 0;
+};
+
+#endif //OBOESAMPLE_VOICEACTIVITYDETECTOR_H
@@ -0,0 +1,845 @@
+/**
+ * Host benchmark for the DSP modules and the AudioRecorder processing chain.
+ *
+ * Every module and the full recorder chain are driven in callback-sized bursts
+ * (4 ms) over a deterministic speech-like test signal, at 16/48/96 kHz with
+ * 1/2/4 channels. For each case the best of several runs is reported as
+ * ns/sample and samples/sec, where a "sample" is one value of the interleaved
+ * stream (frames * channels).
+ *
+ * The noise reduction row also reports the delay the STFT adds and its CPU
+ * time per 10 ms of audio, and the echo canceller row its partitioning. The
+ * full chain runs full duplex, with every burst also published as the far end.
+ *
+ * The lossless encoder and decoder rows time the recording codec on the
+ * int16 version of the signal (the encoder in callback-sized bursts as the
+ * writer thread feeds it, the decoder a block at a time) and report the
+ * compression ratio.
+ *
+ * The int16tofloat/floattoint16 rows time the recorder's SIMD conversion
+ * kernels against the scalar loops they replaced, and check both produce the
+ * same samples; a mismatch makes the benchmark exit non-zero.
+ *
+ * The autogain row runs the AGC and look-ahead limiter on the stream's frames,
+ * reports its latency and CPU time per 10 ms, and counts heap allocations in
+ * its process() calls like the chain row does.
+ *
+ * The plan row runs every stage through the ExecutionPlan the recorder
+ * compiles for the classic graph, without the recorder around it.
+ *
+ * The eqsweep row runs the three classic EQ filters as a plan whose peaking
+ * frequency and gain are moved every burst, so the cascade glides the whole
+ * time and redesigns its coefficients every sub-block; the note gives the
+ * same plan held still. Allocations during the sweep fail the benchmark.
+ *
+ * The resampler row converts to the 16 kHz the recorder stores voice at (or,
+ * at 16 kHz, up to 48 kHz as playback does); ns/sample is per input sample.
+ *
+ * The chain benchmark also counts heap allocations made while the recorder
+ * callback runs; any allocation in the steady state is reported and makes the
+ * benchmark exit non-zero.
+ *
+ * With --metrics, each chain row is followed by the recorder's own callback
+ * metrics (see CallbackMetrics.h): the summary and the processing-time
+ * histogram, as the app would report them on a device.
+ *
+ * Last, the batch table reprocesses a set of stereo 48 kHz files of mixed
+ * lengths through BatchProcessor with every stage enabled, on 1 to N threads
+ * (N = the core count, or --threads), and reports throughput as a multiple
+ * of real time, speedup over one thread and parallel efficiency.
+ *
+ * Usage: dsp-benchmark [--seconds N] [--runs N] [--only NAME] [--metrics] [--threads N]
+ */
+
+#include <oboe/Oboe.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "AudioRecorder.h"
+#include "BatchProcessor.h"
+#include "CallbackMetrics.h"
+#include "DspGraph.h"
+#include "ExecutionPlan.h"
+#include "FarEndReference.h"
+#include "LosslessCodec.h"
+#include "filter/AutoGain.h"
+#include "filter/BiquadCascade.h"
+#include "filter/BiquadFilter.h"
+#include "filter/EchoCanceller.h"
+#include "filter/NoiseGate.h"
+#include "filter/NoiseReduction.h"
+#include "filter/PlaybackSuppressor.h"
+#include "filter/PolyphaseResampler.h"
+#include "filter/SampleConversion.h"
+
+// Global allocation counter, used to check the recorder callback never allocates
+static std::atomic<int64_t> gAllocations{0};
+
+void *operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace {
+
+constexpr int kSampleRates[] = {16000, 48000, 96000};
+constexpr int kChannelCounts[] = {1, 2, 4};
+
+struct BenchConfig {
+    double seconds = 2.0;
+    int runs = 3;
+    std::string only;
+    bool metrics = false;
+    int threads = 0;  // batch table maximum; 0 = core count
+};
+
+struct BenchResult {
+    double nsPerSample;
+    double samplesPerSec;
+};
+
+// Keeps the optimizer from discarding processed output
+volatile float gSink;
+
+// Set when a steady-state recorder callback allocated
+bool gCallbackAllocated = false;
+
+// Set when a SIMD conversion kernel disagreed with the scalar loop
+bool gConversionMismatch = false;
+
+// Deterministic speech-like signal: a gliding harmonic tone with a syllable-rate
+// envelope plus a little white noise, interleaved across channels.
+std::vector<float> makeTestSignal(int sampleRate, int channels, size_t frames) {
+    std::vector<float> signal(frames * channels);
+    uint32_t seed = 0x12345678u;
+    double phase = 0.0;
+    for (size_t i = 0; i < frames; i++) {
+        double t = static_cast<double>(i) / sampleRate;
+        double f0 = 140.0 + 40.0 * std::sin(2.0 * M_PI * 0.7 * t);
+        phase += 2.0 * M_PI * f0 / sampleRate;
+        double envelope = 0.5 + 0.5 * std::sin(2.0 * M_PI * 4.0 * t);
+        double voiced = 0.0;
+        for (int h = 1; h <= 8; h++) {
+            voiced += std::sin(h * phase) / h;
+        }
+        for (int c = 0; c < channels; c++) {
+            seed = seed * 1664525u + 1013904223u;
+            double noise = (static_cast<double>(seed >> 8) / 16777216.0 - 0.5) * 0.02;
+            signal[i * channels + c] = static_cast<float>(0.2 * envelope * voiced + noise);
+        }
+    }
+    return signal;
+}
+
+std::vector<int16_t> toInt16(const std::vector<float> &signal) {
+    std::vector<int16_t> out(signal.size());
+    for (size_t i = 0; i < signal.size(); i++) {
+        float s = std::max(-1.0f, std::min(1.0f, signal[i]));
+        out[i] = static_cast<int16_t>(s * 32767.0f);
+    }
+    return out;
+}
+
+// Times processBurst(offset, samples) over the whole signal, best of config.runs
+template<typename ProcessBurst>
+BenchResult timeBursts(const BenchConfig &config, size_t totalSamples, size_t burstSamples,
+                       ProcessBurst &&processBurst) {
+    double bestNs = 1e300;
+    for (int run = 0; run < config.runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset + burstSamples <= totalSamples; offset += burstSamples) {
+            processBurst(offset, burstSamples);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        bestNs = std::min(bestNs, ns);
+    }
+    size_t processed = (totalSamples / burstSamples) * burstSamples;
+    double nsPerSample = bestNs / static_cast<double>(processed);
+    return {nsPerSample, 1e9 / nsPerSample};
+}
+
+// Runs a module's block process() over the interleaved stream. Modules set up
+// for the stream's channel count take frames (channels > 1); the rest see the
+// stream as one signal.
+template<typename Module>
+BenchResult benchModule(const BenchConfig &config, Module &module, const std::vector<float> &input,
+                        size_t burstSamples, int channels = 1) {
+    std::vector<float> output(input.size());
+    BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                    [&](size_t offset, size_t count) {
+                                        module.process(input.data() + offset,
+                                                       output.data() + offset,
+                                                       static_cast<int32_t>(count / channels));
+                                    });
+    gSink = output[output.size() / 2];
+    return result;
+}
+
+// Echo canceller with the signal as both far end and mic, so the filter keeps
+// adapting the whole time (its most expensive path)
+BenchResult benchEchoCanceller(const BenchConfig &config, EchoCanceller &canceller,
+                               const std::vector<float> &input, size_t burstSamples) {
+    std::vector<float> output(input.size());
+    BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                    [&](size_t offset, size_t count) {
+                                        canceller.process(input.data() + offset,
+                                                          input.data() + offset,
+                                                          output.data() + offset,
+                                                          static_cast<int32_t>(count));
+                                    });
+    gSink = output[output.size() / 2];
+    return result;
+}
+
+// Serial per-section BiquadFilters vs. the fused BiquadCascade over the same sections
+std::vector<BiquadFilter> makeEqSections(int sampleRate, int numSections) {
+    std::vector<BiquadFilter> sections(numSections);
+    for (int k = 0; k < numSections; k++) {
+        float freq = std::min(250.0f * (k + 1), sampleRate * 0.45f);
+        if (k == 0) {
+            sections[k].setBandpass(sampleRate, 1000.0f, 1.0f);
+        } else if (k == numSections - 1) {
+            sections[k].setHighShelf(sampleRate, std::min(8000.0f, sampleRate * 0.45f), 0.7f,
+                                     3.0f);
+        } else {
+            sections[k].setPeaking(sampleRate, freq, 1.0f, 3.0f);
+        }
+    }
+    return sections;
+}
+
+BenchResult benchEqSerial(const BenchConfig &config, int sampleRate, int numSections,
+                          const std::vector<float> &input, size_t burstSamples) {
+    std::vector<BiquadFilter> sections = makeEqSections(sampleRate, numSections);
+    std::vector<float> output(input.size());
+    BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                    [&](size_t offset, size_t count) {
+                                        const float *src = input.data() + offset;
+                                        for (auto &section : sections) {
+                                            section.process(src, output.data() + offset,
+                                                            static_cast<int32_t>(count));
+                                            src = output.data() + offset;
+                                        }
+                                    });
+    gSink = output[output.size() / 2];
+    return result;
+}
+
+BenchResult benchEqCascade(const BenchConfig &config, int sampleRate, int channels,
+                           int numSections, const std::vector<float> &input,
+                           size_t burstSamples) {
+    std::vector<BiquadCoefficients> coefficients;
+    for (auto &section : makeEqSections(sampleRate, numSections)) {
+        coefficients.push_back(section.getCoefficients());
+    }
+    BiquadCascade cascade;
+    cascade.setChannelCount(channels);
+    cascade.setSections(coefficients.data(), numSections);
+
+    std::vector<float> output(input.size());
+    BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                    [&](size_t offset, size_t count) {
+                                        cascade.process(input.data() + offset,
+                                                        output.data() + offset,
+                                                        static_cast<int32_t>(count / channels));
+                                    });
+    gSink = output[output.size() / 2];
+    return result;
+}
+
+// Float chain with every stage enabled, run as an ExecutionPlan compiled from
+// the classic graph; *steps is set to how many steps it compiled to
+BenchResult benchPlan(const BenchConfig &config, int sampleRate, int channels,
+                      const std::vector<float> &input, size_t burstSamples, int *steps) {
+    RecorderParams params;
+    params.playbackSuppressorEnabled = true;
+    params.echoCancellerEnabled = true;
+    params.noiseReductionEnabled = true;
+    params.noiseGateEnabled = true;
+    params.bandpassEnabled = true;
+    params.peakingEnabled = true;
+    params.highShelfEnabled = true;
+    params.autoGainEnabled = true;
+    const size_t burstFrames = burstSamples / channels;
+    std::unique_ptr<ExecutionPlan> plan =
+            ExecutionPlan::compile(DspGraph::fromParams(params), sampleRate, channels,
+                                   static_cast<int32_t>(burstFrames), nullptr);
+    *steps = plan->getNumSteps();
+
+    // The far end is the first channel of the signal itself: an echo path of unity gain
+    std::vector<float> farEnd(input.size() / channels);
+    for (size_t i = 0; i < farEnd.size(); i++) {
+        farEnd[i] = input[i * channels];
+    }
+
+    std::vector<float> buffer(input);
+    BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                    [&](size_t offset, size_t count) {
+                                        plan->process(buffer.data() + offset,
+                                                      static_cast<int32_t>(count / channels),
+                                                      farEnd.data() + offset / channels);
+                                    });
+    gSink = buffer[buffer.size() / 2];
+    return result;
+}
+
+// The classic EQ as a plan, with the peaking filter swept up and down an
+// octave around 1 kHz every burst if sweep; *allocations counts the heap
+// allocations in configure() and process()
+BenchResult benchEqSweep(const BenchConfig &config, int sampleRate, int channels,
+                         const std::vector<float> &input, size_t burstSamples, bool sweep,
+                         int64_t *allocations) {
+    RecorderParams params;
+    params.bandpassEnabled = true;
+    params.peakingEnabled = true;
+    params.highShelfEnabled = true;
+    DspGraph graph = DspGraph::fromParams(params);
+    const size_t burstFrames = burstSamples / channels;
+    std::unique_ptr<ExecutionPlan> plan =
+            ExecutionPlan::compile(graph, sampleRate, channels,
+                                   static_cast<int32_t>(burstFrames), nullptr);
+    StageConfig *peaking = graph.findStage(classicStageId(StageType::Peaking));
+
+    std::vector<float> buffer(input);
+    int64_t burst = 0;
+    const int64_t allocationsBefore = gAllocations.load();
+    BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                    [&](size_t offset, size_t count) {
+                                        if (sweep) {
+                                            const float position = std::sin(0.05f * burst++);
+                                            peaking->frequency =
+                                                    1000.0f * std::exp2(position);
+                                            peaking->gainDb = 6.0f * position;
+                                            plan->configure(graph);
+                                        }
+                                        plan->process(buffer.data() + offset,
+                                                      static_cast<int32_t>(count / channels),
+                                                      nullptr);
+                                    });
+    *allocations = gAllocations.load() - allocationsBefore;
+    gSink = buffer[buffer.size() / 2];
+    return result;
+}
+
+// Callback metrics summary and the non-empty histogram buckets, indented
+// under the row they belong to
+void printMetrics(const CallbackMetrics::Snapshot &metrics) {
+    char summary[256];
+    metrics.formatSummary(summary, sizeof(summary));
+    printf("    %s\n", summary);
+
+    int64_t peak = 1;
+    for (int64_t count : metrics.histogram) peak = std::max(peak, count);
+    for (int b = 0; b < CallbackMetrics::kNumBuckets; b++) {
+        if (metrics.histogram[b] == 0) continue;
+        int bar = static_cast<int>(40 * metrics.histogram[b] / peak);
+        printf("    %9.2f us %9lld  %.*s\n", CallbackMetrics::bucketStartNs(b) / 1000.0,
+               static_cast<long long>(metrics.histogram[b]), std::max(bar, 1),
+               "########################################");
+    }
+}
+
+// The recorder's full callback, driven through onAudioReady. Reports the
+// recorder's own callback metrics through metrics.
+BenchResult benchChain(const BenchConfig &config, int sampleRate, int channels,
+                       const std::vector<int16_t> &input, int32_t framesPerBurst,
+                       CallbackMetrics::Snapshot &metrics) {
+    oboe::StubDevice::configure(sampleRate, channels, framesPerBurst);
+
+    // Full duplex: a player publishes each burst as the far end just before
+    // the recorder callback consumes the matching mic burst
+    auto farEnd = std::make_unique<FarEndReference>();
+
+    auto recorder = std::make_unique<AudioRecorder>();
+    recorder->setStoragePath("/dev/null");
+    recorder->setFarEndReference(farEnd.get());
+    recorder->setPlaybackSuppressorEnabled(true);
+    recorder->setEchoCancellerEnabled(true);
+    recorder->setNoiseReductionEnabled(true);
+    recorder->setNoiseGateEnabled(true);
+    recorder->setBandpassFilterEnabled(true);
+    recorder->setPeakingFilterEnabled(true);
+    recorder->setHighShelfFilterEnabled(true);
+    recorder->setAutoGainEnabled(true);
+    if (recorder->startRecording() != oboe::Result::OK) {
+        fprintf(stderr, "chain: startRecording failed\n");
+        return {0.0, 0.0};
+    }
+
+    // The callback only needs the stream for its format
+    oboe::AudioStreamBuilder builder;
+    builder.setDirection(oboe::Direction::Input)
+            ->setFormat(oboe::AudioFormat::I16)
+            ->setChannelCount(channels)
+            ->setSampleRate(sampleRate);
+    std::shared_ptr<oboe::AudioStream> stream;
+    builder.openStream(stream);
+
+    // onAudioReady may process in place, so feed it a copy of each burst
+    std::vector<int16_t> burst(static_cast<size_t>(framesPerBurst) * channels);
+
+    int64_t allocationsBefore = gAllocations.load();
+    BenchResult result = timeBursts(config, input.size(), burst.size(),
+                                    [&](size_t offset, size_t count) {
+                                        memcpy(burst.data(), input.data() + offset,
+                                               count * sizeof(int16_t));
+                                        farEnd->write(burst.data(), framesPerBurst, channels,
+                                                      sampleRate, FarEndReference::nowNs());
+                                        recorder->onAudioReady(stream.get(), burst.data(),
+                                                               framesPerBurst);
+                                    });
+    int64_t allocations = gAllocations.load() - allocationsBefore;
+    if (allocations > 0) {
+        fprintf(stderr, "chain %d Hz x%d: %lld heap allocations in steady-state callbacks\n",
+                sampleRate, channels, static_cast<long long>(allocations));
+        gCallbackAllocated = true;
+    }
+
+    recorder->stopRecording();
+    metrics = recorder->getCallbackMetrics();
+    return result;
+}
+
+// Encodes input in bursts, as the writer thread does. Reports the compressed
+// size through encodedBytes.
+BenchResult benchLosslessEncode(const BenchConfig &config, int sampleRate, int channels,
+                                const std::vector<int16_t> &input, size_t burstSamples,
+                                size_t &encodedBytes) {
+    LosslessEncoder encoder;
+    std::vector<uint8_t> encoded;
+    encoded.reserve(input.size() * sizeof(int16_t) * 2);
+    BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                    [&](size_t offset, size_t count) {
+                                        if (offset == 0) {
+                                            encoder.init(sampleRate, channels);
+                                            encoded.clear();
+                                        }
+                                        encoder.encode(input.data() + offset, count, encoded);
+                                    });
+    encoder.finish(encoded);
+    encodedBytes = encoded.size();
+    return result;
+}
+
+// Decodes input's encoding one block at a time, as the playback decoder thread does
+BenchResult benchLosslessDecode(const BenchConfig &config, int sampleRate, int channels,
+                                const std::vector<int16_t> &input) {
+    LosslessEncoder encoder;
+    encoder.init(sampleRate, channels);
+    std::vector<uint8_t> encoded;
+    encoder.writeFileHeader(encoded);
+    encoder.encode(input.data(), input.size(), encoded);
+    encoder.finish(encoded);
+
+    LosslessFormat format;
+    format.parseFileHeader(encoded.data(), encoded.size());
+    LosslessDecoder decoder;
+    decoder.init(format);
+
+    // Index the blocks up front so the timed loop only decodes
+    struct Block {
+        size_t payload;
+        uint32_t payloadBytes;
+        int32_t frames;
+    };
+    std::vector<Block> blocks;
+    for (size_t position = LosslessFormat::kFileHeaderBytes; position < encoded.size();) {
+        Block block{};
+        format.parseBlockHeader(encoded.data() + position, block.frames, block.payloadBytes);
+        block.payload = position + LosslessFormat::kBlockHeaderBytes;
+        blocks.push_back(block);
+        position = block.payload + block.payloadBytes;
+    }
+
+    const size_t blockSamples = static_cast<size_t>(format.blockFrames) * channels;
+    std::vector<int16_t> output(blockSamples);
+    BenchResult result = timeBursts(config, input.size(), blockSamples,
+                                    [&](size_t offset, size_t) {
+                                        const Block &block = blocks[offset / blockSamples];
+                                        decoder.decodeBlock(encoded.data() + block.payload,
+                                                            block.payloadBytes, block.frames,
+                                                            output.data());
+                                    });
+    gSink = output[output.size() / 2];
+    return result;
+}
+
+// Times int16 -> float conversion with the input gain, SIMD kernel and scalar
+// loop. Reports the scalar time through scalarNsPerSample.
+BenchResult benchInt16ToFloat(const BenchConfig &config, const std::vector<int16_t> &input,
+                              size_t burstSamples, double &scalarNsPerSample) {
+    constexpr float gain = 2.0f;
+    std::vector<float> output(input.size());
+    std::vector<float> reference(input.size());
+    BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                    [&](size_t offset, size_t count) {
+                                        convertInt16ToFloat(input.data() + offset,
+                                                            output.data() + offset,
+                                                            static_cast<int32_t>(count), gain);
+                                    });
+    scalarNsPerSample = timeBursts(config, input.size(), burstSamples,
+                                   [&](size_t offset, size_t count) {
+                                       for (size_t i = offset; i < offset + count; i++) {
+                                           float s = static_cast<float>(input[i]) / 32768.0f * gain;
+                                           reference[i] = std::max(-1.0f, std::min(1.0f, s));
+                                       }
+                                   }).nsPerSample;
+    if (output != reference) {
+        gConversionMismatch = true;
+    }
+    gSink = output[output.size() / 2] + reference[reference.size() / 2];
+    return result;
+}
+
+// Times float -> int16 conversion, SIMD kernel and scalar loop. Reports the
+// scalar time through scalarNsPerSample.
+BenchResult benchFloatToInt16(const BenchConfig &config, const std::vector<float> &input,
+                              size_t burstSamples, double &scalarNsPerSample) {
+    std::vector<int16_t> output(input.size());
+    std::vector<int16_t> reference(input.size());
+    BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                    [&](size_t offset, size_t count) {
+                                        convertFloatToInt16(input.data() + offset,
+                                                            output.data() + offset,
+                                                            static_cast<int32_t>(count));
+                                    });
+    scalarNsPerSample = timeBursts(config, input.size(), burstSamples,
+                                   [&](size_t offset, size_t count) {
+                                       for (size_t i = offset; i < offset + count; i++) {
+                                           float s = std::max(-1.0f, std::min(1.0f, input[i]));
+                                           reference[i] = static_cast<int16_t>(s * 32767.0f);
+                                       }
+                                   }).nsPerSample;
+    if (output != reference) {
+        gConversionMismatch = true;
+    }
+    gSink = output[output.size() / 2] + reference[reference.size() / 2];
+    return result;
+}
+
+void printRow(const char *name, int sampleRate, int channels, const BenchResult &result,
+              const char *note = "") {
+    printf("%-20s %7d %4d %12.2f %14.2f  %s\n", name, sampleRate, channels, result.nsPerSample,
+           result.samplesPerSec / 1e6, note);
+}
+
+bool selected(const BenchConfig &config, const char *name) {
+    return config.only.empty() || config.only == name;
+}
+
+void runCase(const BenchConfig &config, int sampleRate, int channels) {
+    const int32_t framesPerBurst = sampleRate / 250; // 4 ms callbacks
+    const size_t burstSamples = static_cast<size_t>(framesPerBurst) * channels;
+    const size_t frames = static_cast<size_t>(config.seconds * sampleRate);
+    const std::vector<float> input = makeTestSignal(sampleRate, channels, frames);
+
+    if (selected(config, "bandpass")) {
+        BiquadFilter filter;
+        filter.setBandpass(sampleRate, 1000.0f, 1.0f);
+        printRow("bandpass", sampleRate, channels, benchModule(config, filter, input, burstSamples));
+    }
+    if (selected(config, "peaking")) {
+        BiquadFilter filter;
+        filter.setPeaking(sampleRate, 3000.0f, 1.0f, 6.0f);
+        printRow("peaking", sampleRate, channels, benchModule(config, filter, input, burstSamples));
+    }
+    if (selected(config, "highshelf")) {
+        BiquadFilter filter;
+        filter.setHighShelf(sampleRate, std::min(8000.0f, sampleRate * 0.45f), 0.7f, 3.0f);
+        printRow("highshelf", sampleRate, channels,
+                 benchModule(config, filter, input, burstSamples));
+    }
+    if (selected(config, "eqserial3")) {
+        printRow("eqserial3", sampleRate, channels,
+                 benchEqSerial(config, sampleRate, 3, input, burstSamples));
+    }
+    if (selected(config, "eqcascade3")) {
+        printRow("eqcascade3", sampleRate, channels,
+                 benchEqCascade(config, sampleRate, channels, 3, input, burstSamples));
+    }
+    if (selected(config, "eqserial8")) {
+        printRow("eqserial8", sampleRate, channels,
+                 benchEqSerial(config, sampleRate, 8, input, burstSamples));
+    }
+    if (selected(config, "eqcascade8")) {
+        printRow("eqcascade8", sampleRate, channels,
+                 benchEqCascade(config, sampleRate, channels, 8, input, burstSamples));
+    }
+    if (selected(config, "noisegate")) {
+        NoiseGate gate;
+        gate.setChannelCount(channels);
+        gate.setThreshold(-40.0f);
+        gate.setRatio(4.0f);
+        gate.setAttack(5.0f, sampleRate);
+        gate.setRelease(50.0f, sampleRate);
+        printRow("noisegate", sampleRate, channels,
+                 benchModule(config, gate, input, burstSamples, channels));
+    }
+    if (selected(config, "autogain")) {
+        AutoGain agc;
+        agc.prepare(sampleRate, channels);
+        std::vector<float> output(input.size());
+        int64_t allocationsBefore = gAllocations.load();
+        BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                        [&](size_t offset, size_t count) {
+                                            agc.process(input.data() + offset,
+                                                        output.data() + offset,
+                                                        static_cast<int32_t>(count / channels));
+                                        });
+        int64_t allocations = gAllocations.load() - allocationsBefore;
+        gSink = output[output.size() / 2];
+        if (allocations > 0) {
+            fprintf(stderr, "autogain %d Hz x%d: %lld heap allocations in process()\n",
+                    sampleRate, channels, static_cast<long long>(allocations));
+            gCallbackAllocated = true;
+        }
+
+        char note[64];
+        snprintf(note, sizeof(note), "latency %d frames, %.1f us/10ms",
+                 agc.getLatencyFrames(),
+                 result.nsPerSample * (sampleRate / 100) * channels / 1000.0);
+        printRow("autogain", sampleRate, channels, result, note);
+    }
+    if (selected(config, "noisereduction")) {
+        NoiseReduction reduction(sampleRate);
+        reduction.setReductionAmount(0.5f);
+        BenchResult result = benchModule(config, reduction, input, burstSamples);
+
+        // Added delay (in stream samples; the module sees the interleaved
+        // stream as one signal), and CPU time per 10 ms of that stream
+        char note[64];
+        snprintf(note, sizeof(note), "latency %d samples, %.1f us/10ms",
+                 reduction.getLatencyFrames(),
+                 result.nsPerSample * (sampleRate / 100) * channels / 1000.0);
+        printRow("noisereduction", sampleRate, channels, result, note);
+    }
+    if (selected(config, "echocanceller")) {
+        EchoCanceller canceller(sampleRate);
+        canceller.setEchoDelay(50.0f);
+        canceller.setSuppressionAmount(0.7f);
+        BenchResult result = benchEchoCanceller(config, canceller, input, burstSamples);
+
+        char note[64];
+        snprintf(note, sizeof(note), "%d x %d-sample partitions, %.1f us/10ms",
+                 canceller.getNumPartitions(), canceller.getBlockSize(),
+                 result.nsPerSample * (sampleRate / 100) * channels / 1000.0);
+        printRow("echocanceller", sampleRate, channels, result, note);
+    }
+    if (selected(config, "playbacksuppressor")) {
+        PlaybackSuppressor suppressor(sampleRate);
+        suppressor.setEnabled(true);
+        suppressor.setAggressiveness(0.8f);
+        printRow("playbacksuppressor", sampleRate, channels,
+                 benchModule(config, suppressor, input, burstSamples));
+    }
+    if (selected(config, "losslessencode") || selected(config, "losslessdecode")) {
+        const std::vector<int16_t> pcm = toInt16(input);
+        size_t encodedBytes = 0;
+        BenchResult encode = benchLosslessEncode(config, sampleRate, channels, pcm, burstSamples,
+                                                 encodedBytes);
+        char note[64];
+        snprintf(note, sizeof(note), "ratio %.3f",
+                 static_cast<double>(encodedBytes) / (pcm.size() * sizeof(int16_t)));
+        if (selected(config, "losslessencode")) {
+            printRow("losslessencode", sampleRate, channels, encode, note);
+        }
+        if (selected(config, "losslessdecode")) {
+            printRow("losslessdecode", sampleRate, channels,
+                     benchLosslessDecode(config, sampleRate, channels, pcm), note);
+        }
+    }
+    if (selected(config, "int16tofloat")) {
+        double scalarNs = 0.0;
+        BenchResult result = benchInt16ToFloat(config, toInt16(input), burstSamples, scalarNs);
+        char note[64];
+        snprintf(note, sizeof(note), "scalar %.2f ns/sample", scalarNs);
+        printRow("int16tofloat", sampleRate, channels, result, note);
+    }
+    if (selected(config, "floattoint16")) {
+        // Boosted so the clamp is exercised too
+        std::vector<float> boosted(input);
+        for (float &s : boosted) s *= 2.0f;
+        double scalarNs = 0.0;
+        BenchResult result = benchFloatToInt16(config, boosted, burstSamples, scalarNs);
+        char note[64];
+        snprintf(note, sizeof(note), "scalar %.2f ns/sample", scalarNs);
+        printRow("floattoint16", sampleRate, channels, result, note);
+    }
+    if (selected(config, "resampler")) {
+        const int32_t outputRate = sampleRate == 16000 ? 48000 : 16000;
+        PolyphaseResampler resampler;
+        resampler.configure(sampleRate, outputRate, channels, framesPerBurst);
+        std::vector<float> output(
+                static_cast<size_t>(resampler.getMaxOutputFrames(framesPerBurst)) * channels);
+        BenchResult result = timeBursts(config, input.size(), burstSamples,
+                                        [&](size_t offset, size_t count) {
+                                            resampler.process(
+                                                    input.data() + offset,
+                                                    static_cast<int32_t>(count / channels),
+                                                    output.data());
+                                        });
+        gSink = output[0];
+        char note[64];
+        snprintf(note, sizeof(note), "-> %d Hz, %d taps/phase", outputRate,
+                 resampler.getTapsPerPhase());
+        printRow("resampler", sampleRate, channels, result, note);
+    }
+    if (selected(config, "plan")) {
+        int steps = 0;
+        BenchResult result = benchPlan(config, sampleRate, channels, input, burstSamples, &steps);
+        char note[32];
+        snprintf(note, sizeof(note), "%d steps", steps);
+        printRow("plan", sampleRate, channels, result, note);
+    }
+    if (selected(config, "eqsweep")) {
+        int64_t allocations = 0;
+        BenchResult still = benchEqSweep(config, sampleRate, channels, input, burstSamples,
+                                         false, &allocations);
+        BenchResult result = benchEqSweep(config, sampleRate, channels, input, burstSamples,
+                                          true, &allocations);
+        if (allocations > 0) {
+            fprintf(stderr, "eqsweep %d Hz x%d: %lld heap allocations while sweeping\n",
+                    sampleRate, channels, static_cast<long long>(allocations));
+            gCallbackAllocated = true;
+        }
+        char note[48];
+        snprintf(note, sizeof(note), "held still %.2f ns/sample", still.nsPerSample);
+        printRow("eqsweep", sampleRate, channels, result, note);
+    }
+    if (selected(config, "chain")) {
+        CallbackMetrics::Snapshot metrics;
+        printRow("chain", sampleRate, channels,
+                 benchChain(config, sampleRate, channels, toInt16(input), framesPerBurst,
+                            metrics));
+        if (config.metrics) {
+            printMetrics(metrics);
+        }
+    }
+}
+
+// Batch reprocessing on 1..N threads: 8 files of 2 to 8 x config.seconds,
+// the longer ones split into chunks of 2 x config.seconds
+void runBatchScaling(const BenchConfig &config) {
+    constexpr int kRate = 48000;
+    constexpr int kChannels = 2;
+    constexpr int kFiles = 8;
+    const int maxThreads = config.threads > 0
+                           ? config.threads
+                           : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    std::vector<BatchProcessor::Job> jobs;
+    for (int i = 0; i < kFiles; i++) {
+        auto frames = static_cast<size_t>(config.seconds * kRate * (2 + 2 * (i % 4)));
+        std::vector<int16_t> samples = toInt16(makeTestSignal(kRate, kChannels, frames));
+        char input[] = "/tmp/dsp-batch-in-XXXXXX";
+        char output[] = "/tmp/dsp-batch-out-XXXXXX";
+        int inputFd = mkstemp(input);
+        int outputFd = mkstemp(output);
+        if (inputFd < 0 || outputFd < 0) {
+            fprintf(stderr, "Can't create batch files\n");
+            return;
+        }
+        if (write(inputFd, samples.data(), samples.size() * sizeof(int16_t)) < 0) {
+            fprintf(stderr, "Can't write batch input\n");
+        }
+        close(inputFd);
+        close(outputFd);
+        jobs.push_back({input, output});
+    }
+
+    // No AGC or playback suppressor: with either, files aren't split
+    RecorderParams params;
+    params.noiseReductionEnabled = true;
+    params.noiseGateEnabled = true;
+    params.echoCancellerEnabled = true;
+    params.bandpassEnabled = true;
+    params.peakingEnabled = true;
+    params.highShelfEnabled = true;
+
+    printf("\n%-8s %12s %9s %11s %6s %7s\n", "threads", "x realtime", "speedup", "efficiency",
+           "tasks", "steals");
+    double baseline = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        BatchProcessor batch(threads);
+        batch.setParams(params);
+        batch.setRawInputFormat(FileFormat::Pcm16, kRate, kChannels);
+        batch.setChunkSeconds(static_cast<float>(2.0 * config.seconds));
+        BatchProcessor::Result best;
+        for (int run = 0; run < config.runs; run++) {
+            BatchProcessor::Result result = batch.process(jobs);
+            if (result.failedFiles > 0) {
+                fprintf(stderr, "Batch run failed on %d files\n", result.failedFiles);
+            }
+            if (result.speedFactor() > best.speedFactor()) best = result;
+        }
+        if (threads == 1) baseline = best.speedFactor();
+        double speedup = baseline > 0.0 ? best.speedFactor() / baseline : 0.0;
+        printf("%-8d %12.1f %9.2f %10.0f%% %6d %7lld\n", threads, best.speedFactor(), speedup,
+               100.0 * speedup / threads, best.tasks, static_cast<long long>(best.steals));
+    }
+
+    for (const auto &job : jobs) {
+        unlink(job.inputPath.c_str());
+        unlink(job.outputPath.c_str());
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            config.seconds = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+            config.runs = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--only") && i + 1 < argc) {
+            config.only = argv[++i];
+        } else if (!strcmp(argv[i], "--metrics")) {
+            config.metrics = true;
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            config.threads = atoi(argv[++i]);
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--seconds N] [--runs N] [--only NAME] [--metrics] [--threads N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    printf("%-20s %7s %4s %12s %14s\n", "module", "rate", "ch", "ns/sample", "Msamples/s");
+    for (int sampleRate : kSampleRates) {
+        for (int channels : kChannelCounts) {
+            runCase(config, sampleRate, channels);
+        }
+    }
+    if (selected(config, "batch")) {
+        runBatchScaling(config);
+    }
+    if (gConversionMismatch) {
+        fprintf(stderr, "SIMD sample conversion differs from the scalar loop\n");
+    }
+    return gCallbackAllocated || gConversionMismatch ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+#include "HostTimerBackend.h"
+#include "filter/SampleConversion.h"
+#include <android/log.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+#define LOG_TAG "HostTimerBackend"
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Buffer capacity of a stream, in its largest bursts
+constexpr int32_t kCapacityBursts = 8;
+
+/**
+ * A stub stream that runs its data callback from a timer thread between
+ * requestStart() and requestStop(). The thread owns the capture position and
+ * the render file while it runs.
+ */
+class HostTimerStream : public oboe::AudioStream {
+public:
+    HostTimerStream(const oboe::AudioStreamBuilder &builder, HostTimerBackend &backend,
+                    uint32_t seed)
+            : oboe::AudioStream(builder), mBackend(backend), mCapture(backend.mCapture),
+              mRenderPath(backend.mRenderPath), mRandom(seed) {
+        const HostTimerBackend::Options &options = backend.getOptions();
+        mMinBurst = std::max(1, options.framesPerBurst);
+        mMaxBurst = std::max(mMinBurst, options.maxFramesPerBurst);
+        mFramesPerBurst = mMinBurst;
+        mBufferCapacityInFrames = mMaxBurst * kCapacityBursts;
+        mRealTime = options.realTime;
+        mJitterUs = std::max(0, options.jitterUs);
+        mBuffer.assign(static_cast<size_t>(mMaxBurst) * getBytesPerFrame(), 0);
+        if (mDirection == oboe::Direction::Input && getFormat() == oboe::AudioFormat::Float) {
+            mConvertBuffer.assign(static_cast<size_t>(mMaxBurst) * mChannelCount, 0);
+        }
+    }
+
+    ~HostTimerStream() override {
+        mStopRequested.store(true, std::memory_order_release);
+        joinTimer();
+    }
+
+    oboe::StreamState getState() const override {
+        return mTimerState.load(std::memory_order_acquire);
+    }
+
+    oboe::Result requestStart() override {
+        const oboe::StreamState state = getState();
+        if (state == oboe::StreamState::Closed) return oboe::Result::ErrorClosed;
+        if (state == oboe::StreamState::Started) return oboe::Result::OK;
+
+        // A run that ended with its callback returning Stop
+        joinTimer();
+
+        // Without a callback there is nothing to run, as with the stub device
+        if (mDataCallback == nullptr) {
+            mTimerState.store(oboe::StreamState::Started, std::memory_order_release);
+            return oboe::Result::OK;
+        }
+        if (mDirection == oboe::Direction::Output && !mRenderPath.empty()) {
+            mRenderFile = fopen(mRenderPath.c_str(), "wb");
+            if (mRenderFile == nullptr) {
+                LOGE("Can't open render file %s", mRenderPath.c_str());
+                return oboe::Result::ErrorInternal;
+            }
+        }
+        mStopRequested.store(false, std::memory_order_relaxed);
+        mTimerState.store(oboe::StreamState::Started, std::memory_order_release);
+        mBackend.mRunningStreams.fetch_add(1, std::memory_order_acq_rel);
+        mTimer = std::thread(&HostTimerStream::run, this);
+        return oboe::Result::OK;
+    }
+
+    oboe::Result requestStop() override {
+        if (getState() == oboe::StreamState::Closed) return oboe::Result::ErrorClosed;
+        mStopRequested.store(true, std::memory_order_release);
+        joinTimer();
+        mTimerState.store(oboe::StreamState::Stopped, std::memory_order_release);
+        return oboe::Result::OK;
+    }
+
+    oboe::Result close() override {
+        mStopRequested.store(true, std::memory_order_release);
+        joinTimer();
+        mTimerState.store(oboe::StreamState::Closed, std::memory_order_release);
+        return oboe::Result::OK;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Waits for the timer thread, unless it is the caller (a callback stopping
+    // its own stream just leaves the thread to finish)
+    void joinTimer() {
+        if (mTimer.joinable() && mTimer.get_id() != std::this_thread::get_id()) {
+            mTimer.join();
+        }
+    }
+
+    Clock::duration framesToDuration(int64_t frames) const {
+        return std::chrono::duration_cast<Clock::duration>(
+                std::chrono::nanoseconds(frames * 1000000000 / mSampleRate));
+    }
+
+    // Fills the first numFrames of mBuffer with the next of the capture signal
+    void capture(int32_t numFrames) {
+        const int32_t numSamples = numFrames * mChannelCount;
+        const bool floatStream = getFormat() == oboe::AudioFormat::Float;
+        auto *samples16 = floatStream ? mConvertBuffer.data()
+                                      : reinterpret_cast<int16_t *>(mBuffer.data());
+        if (mCapture == nullptr || mCapture->empty()) {
+            std::fill(samples16, samples16 + numSamples, 0);
+        } else {
+            const auto size = static_cast<int64_t>(mCapture->size());
+            for (int32_t done = 0; done < numSamples;) {
+                const auto count = static_cast<int32_t>(
+                        std::min<int64_t>(numSamples - done, size - mCapturePosition));
+                std::copy_n(mCapture->data() + mCapturePosition, count, samples16 + done);
+                done += count;
+                mCapturePosition = (mCapturePosition + count) % size;
+            }
+        }
+        if (floatStream) {
+            convertInt16ToFloat(samples16, reinterpret_cast<float *>(mBuffer.data()), numSamples);
+        }
+    }
+
+    void run() {
+        std::uniform_int_distribution<int32_t> burstSizes(mMinBurst, mMaxBurst);
+        std::uniform_int_distribution<int32_t> jitter(0, mJitterUs);
+        const Clock::duration capacity = framesToDuration(mBufferCapacityInFrames);
+
+        // Deadlines count frames from start so rounding never drifts
+        Clock::time_point start = Clock::now();
+        int64_t framesSinceStart = 0;
+
+        while (!mStopRequested.load(std::memory_order_acquire)) {
+            const int32_t numFrames = burstSizes(mRandom);
+            if (mRealTime) {
+                framesSinceStart += numFrames;
+                const Clock::time_point deadline = start + framesToDuration(framesSinceStart);
+                std::this_thread::sleep_until(deadline
+                                              + std::chrono::microseconds(jitter(mRandom)));
+                if (mStopRequested.load(std::memory_order_acquire)) {
+                    break;
+                }
+                const Clock::time_point now = Clock::now();
+                if (now - deadline > capacity) {
+                    addXRuns(1);
+                    start = now;
+                    framesSinceStart = 0;
+                }
+            }
+
+            if (mDirection == oboe::Direction::Input) {
+                capture(numFrames);
+            }
+            const oboe::DataCallbackResult result =
+                    mDataCallback->onAudioReady(this, mBuffer.data(), numFrames);
+            if (mRenderFile != nullptr) {
+                fwrite(mBuffer.data(), getBytesPerFrame(), numFrames, mRenderFile);
+            }
+            if (result == oboe::DataCallbackResult::Stop) {
+                break;
+            }
+        }
+
+        if (mRenderFile != nullptr) {
+            fclose(mRenderFile);
+            mRenderFile = nullptr;
+        }
+        mTimerState.store(oboe::StreamState::Stopped, std::memory_order_release);
+        mBackend.mRunningStreams.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    HostTimerBackend &mBackend;
+    std::shared_ptr<const std::vector<int16_t>> mCapture;
+    std::string mRenderPath;
+    int32_t mMinBurst = 0;
+    int32_t mMaxBurst = 0;
+    bool mRealTime = true;
+    int32_t mJitterUs = 0;
+
+    std::thread mTimer;
+    std::atomic<bool> mStopRequested{false};
+    std::atomic<oboe::StreamState> mTimerState{oboe::StreamState::Open};
+
+    // Timer thread
+    std::minstd_rand mRandom;
+    std::vector<uint8_t> mBuffer;         // one burst in the stream's format
+    std::vector<int16_t> mConvertBuffer;  // capture before conversion to float
+    int64_t mCapturePosition = 0;
+    FILE *mRenderFile = nullptr;
+};
+
+HostTimerBackend::HostTimerBackend(const Options &options) : mOptions(options) {}
+
+void HostTimerBackend::setCaptureSignal(std::vector<int16_t> samples) {
+    mCapture = std::make_shared<const std::vector<int16_t>>(std::move(samples));
+}
+
+bool HostTimerBackend::setCaptureFile(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        LOGE("Can't open capture file %s", path);
+        return false;
+    }
+    std::vector<int16_t> samples;
+    int16_t chunk[4096];
+    size_t count;
+    while ((count = fread(chunk, sizeof(int16_t), 4096, file)) > 0) {
+        samples.insert(samples.end(), chunk, chunk + count);
+    }
+    fclose(file);
+    setCaptureSignal(std::move(samples));
+    return true;
+}
+
+oboe::Result HostTimerBackend::openStream(const oboe::AudioStreamBuilder &builder,
+                                          std::shared_ptr<oboe::AudioStream> &stream) {
+    oboe::AudioStreamBuilder request(builder);
+    if (request.getSampleRate() == oboe::kUnspecified) {
+        request.setSampleRate(mOptions.sampleRate);
+    }
+    if (request.getChannelCount() == oboe::kUnspecified) {
+        request.setChannelCount(mOptions.channelCount);
+    }
+    stream = std::make_shared<HostTimerStream>(request, *this, mOptions.seed + mStreamsOpened++);
+    return oboe::Result::OK;
+}
@@ -0,0 +1,86 @@
+#ifndef OBOESAMPLE_HOSTTIMERBACKEND_H
+#define OBOESAMPLE_HOSTTIMERBACKEND_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AudioBackend.h"
+
+/**
+ * Host audio backend: each started stream's data callback runs on a timer
+ * thread of its own, as a device's audio thread would call it, so
+ * AudioRecorder and AudioPlayer run end to end on Linux with their writer,
+ * decoder and read-ahead threads around them.
+ *
+ * Pacing is real time by default: a callback for n frames comes n frames'
+ * worth of time after the previous one, so the threads around the callback
+ * see device timing. With realTime off the callbacks run back to back, as fast
+ * as the CPU allows, for load tests. Burst sizes may vary from callback to
+ * callback, and each real-time wake-up may be delayed by a random jitter. A
+ * wake-up more than the buffer capacity behind its deadline counts as an xrun
+ * (getXRunCount()), and the clock restarts from there.
+ *
+ * Input streams capture the capture signal, looped, or silence without one.
+ * Output streams render into the render file, in the stream's sample format
+ * and channel layout (the raw layout recordings use), or nowhere. A callback
+ * that returns Stop stops its stream, as in Oboe.
+ *
+ * Configure before opening streams; the backend must outlive them.
+ */
+class HostTimerBackend : public AudioBackend {
+public:
+    struct Options {
+        // Device format, for whatever the builder leaves unspecified
+        int32_t sampleRate = 48000;
+        int32_t channelCount = 1;
+
+        // Frames per callback: each callback's size is drawn from
+        // [framesPerBurst, maxFramesPerBurst], or is framesPerBurst if the
+        // maximum is smaller
+        int32_t framesPerBurst = 192;
+        int32_t maxFramesPerBurst = 0;
+
+        bool realTime = true;
+
+        // Largest random delay added to a real-time wake-up
+        int32_t jitterUs = 0;
+
+        // Seeds the burst sizes and jitter (each stream gets its own sequence)
+        uint32_t seed = 1;
+    };
+
+    explicit HostTimerBackend(const Options &options);
+    ~HostTimerBackend() override = default;
+
+    const Options &getOptions() const { return mOptions; }
+
+    // What input streams capture: interleaved int16 at the stream's channel
+    // count, converted if the stream is float. Empty captures silence.
+    void setCaptureSignal(std::vector<int16_t> samples);
+
+    // Loads the capture signal from a raw int16 file (a Pcm16 recording)
+    bool setCaptureFile(const char *path);
+
+    // Where output streams render to; empty discards. Each start truncates it.
+    void setRenderFile(const char *path) { mRenderPath = path; }
+
+    // Streams whose timer thread is running; 0 once every stream has stopped,
+    // including by its callback returning Stop
+    int32_t getRunningStreams() const { return mRunningStreams.load(std::memory_order_acquire); }
+
+    oboe::Result openStream(const oboe::AudioStreamBuilder &builder,
+                            std::shared_ptr<oboe::AudioStream> &stream) override;
+
+private:
+    Options mOptions;
+    std::shared_ptr<const std::vector<int16_t>> mCapture;
+    std::string mRenderPath;
+    uint32_t mStreamsOpened = 0;
+    std::atomic<int32_t> mRunningStreams{0};
+
+    friend class HostTimerStream;
+};
+
+#endif //OBOESAMPLE_HOSTTIMERBACKEND_H
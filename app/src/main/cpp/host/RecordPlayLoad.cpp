@@ -0,0 +1,186 @@
+/**
+ * Load test for the full record/play path on HostTimerBackend.
+ *
+ * AudioPlayer plays a speech-like file while AudioRecorder records the same
+ * signal as its capture, with every processing stage enabled and the player
+ * publishing the echo canceller's far end, as during a duplex session on a
+ * device. Both streams' callbacks run on the backend's timer threads, with
+ * the recorder's writer thread and the player's read-ahead thread around
+ * them.
+ *
+ * Real-time pacing (the default) shows how the path behaves at device timing:
+ * callback utilization, xruns and whether the writer keeps up. With --fast
+ * the callbacks run back to back, and the run reports how many times faster
+ * than real time the recorder got through its audio.
+ *
+ * At the end each stream's callback metrics and its worker thread's stats are
+ * printed. In real time, any xrun or frame the writer dropped makes the run
+ * exit non-zero.
+ *
+ * Usage: record-play-load [--seconds N] [--fast] [--rate HZ] [--channels N]
+ *                         [--burst N] [--max-burst N] [--jitter-us N]
+ *                         [--capture FILE]
+ */
+
+#include <oboe/Oboe.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "AudioPlayer.h"
+#include "AudioRecorder.h"
+#include "FarEndReference.h"
+#include "HostTimerBackend.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Deterministic speech-like signal: a gliding harmonic tone with a
+// syllable-rate envelope plus a little white noise, on every channel
+std::vector<int16_t> makeSpeechLike(int32_t sampleRate, int32_t channels, size_t frames) {
+    std::vector<int16_t> signal(frames * channels);
+    uint32_t seed = 0x12345678u;
+    double phase = 0.0;
+    for (size_t i = 0; i < frames; i++) {
+        double t = static_cast<double>(i) / sampleRate;
+        phase += 2.0 * M_PI * (140.0 + 40.0 * std::sin(2.0 * M_PI * 0.7 * t)) / sampleRate;
+        double envelope = 0.5 + 0.5 * std::sin(2.0 * M_PI * 4.0 * t);
+        double voiced = 0.0;
+        for (int h = 1; h <= 8; h++) {
+            voiced += std::sin(h * phase) / h;
+        }
+        for (int32_t c = 0; c < channels; c++) {
+            seed = seed * 1664525u + 1013904223u;
+            double noise = (static_cast<double>(seed >> 8) / 16777216.0 - 0.5) * 0.02;
+            signal[i * channels + c] = static_cast<int16_t>(32767.0 * (0.2 * envelope * voiced
+                                                                      + noise));
+        }
+    }
+    return signal;
+}
+
+void printStream(const char *name, const CallbackMetrics::Snapshot &metrics,
+                 const WorkerThread::Stats &thread) {
+    char summary[256];
+    metrics.formatSummary(summary, sizeof(summary));
+    printf("%-9s %s\n", name, summary);
+    thread.formatSummary(summary, sizeof(summary));
+    printf("%-9s thread: %s\n", "", summary);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    HostTimerBackend::Options options;
+    double seconds = 5.0;
+    const char *capturePath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--fast")) {
+            options.realTime = false;
+        } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+            options.sampleRate = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--channels") && i + 1 < argc) {
+            options.channelCount = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--burst") && i + 1 < argc) {
+            options.framesPerBurst = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--max-burst") && i + 1 < argc) {
+            options.maxFramesPerBurst = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--jitter-us") && i + 1 < argc) {
+            options.jitterUs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+            capturePath = argv[++i];
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--seconds N] [--fast] [--rate HZ] [--channels N] [--burst N]\n"
+                    "       [--max-burst N] [--jitter-us N] [--capture FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    HostTimerBackend backend(options);
+    const auto targetFrames = static_cast<int64_t>(seconds * options.sampleRate);
+    const std::string base = "/tmp/record-play-load-" + std::to_string(getpid());
+    const std::string playbackPath = base + "-playback.raw";
+    const std::string recordingPath = base + "-recording.raw";
+
+    // A playback file long enough for the whole run, which is also the capture
+    // unless one was given
+    std::vector<int16_t> signal = makeSpeechLike(options.sampleRate, options.channelCount,
+                                                 static_cast<size_t>(targetFrames));
+    FILE *file = fopen(playbackPath.c_str(), "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Can't write %s\n", playbackPath.c_str());
+        return 1;
+    }
+    fwrite(signal.data(), sizeof(int16_t), signal.size(), file);
+    fclose(file);
+    if (capturePath != nullptr) {
+        if (!backend.setCaptureFile(capturePath)) return 1;
+    } else {
+        backend.setCaptureSignal(std::move(signal));
+    }
+
+    FarEndReference farEnd;
+    AudioPlayer player(backend);
+    player.setFarEndReference(&farEnd);
+    AudioRecorder recorder(backend);
+    recorder.setStoragePath(recordingPath.c_str());
+    recorder.setFarEndReference(&farEnd);
+    recorder.setPlaybackSuppressorEnabled(true);
+    recorder.setEchoCancellerEnabled(true);
+    recorder.setNoiseReductionEnabled(true);
+    recorder.setNoiseGateEnabled(true);
+    recorder.setBandpassFilterEnabled(true);
+    recorder.setPeakingFilterEnabled(true);
+    recorder.setHighShelfFilterEnabled(true);
+    recorder.setAutoGainEnabled(true);
+
+    printf("%d Hz x%d, bursts %d..%d frames, jitter %d us, %s, %.1f s of audio\n",
+           options.sampleRate, options.channelCount, options.framesPerBurst,
+           std::max(options.framesPerBurst, options.maxFramesPerBurst), options.jitterUs,
+           options.realTime ? "real time" : "as fast as possible", seconds);
+
+    const Clock::time_point start = Clock::now();
+    if (player.startPlaybackFromFile(playbackPath.c_str()) != oboe::Result::OK
+        || recorder.startRecording() != oboe::Result::OK) {
+        fprintf(stderr, "Failed to start the streams\n");
+        player.stopPlayback();
+        return 1;
+    }
+    while (recorder.getCallbackMetrics().frames < targetFrames) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    recorder.stopRecording();
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    player.stopPlayback();
+
+    const CallbackMetrics::Snapshot recorded = recorder.getCallbackMetrics();
+    const CallbackMetrics::Snapshot played = player.getCallbackMetrics();
+    printStream("recorder", recorded, recorder.getWriterThreadStats());
+    printStream("player", played, player.getSourceThreadStats());
+    const double audioSeconds = static_cast<double>(recorded.frames) / options.sampleRate;
+    printf("%.2f s of audio in %.2f s (%.1fx real time), writer dropped %lld frames\n",
+           audioSeconds, elapsed, audioSeconds / elapsed,
+           static_cast<long long>(recorder.getDroppedFrames()));
+
+    remove(playbackPath.c_str());
+    remove(recordingPath.c_str());
+
+    const bool glitched = recorded.xRunCount > 0 || played.xRunCount > 0
+                          || recorder.getDroppedFrames() > 0;
+    if (options.realTime && glitched) {
+        fprintf(stderr, "Glitches at real-time pacing\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "SimulatedDuplexDriver.h"
+#include "filter/SampleConversion.h"
+
+SimulatedDuplexDriver::SimulatedDuplexDriver(oboe::AudioStream *input, oboe::AudioStream *output)
+        : mInputStream(input), mOutputStream(output) {}
+
+bool SimulatedDuplexDriver::tick(int32_t outputFrames, int32_t inputFrames) {
+    // Capture: near end plus whatever of the output the loopback has delivered
+    const int32_t inputChannels = mInputStream->getChannelCount();
+    mFloatBlock.resize(static_cast<size_t>(inputFrames) * inputChannels);
+    for (int32_t i = 0; i < inputFrames; i++) {
+        const auto index = static_cast<int64_t>(mInput.size());
+        float sample = index < static_cast<int64_t>(mNearEnd.size()) ? mNearEnd[index] : 0.0f;
+        const int64_t source = index - mLoopbackDelay;
+        if (source >= 0 && source < static_cast<int64_t>(mOutput.size())) {
+            sample += mLoopbackGain * mOutput[source];
+        }
+        mInput.push_back(sample);
+        for (int32_t c = 0; c < inputChannels; c++) {
+            mFloatBlock[static_cast<size_t>(i) * inputChannels + c] = sample;
+        }
+    }
+    if (mInputStream->getFormat() == oboe::AudioFormat::Float) {
+        mInputStream->pushInput(mFloatBlock.data(), inputFrames);
+    } else {
+        mInt16Block.resize(mFloatBlock.size());
+        convertFloatToInt16(mFloatBlock.data(), mInt16Block.data(),
+                            static_cast<int32_t>(mFloatBlock.size()));
+        mInputStream->pushInput(mInt16Block.data(), inputFrames);
+    }
+
+    // Render
+    const int32_t outputChannels = mOutputStream->getChannelCount();
+    const auto outputSamples = static_cast<size_t>(outputFrames) * outputChannels;
+    const bool floatOutput = mOutputStream->getFormat() == oboe::AudioFormat::Float;
+    mFloatBlock.assign(outputSamples, 0.0f);
+    mInt16Block.assign(outputSamples, 0);
+    void *data = floatOutput ? static_cast<void *>(mFloatBlock.data()) : mInt16Block.data();
+    const oboe::DataCallbackResult result =
+            mOutputStream->getDataCallback()->onAudioReady(mOutputStream, data, outputFrames);
+    if (!floatOutput) {
+        convertInt16ToFloat(mInt16Block.data(), mFloatBlock.data(),
+                            static_cast<int32_t>(outputSamples));
+    }
+    for (int32_t i = 0; i < outputFrames; i++) {
+        mOutput.push_back(mFloatBlock[static_cast<size_t>(i) * outputChannels]);
+    }
+    return result == oboe::DataCallbackResult::Continue;
+}
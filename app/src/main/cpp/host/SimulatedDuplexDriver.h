@@ -0,0 +1,62 @@
+#ifndef OBOESAMPLE_SIMULATEDDUPLEXDRIVER_H
+#define OBOESAMPLE_SIMULATEDDUPLEXDRIVER_H
+
+#include <oboe/Oboe.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Host stand-in for a full-duplex audio device, for driving FullDuplexEngine
+ * (or any output callback that reads its input stream) off-device.
+ *
+ * Each tick() is one device period: the "microphone" captures a block into the
+ * input stream, then the output stream's callback is asked for a block. What
+ * the microphone picks up is the near-end signal plus the output fed back
+ * through a loopback: output frame n arrives, at the loopback gain, in input
+ * frame n + the loopback delay. Both are counted on the device's frame clock,
+ * from the first tick. Output not rendered yet when it would be captured (the
+ * input running ahead by more than the delay) reads as silence.
+ *
+ * Input and output may be ticked with different block sizes to simulate
+ * jitter between the two directions. Streams are float or int16, with any
+ * channel count. The near end goes to every input channel, and the output's
+ * first channel is what the loopback carries and getOutput() keeps.
+ */
+class SimulatedDuplexDriver {
+public:
+    SimulatedDuplexDriver(oboe::AudioStream *input, oboe::AudioStream *output);
+
+    void setLoopback(int32_t delayFrames, float gain) {
+        mLoopbackDelay = delayFrames;
+        mLoopbackGain = gain;
+    }
+
+    // Mono near-end signal captured from the first tick on; silence after it
+    void setNearEnd(std::vector<float> signal) { mNearEnd = std::move(signal); }
+
+    // Captures inputFrames, then renders outputFrames. Returns false once the
+    // output callback asks to stop.
+    bool tick(int32_t outputFrames, int32_t inputFrames);
+    bool tick(int32_t frames) { return tick(frames, frames); }
+
+    // Everything rendered and captured so far, first channel
+    const std::vector<float> &getOutput() const { return mOutput; }
+    const std::vector<float> &getInput() const { return mInput; }
+
+private:
+    oboe::AudioStream *mInputStream;
+    oboe::AudioStream *mOutputStream;
+    int32_t mLoopbackDelay = 0;
+    float mLoopbackGain = 0.0f;
+    std::vector<float> mNearEnd;
+
+    std::vector<float> mOutput;
+    std::vector<float> mInput;
+
+    // One block in the streams' own formats
+    std::vector<float> mFloatBlock;
+    std::vector<int16_t> mInt16Block;
+};
+
+#endif //OBOESAMPLE_SIMULATEDDUPLEXDRIVER_H
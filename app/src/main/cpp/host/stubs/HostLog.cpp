@@ -0,0 +1,33 @@
+#include <android/log.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+static std::atomic<int> sMinPriority{ANDROID_LOG_WARN};
+static std::atomic<long> sCount{0};
+
+extern "C" int __android_log_print(int prio, const char *tag, const char *fmt, ...) {
+    sCount.fetch_add(1, std::memory_order_relaxed);
+    if (prio < sMinPriority.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    static const char kLevels[] = "??VDIWEFS";
+    char level = (prio >= 0 && prio <= ANDROID_LOG_SILENT) ? kLevels[prio] : '?';
+
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%c/%s: ", level, tag);
+    int written = vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return written;
+}
+
+extern "C" void host_log_set_min_priority(int prio) {
+    sMinPriority.store(prio, std::memory_order_relaxed);
+}
+
+extern "C" long host_log_count(void) {
+    return sCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,41 @@
+#ifndef OBOESAMPLE_HOST_ANDROID_LOG_H
+#define OBOESAMPLE_HOST_ANDROID_LOG_H
+
+/**
+ * Host stand-in for <android/log.h>. Messages at or above the minimum
+ * priority (default ANDROID_LOG_WARN) go to stderr; everything else is dropped
+ * so LOGD calls in the DSP setters don't flood benchmark output.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum android_LogPriority {
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT,
+} android_LogPriority;
+
+int __android_log_print(int prio, const char *tag, const char *fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+
+// Host-only: change the minimum priority that reaches stderr
+void host_log_set_min_priority(int prio);
+
+// Host-only: messages logged so far, at any priority, dropped ones included.
+// Tests use it to check that audio-thread paths never log: logging can block
+// on Android.
+long host_log_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //OBOESAMPLE_HOST_ANDROID_LOG_H
@@ -0,0 +1,360 @@
+#ifndef OBOESAMPLE_HOST_OBOE_H
+#define OBOESAMPLE_HOST_OBOE_H
+
+/**
+ * Minimal host stand-in for <oboe/Oboe.h>.
+ *
+ * Only the subset of the Oboe API that AudioRecorder/AudioPlayer and
+ * FullDuplexEngine touch is provided. Streams opened through the stub builder
+ * never run on their own; host code (benchmarks, tests) drives onAudioReady()
+ * directly with the returned stream, and queues what an input stream read()s
+ * with pushInput(). The format a "device" opens with is taken from StubDevice
+ * whenever the builder leaves it unspecified.
+ *
+ * As in Oboe, the stream's state and start/stop/close are virtual, so a host
+ * backend (HostTimerBackend) can run streams of its own behind the same type.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace oboe {
+
+constexpr int32_t kUnspecified = 0;
+
+enum class Result : int32_t {
+    OK = 0,
+    ErrorBase = -900,
+    ErrorDisconnected = -899,
+    ErrorIllegalArgument = -898,
+    ErrorInternal = -896,
+    ErrorInvalidState = -895,
+    ErrorInvalidHandle = -892,
+    ErrorUnimplemented = -890,
+    ErrorUnavailable = -889,
+    ErrorNoFreeHandles = -888,
+    ErrorNoMemory = -887,
+    ErrorNull = -886,
+    ErrorTimeout = -885,
+    ErrorWouldBlock = -884,
+    ErrorInvalidFormat = -883,
+    ErrorOutOfRange = -882,
+    ErrorNoService = -881,
+    ErrorInvalidRate = -880,
+    ErrorClosed = -869,
+};
+
+enum class DataCallbackResult : int32_t {
+    Continue = 0,
+    Stop = 1,
+};
+
+enum class Direction : int32_t {
+    Output = 0,
+    Input = 1,
+};
+
+enum class AudioFormat : int32_t {
+    Invalid = -1,
+    Unspecified = 0,
+    I16 = 1,
+    Float = 2,
+    I24 = 3,
+    I32 = 4,
+};
+
+enum class StreamState : int32_t {
+    Uninitialized = 0,
+    Unknown = 1,
+    Open = 2,
+    Starting = 3,
+    Started = 4,
+    Pausing = 5,
+    Paused = 6,
+    Flushing = 7,
+    Flushed = 8,
+    Stopping = 9,
+    Stopped = 10,
+    Closing = 11,
+    Closed = 12,
+    Disconnected = 13,
+};
+
+enum class PerformanceMode : int32_t {
+    None = 10,
+    PowerSaving = 11,
+    LowLatency = 12,
+};
+
+enum class SharingMode : int32_t {
+    Exclusive = 0,
+    Shared = 1,
+};
+
+enum class InputPreset : int32_t {
+    Generic = 1,
+    Camcorder = 5,
+    VoiceRecognition = 6,
+    VoiceCommunication = 7,
+    Unprocessed = 9,
+    VoicePerformance = 10,
+};
+
+enum class Usage : int32_t {
+    Media = 1,
+    VoiceCommunication = 2,
+    VoiceCommunicationSignalling = 3,
+    Alarm = 4,
+    Notification = 5,
+    NotificationRingtone = 6,
+    Game = 14,
+    Assistant = 16,
+};
+
+enum class ContentType : int32_t {
+    Speech = 1,
+    Music = 2,
+    Movie = 3,
+    Sonification = 4,
+};
+
+inline const char *convertToText(Result result) {
+    switch (result) {
+        case Result::OK: return "OK";
+        case Result::ErrorDisconnected: return "ErrorDisconnected";
+        case Result::ErrorIllegalArgument: return "ErrorIllegalArgument";
+        case Result::ErrorInternal: return "ErrorInternal";
+        case Result::ErrorInvalidState: return "ErrorInvalidState";
+        case Result::ErrorUnimplemented: return "ErrorUnimplemented";
+        case Result::ErrorUnavailable: return "ErrorUnavailable";
+        case Result::ErrorInvalidFormat: return "ErrorInvalidFormat";
+        case Result::ErrorInvalidRate: return "ErrorInvalidRate";
+        case Result::ErrorClosed: return "ErrorClosed";
+        default: return "Unrecognized result";
+    }
+}
+
+template<typename T>
+class ResultWithValue {
+public:
+    ResultWithValue(Result error) : mValue{}, mError(error) {}
+    ResultWithValue(T value) : mValue(value), mError(Result::OK) {}
+
+    Result error() const { return mError; }
+    T value() const { return mValue; }
+    explicit operator bool() const { return mError == Result::OK; }
+
+private:
+    T mValue;
+    Result mError;
+};
+
+class AudioStream;
+
+class AudioStreamDataCallback {
+public:
+    virtual ~AudioStreamDataCallback() = default;
+
+    virtual DataCallbackResult
+    onAudioReady(AudioStream *audioStream, void *audioData, int32_t numFrames) = 0;
+};
+
+// Host-only: the format a stub "device" opens with when the builder does not ask for one
+struct StubDevice {
+    static inline int32_t sampleRate = 48000;
+    static inline int32_t channelCount = 1;
+    static inline int32_t framesPerBurst = 192;
+    static inline int32_t bufferCapacityInFrames = 192 * 8;
+
+    static void configure(int32_t rate, int32_t channels, int32_t burst) {
+        sampleRate = rate;
+        channelCount = channels;
+        framesPerBurst = burst;
+        bufferCapacityInFrames = burst * 8;
+    }
+};
+
+class AudioStreamBuilder {
+public:
+    AudioStreamBuilder *setDirection(Direction direction) {
+        mDirection = direction;
+        return this;
+    }
+
+    AudioStreamBuilder *setPerformanceMode(PerformanceMode mode) {
+        mPerformanceMode = mode;
+        return this;
+    }
+
+    AudioStreamBuilder *setSharingMode(SharingMode mode) {
+        mSharingMode = mode;
+        return this;
+    }
+
+    AudioStreamBuilder *setFormat(AudioFormat format) {
+        mFormat = format;
+        return this;
+    }
+
+    AudioStreamBuilder *setChannelCount(int32_t channelCount) {
+        mChannelCount = channelCount;
+        return this;
+    }
+
+    AudioStreamBuilder *setSampleRate(int32_t sampleRate) {
+        mSampleRate = sampleRate;
+        return this;
+    }
+
+    AudioStreamBuilder *setInputPreset(InputPreset preset) {
+        mInputPreset = preset;
+        return this;
+    }
+
+    AudioStreamBuilder *setUsage(Usage usage) {
+        mUsage = usage;
+        return this;
+    }
+
+    AudioStreamBuilder *setContentType(ContentType contentType) {
+        mContentType = contentType;
+        return this;
+    }
+
+    AudioStreamBuilder *setDataCallback(AudioStreamDataCallback *callback) {
+        mDataCallback = callback;
+        return this;
+    }
+
+    Direction getDirection() const { return mDirection; }
+    AudioFormat getFormat() const { return mFormat; }
+    int32_t getSampleRate() const { return mSampleRate; }
+    int32_t getChannelCount() const { return mChannelCount; }
+    AudioStreamDataCallback *getDataCallback() const { return mDataCallback; }
+
+    Result openStream(std::shared_ptr<AudioStream> &stream);
+
+private:
+    friend class AudioStream;
+
+    Direction mDirection = Direction::Output;
+    PerformanceMode mPerformanceMode = PerformanceMode::None;
+    SharingMode mSharingMode = SharingMode::Shared;
+    AudioFormat mFormat = AudioFormat::Unspecified;
+    int32_t mChannelCount = kUnspecified;
+    int32_t mSampleRate = kUnspecified;
+    InputPreset mInputPreset = InputPreset::VoiceRecognition;
+    Usage mUsage = Usage::Media;
+    ContentType mContentType = ContentType::Music;
+    AudioStreamDataCallback *mDataCallback = nullptr;
+};
+
+class AudioStream {
+public:
+    explicit AudioStream(const AudioStreamBuilder &builder)
+            : mDirection(builder.mDirection),
+              mFormat(builder.mFormat == AudioFormat::Unspecified ? AudioFormat::I16
+                                                                  : builder.mFormat),
+              mSampleRate(builder.mSampleRate != kUnspecified ? builder.mSampleRate
+                                                              : StubDevice::sampleRate),
+              mChannelCount(builder.mChannelCount != kUnspecified ? builder.mChannelCount
+                                                                  : StubDevice::channelCount),
+              mFramesPerBurst(StubDevice::framesPerBurst),
+              mBufferCapacityInFrames(StubDevice::bufferCapacityInFrames),
+              mDataCallback(builder.mDataCallback) {}
+    virtual ~AudioStream() = default;
+
+    Direction getDirection() const { return mDirection; }
+    AudioFormat getFormat() const { return mFormat; }
+    int32_t getSampleRate() const { return mSampleRate; }
+    int32_t getChannelCount() const { return mChannelCount; }
+    int32_t getFramesPerBurst() const { return mFramesPerBurst; }
+    int32_t getBufferCapacityInFrames() const { return mBufferCapacityInFrames; }
+    virtual StreamState getState() const { return mState; }
+    AudioStreamDataCallback *getDataCallback() const { return mDataCallback; }
+    ResultWithValue<int32_t> getXRunCount() { return mXRunCount; }
+
+    int32_t getBytesPerSample() const {
+        switch (mFormat) {
+            case AudioFormat::Float:
+            case AudioFormat::I32: return 4;
+            case AudioFormat::I24: return 3;
+            default: return 2;
+        }
+    }
+    int32_t getBytesPerFrame() const { return getBytesPerSample() * mChannelCount; }
+
+    // Blocking-mode input: takes up to numFrames of what was pushed, without
+    // ever waiting (the stub device captures nothing on its own)
+    ResultWithValue<int32_t> read(void *buffer, int32_t numFrames, int64_t /*timeoutNanoseconds*/) {
+        if (mState == StreamState::Closed) return Result::ErrorClosed;
+        const int32_t frames = numFrames < mInputFrames ? numFrames : mInputFrames;
+        const size_t bytes = static_cast<size_t>(frames) * getBytesPerFrame();
+        memcpy(buffer, mInput.data() + mInputHead, bytes);
+        mInputHead += bytes;
+        mInputFrames -= frames;
+        if (mInputFrames == 0) {
+            mInput.clear();
+            mInputHead = 0;
+        }
+        return frames;
+    }
+
+    ResultWithValue<int32_t> getAvailableFrames() {
+        if (mState == StreamState::Closed) return Result::ErrorClosed;
+        return mInputFrames;
+    }
+
+    // Host-only: pretend the device glitched
+    void addXRuns(int32_t count) { mXRunCount += count; }
+
+    // Host-only: frames the device captured, in the stream's format, for read()
+    void pushInput(const void *data, int32_t numFrames) {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        mInput.insert(mInput.end(), bytes,
+                      bytes + static_cast<size_t>(numFrames) * getBytesPerFrame());
+        mInputFrames += numFrames;
+    }
+
+    virtual Result requestStart() {
+        if (mState == StreamState::Closed) return Result::ErrorClosed;
+        mState = StreamState::Started;
+        return Result::OK;
+    }
+
+    virtual Result requestStop() {
+        if (mState == StreamState::Closed) return Result::ErrorClosed;
+        mState = StreamState::Stopped;
+        return Result::OK;
+    }
+
+    virtual Result close() {
+        mState = StreamState::Closed;
+        return Result::OK;
+    }
+
+protected:
+    Direction mDirection;
+    AudioFormat mFormat;
+    int32_t mSampleRate;
+    int32_t mChannelCount;
+    int32_t mFramesPerBurst;
+    int32_t mBufferCapacityInFrames;
+    AudioStreamDataCallback *mDataCallback;
+    StreamState mState = StreamState::Open;
+    int32_t mXRunCount = 0;
+    std::vector<uint8_t> mInput;  // pushed and not yet read from mInputHead on
+    size_t mInputHead = 0;
+    int32_t mInputFrames = 0;
+};
+
+inline Result AudioStreamBuilder::openStream(std::shared_ptr<AudioStream> &stream) {
+    stream = std::make_shared<AudioStream>(*this);
+    return Result::OK;
+}
+
+} // namespace oboe
+
+#endif //OBOESAMPLE_HOST_OBOE_H
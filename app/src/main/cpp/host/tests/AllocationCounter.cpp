@@ -0,0 +1,26 @@
+// Global allocation counter, to check the audio side never allocates. Linked
+// into the tests that call allocationCount() (see TestSupport.h).
+
+#include "TestSupport.h"
+#include <atomic>
+#include <new>
+
+static std::atomic<int64_t> gAllocations{0};
+
+int64_t allocationCount() {
+    return gAllocations.load();
+}
+
+void *operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
@@ -0,0 +1,191 @@
+/**
+ * Batch reprocessing test.
+ *
+ * Runs a mixed batch through BatchProcessor on several threads: a long raw
+ * file that gets split into chunks, short raw files, and a compressed file
+ * that must stay whole. Every output has to match OfflineProcessor running
+ * over the same file sequentially. For the chunked file that means the
+ * warm-up before each chunk must have brought every module (noise tracker,
+ * gate envelopes, filter states) to exactly where a sequential run is there.
+ *
+ * The batch runs twice: without the AGC and the playback suppressor, and with
+ * every stage, when the long file has to stay whole too. The speech drops
+ * 12 dB for longer than a chunk, so either of those two started fresh partway
+ * through would end up somewhere else.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "AudioFileWriter.h"
+#include "BatchProcessor.h"
+#include "OfflineProcessor.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kChannelCount = 2;
+constexpr int32_t kThreads = 3;
+constexpr float kChunkSeconds = 3.0f;
+
+// Speech-like bursts over noise whose level drifts, so the noise tracker and
+// the gate keep moving. The speech is 12 dB down from 4 s to 9 s, so the AGC
+// does too.
+std::vector<int16_t> makeSignal(size_t frames, uint32_t seed) {
+    std::vector<int16_t> samples(frames * kChannelCount);
+    double phase = 0.0;
+    for (size_t i = 0; i < frames; i++) {
+        double t = static_cast<double>(i) / kSampleRate;
+        phase += 2.0 * M_PI * (130.0 + 50.0 * std::sin(2.0 * M_PI * 0.3 * t)) / kSampleRate;
+        double envelope = std::max(0.0, std::sin(2.0 * M_PI * 0.9 * t + seed));
+        if (t >= 4.0 && t < 9.0) envelope *= 0.25;
+        double noiseLevel = 200.0 + 150.0 * std::sin(2.0 * M_PI * 0.05 * t);
+        for (int c = 0; c < kChannelCount; c++) {
+            seed = seed * 1664525u + 1013904223u;
+            double voiced = 0.0;
+            for (int h = 1; h <= 6; h++) voiced += std::sin(h * (phase + c)) / h;
+            double noise = static_cast<double>(seed >> 16) / 65536.0 - 0.5;
+            samples[i * kChannelCount + c] =
+                    static_cast<int16_t>(6000.0 * envelope * voiced + noiseLevel * noise);
+        }
+    }
+    return samples;
+}
+
+void writeRaw(const std::string &path, const std::vector<int16_t> &samples) {
+    FILE *file = fopen(path.c_str(), "wb");
+    CHECK(file != nullptr, "could not write %s", path.c_str());
+    if (!file) return;
+    fwrite(samples.data(), sizeof(int16_t), samples.size(), file);
+    fclose(file);
+}
+
+void writeCompressed(const std::string &path, const std::vector<int16_t> &samples) {
+    AudioFileWriter writer;
+    CHECK(writer.open(path, kSampleRate, kChannelCount, FileFormat::Lossless),
+          "writer open failed");
+    const size_t frames = samples.size() / kChannelCount;
+    for (size_t frame = 0; frame < frames; frame += OfflineProcessor::kBlockFrames) {
+        auto count = static_cast<int32_t>(
+                std::min<size_t>(OfflineProcessor::kBlockFrames, frames - frame));
+        writer.writeBlocking(samples.data() + frame * kChannelCount, count);
+    }
+    CHECK(writer.close(), "writer flush timed out");
+}
+
+RecorderParams allStages() {
+    RecorderParams params;
+    params.noiseReductionEnabled = true;
+    params.noiseReductionAmount = 0.8f;
+    params.noiseGateEnabled = true;
+    params.gateThresholdDb = -35.0f;
+    params.echoCancellerEnabled = true;
+    params.playbackSuppressorEnabled = true;
+    params.bandpassEnabled = true;
+    params.bandpassFreq = 900.0f;
+    params.bandpassQ = 0.4f;
+    params.peakingEnabled = true;
+    params.highShelfEnabled = true;
+    params.autoGainEnabled = true;
+    return params;
+}
+
+// Processes the files through BatchProcessor and checks every output against
+// a sequential run. The long file must be split into chunks iff split.
+void runBatch(const char *name, const RecorderParams &params, bool split) {
+    const struct {
+        const char *name;
+        float seconds;
+        bool compressed;
+    } kFiles[] = {
+            {"long", 14.5f, false},
+            {"short-a", 1.2f, false},
+            {"short-b", 2.0f, false},
+            {"compressed", 4.0f, true},
+    };
+
+    std::vector<BatchProcessor::Job> jobs;
+    std::vector<std::string> references;
+    double totalSeconds = 0.0;
+    for (const auto &file : kFiles) {
+        auto frames = static_cast<size_t>(file.seconds * kSampleRate);
+        std::vector<int16_t> input = makeSignal(frames, static_cast<uint32_t>(jobs.size() + 7));
+        std::string inputPath = tempPath("batch-input");
+        if (file.compressed) {
+            writeCompressed(inputPath, input);
+        } else {
+            writeRaw(inputPath, input);
+        }
+        jobs.push_back({inputPath, tempPath("batch-output")});
+        totalSeconds += static_cast<double>(frames) / kSampleRate;
+
+        // Sequential reference
+        std::string referencePath = tempPath("batch-reference");
+        OfflineProcessor sequential;
+        sequential.setParams(params);
+        sequential.setRawInputFormat(FileFormat::Pcm16, kSampleRate, kChannelCount);
+        CHECK(sequential.process(inputPath, referencePath).ok, "%s, %s: reference failed",
+              name, file.name);
+        references.push_back(referencePath);
+    }
+
+    BatchProcessor batch(kThreads);
+    batch.setParams(params);
+    batch.setRawInputFormat(FileFormat::Pcm16, kSampleRate, kChannelCount);
+    batch.setChunkSeconds(kChunkSeconds);
+    BatchProcessor::Result result = batch.process(jobs);
+
+    printf("%s: %d files in %d tasks on %d threads: %.1f s of audio, %.0fx real time, "
+           "%lld steals\n", name, result.files, result.tasks, result.threads,
+           result.audioSeconds, result.speedFactor(), static_cast<long long>(result.steals));
+    CHECK(result.failedFiles == 0, "%s: %d files failed", name, result.failedFiles);
+    if (split) {
+        CHECK(result.tasks > static_cast<int32_t>(jobs.size()),
+              "%s: long file wasn't split (%d tasks)", name, result.tasks);
+    } else {
+        CHECK(result.tasks == static_cast<int32_t>(jobs.size()),
+              "%s: %d tasks for %zu files", name, result.tasks, jobs.size());
+    }
+    CHECK(std::fabs(result.audioSeconds - totalSeconds) < 1e-3,
+          "%s: processed %.3f s of %.3f s", name, result.audioSeconds, totalSeconds);
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        std::vector<int16_t> output = readFile(jobs[i].outputPath);
+        std::vector<int16_t> reference = readFile(references[i]);
+        CHECK(output.size() == reference.size(), "%s, %s: %zu samples, sequential has %zu",
+              name, kFiles[i].name, output.size(), reference.size());
+        size_t mismatches = 0;
+        int maxError = 0;
+        for (size_t s = 0; s < std::min(output.size(), reference.size()); s++) {
+            int error = std::abs(output[s] - reference[s]);
+            mismatches += error != 0;
+            maxError = std::max(maxError, error);
+        }
+        CHECK(mismatches == 0, "%s, %s: %zu samples differ from sequential (max %d)",
+              name, kFiles[i].name, mismatches, maxError);
+        unlink(jobs[i].inputPath.c_str());
+        unlink(jobs[i].outputPath.c_str());
+        unlink(references[i].c_str());
+    }
+}
+
+} // namespace
+
+int main() {
+    RecorderParams chunkable = allStages();
+    chunkable.autoGainEnabled = false;
+    chunkable.playbackSuppressorEnabled = false;
+    runBatch("chunked", chunkable, true);
+    runBatch("all stages", allStages(), false);
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
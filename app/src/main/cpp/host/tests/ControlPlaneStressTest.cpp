@@ -0,0 +1,214 @@
+/**
+ * Stress test for the recorder's lock-free control plane.
+ *
+ * An "audio" thread drives AudioRecorder::onAudioReady back to back while
+ * several control threads hammer every enable/configure setter with random
+ * values. Afterwards the test checks that the writer never fell behind and
+ * that the last configuration published by the control threads reaches the
+ * audio thread: once everything is switched off, the recorder must write the
+ * input back unchanged.
+ *
+ * Meanwhile a metrics thread keeps taking callback metrics snapshots, which
+ * must always be consistent and in the end account for every callback.
+ *
+ * Build with -DDSP_SANITIZE_THREAD=ON to run it under ThreadSanitizer.
+ */
+
+#include <oboe/Oboe.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "AudioRecorder.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kChannelCount = 1;
+constexpr int32_t kFramesPerBurst = 192;
+constexpr auto kHammerDuration = std::chrono::milliseconds(1500);
+constexpr int kControlThreads = 3;
+
+// Number of bursts recorded after the control threads have settled
+constexpr int kVerifyBursts = 50;
+
+void fillBurst(std::vector<int16_t> &burst, uint32_t &seed) {
+    for (auto &sample : burst) {
+        seed = seed * 1664525u + 1013904223u;
+        sample = static_cast<int16_t>(static_cast<int32_t>(seed >> 16) - 32768) / 4;
+    }
+}
+
+void hammer(AudioRecorder &recorder, unsigned seed, const std::atomic<bool> &running) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    while (running.load(std::memory_order_relaxed)) {
+        switch (rng() % 14) {
+            case 0: recorder.setBandpassFilterEnabled(rng() & 1); break;
+            case 1: recorder.configureBandpassFilter(100.0f + 8000.0f * unit(rng),
+                                                     0.3f + 4.0f * unit(rng)); break;
+            case 2: recorder.setPeakingFilterEnabled(rng() & 1); break;
+            case 3: recorder.configurePeakingFilter(200.0f + 10000.0f * unit(rng),
+                                                    0.3f + 4.0f * unit(rng),
+                                                    -12.0f + 24.0f * unit(rng)); break;
+            case 4: recorder.setHighShelfFilterEnabled(rng() & 1); break;
+            case 5: recorder.configureHighShelfFilter(2000.0f + 15000.0f * unit(rng),
+                                                      0.3f + 2.0f * unit(rng),
+                                                      -12.0f + 24.0f * unit(rng)); break;
+            case 6: recorder.setNoiseGateEnabled(rng() & 1); break;
+            case 7: recorder.configureNoiseGate(-80.0f + 70.0f * unit(rng), 1.0f + 9.0f * unit(rng),
+                                                0.1f + 20.0f * unit(rng),
+                                                1.0f + 200.0f * unit(rng)); break;
+            case 8: recorder.setNoiseReductionEnabled(rng() & 1); break;
+            case 9: recorder.configureNoiseReduction(unit(rng)); break;
+            case 10: recorder.setEchoCancellerEnabled(rng() & 1); break;
+            case 11: recorder.configureEchoCanceller(1.0f + 400.0f * unit(rng), unit(rng)); break;
+            case 12: recorder.setPlaybackSuppressorEnabled(rng() & 1); break;
+            case 13: recorder.configurePlaybackSuppressor(unit(rng)); break;
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    oboe::StubDevice::configure(kSampleRate, kChannelCount, kFramesPerBurst);
+
+    char path[] = "/tmp/control_plane_stress_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0, "mkstemp failed");
+    close(fd);
+
+    auto recorder = std::make_unique<AudioRecorder>();
+    recorder->setStoragePath(path);
+    CHECK(recorder->startRecording() == oboe::Result::OK, "startRecording failed");
+
+    oboe::AudioStreamBuilder builder;
+    builder.setDirection(oboe::Direction::Input)
+            ->setChannelCount(kChannelCount)
+            ->setSampleRate(kSampleRate);
+    std::shared_ptr<oboe::AudioStream> stream;
+    builder.openStream(stream);
+
+    std::atomic<bool> audioRunning{true};
+    std::atomic<bool> controlRunning{true};
+    std::atomic<int64_t> callbacks{0};
+
+    // Runs callbacks at roughly 4x real time so the writer keeps up
+    std::thread audioThread([&] {
+        std::vector<int16_t> burst(kFramesPerBurst * kChannelCount);
+        uint32_t seed = 1;
+        while (audioRunning.load(std::memory_order_relaxed)) {
+            fillBurst(burst, seed);
+            recorder->onAudioReady(stream.get(), burst.data(), kFramesPerBurst);
+            callbacks.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::sleep_for(std::chrono::microseconds(1000));
+        }
+    });
+
+    std::vector<std::thread> controlThreads;
+    for (int i = 0; i < kControlThreads; i++) {
+        controlThreads.emplace_back(hammer, std::ref(*recorder), 1234u + i,
+                                    std::cref(controlRunning));
+    }
+
+    // Snapshots must be whole: the histogram always sums to the callback count
+    std::atomic<int64_t> tornSnapshots{0};
+    std::thread metricsThread([&] {
+        while (controlRunning.load(std::memory_order_relaxed)) {
+            CallbackMetrics::Snapshot metrics = recorder->getCallbackMetrics();
+            int64_t histogramTotal = 0;
+            for (int64_t count : metrics.histogram) histogramTotal += count;
+            if (histogramTotal != metrics.callbacks) {
+                tornSnapshots.fetch_add(1, std::memory_order_relaxed);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+
+    std::this_thread::sleep_for(kHammerDuration);
+    controlRunning.store(false);
+    for (auto &thread : controlThreads) thread.join();
+    metricsThread.join();
+
+    // Final configuration: everything off, so output must equal input
+    recorder->setBandpassFilterEnabled(false);
+    recorder->setPeakingFilterEnabled(false);
+    recorder->setHighShelfFilterEnabled(false);
+    recorder->setNoiseGateEnabled(false);
+    recorder->setNoiseReductionEnabled(false);
+    recorder->setEchoCancellerEnabled(false);
+    recorder->setPlaybackSuppressorEnabled(false);
+
+    // Let at least one callback pick the snapshot up, then stop the free-running thread
+    int64_t settledAt = callbacks.load() + 2;
+    while (callbacks.load() < settledAt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    audioRunning.store(false);
+    audioThread.join();
+    int64_t hammeredCallbacks = callbacks.load();
+
+    // A known tail that must come through untouched
+    std::vector<int16_t> expectedTail;
+    std::vector<int16_t> burst(kFramesPerBurst * kChannelCount);
+    uint32_t seed = 0xC0FFEE;
+    for (int i = 0; i < kVerifyBursts; i++) {
+        fillBurst(burst, seed);
+        expectedTail.insert(expectedTail.end(), burst.begin(), burst.end());
+        recorder->onAudioReady(stream.get(), burst.data(), kFramesPerBurst);
+    }
+
+    // The stream's xrun count is picked up by the next callback
+    stream->addXRuns(3);
+    recorder->onAudioReady(stream.get(), burst.data(), kFramesPerBurst);
+    expectedTail.insert(expectedTail.end(), burst.begin(), burst.end());
+    CallbackMetrics::Snapshot metrics = recorder->getCallbackMetrics();
+
+    int64_t dropped = recorder->getDroppedFrames();
+    recorder->stopRecording();
+
+    std::vector<int16_t> recorded = readFile(path);
+    unlink(path);
+
+    printf("%lld callbacks under parameter churn, %zu samples recorded, %lld frames dropped\n",
+           static_cast<long long>(hammeredCallbacks), recorded.size(),
+           static_cast<long long>(dropped));
+
+    CHECK(hammeredCallbacks > 100, "too few callbacks ran (%lld)",
+          static_cast<long long>(hammeredCallbacks));
+    CHECK(dropped == 0, "writer dropped %lld frames", static_cast<long long>(dropped));
+    CHECK(tornSnapshots.load() == 0, "%lld inconsistent metrics snapshots",
+          static_cast<long long>(tornSnapshots.load()));
+    CHECK(metrics.callbacks == hammeredCallbacks + kVerifyBursts + 1,
+          "metrics counted %lld callbacks, expected %lld", static_cast<long long>(metrics.callbacks),
+          static_cast<long long>(hammeredCallbacks + kVerifyBursts + 1));
+    CHECK(metrics.frames == metrics.callbacks * kFramesPerBurst, "metrics counted %lld frames",
+          static_cast<long long>(metrics.frames));
+    CHECK(metrics.xRunCount == 3, "metrics report %d xruns", metrics.xRunCount);
+    CHECK(recorded.size() >= expectedTail.size(), "recording too short (%zu samples)",
+          recorded.size());
+
+    if (recorded.size() >= expectedTail.size()) {
+        size_t offset = recorded.size() - expectedTail.size();
+        size_t mismatches = 0;
+        for (size_t i = 0; i < expectedTail.size(); i++) {
+            if (recorded[offset + i] != expectedTail[i]) mismatches++;
+        }
+        CHECK(mismatches == 0, "%zu samples of the pass-through tail differ", mismatches);
+    }
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
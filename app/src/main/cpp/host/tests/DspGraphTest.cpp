@@ -0,0 +1,448 @@
+/**
+ * Runtime DSP graph test.
+ *
+ * Graph editing has to keep ids stable and order exact, and the per-type
+ * setters may only touch the classic stage they control. A compiled plan has
+ * to match the modules run by hand in the same order, fuse neighbouring EQ
+ * filters into one step, run its suppressors enabled, and handle several
+ * instances of one type and any order. Through ChainProcessor, a structural edit must keep the state of the
+ * stages that survive it, settings and swaps must never allocate on the audio
+ * side, and a control thread editing the graph while the audio thread runs
+ * must be safe (run this one under ThreadSanitizer too).
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "AudioRecorder.h"
+#include "ChainProcessor.h"
+#include "DspGraph.h"
+#include "ExecutionPlan.h"
+#include "filter/BiquadCascade.h"
+#include "filter/NoiseGate.h"
+#include "filter/NoiseReduction.h"
+#include "filter/PlaybackSuppressor.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr int32_t kBurst = 192;
+constexpr int32_t kBursts = 500;
+constexpr size_t kFrames = static_cast<size_t>(kBurst) * kBursts;
+
+// Speech-band tones with some noise, channel c phase shifted
+std::vector<float> makeSignal(int channels) {
+    std::vector<float> signal(kFrames * channels);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < kFrames; i++) {
+        for (int c = 0; c < channels; c++) {
+            seed = seed * 1664525u + 1013904223u;
+            float noise = static_cast<float>(seed >> 8) / 16777216.0f - 0.5f;
+            float t = static_cast<float>(i) / kSampleRate;
+            signal[i * channels + c] =
+                    0.3f * std::sin(2.0f * static_cast<float>(M_PI) * 440.0f * t + c) +
+                    0.1f * std::sin(2.0f * static_cast<float>(M_PI) * 2500.0f * t) +
+                    0.02f * noise;
+        }
+    }
+    return signal;
+}
+
+float maxDifference(const std::vector<float> &a, const std::vector<float> &b) {
+    float maxError = 0.0f;
+    for (size_t i = 0; i < a.size(); i++) {
+        maxError = std::max(maxError, std::fabs(a[i] - b[i]));
+    }
+    return maxError;
+}
+
+void runPlan(ExecutionPlan &plan, std::vector<float> &buffer, int channels) {
+    for (size_t frame = 0; frame < kFrames; frame += kBurst) {
+        plan.process(buffer.data() + frame * channels, kBurst, nullptr);
+    }
+}
+
+StageConfig filterStage(StageType type, float frequency, float q, float gainDb) {
+    StageConfig stage = StageConfig::defaults(type);
+    stage.frequency = frequency;
+    stage.q = q;
+    stage.gainDb = gainDb;
+    return stage;
+}
+
+BiquadCoefficients design(const StageConfig &stage) {
+    BiquadFilter filter;
+    switch (stage.type) {
+        case StageType::Bandpass:
+            filter.setBandpass(kSampleRate, stage.frequency, stage.q);
+            break;
+        case StageType::Peaking:
+            filter.setPeaking(kSampleRate, stage.frequency, stage.q, stage.gainDb);
+            break;
+        default:
+            filter.setHighShelf(kSampleRate, stage.frequency, stage.q, stage.gainDb);
+            break;
+    }
+    return filter.getCoefficients();
+}
+
+void checkEditing() {
+    DspGraph graph = DspGraph::fromParams(RecorderParams());
+    CHECK(graph.size() == kNumStageTypes, "classic graph has %d stages", graph.size());
+    for (int32_t i = 0; i < graph.size(); i++) {
+        CHECK(graph.stage(i).id == classicStageId(static_cast<StageType>(i)) &&
+              !graph.stage(i).enabled, "classic stage %d out of place or enabled", i);
+    }
+    CHECK(!graph.anyEnabled(), "default graph has an enabled stage");
+
+    const int32_t first = graph.addStage(StageType::Peaking, 0);
+    const int32_t second = graph.addStage(StageType::Peaking);
+    CHECK(first == kFirstUserStageId && second == first + 1, "new ids %d, %d", first, second);
+    CHECK(graph.stage(0).id == first && graph.stage(graph.size() - 1).id == second,
+          "stages not inserted where asked");
+
+    CHECK(graph.moveStage(first, 3) && graph.stage(3).id == first, "move to 3 failed");
+    CHECK(graph.moveStage(second, 0) && graph.stage(0).id == second, "move to 0 failed");
+    CHECK(graph.removeStage(second) && graph.findStage(second) == nullptr, "remove failed");
+    CHECK(!graph.removeStage(second), "removed a stage twice");
+    CHECK(graph.addStage(StageType::Bandpass) == second + 1, "ids reused after a removal");
+
+    // Disabled stages don't count towards the structure
+    DspGraph other = graph;
+    other.findStage(classicStageId(StageType::NoiseGate))->gainDb = 12.0f;
+    CHECK(graph.sameStructure(other), "settings changed the structure");
+    other.findStage(classicStageId(StageType::NoiseGate))->enabled = true;
+    CHECK(!graph.sameStructure(other), "enabling a stage kept the structure");
+    other.removeStage(classicStageId(StageType::Bandpass));
+    other.findStage(classicStageId(StageType::NoiseGate))->enabled = false;
+    CHECK(graph.sameStructure(other), "removing a disabled stage changed the structure");
+
+    while (graph.size() < DspGraph::kMaxStages) {
+        graph.addStage(StageType::NoiseGate);
+    }
+    CHECK(graph.addStage(StageType::NoiseGate) == -1, "added beyond capacity");
+
+    // The classic setters only touch what changed
+    DspGraph classic = DspGraph::fromParams(RecorderParams());
+    classic.findStage(classicStageId(StageType::Peaking))->gainDb = -3.0f;
+    RecorderParams before;
+    RecorderParams after = before;
+    after.noiseGateEnabled = true;
+    after.bandpassFreq = 500.0f;
+    classic.applyClassicParams(before, after);
+    CHECK(classic.findStage(classicStageId(StageType::NoiseGate))->enabled, "gate not enabled");
+    CHECK(classic.findStage(classicStageId(StageType::Bandpass))->frequency == 500.0f,
+          "bandpass frequency not applied");
+    CHECK(classic.findStage(classicStageId(StageType::Peaking))->gainDb == -3.0f,
+          "an unrelated setting was overwritten");
+}
+
+// The classic chain compiled from a graph against its modules run by hand
+void checkClassicOrder() {
+    const int channels = 2;
+    RecorderParams params;
+    params.noiseReductionEnabled = true;
+    params.noiseGateEnabled = true;
+    params.gateThresholdDb = -20.0f;
+    params.bandpassEnabled = true;
+    params.peakingEnabled = true;
+    const DspGraph graph = DspGraph::fromParams(params);
+    auto plan = ExecutionPlan::compile(graph, kSampleRate, channels, kBurst, nullptr);
+    CHECK(plan->getNumSteps() == 3, "classic chain compiled to %d steps", plan->getNumSteps());
+
+    std::vector<float> input = makeSignal(channels);
+    std::vector<float> output = input;
+    runPlan(*plan, output, channels);
+
+    std::vector<NoiseReduction> reductions(channels, NoiseReduction(kSampleRate));
+    for (auto &reduction : reductions) reduction.setReductionAmount(params.noiseReductionAmount);
+    NoiseGate gate;
+    gate.setChannelCount(channels);
+    gate.setThreshold(params.gateThresholdDb);
+    gate.setRatio(params.gateRatio);
+    gate.setAttack(params.gateAttackMs, kSampleRate);
+    gate.setRelease(params.gateReleaseMs, kSampleRate);
+    BiquadCoefficients sections[] = {
+            design(DspGraph::classicStage(params, StageType::Bandpass)),
+            design(DspGraph::classicStage(params, StageType::Peaking))};
+    BiquadCascade cascade;
+    cascade.setChannelCount(channels);
+    cascade.setSections(sections, 2);
+
+    std::vector<float> expected = input;
+    std::vector<float> plane(kBurst);
+    for (size_t frame = 0; frame < kFrames; frame += kBurst) {
+        float *block = expected.data() + frame * channels;
+        for (int c = 0; c < channels; c++) {
+            for (int32_t i = 0; i < kBurst; i++) plane[i] = block[i * channels + c];
+            reductions[c].process(plane.data(), plane.data(), kBurst);
+            for (int32_t i = 0; i < kBurst; i++) block[i * channels + c] = plane[i];
+        }
+        gate.process(block, block, kBurst);
+        cascade.process(block, block, kBurst);
+    }
+    float error = maxDifference(output, expected);
+    CHECK(error == 0.0f, "classic plan differs from the modules by %g", error);
+}
+
+// A suppressor stage runs its module enabled: a steady tone, which stands for
+// playback, comes down by the aggressiveness on every channel
+void checkSuppressor() {
+    const int channels = 2;
+    RecorderParams params;
+    params.playbackSuppressorEnabled = true;
+    auto plan = ExecutionPlan::compile(DspGraph::fromParams(params), kSampleRate, channels,
+                                       kBurst, nullptr);
+
+    std::vector<float> input(kFrames * channels);
+    for (size_t i = 0; i < kFrames; i++) {
+        float t = static_cast<float>(i) / kSampleRate;
+        for (int c = 0; c < channels; c++) {
+            input[i * channels + c] =
+                    0.25f * std::sin(2.0f * static_cast<float>(M_PI) * 440.0f * t + c);
+        }
+    }
+    std::vector<float> output = input;
+    runPlan(*plan, output, channels);
+
+    std::vector<PlaybackSuppressor> suppressors(channels, PlaybackSuppressor(kSampleRate));
+    for (auto &suppressor : suppressors) {
+        suppressor.setEnabled(true);
+        suppressor.setAggressiveness(params.suppressorAggressiveness);
+    }
+    std::vector<float> expected = input;
+    std::vector<float> plane(kBurst);
+    for (size_t frame = 0; frame < kFrames; frame += kBurst) {
+        float *block = expected.data() + frame * channels;
+        for (int c = 0; c < channels; c++) {
+            for (int32_t i = 0; i < kBurst; i++) plane[i] = block[i * channels + c];
+            suppressors[c].process(plane.data(), plane.data(), kBurst);
+            for (int32_t i = 0; i < kBurst; i++) block[i * channels + c] = plane[i];
+        }
+    }
+    float error = maxDifference(output, expected);
+    CHECK(error == 0.0f, "suppressor plan differs from the module by %g", error);
+
+    // Over the second half the gain has long settled at 1 - aggressiveness
+    const float expectedGain = 1.0f - params.suppressorAggressiveness;
+    for (int c = 0; c < channels; c++) {
+        double inPower = 0.0;
+        double outPower = 0.0;
+        for (size_t i = kFrames / 2; i < kFrames; i++) {
+            inPower += input[i * channels + c] * input[i * channels + c];
+            outPower += output[i * channels + c] * output[i * channels + c];
+        }
+        const auto gain = static_cast<float>(std::sqrt(outPower / inPower));
+        CHECK(std::fabs(gain - expectedGain) < 0.02f,
+              "channel %d: tone through the suppressor stage at gain %.3f, expected %.3f",
+              c, gain, expectedGain);
+    }
+}
+
+// Several instances of one type, in an order the classic chain can't express
+void checkInstancesAndOrder() {
+    const int channels = 1;
+    const StageConfig cut = filterStage(StageType::Peaking, 2500.0f, 2.0f, -9.0f);
+    const StageConfig boost = filterStage(StageType::Peaking, 440.0f, 1.0f, 6.0f);
+    const StageConfig shelf = filterStage(StageType::HighShelf, 6000.0f, 0.7f, -4.0f);
+    StageConfig gateStage = StageConfig::defaults(StageType::NoiseGate);
+    gateStage.thresholdDb = -15.0f;
+
+    // cut -> gate -> boost -> shelf: two cascades around the gate
+    DspGraph graph;
+    StageConfig stage = cut;
+    stage.id = 1;
+    graph.insertStage(stage);
+    stage = gateStage;
+    stage.id = 2;
+    graph.insertStage(stage);
+    stage = boost;
+    stage.id = 3;
+    graph.insertStage(stage);
+    stage = shelf;
+    stage.id = 4;
+    graph.insertStage(stage);
+    auto plan = ExecutionPlan::compile(graph, kSampleRate, channels, kBurst, nullptr);
+    CHECK(plan->getNumSteps() == 3, "cut/gate/boost/shelf compiled to %d steps",
+          plan->getNumSteps());
+
+    std::vector<float> output = makeSignal(channels);
+    std::vector<float> expected = output;
+    runPlan(*plan, output, channels);
+
+    BiquadCascade first;
+    BiquadCoefficients firstSections[] = {design(cut)};
+    first.setSections(firstSections, 1);
+    NoiseGate gate;
+    gate.setThreshold(gateStage.thresholdDb);
+    gate.setRatio(gateStage.ratio);
+    gate.setAttack(gateStage.attackMs, kSampleRate);
+    gate.setRelease(gateStage.releaseMs, kSampleRate);
+    BiquadCascade second;
+    BiquadCoefficients secondSections[] = {design(boost), design(shelf)};
+    second.setSections(secondSections, 2);
+    for (size_t frame = 0; frame < kFrames; frame += kBurst) {
+        float *block = expected.data() + frame;
+        first.process(block, block, kBurst);
+        gate.process(block, block, kBurst);
+        second.process(block, block, kBurst);
+    }
+    float error = maxDifference(output, expected);
+    CHECK(error == 0.0f, "cut/gate/boost/shelf differs from the modules by %g", error);
+
+    // Moving the gate last fuses all three filters into one step
+    graph.moveStage(2, 3);
+    plan = ExecutionPlan::compile(graph, kSampleRate, channels, kBurst, nullptr);
+    CHECK(plan->getNumSteps() == 2, "gate moved last: %d steps", plan->getNumSteps());
+
+    // More filters than one cascade holds take another step
+    DspGraph filters;
+    for (int i = 0; i < BiquadCascade::kMaxSections + 2; i++) {
+        filters.addStage(StageType::Bandpass);
+    }
+    plan = ExecutionPlan::compile(filters, kSampleRate, channels, kBurst, nullptr);
+    CHECK(plan->getNumSteps() == 2, "%d filters compiled to %d steps",
+          BiquadCascade::kMaxSections + 2, plan->getNumSteps());
+}
+
+// Inserting a stage mid-stream keeps the state of the ones around it: with
+// a gate that never closes, the output must be what the first graph alone
+// would have produced
+void checkStateAcrossSwap() {
+    const int channels = 2;
+    DspGraph graph;
+    graph.addStage(StageType::NoiseReduction);
+    const int32_t eq = graph.addStage(StageType::Peaking);
+
+    ChainProcessor reference;
+    reference.prepare(kSampleRate, channels, kBurst, graph);
+    ChainProcessor edited;
+    edited.prepare(kSampleRate, channels, kBurst, graph);
+
+    std::vector<float> expected = makeSignal(channels);
+    std::vector<float> output = expected;
+    int64_t allocations = 0;
+    for (int32_t burst = 0; burst < kBursts; burst++) {
+        if (burst == kBursts / 2) {
+            DspGraph withGate = graph;
+            const int32_t gate = withGate.addStage(StageType::NoiseGate, 1);
+            withGate.findStage(gate)->thresholdDb = -200.0f;
+            edited.setGraph(withGate);
+        }
+        const size_t offset = static_cast<size_t>(burst) * kBurst * channels;
+        reference.update();
+        reference.process(expected.data() + offset, kBurst);
+        const int64_t before = allocationCount();
+        edited.update();
+        edited.process(output.data() + offset, kBurst);
+        allocations += allocationCount() - before;
+    }
+    float error = maxDifference(output, expected);
+    CHECK(error <= 1e-6f, "inserting a gate disturbed the other stages by %g", error);
+    CHECK(allocations == 0, "%lld allocations on the audio side across a swap",
+          static_cast<long long>(allocations));
+
+    // Settings alone are applied in place, without allocating either
+    DspGraph louder = graph;
+    louder.findStage(eq)->gainDb = 12.0f;
+    edited.setGraph(louder);
+    const int64_t before = allocationCount();
+    edited.update();
+    edited.process(output.data(), kBurst);
+    CHECK(allocationCount() == before, "a settings change allocated on the audio side");
+}
+
+// A control thread restructures the graph as fast as it can while the audio
+// thread keeps processing
+void checkConcurrentEdits() {
+    const int channels = 2;
+    ChainProcessor chain;
+    DspGraph graph = DspGraph::fromParams(RecorderParams());
+    chain.prepare(kSampleRate, channels, kBurst, graph);
+
+    std::atomic<bool> stop{false};
+    std::thread control([&] {
+        DspGraph edit = graph;
+        uint32_t step = 0;
+        while (!stop.load()) {
+            const auto type = static_cast<StageType>(step % kNumStageTypes);
+            StageConfig *stage = edit.findStage(classicStageId(type));
+            stage->enabled = !stage->enabled;
+            stage->amount = 0.1f * static_cast<float>(step % 10);
+            if (step % 5 == 0) edit.moveStage(stage->id, static_cast<int32_t>(step % 7));
+            chain.setGraph(edit);
+            step++;
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<float> signal = makeSignal(channels);
+    bool finite = true;
+    for (int pass = 0; pass < 4; pass++) {
+        for (int32_t burst = 0; burst < kBursts; burst++) {
+            float *block = signal.data() + static_cast<size_t>(burst) * kBurst * channels;
+            chain.update();
+            chain.process(block, kBurst);
+            for (int32_t i = 0; i < kBurst * channels; i++) {
+                finite &= std::isfinite(block[i]);
+            }
+        }
+    }
+    stop = true;
+    control.join();
+    CHECK(finite, "non-finite output under concurrent edits");
+}
+
+void checkRecorderGraph() {
+    auto recorder = std::make_unique<AudioRecorder>();
+    recorder->setNoiseGateEnabled(true);
+    const int32_t id = recorder->addStage(StageType::Bandpass, 0);
+    recorder->setStageParam(id, StageParam::Frequency, 300.0f);
+    recorder->configureBandpassFilter(2000.0f, 2.0f);
+
+    const DspGraph graph = recorder->getGraph();
+    CHECK(graph.stage(0).id == id && graph.stage(0).frequency == 300.0f,
+          "added stage lost its place or setting");
+    const StageConfig *classic = graph.findStage(classicStageId(StageType::Bandpass));
+    CHECK(classic != nullptr && classic->frequency == 2000.0f && !classic->enabled,
+          "classic bandpass not configured by its setter");
+    CHECK(graph.findStage(classicStageId(StageType::NoiseGate))->enabled, "gate not enabled");
+
+    // A classic setter changes only its own settings of the stage: one set
+    // through the stage API, which the setter doesn't cover, survives
+    const int32_t gateId = classicStageId(StageType::NoiseGate);
+    recorder->setStageParam(gateId, StageParam::GainDb, 6.0f);
+    recorder->setStageParam(gateId, StageParam::Ratio, 8.0f);
+    recorder->configureNoiseGate(-30.0f, 8.0f, 5.0f, 50.0f);
+    const StageConfig *gate = recorder->getGraph().findStage(gateId);
+    CHECK(gate->thresholdDb == -30.0f, "gate threshold not configured by its setter");
+    CHECK(gate->gainDb == 6.0f, "the gate setter wiped a setting made through the stage API");
+    CHECK(gate->ratio == 8.0f, "gate ratio %.1f", gate->ratio);
+
+    recorder->resetGraph();
+    CHECK(recorder->getGraph().findStage(id) == nullptr, "reset kept the added stage");
+}
+
+} // namespace
+
+int main() {
+    checkEditing();
+    checkClassicOrder();
+    checkSuppressor();
+    checkInstancesAndOrder();
+    checkStateAcrossSwap();
+    checkConcurrentEdits();
+    checkRecorderGraph();
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
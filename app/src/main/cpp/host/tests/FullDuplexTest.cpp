@@ -0,0 +1,416 @@
+/**
+ * Tests for FullDuplexEngine on a simulated duplex device.
+ *
+ * SimulatedDuplexDriver plays the device: each tick captures a block into the
+ * engine's input stream and asks its output callback for one, with the output
+ * fed back into the input through a loopback of known delay. The tests check
+ * that:
+ *  - monitored output is the input exactly getLatencyFrames() later, through
+ *    callbacks of varying size, and the recording holds the same frames;
+ *  - jitter in when input arrives, up to the cushion, changes nothing;
+ *  - input that comes later than the cushion is played as silence without
+ *    moving the frames after it, and input running ahead is cut back to the
+ *    cushion;
+ *  - monitored input comes back through the loopback exactly a round trip
+ *    (the cushion plus the loopback delay) later;
+ *  - the echo canceller's far end lines up with the loopback sample for
+ *    sample: with its delay set to the loopback's, it removes most of the
+ *    echo of a cue played with mixPlayback(), and with another delay it
+ *    can't;
+ *  - graph edits and monitoring changes from another thread while the
+ *    callback runs leave the clock intact.
+ *
+ * Build with -DDSP_SANITIZE_THREAD=ON to run it under ThreadSanitizer.
+ */
+
+#include <oboe/Oboe.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+#include "FullDuplexEngine.h"
+#include "SimulatedDuplexDriver.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kFramesPerBurst = 192;
+constexpr int32_t kLatency = FullDuplexEngine::kDefaultCushionBursts * kFramesPerBurst;
+
+// Enough ticks to get through draining and the cushion
+constexpr int kMaxStartTicks = 100;
+
+std::vector<float> noise(size_t frames, float amplitude, uint32_t seed) {
+    std::vector<float> signal(frames);
+    for (auto &sample : signal) {
+        seed = seed * 1664525u + 1013904223u;
+        sample = amplitude * (static_cast<float>(seed >> 8) / 8388608.0f - 1.0f);
+    }
+    return signal;
+}
+
+std::vector<float> readFloats(const std::string &path) {
+    std::vector<float> samples;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return samples;
+    float buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, sizeof(float), 4096, file)) > 0) {
+        samples.insert(samples.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return samples;
+}
+
+// Ticks in bursts until the engine has built its cushion. Returns the output
+// frame the running clock starts at.
+size_t synchronize(FullDuplexEngine &engine, SimulatedDuplexDriver &driver) {
+    for (int i = 0; i < kMaxStartTicks && !engine.isSynchronized(); i++) {
+        driver.tick(kFramesPerBurst);
+    }
+    CHECK(engine.isSynchronized(), "engine never synchronized");
+    return driver.getOutput().size();
+}
+
+// Counts output frames in [from, to) that aren't the input `latency` frames earlier
+int64_t countMisaligned(const SimulatedDuplexDriver &driver, int64_t latency, size_t from,
+                        size_t to) {
+    const std::vector<float> &output = driver.getOutput();
+    const std::vector<float> &input = driver.getInput();
+    int64_t misaligned = 0;
+    for (size_t o = from; o < to; o++) {
+        const int64_t i = static_cast<int64_t>(o) - latency;
+        const float expected = i >= 0 && i < static_cast<int64_t>(input.size()) ? input[i] : 0.0f;
+        if (output[o] != expected) {
+            misaligned++;
+        }
+    }
+    return misaligned;
+}
+
+void prepareDevice(FullDuplexEngine &engine, const char *name = nullptr) {
+    oboe::StubDevice::configure(kSampleRate, 1, kFramesPerBurst);
+    if (name != nullptr) {
+        engine.setStoragePath(processTempPath("full-duplex-test", name).c_str());
+        engine.setFileFormat(FileFormat::Float32);
+    }
+    engine.setMonitoringEnabled(true);
+    engine.setMonitorGain(1.0f);
+}
+
+// Callbacks of varying size; the output is the input a fixed latency later and
+// the recording holds exactly what was monitored
+void testFixedLatency() {
+    FullDuplexEngine engine;
+    prepareDevice(engine, "latency");
+    CHECK(engine.start() == oboe::Result::OK, "start failed");
+    CHECK(engine.getLatencyFrames() == kLatency, "latency %d, expected %d",
+          engine.getLatencyFrames(), kLatency);
+
+    SimulatedDuplexDriver driver(engine.getInputStream(), engine.getOutputStream());
+    driver.setNearEnd(noise(kSampleRate * 4, 0.5f, 1));
+    const size_t start = synchronize(engine, driver);
+
+    uint32_t seed = 7;
+    for (int i = 0; i < 500; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        driver.tick(96 + static_cast<int32_t>(seed >> 16) % (2 * kLatency / 3));
+    }
+    const size_t end = driver.getOutput().size();
+    engine.stop();
+
+    CHECK(countMisaligned(driver, kLatency, start, end) == 0,
+          "%lld frames not aligned", static_cast<long long>(countMisaligned(driver, kLatency,
+                                                                              start, end)));
+    CHECK(engine.getLateFrames() == 0 && engine.getResyncCount() == 0,
+          "late %lld, resyncs %lld", static_cast<long long>(engine.getLateFrames()),
+          static_cast<long long>(engine.getResyncCount()));
+
+    const std::vector<float> recorded = readFloats(processTempPath("full-duplex-test", "latency"));
+    CHECK(recorded.size() == end - start, "recorded %zu frames, played %zu", recorded.size(),
+          end - start);
+    int64_t differing = 0;
+    for (size_t k = 0; k < recorded.size() && start + k < end; k++) {
+        differing += recorded[k] != driver.getOutput()[start + k];
+    }
+    CHECK(differing == 0, "%lld recorded frames differ from the monitored ones",
+          static_cast<long long>(differing));
+    unlink(processTempPath("full-duplex-test", "latency").c_str());
+}
+
+// Input arriving early or late by up to the cushion doesn't move anything
+void testInputJitter() {
+    FullDuplexEngine engine;
+    prepareDevice(engine);
+    CHECK(engine.start() == oboe::Result::OK, "start failed");
+    SimulatedDuplexDriver driver(engine.getInputStream(), engine.getOutputStream());
+    driver.setNearEnd(noise(kSampleRate * 2, 0.5f, 2));
+    const size_t start = synchronize(engine, driver);
+
+    // Every four ticks the input catches up with the output
+    const int32_t pattern[] = {0, 2 * kFramesPerBurst, kFramesPerBurst / 2,
+                               3 * kFramesPerBurst / 2};
+    for (int i = 0; i < 200; i++) {
+        driver.tick(kFramesPerBurst, pattern[i % 4]);
+    }
+    const size_t end = driver.getOutput().size();
+    engine.stop();
+
+    CHECK(countMisaligned(driver, kLatency, start, end) == 0, "jitter moved frames");
+    CHECK(engine.getLateFrames() == 0 && engine.getResyncCount() == 0,
+          "late %lld, resyncs %lld", static_cast<long long>(engine.getLateFrames()),
+          static_cast<long long>(engine.getResyncCount()));
+}
+
+// An input stall longer than the cushion is played as silence; the frames
+// after it stay in their slots
+void testLateInput() {
+    FullDuplexEngine engine;
+    prepareDevice(engine);
+    CHECK(engine.start() == oboe::Result::OK, "start failed");
+    SimulatedDuplexDriver driver(engine.getInputStream(), engine.getOutputStream());
+    driver.setNearEnd(noise(kSampleRate * 2, 0.5f, 3));
+    synchronize(engine, driver);
+
+    for (int i = 0; i < 20; i++) {
+        driver.tick(kFramesPerBurst);
+    }
+    constexpr int kStallTicks = 4;
+    for (int i = 0; i < kStallTicks; i++) {
+        driver.tick(kFramesPerBurst, 0);
+    }
+    driver.tick(kFramesPerBurst, (kStallTicks + 1) * kFramesPerBurst);
+    const size_t recovered = driver.getOutput().size();
+    for (int i = 0; i < 100; i++) {
+        driver.tick(kFramesPerBurst);
+    }
+    const size_t end = driver.getOutput().size();
+    engine.stop();
+
+    const int64_t expectedLate = kStallTicks * kFramesPerBurst - kLatency;
+    CHECK(engine.getLateFrames() == expectedLate, "late %lld, expected %lld",
+          static_cast<long long>(engine.getLateFrames()), static_cast<long long>(expectedLate));
+    CHECK(engine.getResyncCount() == 0, "resynced after a stall");
+    CHECK(countMisaligned(driver, kLatency, recovered, end) == 0,
+          "frames after the stall moved");
+}
+
+// Input running further ahead than the cushion allows is cut back to it
+void testInputAhead() {
+    FullDuplexEngine engine;
+    prepareDevice(engine);
+    CHECK(engine.start() == oboe::Result::OK, "start failed");
+    SimulatedDuplexDriver driver(engine.getInputStream(), engine.getOutputStream());
+    driver.setNearEnd(noise(kSampleRate * 2, 0.5f, 4));
+    const size_t start = synchronize(engine, driver);
+
+    for (int i = 0; i < 20; i++) {
+        driver.tick(kFramesPerBurst);
+    }
+    constexpr int32_t kAhead = (FullDuplexEngine::kMaxExtraBursts + 1) * kFramesPerBurst;
+    driver.tick(kFramesPerBurst, kFramesPerBurst + kAhead);
+    const size_t after = driver.getOutput().size();
+    for (int i = 0; i < 100; i++) {
+        driver.tick(kFramesPerBurst);
+    }
+    const size_t end = driver.getOutput().size();
+    engine.stop();
+
+    CHECK(engine.getResyncCount() == 1, "resyncs %lld",
+          static_cast<long long>(engine.getResyncCount()));
+    CHECK(engine.getLateFrames() == 0, "late frames while ahead");
+    CHECK(countMisaligned(driver, kLatency, start, after) == 0, "frames before the cut moved");
+    CHECK(countMisaligned(driver, kLatency - kAhead, after, end) == 0,
+          "not back at the cushion after the cut");
+}
+
+// Monitored output comes back through the loopback a round trip later: the
+// cushion plus the loopback delay
+void testRoundTrip() {
+    FullDuplexEngine engine;
+    prepareDevice(engine);
+    CHECK(engine.start() == oboe::Result::OK, "start failed");
+    SimulatedDuplexDriver driver(engine.getInputStream(), engine.getOutputStream());
+    constexpr int32_t kLoopbackDelay = kSampleRate / 50;
+    constexpr size_t kImpulse = 10000;
+    std::vector<float> nearEnd(kImpulse + 1, 0.0f);
+    nearEnd[kImpulse] = 0.5f;
+    driver.setNearEnd(nearEnd);
+    driver.setLoopback(kLoopbackDelay, 0.5f);
+    synchronize(engine, driver);
+    CHECK(driver.getOutput().size() < kImpulse, "synchronized too late for the impulse");
+    for (int i = 0; i < 150; i++) {
+        driver.tick(kFramesPerBurst);
+    }
+    engine.stop();
+
+    // The impulse, then each pass through the loop at half the level
+    const std::vector<float> &output = driver.getOutput();
+    size_t expected = kImpulse + kLatency;
+    float level = 0.5f;
+    int passes = 0;
+    for (size_t o = 0; o < output.size(); o++) {
+        if (o == expected) {
+            CHECK(output[o] == level, "pass %d: %g at %zu, expected %g", passes, output[o], o,
+                  level);
+            expected += kLatency + kLoopbackDelay;
+            level *= 0.5f;
+            passes++;
+        } else {
+            CHECK(output[o] == 0.0f, "%g at %zu, between passes", output[o], o);
+        }
+    }
+    CHECK(passes >= 3, "only %d passes through the loop", passes);
+}
+
+// Plays a cue over the monitored input
+class CueEngine : public FullDuplexEngine {
+public:
+    explicit CueEngine(std::vector<float> cue) : mCue(std::move(cue)) {}
+
+protected:
+    void mixPlayback(float *output, int32_t numFrames, int32_t channelCount) override {
+        for (int32_t i = 0; i < numFrames && mPosition < mCue.size(); i++, mPosition++) {
+            for (int32_t c = 0; c < channelCount; c++) {
+                output[static_cast<size_t>(i) * channelCount + c] += mCue[mPosition];
+            }
+        }
+    }
+
+private:
+    std::vector<float> mCue;
+    size_t mPosition = 0;
+};
+
+// Records over a noise cue that comes back through a 20 ms loopback; returns
+// the recording
+std::vector<float> recordOverCue(float echoDelayMs, float suppression, float loopbackGain) {
+    CueEngine engine(noise(kSampleRate * 8, 0.3f, 5));
+    prepareDevice(engine, "echo");
+    engine.setMonitoringEnabled(false);
+    DspGraph graph;
+    StageConfig *canceller = graph.findStage(graph.addStage(StageType::EchoCanceller));
+    canceller->delayMs = echoDelayMs;
+    canceller->amount = suppression;
+    engine.setGraph(graph);
+    CHECK(engine.start() == oboe::Result::OK, "start failed");
+
+    SimulatedDuplexDriver driver(engine.getInputStream(), engine.getOutputStream());
+    driver.setNearEnd(noise(kSampleRate * 8, 0.001f, 6));
+    driver.setLoopback(kSampleRate / 50, loopbackGain);
+    for (int i = 0; i < 6 * kSampleRate / kFramesPerBurst; i++) {
+        driver.tick(kFramesPerBurst);
+    }
+    engine.stop();
+    std::vector<float> recorded = readFloats(processTempPath("full-duplex-test", "echo"));
+    unlink(processTempPath("full-duplex-test", "echo").c_str());
+    return recorded;
+}
+
+// Echo left in run over the last two seconds, relative to the echo in
+// uncancelled, both against the echo-free clean run
+double echoReductionDb(const std::vector<float> &run, const std::vector<float> &uncancelled,
+                       const std::vector<float> &clean) {
+    const size_t length = std::min({run.size(), uncancelled.size(), clean.size()});
+    double residual = 0.0;
+    double echo = 0.0;
+    for (size_t i = length - 2 * kSampleRate; i < length; i++) {
+        residual += std::pow(static_cast<double>(run[i]) - clean[i], 2.0);
+        echo += std::pow(static_cast<double>(uncancelled[i]) - clean[i], 2.0);
+    }
+    return 10.0 * std::log10(echo / std::max(residual, 1e-20));
+}
+
+// The far end is the output that played in the slot of the block being
+// cancelled, so the canceller's delay is just the loopback's
+void testEchoReference() {
+    const float loopbackMs = 1000.0f / 50.0f;
+    const std::vector<float> clean = recordOverCue(loopbackMs, 1.0f, 0.0f);
+    const std::vector<float> uncancelled = recordOverCue(loopbackMs, 0.0f, 0.5f);
+    const std::vector<float> cancelled = recordOverCue(loopbackMs, 1.0f, 0.5f);
+    const std::vector<float> misaligned = recordOverCue(loopbackMs + 500.0f, 1.0f, 0.5f);
+    CHECK(clean.size() > 3 * kSampleRate, "recorded only %zu frames", clean.size());
+    if (clean.size() <= 3 * kSampleRate) {
+        return;
+    }
+
+    const double aligned = echoReductionDb(cancelled, uncancelled, clean);
+    const double offset = echoReductionDb(misaligned, uncancelled, clean);
+    printf("Echo reduction: %.1f dB with the loopback's delay, %.1f dB without\n", aligned,
+           offset);
+    CHECK(aligned > 15.0, "only %.1f dB of echo removed", aligned);
+    CHECK(offset < 6.0, "%.1f dB removed with the wrong delay", offset);
+}
+
+// Edits from another thread while the callback runs
+void testConcurrentEdits() {
+    FullDuplexEngine engine;
+    prepareDevice(engine);
+    CHECK(engine.start() == oboe::Result::OK, "start failed");
+    SimulatedDuplexDriver driver(engine.getInputStream(), engine.getOutputStream());
+    driver.setNearEnd(noise(kSampleRate * 8, 0.3f, 6));
+    synchronize(engine, driver);
+
+    std::atomic<bool> done{false};
+    std::thread control([&] {
+        uint32_t seed = 11;
+        while (!done.load()) {
+            seed = seed * 1664525u + 1013904223u;
+            DspGraph graph;
+            const int32_t stages = static_cast<int32_t>(seed >> 28) % 4;
+            for (int32_t s = 0; s < stages; s++) {
+                graph.addStage(static_cast<StageType>((seed >> (4 * s)) % kNumStageTypes));
+            }
+            engine.setGraph(graph);
+            engine.setMonitoringEnabled((seed & 1) != 0);
+            engine.setMonitorGain(static_cast<float>(seed % 100) / 100.0f);
+            std::this_thread::yield();
+        }
+    });
+    for (int i = 0; i < 400; i++) {
+        driver.tick(kFramesPerBurst);
+    }
+    done.store(true);
+    control.join();
+
+    // Back to a plain monitor: the clock must not have moved
+    engine.setGraph(DspGraph());
+    engine.setMonitoringEnabled(true);
+    engine.setMonitorGain(1.0f);
+    driver.tick(kFramesPerBurst);
+    const size_t from = driver.getOutput().size();
+    for (int i = 0; i < 100; i++) {
+        driver.tick(kFramesPerBurst);
+    }
+    const size_t end = driver.getOutput().size();
+    engine.stop();
+
+    CHECK(countMisaligned(driver, kLatency, from, end) == 0, "clock moved during edits");
+    CHECK(engine.getLateFrames() == 0 && engine.getResyncCount() == 0,
+          "late %lld, resyncs %lld", static_cast<long long>(engine.getLateFrames()),
+          static_cast<long long>(engine.getResyncCount()));
+}
+
+} // namespace
+
+int main() {
+    testFixedLatency();
+    testInputJitter();
+    testLateInput();
+    testInputAhead();
+    testRoundTrip();
+    testEchoReference();
+    testConcurrentEdits();
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
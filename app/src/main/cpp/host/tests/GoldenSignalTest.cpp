@@ -0,0 +1,849 @@
+/**
+ * Golden-signal regression test for the filter modules and the full chain.
+ *
+ * Every module runs, in callback-sized bursts, over a deterministic corpus:
+ * a logarithmic sine sweep, white and pink noise, an impulse, steady tones
+ * and a synthetic speech-like signal (a harmonic source with a wandering
+ * pitch, shaped by three formants and cut into syllables and pauses). What
+ * it did is reduced to named metrics that mean something for that module:
+ *  - each BiquadFilter mode's magnitude response, measured with tones and
+ *    checked against the response of its own coefficients, and its impulse
+ *    response energy;
+ *  - the gate's close and open times and its attenuation below threshold;
+ *  - noise reduction's attenuation of white and pink noise and what it
+ *    leaves of speech;
+ *  - the echo canceller's echo return loss enhancement on pink noise and
+ *    on speech;
+ *  - the suppressor's output level on speech and on a steady tone, and the
+ *    share of the speech its detector hears as speech;
+ *  - the resampler's output level;
+ *  - the auto gain's level on quiet speech, its latency, and the peak it
+ *    lets through of speech driven far past full scale;
+ *  - the full classic chain's output level over the speech signal,
+ *    segment by segment.
+ * Each metric is compared with the golden value stored for it, within that
+ * value's tolerance. An optimized kernel must also match the reference it
+ * replaces: the fused SIMD cascade against BiquadFilters in series, the
+ * block gate against the per-sample one, the vector auto gain against its
+ * per-frame path, and the vector conversions against scalar loops.
+ *
+ * Throughput is recorded alongside: ns/sample for every module, and the
+ * speedup of each optimized kernel over its reference. It's printed and,
+ * with --throughput, written as CSV. It is never checked, as it depends on
+ * the machine, but it shows whether an optimization that passes the golden
+ * values also made things faster.
+ *
+ * Usage: golden-signal-test GOLDEN_FILE [--update] [--throughput CSV]
+ * --update rewrites GOLDEN_FILE from this run, for a deliberate change in
+ * behaviour; review the diff before committing it.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DspGraph.h"
+#include "ExecutionPlan.h"
+#include "filter/AutoGain.h"
+#include "filter/BiquadCascade.h"
+#include "filter/BiquadFilter.h"
+#include "filter/EchoCanceller.h"
+#include "filter/NoiseGate.h"
+#include "filter/NoiseReduction.h"
+#include "filter/PlaybackSuppressor.h"
+#include "filter/PolyphaseResampler.h"
+#include "filter/SampleConversion.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr int32_t kBurst = 192;
+constexpr size_t kSignalFrames = kSampleRate * 4;
+constexpr int kTimingRuns = 3;
+
+// Tolerances by kind of metric
+constexpr double kLevelToleranceDb = 0.1;
+constexpr double kAdaptiveToleranceDb = 1.0;  // NR, EC: adaptive, more rounding sensitive
+constexpr double kTimeToleranceMs = 0.1;
+
+// Optimized kernels against their references
+constexpr float kKernelTolerance = 1e-5f;
+
+struct Metric {
+    std::string name;
+    double value;
+    double tolerance;
+};
+
+struct Timing {
+    std::string name;
+    double nsPerSample;
+    double speedup;  // over the reference kernel, 0 if there is none
+};
+
+std::vector<Metric> gMetrics;
+std::vector<Timing> gTimings;
+
+void record(const std::string &name, double value, double tolerance) {
+    gMetrics.push_back({name, value, tolerance});
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Best of kTimingRuns runs of run(), per sample of numSamples
+template<typename Run>
+double timePerSample(size_t numSamples, Run &&run) {
+    int64_t best = INT64_MAX;
+    for (int i = 0; i < kTimingRuns; i++) {
+        const int64_t startNs = nowNs();
+        run();
+        best = std::min(best, nowNs() - startNs);
+    }
+    return static_cast<double>(best) / static_cast<double>(numSamples);
+}
+
+void recordTiming(const std::string &name, double nsPerSample, double referenceNs = 0.0) {
+    gTimings.push_back({name, nsPerSample, referenceNs > 0.0 ? referenceNs / nsPerSample : 0.0});
+}
+
+// ---- Signals ----
+
+// Deterministic white noise in [-1, 1)
+class WhiteNoise {
+public:
+    explicit WhiteNoise(uint32_t seed) : mState(seed) {}
+
+    float next() {
+        mState = mState * 1664525u + 1013904223u;
+        return static_cast<float>(mState >> 8) / 8388608.0f - 1.0f;
+    }
+
+private:
+    uint32_t mState;
+};
+
+std::vector<float> whiteNoise(size_t frames, float amplitude, uint32_t seed) {
+    WhiteNoise noise(seed);
+    std::vector<float> signal(frames);
+    for (auto &sample : signal) sample = amplitude * noise.next();
+    return signal;
+}
+
+// Pink (-3 dB/octave) noise from Paul Kellet's filter, normalized to rms
+std::vector<float> pinkNoise(size_t frames, float rms, uint32_t seed) {
+    WhiteNoise noise(seed);
+    std::vector<float> signal(frames);
+    float b0 = 0, b1 = 0, b2 = 0, b3 = 0, b4 = 0, b5 = 0, b6 = 0;
+    double sumSquares = 0.0;
+    for (auto &sample : signal) {
+        const float white = noise.next();
+        b0 = 0.99886f * b0 + white * 0.0555179f;
+        b1 = 0.99332f * b1 + white * 0.0750759f;
+        b2 = 0.96900f * b2 + white * 0.1538520f;
+        b3 = 0.86650f * b3 + white * 0.3104856f;
+        b4 = 0.55000f * b4 + white * 0.5329522f;
+        b5 = -0.7616f * b5 - white * 0.0168980f;
+        sample = b0 + b1 + b2 + b3 + b4 + b5 + b6 + white * 0.5362f;
+        b6 = white * 0.115926f;
+        sumSquares += static_cast<double>(sample) * sample;
+    }
+    const auto scale = static_cast<float>(rms / std::sqrt(sumSquares / frames));
+    for (auto &sample : signal) sample *= scale;
+    return signal;
+}
+
+// Exponential sweep from 20 Hz to 20 kHz
+std::vector<float> sineSweep(size_t frames, float amplitude) {
+    std::vector<float> signal(frames);
+    const double duration = static_cast<double>(frames) / kSampleRate;
+    const double k = std::log(20000.0 / 20.0);
+    for (size_t i = 0; i < frames; i++) {
+        const double t = static_cast<double>(i) / kSampleRate;
+        const double phase = 2.0 * M_PI * 20.0 * duration / k * (std::exp(t / duration * k) - 1.0);
+        signal[i] = amplitude * static_cast<float>(std::sin(phase));
+    }
+    return signal;
+}
+
+std::vector<float> tone(size_t frames, float frequency, float amplitude) {
+    std::vector<float> signal(frames);
+    for (size_t i = 0; i < frames; i++) {
+        signal[i] = amplitude * static_cast<float>(
+                std::sin(2.0 * M_PI * frequency * static_cast<double>(i) / kSampleRate));
+    }
+    return signal;
+}
+
+// A harmonic source with a wandering pitch through three formants, in
+// syllables of ~200 ms with a pause every third one and a little breath noise
+std::vector<float> speechLike(size_t frames, uint32_t seed) {
+    struct Formant {
+        float frequency;
+        float bandwidth;
+        float gain;
+    };
+    const Formant formants[3] = {{700.0f, 130.0f, 1.0f}, {1220.0f, 70.0f, 0.5f},
+                                 {2600.0f, 160.0f, 0.25f}};
+    WhiteNoise noise(seed);
+    std::vector<float> signal(frames);
+    double phase = 0.0;
+    for (size_t i = 0; i < frames; i++) {
+        const double t = static_cast<double>(i) / kSampleRate;
+        const double f0 = 140.0 + 30.0 * std::sin(2.0 * M_PI * 0.7 * t) +
+                          10.0 * std::sin(2.0 * M_PI * 3.1 * t);
+        phase += 2.0 * M_PI * f0 / kSampleRate;
+
+        // Harmonics weighted by the formant resonances
+        double voiced = 0.0;
+        for (int h = 1; h * f0 < 4000.0; h++) {
+            const double frequency = h * f0;
+            double weight = 0.0;
+            for (const Formant &formant : formants) {
+                const double offset = (frequency - formant.frequency) / formant.bandwidth;
+                weight += formant.gain / (1.0 + offset * offset);
+            }
+            voiced += weight / h * std::sin(h * phase);
+        }
+
+        // Syllable envelope: raised cosine, silent every third syllable
+        const auto syllable = static_cast<int64_t>(t / 0.2);
+        const double position = t / 0.2 - static_cast<double>(syllable);
+        const double envelope = syllable % 3 == 2 ? 0.0 : 0.5 - 0.5 * std::cos(2.0 * M_PI * position);
+        signal[i] = static_cast<float>(0.25 * envelope * voiced) + 0.003f * noise.next();
+    }
+    return signal;
+}
+
+// ---- Measurements ----
+
+double rms(const float *samples, size_t count) {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) sum += static_cast<double>(samples[i]) * samples[i];
+    return std::sqrt(sum / std::max<size_t>(count, 1));
+}
+
+double toDb(double ratio) {
+    return 20.0 * std::log10(std::max(ratio, 1e-12));
+}
+
+// Level of out relative to in over [begin, end)
+double gainDb(const std::vector<float> &in, const std::vector<float> &out, size_t begin,
+              size_t end) {
+    return toDb(rms(out.data() + begin, end - begin) / rms(in.data() + begin, end - begin));
+}
+
+float maxDifference(const std::vector<float> &a, const std::vector<float> &b) {
+    float maxError = 0.0f;
+    for (size_t i = 0; i < a.size(); i++) maxError = std::max(maxError, std::fabs(a[i] - b[i]));
+    return maxError;
+}
+
+// |H(f)| in dB of the biquad's own coefficients
+double responseDb(const BiquadCoefficients &c, double frequency) {
+    const std::complex<double> z1 = std::polar(1.0, -2.0 * M_PI * frequency / kSampleRate);
+    const std::complex<double> z2 = z1 * z1;
+    const std::complex<double> h = (double(c.b0) + double(c.b1) * z1 + double(c.b2) * z2) /
+                                   (1.0 + double(c.a1) * z1 + double(c.a2) * z2);
+    return toDb(std::abs(h));
+}
+
+// Runs process(in, out, count) over a whole signal in bursts
+template<typename Process>
+void inBursts(const std::vector<float> &in, std::vector<float> &out, Process &&process) {
+    out.resize(in.size());
+    for (size_t offset = 0; offset < in.size(); offset += kBurst) {
+        const auto count = static_cast<int32_t>(std::min<size_t>(kBurst, in.size() - offset));
+        process(in.data() + offset, out.data() + offset, count, offset);
+    }
+}
+
+// ---- Modules ----
+
+struct FilterMode {
+    const char *name;
+    void (*design)(BiquadFilter &filter);
+};
+
+const FilterMode kFilterModes[] = {
+        {"bandpass", [](BiquadFilter &f) { f.setBandpass(kSampleRate, 1000.0f, 1.0f); }},
+        {"peaking", [](BiquadFilter &f) { f.setPeaking(kSampleRate, 3000.0f, 1.0f, 6.0f); }},
+        {"highshelf", [](BiquadFilter &f) { f.setHighShelf(kSampleRate, 8000.0f, 0.7f, 3.0f); }},
+};
+
+void checkBiquads() {
+    const float frequencies[] = {100.0f, 300.0f, 1000.0f, 3000.0f, 8000.0f, 16000.0f};
+    const size_t toneFrames = kSampleRate / 4;
+    const size_t settled = kSampleRate / 10;  // measured after this
+
+    for (const FilterMode &mode : kFilterModes) {
+        const std::string prefix = std::string("biquad.") + mode.name;
+        for (float frequency : frequencies) {
+            BiquadFilter filter;
+            mode.design(filter);
+            const std::vector<float> in = tone(toneFrames, frequency, 0.5f);
+            std::vector<float> out;
+            inBursts(in, out, [&](const float *src, float *dst, int32_t n, size_t) {
+                filter.process(src, dst, n);
+            });
+            const double measured = gainDb(in, out, settled, toneFrames);
+            const double expected = responseDb(filter.getCoefficients(), frequency);
+            CHECK(std::fabs(measured - expected) < 0.05,
+                  "%s at %.0f Hz: measured %.3f dB, coefficients give %.3f dB", mode.name,
+                  frequency, measured, expected);
+            char name[96];
+            snprintf(name, sizeof(name), "%s.response_db.%.0fhz", prefix.c_str(), frequency);
+            record(name, measured, kLevelToleranceDb);
+        }
+
+        BiquadFilter filter;
+        mode.design(filter);
+        double energy = 0.0;
+        for (int i = 0; i < kSampleRate / 10; i++) {
+            const float y = filter.process(i == 0 ? 1.0f : 0.0f);
+            energy += static_cast<double>(y) * y;
+        }
+        record(prefix + ".impulse_energy_db", 10.0 * std::log10(energy), kLevelToleranceDb);
+
+        const std::vector<float> sweep = sineSweep(kSignalFrames, 0.5f);
+        std::vector<float> out;
+        mode.design(filter);
+        const double ns = timePerSample(sweep.size(), [&] {
+            filter.reset();
+            inBursts(sweep, out, [&](const float *src, float *dst, int32_t n, size_t) {
+                filter.process(src, dst, n);
+            });
+        });
+        record(prefix + ".sweep_gain_db", gainDb(sweep, out, 0, sweep.size()), kLevelToleranceDb);
+        recordTiming(prefix, ns);
+    }
+}
+
+// The three modes fused in one SIMD cascade against the same filters in series
+void checkCascade() {
+    BiquadFilter filters[3];
+    BiquadCoefficients sections[3];
+    for (int i = 0; i < 3; i++) {
+        kFilterModes[i].design(filters[i]);
+        sections[i] = filters[i].getCoefficients();
+    }
+    const std::vector<float> speech = speechLike(kSignalFrames, 7);
+
+    std::vector<float> serial;
+    const double serialNs = timePerSample(speech.size(), [&] {
+        for (auto &filter : filters) filter.reset();
+        inBursts(speech, serial, [&](const float *src, float *dst, int32_t n, size_t) {
+            filters[0].process(src, dst, n);
+            filters[1].process(dst, dst, n);
+            filters[2].process(dst, dst, n);
+        });
+    });
+
+    BiquadCascade cascade;
+    cascade.setSections(sections, 3);
+    std::vector<float> fused;
+    const double fusedNs = timePerSample(speech.size(), [&] {
+        cascade.reset();
+        inBursts(speech, fused, [&](const float *src, float *dst, int32_t n, size_t) {
+            cascade.process(src, dst, n);
+        });
+    });
+
+    float error = maxDifference(serial, fused);
+    CHECK(error <= kKernelTolerance, "cascade differs from serial biquads by %g", error);
+    record("cascade.eq3.speech_gain_db", gainDb(speech, fused, 0, speech.size()),
+           kLevelToleranceDb);
+    recordTiming("biquad.serial3", serialNs);
+    recordTiming("cascade.eq3", fusedNs, serialNs);
+}
+
+void checkGate() {
+    // Loud tone, a drop to -60 dBFS (below the -40 dB threshold), then loud again
+    const size_t stepFrames = kSampleRate / 2;
+    std::vector<float> in = tone(3 * stepFrames, 1000.0f, 0.5f);
+    for (size_t i = stepFrames; i < 2 * stepFrames; i++) in[i] *= 0.002f;
+
+    NoiseGate gate;
+    gate.setThreshold(-40.0f);
+    gate.setRatio(4.0f);
+    gate.setAttack(5.0f, kSampleRate);
+    gate.setRelease(50.0f, kSampleRate);
+    std::vector<float> out;
+    inBursts(in, out, [&](const float *src, float *dst, int32_t n, size_t) {
+        gate.process(src, dst, n);
+    });
+
+    // The gate only multiplies, so out / in is its gain at every sample
+    auto gainAt = [&](size_t i) { return out[i] / in[i]; };
+    auto nonZero = [&](size_t i) { return std::fabs(in[i]) > 1e-6f; };
+    const double closedGain = gainAt(2 * stepFrames - 1);
+    size_t closeFrames = 0;
+    while (closeFrames < stepFrames &&
+           (!nonZero(stepFrames + closeFrames) ||
+            gainAt(stepFrames + closeFrames) > 0.5 * (1.0 + closedGain))) {
+        closeFrames++;
+    }
+    size_t openFrames = 0;
+    while (openFrames < stepFrames &&
+           (!nonZero(2 * stepFrames + openFrames) || gainAt(2 * stepFrames + openFrames) < 0.9)) {
+        openFrames++;
+    }
+    record("gate.close_ms", 1000.0 * closeFrames / kSampleRate, kTimeToleranceMs);
+    record("gate.open_ms", 1000.0 * openFrames / kSampleRate, kTimeToleranceMs);
+    record("gate.closed_gain_db", toDb(closedGain), kLevelToleranceDb);
+
+    // Block kernel against the per-sample one (both first-channel mono)
+    const std::vector<float> speech = speechLike(kSignalFrames, 11);
+    NoiseGate block;
+    NoiseGate single;
+    for (NoiseGate *g : {&block, &single}) {
+        g->setThreshold(-30.0f);
+        g->setAttack(5.0f, kSampleRate);
+        g->setRelease(50.0f, kSampleRate);
+    }
+    std::vector<float> blockOut;
+    const double blockNs = timePerSample(speech.size(), [&] {
+        block.reset();
+        inBursts(speech, blockOut, [&](const float *src, float *dst, int32_t n, size_t) {
+            block.process(src, dst, n);
+        });
+    });
+    std::vector<float> singleOut(speech.size());
+    const double singleNs = timePerSample(speech.size(), [&] {
+        single.reset();
+        for (size_t i = 0; i < speech.size(); i++) singleOut[i] = single.process(speech[i]);
+    });
+    float error = maxDifference(blockOut, singleOut);
+    CHECK(error <= kKernelTolerance, "block gate differs from per-sample by %g", error);
+    record("gate.speech_gain_db", gainDb(speech, blockOut, 0, speech.size()), kLevelToleranceDb);
+    recordTiming("gate.sample", singleNs);
+    recordTiming("gate.block", blockNs, singleNs);
+}
+
+void checkNoiseReduction() {
+    struct Case {
+        const char *name;
+        std::vector<float> signal;
+    };
+    const Case cases[] = {{"white", whiteNoise(kSignalFrames, 0.05f, 3)},
+                          {"pink", pinkNoise(kSignalFrames, 0.05f, 5)}};
+    const size_t tail = kSignalFrames / 4;  // once the noise estimate has settled
+
+    for (const Case &c : cases) {
+        NoiseReduction reduction(kSampleRate);
+        reduction.setReductionAmount(1.0f);
+        std::vector<float> out;
+        const double ns = timePerSample(c.signal.size(), [&] {
+            reduction.reset();
+            inBursts(c.signal, out, [&](const float *src, float *dst, int32_t n, size_t) {
+                reduction.process(src, dst, n);
+            });
+        });
+        record(std::string("nr.") + c.name + ".attenuation_db",
+               gainDb(c.signal, out, kSignalFrames - tail, kSignalFrames), kAdaptiveToleranceDb);
+        recordTiming(std::string("nr.") + c.name, ns);
+    }
+
+    // Speech over pink noise keeps most of its level
+    std::vector<float> speech = speechLike(kSignalFrames, 13);
+    const std::vector<float> noise = pinkNoise(kSignalFrames, 0.01f, 17);
+    for (size_t i = 0; i < speech.size(); i++) speech[i] += noise[i];
+    NoiseReduction reduction(kSampleRate);
+    reduction.setReductionAmount(0.5f);
+    std::vector<float> out;
+    inBursts(speech, out, [&](const float *src, float *dst, int32_t n, size_t) {
+        reduction.process(src, dst, n);
+    });
+    record("nr.speech.gain_db", gainDb(speech, out, kSignalFrames - tail, kSignalFrames),
+           kAdaptiveToleranceDb);
+}
+
+void checkEchoCanceller() {
+    // The mic hears the far end 20 ms late at half level, plus a little noise
+    const size_t delay = kSampleRate / 50;
+    const size_t tail = kSignalFrames / 4;
+    struct Case {
+        const char *name;
+        std::vector<float> farEnd;
+    };
+    const Case cases[] = {{"pink", pinkNoise(kSignalFrames, 0.1f, 19)},
+                          {"speech", speechLike(kSignalFrames, 23)}};
+
+    for (const Case &c : cases) {
+        const std::vector<float> noise = whiteNoise(kSignalFrames, 0.0005f, 29);
+        std::vector<float> mic(kSignalFrames);
+        for (size_t i = 0; i < kSignalFrames; i++) {
+            mic[i] = (i >= delay ? 0.5f * c.farEnd[i - delay] : 0.0f) + noise[i];
+        }
+        EchoCanceller canceller(kSampleRate);
+        canceller.setEchoDelay(20.0f);
+        canceller.setSuppressionAmount(1.0f);
+        std::vector<float> out;
+        const double ns = timePerSample(mic.size(), [&] {
+            canceller.reset();
+            inBursts(mic, out, [&](const float *src, float *dst, int32_t n, size_t offset) {
+                canceller.process(src, c.farEnd.data() + offset, dst, n);
+            });
+        });
+        record(std::string("ec.") + c.name + ".erle_db",
+               -gainDb(mic, out, kSignalFrames - tail, kSignalFrames), kAdaptiveToleranceDb);
+        recordTiming(std::string("ec.") + c.name, ns);
+    }
+}
+
+void checkSuppressor() {
+    const std::vector<float> speech = speechLike(kSignalFrames, 31);
+    PlaybackSuppressor suppressor(kSampleRate);
+    suppressor.setEnabled(true);
+    suppressor.setAggressiveness(0.8f);
+    std::vector<float> out;
+    const double ns = timePerSample(speech.size(), [&] {
+        suppressor.reset();
+        inBursts(speech, out, [&](const float *src, float *dst, int32_t n, size_t) {
+            suppressor.process(src, dst, n);
+        });
+    });
+    record("suppressor.speech.gain_db", gainDb(speech, out, 0, speech.size()),
+           kLevelToleranceDb);
+    const VoiceActivityDetector &detector = suppressor.getDetector();
+    record("suppressor.speech.speech_share",
+           static_cast<double>(detector.getSpeechFrameCount()) /
+           static_cast<double>(detector.getFrameCount()), 0.05);
+    recordTiming("suppressor.speech", ns);
+
+    // A steady tone stands for playback: after the detector has seen it start,
+    // it comes down by the aggressiveness
+    const std::vector<float> playback = tone(kSignalFrames, 440.0f, 0.25f);
+    suppressor.reset();
+    inBursts(playback, out, [&](const float *src, float *dst, int32_t n, size_t) {
+        suppressor.process(src, dst, n);
+    });
+    record("suppressor.tone.gain_db",
+           gainDb(playback, out, kSignalFrames / 2, kSignalFrames), kLevelToleranceDb);
+}
+
+void checkResampler() {
+    const std::vector<float> sweep = sineSweep(kSignalFrames, 0.5f);
+    PolyphaseResampler resampler;
+    resampler.configure(kSampleRate, 16000, 1, kBurst);
+    std::vector<float> out(resampler.getMaxOutputFrames(static_cast<int32_t>(sweep.size())));
+    int32_t written = 0;
+    const double ns = timePerSample(sweep.size(), [&] {
+        resampler.reset();
+        written = 0;
+        for (size_t offset = 0; offset < sweep.size(); offset += kBurst) {
+            written += resampler.process(sweep.data() + offset, kBurst, out.data() + written);
+        }
+    });
+    // The sweep is at 3.6 kHz three quarters of the way through, well inside
+    // the 16 kHz passband, and at 10 kHz nine tenths of the way, above its Nyquist
+    auto sweepLevel = [&](const float *signal, size_t length, double from, double to) {
+        const auto begin = static_cast<size_t>(from * static_cast<double>(length));
+        const auto end = static_cast<size_t>(to * static_cast<double>(length));
+        return rms(signal + begin, end - begin);
+    };
+    const auto outLength = static_cast<size_t>(written);
+    record("resampler.48to16.sweep_passband_db",
+           toDb(sweepLevel(out.data(), outLength, 0.0, 0.75) /
+                sweepLevel(sweep.data(), sweep.size(), 0.0, 0.75)),
+           kLevelToleranceDb);
+    record("resampler.48to16.sweep_stopband_db",
+           toDb(sweepLevel(out.data(), outLength, 0.9, 1.0) /
+                sweepLevel(sweep.data(), sweep.size(), 0.9, 1.0)),
+           kAdaptiveToleranceDb);  // ~100 dB down, where rounding shows
+    recordTiming("resampler.48to16", ns);
+}
+
+void checkAutoGain() {
+    // Latency: where an impulse comes out
+    AutoGain agc;
+    agc.prepare(kSampleRate, 1);
+    std::vector<float> impulse(kSampleRate / 10, 0.0f);
+    impulse[100] = 0.5f;
+    std::vector<float> out;
+    inBursts(impulse, out, [&](const float *src, float *dst, int32_t n, size_t) {
+        agc.process(src, dst, n);
+    });
+    const auto peakAt = static_cast<int32_t>(
+            std::max_element(out.begin(), out.end(), [](float a, float b) {
+                return std::fabs(a) < std::fabs(b);
+            }) - out.begin());
+    CHECK(peakAt - 100 == agc.getLatencyFrames(), "impulse out after %d frames, latency %d",
+          peakAt - 100, agc.getLatencyFrames());
+    record("autogain.latency_ms", 1000.0 * agc.getLatencyFrames() / kSampleRate,
+           kTimeToleranceMs);
+
+    // Quiet speech is brought up towards the -18 dBFS target, up to the 12 dB maximum
+    std::vector<float> quiet = speechLike(kSignalFrames, 47);
+    for (float &sample : quiet) sample *= 0.5f;
+    agc.prepare(kSampleRate, 1);
+    inBursts(quiet, out, [&](const float *src, float *dst, int32_t n, size_t) {
+        agc.process(src, dst, n);
+    });
+    const size_t settled = quiet.size() / 2;
+    record("autogain.quiet_speech_gain_db", gainDb(quiet, out, settled, quiet.size()),
+           kLevelToleranceDb);
+    record("autogain.agc_gain_db", agc.getGainDb(), kLevelToleranceDb);
+
+    // Speech with peaks 12 dB over full scale: the limiter holds every one
+    // under the ceiling
+    std::vector<float> loud = speechLike(kSignalFrames, 53);
+    for (float &sample : loud) sample *= 32.0f;
+    agc.prepare(kSampleRate, 1);
+    agc.setCeiling(-1.0f);
+    std::vector<float> mono;
+    const double monoNs = timePerSample(loud.size(), [&] {
+        agc.reset();
+        inBursts(loud, mono, [&](const float *src, float *dst, int32_t n, size_t) {
+            agc.process(src, dst, n);
+        });
+    });
+    float peak = 0.0f;
+    for (float sample : mono) peak = std::max(peak, std::fabs(sample));
+    CHECK(peak <= std::pow(10.0f, -1.0f / 20.0f) * (1.0f + kKernelTolerance),
+          "limiter let through a %.2f dBFS peak", toDb(peak));
+    record("autogain.loud_peak_db", toDb(peak), kLevelToleranceDb);
+    record("autogain.loud_speech_gain_db", gainDb(loud, mono, settled, loud.size()),
+           kLevelToleranceDb);
+
+    // The same signal on every channel of a 3-channel stream takes the
+    // per-frame path and must come out as mono did on each, in odd-sized calls
+    constexpr int32_t kChannels = 3;
+    std::vector<float> frames(loud.size() * kChannels);
+    for (size_t i = 0; i < frames.size(); i++) frames[i] = loud[i / kChannels];
+    AutoGain multi;
+    multi.prepare(kSampleRate, kChannels);
+    multi.setCeiling(-1.0f);
+    for (size_t offset = 0; offset < loud.size(); offset += 37) {
+        const auto n = static_cast<int32_t>(std::min<size_t>(37, loud.size() - offset));
+        float *block = frames.data() + kChannels * offset;
+        multi.process(block, block, n);
+    }
+    float error = 0.0f;
+    for (size_t i = 0; i < frames.size(); i++) {
+        error = std::max(error, std::fabs(frames[i] - mono[i / kChannels]));
+    }
+    CHECK(error <= kKernelTolerance, "per-frame auto gain differs from mono by %g", error);
+    recordTiming("autogain.mono", monoNs);
+}
+
+void checkConversion() {
+    const std::vector<float> speech = speechLike(kSignalFrames, 37);
+    std::vector<int16_t> pcm(speech.size());
+    for (size_t i = 0; i < speech.size(); i++) {
+        pcm[i] = static_cast<int16_t>(std::lrint(speech[i] * 32767.0f));
+    }
+    const auto n = static_cast<int32_t>(pcm.size());
+
+    std::vector<float> scalar(pcm.size());
+    const double scalarNs = timePerSample(pcm.size(), [&] {
+        for (size_t i = 0; i < pcm.size(); i++) {
+            scalar[i] = std::min(1.0f, std::max(-1.0f, pcm[i] * (2.0f / 32768.0f)));
+        }
+    });
+    std::vector<float> vector(pcm.size());
+    const double vectorNs = timePerSample(pcm.size(), [&] {
+        convertInt16ToFloat(pcm.data(), vector.data(), n, 2.0f);
+    });
+    float error = maxDifference(scalar, vector);
+    CHECK(error <= kKernelTolerance, "int16 -> float differs from scalar by %g", error);
+    recordTiming("int16tofloat.scalar", scalarNs);
+    recordTiming("int16tofloat.simd", vectorNs, scalarNs);
+}
+
+// The classic chain with every stage on, over speech with pink noise and an echo
+void checkChain() {
+    RecorderParams params;
+    params.playbackSuppressorEnabled = true;
+    params.echoCancellerEnabled = true;
+    params.noiseReductionEnabled = true;
+    params.noiseGateEnabled = true;
+    params.bandpassEnabled = true;
+    params.peakingEnabled = true;
+    params.highShelfEnabled = true;
+    params.echoDelayMs = 20.0f;
+    std::unique_ptr<ExecutionPlan> plan = ExecutionPlan::compile(
+            DspGraph::fromParams(params), kSampleRate, 1, kBurst, nullptr);
+
+    const std::vector<float> farEnd = pinkNoise(kSignalFrames, 0.05f, 41);
+    std::vector<float> mic = speechLike(kSignalFrames, 43);
+    const size_t delay = kSampleRate / 50;
+    for (size_t i = delay; i < mic.size(); i++) mic[i] += 0.3f * farEnd[i - delay];
+
+    std::vector<float> out;
+    inBursts(mic, out, [&](const float *src, float *dst, int32_t n, size_t offset) {
+        std::copy(src, src + n, dst);
+        plan->process(dst, n, farEnd.data() + offset);
+    });
+    constexpr int kSegments = 4;
+    const size_t segment = mic.size() / kSegments;
+    for (int s = 0; s < kSegments; s++) {
+        char name[64];
+        snprintf(name, sizeof(name), "chain.speech.segment%d_gain_db", s);
+        record(name, gainDb(mic, out, s * segment, (s + 1) * segment), kAdaptiveToleranceDb);
+    }
+
+    // The suppressor stage on its own, through a plan: playback comes down
+    // as it does through the module (suppressor.tone.gain_db)
+    RecorderParams suppressorOnly;
+    suppressorOnly.playbackSuppressorEnabled = true;
+    std::unique_ptr<ExecutionPlan> suppressorPlan = ExecutionPlan::compile(
+            DspGraph::fromParams(suppressorOnly), kSampleRate, 1, kBurst, nullptr);
+    const std::vector<float> playback = tone(kSignalFrames, 440.0f, 0.25f);
+    inBursts(playback, out, [&](const float *src, float *dst, int32_t n, size_t) {
+        std::copy(src, src + n, dst);
+        suppressorPlan->process(dst, n, nullptr);
+    });
+    record("chain.tone.gain_db", gainDb(playback, out, kSignalFrames / 2, kSignalFrames),
+           kLevelToleranceDb);
+
+    std::vector<float> buffer(mic.size());
+    const double ns = timePerSample(mic.size(), [&] {
+        std::copy(mic.begin(), mic.end(), buffer.begin());
+        for (size_t offset = 0; offset < buffer.size(); offset += kBurst) {
+            plan->process(buffer.data() + offset, kBurst, farEnd.data() + offset);
+        }
+    });
+    recordTiming("chain.classic", ns);
+}
+
+// ---- Golden file ----
+
+bool loadGolden(const char *path, std::map<std::string, Metric> &golden) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char name[128];
+        double value = 0.0;
+        double tolerance = 0.0;
+        if (line[0] == '#' || sscanf(line, "%127s %lf %lf", name, &value, &tolerance) != 3) {
+            continue;
+        }
+        golden[name] = {name, value, tolerance};
+    }
+    fclose(file);
+    return true;
+}
+
+bool writeGolden(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "# Golden metrics for golden-signal-test: name, value, tolerance.\n"
+                  "# Regenerate with --update after a deliberate change in behaviour.\n");
+    for (const Metric &metric : gMetrics) {
+        fprintf(file, "%s %.4f %.4f\n", metric.name.c_str(), metric.value, metric.tolerance);
+    }
+    fclose(file);
+    return true;
+}
+
+void compareGolden(const std::map<std::string, Metric> &golden) {
+    for (const Metric &metric : gMetrics) {
+        auto entry = golden.find(metric.name);
+        if (entry == golden.end()) {
+            CHECK(false, "%s = %.4f has no golden value (run with --update)",
+                  metric.name.c_str(), metric.value);
+            continue;
+        }
+        const Metric &expected = entry->second;
+        CHECK(std::fabs(metric.value - expected.value) <= expected.tolerance,
+              "%s = %.4f, golden %.4f +- %.4f", metric.name.c_str(), metric.value,
+              expected.value, expected.tolerance);
+    }
+    for (const auto &entry : golden) {
+        bool measured = std::any_of(gMetrics.begin(), gMetrics.end(),
+                                    [&](const Metric &m) { return m.name == entry.first; });
+        CHECK(measured, "golden value %s is no longer measured", entry.first.c_str());
+    }
+}
+
+bool writeThroughput(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "kernel,ns_per_sample,speedup\n");
+    for (const Timing &timing : gTimings) {
+        fprintf(file, "%s,%.3f,%.2f\n", timing.name.c_str(), timing.nsPerSample, timing.speedup);
+    }
+    fclose(file);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *goldenPath = nullptr;
+    const char *throughputPath = nullptr;
+    bool update = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (strcmp(argv[i], "--throughput") == 0 && i + 1 < argc) {
+            throughputPath = argv[++i];
+        } else {
+            goldenPath = argv[i];
+        }
+    }
+    if (goldenPath == nullptr) {
+        fprintf(stderr, "Usage: golden-signal-test GOLDEN_FILE [--update] [--throughput CSV]\n");
+        return 2;
+    }
+
+    checkBiquads();
+    checkCascade();
+    checkGate();
+    checkNoiseReduction();
+    checkEchoCanceller();
+    checkSuppressor();
+    checkResampler();
+    checkAutoGain();
+    checkConversion();
+    checkChain();
+
+    for (const Metric &metric : gMetrics) {
+        printf("%-44s %10.4f\n", metric.name.c_str(), metric.value);
+    }
+    printf("\n%-24s %12s %8s\n", "kernel", "ns/sample", "speedup");
+    for (const Timing &timing : gTimings) {
+        if (timing.speedup > 0.0) {
+            printf("%-24s %12.2f %7.2fx\n", timing.name.c_str(), timing.nsPerSample,
+                   timing.speedup);
+        } else {
+            printf("%-24s %12.2f\n", timing.name.c_str(), timing.nsPerSample);
+        }
+    }
+    if (throughputPath != nullptr && !writeThroughput(throughputPath)) {
+        fprintf(stderr, "Can't write %s\n", throughputPath);
+    }
+
+    if (update) {
+        CHECK(writeGolden(goldenPath), "can't write %s", goldenPath);
+        printf("Wrote %zu golden values to %s\n", gMetrics.size(), goldenPath);
+    } else {
+        std::map<std::string, Metric> golden;
+        CHECK(loadGolden(goldenPath, golden), "can't read %s", goldenPath);
+        compareGolden(golden);
+    }
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
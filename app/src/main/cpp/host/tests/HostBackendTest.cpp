@@ -0,0 +1,325 @@
+/**
+ * Tests for HostTimerBackend, alone and under AudioRecorder and AudioPlayer.
+ *
+ * On its own, with a probe callback that notes what it is called with:
+ *  - real-time callbacks come at the stream's rate, with every burst size in
+ *    the configured range, and jitter below the buffer capacity causes no
+ *    xruns;
+ *  - as fast as possible, callbacks run far ahead of real time;
+ *  - a callback that stalls for longer than the buffer capacity counts an
+ *    xrun and the stream carries on;
+ *  - a callback returning Stop stops its stream without requestStop().
+ *
+ * End to end: AudioRecorder on the backend records the capture signal frame
+ * for frame through jittered, variable bursts, and AudioPlayer plays that
+ * recording back into the render file unchanged, stopping at its end.
+ */
+
+#include <oboe/Oboe.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "AudioPlayer.h"
+#include "AudioRecorder.h"
+#include "HostTimerBackend.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kChannels = 2;
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<int16_t> readInt16(const std::string &path) {
+    std::vector<int16_t> samples;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return samples;
+    int16_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, sizeof(int16_t), 4096, file)) > 0) {
+        samples.insert(samples.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return samples;
+}
+
+void writeInt16(const std::string &path, const std::vector<int16_t> &samples) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return;
+    fwrite(samples.data(), sizeof(int16_t), samples.size(), file);
+    fclose(file);
+}
+
+// Noise whose length isn't a multiple of any burst, so the loop point moves
+std::vector<int16_t> captureSignal(size_t frames) {
+    std::vector<int16_t> signal(frames * kChannels);
+    uint32_t seed = 12345;
+    for (auto &sample : signal) {
+        seed = seed * 1664525u + 1013904223u;
+        sample = static_cast<int16_t>(seed >> 16);
+    }
+    return signal;
+}
+
+// Notes every callback; stalls once at stallAt and returns Stop at stopAt
+class ProbeCallback : public oboe::AudioStreamDataCallback {
+public:
+    int64_t stallAt = -1;
+    std::chrono::milliseconds stall{0};
+    int64_t stopAt = -1;
+
+    std::vector<int32_t> sizes;
+    std::vector<Clock::time_point> times;
+    std::atomic<int64_t> callbacks{0};
+    std::atomic<int64_t> frames{0};
+
+    oboe::DataCallbackResult
+    onAudioReady(oboe::AudioStream * /*stream*/, void * /*audioData*/, int32_t numFrames) override {
+        const int64_t index = callbacks.load(std::memory_order_relaxed);
+        sizes.push_back(numFrames);
+        times.push_back(Clock::now());
+        if (index == stallAt) {
+            std::this_thread::sleep_for(stall);
+        }
+        callbacks.store(index + 1, std::memory_order_release);
+        frames.fetch_add(numFrames, std::memory_order_release);
+        return index + 1 == stopAt ? oboe::DataCallbackResult::Stop
+                                   : oboe::DataCallbackResult::Continue;
+    }
+};
+
+std::shared_ptr<oboe::AudioStream> openProbe(HostTimerBackend &backend, ProbeCallback &probe,
+                                             oboe::Direction direction) {
+    oboe::AudioStreamBuilder builder;
+    builder.setDirection(direction)
+            ->setFormat(oboe::AudioFormat::Float)
+            ->setDataCallback(&probe);
+    std::shared_ptr<oboe::AudioStream> stream;
+    CHECK(backend.openStream(builder, stream) == oboe::Result::OK, "openStream failed");
+    return stream;
+}
+
+// Waits up to timeout for condition
+template<typename Condition>
+bool waitFor(Condition condition, std::chrono::milliseconds timeout) {
+    const Clock::time_point end = Clock::now() + timeout;
+    while (!condition()) {
+        if (Clock::now() > end) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void testRealTimePacing() {
+    HostTimerBackend::Options options;
+    options.sampleRate = kSampleRate;
+    options.channelCount = kChannels;
+    options.framesPerBurst = 96;
+    options.maxFramesPerBurst = 288;
+    options.jitterUs = 1000;
+    HostTimerBackend backend(options);
+
+    ProbeCallback probe;
+    probe.sizes.reserve(1000);
+    probe.times.reserve(1000);
+    auto stream = openProbe(backend, probe, oboe::Direction::Input);
+    CHECK(stream->getSampleRate() == kSampleRate && stream->getChannelCount() == kChannels,
+          "device format not applied: %d Hz x%d", stream->getSampleRate(),
+          stream->getChannelCount());
+    CHECK(backend.getRunningStreams() == 0, "running before start");
+
+    stream->requestStart();
+    CHECK(backend.getRunningStreams() == 1, "not running after start");
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    stream->requestStop();
+    CHECK(stream->getState() == oboe::StreamState::Stopped, "not stopped");
+    CHECK(backend.getRunningStreams() == 0, "still running after stop");
+
+    const auto callbacks = static_cast<int32_t>(probe.sizes.size());
+    CHECK(callbacks >= 20, "only %d callbacks in 400 ms", callbacks);
+    if (callbacks < 20) return;
+
+    int32_t smallest = probe.sizes[0];
+    int32_t largest = probe.sizes[0];
+    int64_t frames = 0;
+    for (int32_t i = 0; i < callbacks; i++) {
+        smallest = std::min(smallest, probe.sizes[i]);
+        largest = std::max(largest, probe.sizes[i]);
+        // The first callback's frames were captured before it
+        if (i > 0) frames += probe.sizes[i];
+    }
+    CHECK(smallest >= 96 && largest <= 288 && smallest < largest,
+          "burst sizes %d..%d, expected a spread within 96..288", smallest, largest);
+
+    // Frames delivered per second of wall time is the stream's rate
+    const double seconds = std::chrono::duration<double>(
+            probe.times.back() - probe.times.front()).count();
+    const double rate = frames / seconds;
+    CHECK(rate > kSampleRate * 0.9 && rate < kSampleRate * 1.1,
+          "delivered %.0f frames/s, expected ~%d", rate, kSampleRate);
+
+    const int32_t xRuns = stream->getXRunCount().value();
+    CHECK(xRuns == 0, "%d xruns with jitter below the capacity", xRuns);
+    stream->close();
+}
+
+void testFastMode() {
+    HostTimerBackend::Options options;
+    options.sampleRate = kSampleRate;
+    options.realTime = false;
+    HostTimerBackend backend(options);
+
+    // 10 s of audio, then the callback stops the stream
+    ProbeCallback probe;
+    probe.stopAt = 10 * kSampleRate / options.framesPerBurst;
+    probe.sizes.reserve(static_cast<size_t>(probe.stopAt));
+    probe.times.reserve(static_cast<size_t>(probe.stopAt));
+    auto stream = openProbe(backend, probe, oboe::Direction::Output);
+
+    const Clock::time_point start = Clock::now();
+    stream->requestStart();
+    CHECK(waitFor([&] { return backend.getRunningStreams() == 0; }, std::chrono::seconds(5)),
+          "fast stream didn't get through 10 s of audio in 5 s");
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    CHECK(stream->getState() == oboe::StreamState::Stopped, "Stop didn't stop the stream");
+    CHECK(probe.callbacks.load() == probe.stopAt, "%lld callbacks, expected %lld",
+          static_cast<long long>(probe.callbacks.load()), static_cast<long long>(probe.stopAt));
+    printf("fast mode: 10 s of audio in %.3f s\n", seconds);
+    stream->close();
+}
+
+void testXRun() {
+    HostTimerBackend::Options options;
+    options.sampleRate = kSampleRate;
+    options.framesPerBurst = 192;
+    HostTimerBackend backend(options);
+
+    // The capacity is 8 bursts, 32 ms
+    ProbeCallback probe;
+    probe.stallAt = 10;
+    probe.stall = std::chrono::milliseconds(60);
+    probe.sizes.reserve(1000);
+    probe.times.reserve(1000);
+    auto stream = openProbe(backend, probe, oboe::Direction::Input);
+    stream->requestStart();
+    CHECK(waitFor([&] { return probe.callbacks.load(std::memory_order_acquire) >= 40; },
+                  std::chrono::seconds(2)), "stream stalled for good");
+    stream->requestStop();
+
+    const int32_t xRuns = stream->getXRunCount().value();
+    CHECK(xRuns == 1, "%d xruns after one 60 ms stall, expected 1", xRuns);
+    stream->close();
+}
+
+void testRecordAndPlay() {
+    HostTimerBackend::Options options;
+    options.sampleRate = kSampleRate;
+    options.channelCount = kChannels;
+    options.framesPerBurst = 64;
+    options.maxFramesPerBurst = 480;
+    options.jitterUs = 2000;
+    HostTimerBackend backend(options);
+    const std::vector<int16_t> capture = captureSignal(10007);
+    const std::string capturePath = processTempPath("host-backend-test", "capture");
+    writeInt16(capturePath, capture);
+    CHECK(backend.setCaptureFile(capturePath.c_str()), "capture file not loaded");
+
+    // Record: nothing is enabled, so the capture goes to the file as it is
+    const std::string recordingPath = processTempPath("host-backend-test", "recording");
+    {
+        AudioRecorder recorder(backend);
+        recorder.setStoragePath(recordingPath.c_str());
+        CHECK(recorder.startRecording() == oboe::Result::OK, "startRecording failed");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        recorder.stopRecording();
+        CHECK(recorder.getDroppedFrames() == 0, "writer dropped %lld frames",
+              static_cast<long long>(recorder.getDroppedFrames()));
+        CHECK(recorder.getCallbackMetrics().callbacks > 10, "recorder barely ran");
+    }
+    const std::vector<int16_t> recording = readInt16(recordingPath);
+    CHECK(recording.size() > capture.size(), "recorded %zu samples, expected > %zu",
+          recording.size(), capture.size());
+    size_t mismatches = 0;
+    for (size_t i = 0; i < recording.size(); i++) {
+        if (recording[i] != capture[i % capture.size()]) mismatches++;
+    }
+    CHECK(mismatches == 0, "%zu of %zu recorded samples differ from the capture", mismatches,
+          recording.size());
+
+    // Play it back into the render file; the player stops the stream at the end
+    const std::string renderPath = processTempPath("host-backend-test", "render");
+    backend.setRenderFile(renderPath.c_str());
+    {
+        AudioPlayer player(backend);
+        CHECK(player.startPlaybackFromFile(recordingPath.c_str()) == oboe::Result::OK,
+              "startPlaybackFromFile failed");
+        CHECK(waitFor([&] { return backend.getRunningStreams() == 0; }, std::chrono::seconds(5)),
+              "playback didn't stop at the end of the file");
+        player.stopPlayback();
+    }
+    const std::vector<int16_t> rendered = readInt16(renderPath);
+    CHECK(rendered.size() >= recording.size(), "rendered %zu samples of %zu", rendered.size(),
+          recording.size());
+    mismatches = 0;
+    for (size_t i = 0; i < rendered.size(); i++) {
+        const int16_t expected = i < recording.size() ? recording[i] : 0;
+        if (rendered[i] != expected) mismatches++;
+    }
+    CHECK(mismatches == 0, "%zu of %zu rendered samples differ from the recording", mismatches,
+          rendered.size());
+
+    remove(capturePath.c_str());
+    remove(recordingPath.c_str());
+    remove(renderPath.c_str());
+}
+
+void testStopFromCallback() {
+    HostTimerBackend::Options options;
+    options.sampleRate = kSampleRate;
+    options.framesPerBurst = 48;
+    HostTimerBackend backend(options);
+
+    ProbeCallback probe;
+    probe.stopAt = 10;
+    probe.sizes.reserve(100);
+    probe.times.reserve(100);
+    auto stream = openProbe(backend, probe, oboe::Direction::Output);
+    stream->requestStart();
+    CHECK(waitFor([&] { return backend.getRunningStreams() == 0; }, std::chrono::seconds(2)),
+          "Stop didn't end the timer thread");
+    CHECK(stream->getState() == oboe::StreamState::Stopped, "not stopped");
+    CHECK(probe.callbacks.load() == 10, "%lld callbacks, expected 10",
+          static_cast<long long>(probe.callbacks.load()));
+
+    // And it starts again
+    probe.stopAt = 11;
+    stream->requestStart();
+    CHECK(waitFor([&] { return backend.getRunningStreams() == 0; }, std::chrono::seconds(2)),
+          "restarted stream never stopped");
+    CHECK(probe.callbacks.load() == 11, "restart: %lld callbacks, expected 11",
+          static_cast<long long>(probe.callbacks.load()));
+    stream->close();
+    CHECK(stream->requestStart() == oboe::Result::ErrorClosed, "closed stream started");
+}
+
+} // namespace
+
+int main() {
+    testRealTimePacing();
+    testFastMode();
+    testXRun();
+    testStopFromCallback();
+    testRecordAndPlay();
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
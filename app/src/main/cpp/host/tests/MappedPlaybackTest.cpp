@@ -0,0 +1,116 @@
+/**
+ * Playback test for MappedAudioSource.
+ *
+ * Writes a long raw int16 recording, then plays it back through read() in
+ * callback-sized bursts at roughly 4x real time while the helper thread keeps
+ * the read-ahead window resident. The output must match the file sample for
+ * sample, no read may run past the prefaulted window, and the end of the file
+ * must show up as one short, zero-padded read.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "MappedAudioSource.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kChannelCount = 2;
+constexpr int32_t kFramesPerBurst = 192;
+constexpr int32_t kSeconds = 10;
+
+std::string writeTempFile(const std::vector<int16_t> &samples) {
+    char path[] = "/tmp/mapped-playback-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return {};
+    }
+    FILE *file = fdopen(fd, "wb");
+    fwrite(samples.data(), sizeof(int16_t), samples.size(), file);
+    fclose(file);
+    return path;
+}
+
+void testPlayback() {
+    // A few frames past a whole number of bursts, so the last read is short
+    const size_t totalSamples =
+            static_cast<size_t>(kSampleRate) * kChannelCount * kSeconds + 3 * kChannelCount;
+    std::vector<int16_t> recording(totalSamples);
+    uint32_t seed = 1;
+    for (auto &sample : recording) {
+        seed = seed * 1664525u + 1013904223u;
+        sample = static_cast<int16_t>(seed >> 16);
+    }
+    std::string path = writeTempFile(recording);
+    CHECK(!path.empty(), "could not create the recording");
+
+    MappedAudioSource source;
+    CHECK(source.open(path), "open failed");
+    CHECK(source.getTotalSamples() == totalSamples, "expected %zu samples, mapped %zu",
+          totalSamples, source.getTotalSamples());
+
+    const size_t burstSamples = static_cast<size_t>(kFramesPerBurst) * kChannelCount;
+    std::vector<int16_t> burst(burstSamples);
+    size_t played = 0;
+    size_t mismatches = 0;
+    bool ended = false;
+    while (!ended) {
+        size_t count = source.read(burst.data(), burstSamples);
+        for (size_t i = 0; i < count; i++) {
+            mismatches += burst[i] != recording[played + i];
+        }
+        played += count;
+        if (count < burstSamples) {
+            ended = true;
+            for (size_t i = count; i < burstSamples; i++) {
+                CHECK(burst[i] == 0, "sample %zu past the end is %d, not silence", i, burst[i]);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(1000));
+    }
+
+    CHECK(played == totalSamples, "played %zu of %zu samples", played, totalSamples);
+    CHECK(mismatches == 0, "%zu samples differ from the recording", mismatches);
+    CHECK(source.getPrefaultMisses() == 0, "%lld reads ran past the prefaulted window",
+          static_cast<long long>(source.getPrefaultMisses()));
+
+    // Reads after the end keep returning silence
+    CHECK(source.read(burst.data(), burstSamples) == 0, "read past the end returned data");
+
+    source.close();
+    unlink(path.c_str());
+}
+
+void testEdgeCases() {
+    MappedAudioSource source;
+    CHECK(!source.open("/nonexistent/recording.pcm"), "opened a missing file");
+    CHECK(!source.isOpen(), "missing file left the source open");
+
+    std::string path = writeTempFile({});
+    CHECK(source.open(path), "could not open an empty recording");
+    int16_t burst[4] = {1, 2, 3, 4};
+    CHECK(source.read(burst, 4) == 0, "empty recording returned data");
+    CHECK(burst[0] == 0 && burst[3] == 0, "empty recording didn't read as silence");
+    source.close();
+    unlink(path.c_str());
+}
+
+} // namespace
+
+int main() {
+    testPlayback();
+    testEdgeCases();
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
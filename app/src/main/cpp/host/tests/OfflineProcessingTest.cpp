@@ -0,0 +1,176 @@
+/**
+ * Equivalence test for offline processing.
+ *
+ * Records a stereo signal live through AudioRecorder (callback-sized bursts,
+ * every stage enabled), then runs the same raw input through OfflineProcessor
+ * with the recorder's parameters. Despite the much larger blocks, the offline
+ * output must be sample-for-sample identical to the live recording, whether
+ * the input is raw PCM or compressed, and it must run faster than real time.
+ */
+
+#include <oboe/Oboe.h>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "AudioFileWriter.h"
+#include "AudioRecorder.h"
+#include "OfflineProcessor.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kChannelCount = 2;
+constexpr int32_t kFramesPerBurst = 192;
+constexpr size_t kFrames = kSampleRate * 3;
+
+// Voiced bursts over low noise, a different pitch per channel
+std::vector<int16_t> makeInput() {
+    std::vector<int16_t> samples(kFrames * kChannelCount);
+    uint32_t seed = 0x13579bdfu;
+    for (size_t i = 0; i < kFrames; i++) {
+        double t = static_cast<double>(i) / kSampleRate;
+        double envelope = std::sin(2.0 * M_PI * 1.5 * t) > 0.0 ? 1.0 : 0.0;
+        for (int c = 0; c < kChannelCount; c++) {
+            seed = seed * 1664525u + 1013904223u;
+            double voiced = 0.0;
+            for (int h = 1; h <= 6; h++) {
+                voiced += std::sin(2.0 * M_PI * (150.0 + 70.0 * c) * h * t) / h;
+            }
+            double noise = static_cast<double>(seed >> 16) / 65536.0 - 0.5;
+            samples[i * kChannelCount + c] =
+                    static_cast<int16_t>(5000.0 * envelope * voiced + 300.0 * noise);
+        }
+    }
+    return samples;
+}
+
+void writeFile(const std::string &path, const std::vector<int16_t> &samples) {
+    FILE *file = fopen(path.c_str(), "wb");
+    CHECK(file != nullptr, "could not write %s", path.c_str());
+    if (!file) return;
+    fwrite(samples.data(), sizeof(int16_t), samples.size(), file);
+    fclose(file);
+}
+
+// Records input through the recorder's callback, at ~4x real time
+std::vector<int16_t> recordLive(AudioRecorder &recorder, const std::vector<int16_t> &input) {
+    const std::string path = tempPath("offline-live");
+    recorder.setStoragePath(path.c_str());
+    CHECK(recorder.startRecording() == oboe::Result::OK, "startRecording failed");
+
+    oboe::AudioStreamBuilder builder;
+    builder.setDirection(oboe::Direction::Input)
+            ->setChannelCount(kChannelCount)
+            ->setSampleRate(kSampleRate);
+    std::shared_ptr<oboe::AudioStream> stream;
+    builder.openStream(stream);
+
+    std::vector<int16_t> burst(kFramesPerBurst * kChannelCount);
+    for (size_t frame = 0; frame + kFramesPerBurst <= kFrames; frame += kFramesPerBurst) {
+        std::copy(input.begin() + frame * kChannelCount,
+                  input.begin() + (frame + kFramesPerBurst) * kChannelCount, burst.begin());
+        recorder.onAudioReady(stream.get(), burst.data(), kFramesPerBurst);
+        std::this_thread::sleep_for(std::chrono::microseconds(1000));
+    }
+    CHECK(recorder.getDroppedFrames() == 0, "live recording dropped %lld frames",
+          static_cast<long long>(recorder.getDroppedFrames()));
+    recorder.stopRecording();
+
+    std::vector<int16_t> recorded = readFile(path);
+    unlink(path.c_str());
+    return recorded;
+}
+
+std::vector<int16_t> processOffline(const char *name, const RecorderParams &params,
+                                    const std::string &inputPath) {
+    const std::string outputPath = tempPath("offline-output");
+    OfflineProcessor processor;
+    processor.setParams(params);
+    processor.setRawInputFormat(FileFormat::Pcm16, kSampleRate, kChannelCount);
+    processor.setOutputFormat(FileFormat::Pcm16);
+    OfflineProcessor::Result result = processor.process(inputPath, outputPath);
+
+    printf("%s: %.1f s of audio in %.1f ms, %.0fx real time\n", name, result.audioSeconds(),
+           static_cast<double>(result.elapsedNs) / 1e6, result.speedFactor());
+    CHECK(result.ok, "%s: processing failed", name);
+    CHECK(result.sampleRate == kSampleRate && result.channelCount == kChannelCount,
+          "%s: input read as %d channels at %d Hz", name, result.channelCount, result.sampleRate);
+    CHECK(result.frames == static_cast<int64_t>(kFrames), "%s: processed %lld frames", name,
+          static_cast<long long>(result.frames));
+    CHECK(result.speedFactor() > 1.0, "%s: only %.2fx real time", name, result.speedFactor());
+
+    std::vector<int16_t> output = readFile(outputPath);
+    unlink(outputPath.c_str());
+    return output;
+}
+
+void compare(const char *name, const std::vector<int16_t> &offline,
+             const std::vector<int16_t> &live) {
+    CHECK(offline.size() == live.size(), "%s: %zu samples, live recording has %zu", name,
+          offline.size(), live.size());
+    size_t mismatches = 0;
+    for (size_t i = 0; i < std::min(offline.size(), live.size()); i++) {
+        mismatches += offline[i] != live[i];
+    }
+    CHECK(mismatches == 0, "%s: %zu samples differ from the live recording", name, mismatches);
+}
+
+} // namespace
+
+int main() {
+    oboe::StubDevice::configure(kSampleRate, kChannelCount, kFramesPerBurst);
+    const std::vector<int16_t> input = makeInput();
+
+    auto recorder = std::make_unique<AudioRecorder>();
+    recorder->setBandpassFilterEnabled(true);
+    recorder->configureBandpassFilter(1200.0f, 0.5f);
+    recorder->setPeakingFilterEnabled(true);
+    recorder->configurePeakingFilter(3000.0f, 1.0f, 4.0f);
+    recorder->setHighShelfFilterEnabled(true);
+    recorder->setAutoGainEnabled(true);
+    recorder->setNoiseGateEnabled(true);
+    recorder->configureNoiseGate(-40.0f, 4.0f, 2.0f, 80.0f);
+    recorder->setNoiseReductionEnabled(true);
+    recorder->configureNoiseReduction(0.6f);
+    recorder->setEchoCancellerEnabled(true);
+    recorder->setPlaybackSuppressorEnabled(true);
+    const std::vector<int16_t> live = recordLive(*recorder, input);
+    const RecorderParams params = recorder->getParams();
+
+    // Raw PCM input
+    const std::string rawPath = tempPath("offline-raw");
+    writeFile(rawPath, input);
+    compare("raw", processOffline("raw", params, rawPath), live);
+    unlink(rawPath.c_str());
+
+    // The same input compressed: detected from its header, decoded block by block
+    const std::string compressedPath = tempPath("offline-compressed");
+    AudioFileWriter writer;
+    CHECK(writer.open(compressedPath, kSampleRate, kChannelCount, FileFormat::Lossless),
+          "writer open failed");
+    for (size_t frame = 0; frame < kFrames; frame += OfflineProcessor::kBlockFrames) {
+        auto frames = static_cast<int32_t>(
+                std::min<size_t>(OfflineProcessor::kBlockFrames, kFrames - frame));
+        CHECK(writer.writeBlocking(input.data() + frame * kChannelCount, frames),
+              "blocking write failed");
+    }
+    CHECK(writer.close(), "writer flush timed out");
+    CHECK(writer.getDroppedFrames() == 0, "blocking writes dropped %lld frames",
+          static_cast<long long>(writer.getDroppedFrames()));
+    compare("compressed", processOffline("compressed", params, compressedPath), live);
+    unlink(compressedPath.c_str());
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
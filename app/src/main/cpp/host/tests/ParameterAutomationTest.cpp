@@ -0,0 +1,250 @@
+/**
+ * Parameter automation test.
+ *
+ * The FastMath kernels have to hold the accuracy their header promises
+ * against the standard library. Through an ExecutionPlan, moving an EQ
+ * filter's gain or frequency, or a gate's threshold, while audio runs has to
+ * glide rather than step: the output may move no faster than the steady
+ * signal does, where the same change made at once clicks. A glide has to end
+ * on the filter the settings describe, and configuring and processing while
+ * gliding must never allocate or log.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <android/log.h>
+
+#include "DspGraph.h"
+#include "ExecutionPlan.h"
+#include "filter/BiquadFilter.h"
+#include "filter/FastMath.h"
+#include "filter/NoiseGate.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr int32_t kBurst = 192;
+constexpr int32_t kBursts = 100;
+constexpr int32_t kChangeBurst = 50;   // the burst the settings change before
+constexpr size_t kFrames = static_cast<size_t>(kBurst) * kBursts;
+
+std::vector<float> makeTone(float frequency, float amplitude) {
+    std::vector<float> tone(kFrames);
+    for (size_t i = 0; i < kFrames; i++) {
+        tone[i] = amplitude * std::sin(2.0 * M_PI * frequency * i / kSampleRate);
+    }
+    return tone;
+}
+
+// Largest fourth difference over [first, last). It takes a low tone down by
+// orders of magnitude but passes what a click adds: a step in the output or
+// in its slope.
+float maxRoughness(const std::vector<float> &signal, size_t first, size_t last) {
+    float maxValue = 0.0f;
+    for (size_t i = std::max<size_t>(first, 4); i < last; i++) {
+        maxValue = std::max(maxValue, std::fabs(signal[i] - 4.0f * signal[i - 1] +
+                                                6.0f * signal[i - 2] - 4.0f * signal[i - 3] +
+                                                signal[i - 4]));
+    }
+    return maxValue;
+}
+
+float peakOf(const std::vector<float> &signal, size_t first, size_t last) {
+    float peak = 0.0f;
+    for (size_t i = first; i < last; i++) peak = std::max(peak, std::fabs(signal[i]));
+    return peak;
+}
+
+void checkFastMath() {
+    double sinError = 0.0;
+    double expError = 0.0;
+    double logError = 0.0;
+    double dbError = 0.0;
+    for (int i = -20000; i <= 20000; i++) {
+        const float x = static_cast<float>(i) * (2.0f * fastmath::kPi / 20000.0f);
+        float s, c;
+        fastmath::sinCos(x, s, c);
+        sinError = std::max(sinError, std::fabs(s - std::sin(static_cast<double>(x))));
+        sinError = std::max(sinError, std::fabs(c - std::cos(static_cast<double>(x))));
+
+        const float e = static_cast<float>(i) * 0.004f;
+        const double exact = std::exp2(static_cast<double>(e));
+        expError = std::max(expError, std::fabs(fastmath::exp2(e) - exact) / exact);
+    }
+    for (int i = 1; i <= 100000; i++) {
+        const float x = static_cast<float>(i) * 1e-3f;
+        const double exact = std::log2(static_cast<double>(x));
+        logError = std::max(logError,
+                            std::fabs(fastmath::log2(x) - exact) / std::max(1.0, std::fabs(exact)));
+        dbError = std::max(dbError, std::fabs(fastmath::gainToDb(x) -
+                                              20.0 * std::log10(static_cast<double>(x))));
+    }
+    CHECK(sinError <= 5e-7, "sin/cos error %g", sinError);
+    CHECK(expError <= 3e-7, "exp2 error %g", expError);
+    CHECK(logError <= 2e-7, "log2 error %g", logError);
+    CHECK(dbError <= 2e-5, "gainToDb error %g dB", dbError);
+
+    // The fast designs against the textbook ones on the standard library
+    const float frequency = 1000.0f;
+    const float q = 1.0f;
+    const float gainDb = 9.0f;
+    const double A = std::pow(10.0, gainDb / 40.0);
+    const double w0 = 2.0 * M_PI * frequency / kSampleRate;
+    const double alpha = std::sin(w0) / (2.0 * q);
+    const double a0 = 1.0 + alpha / A;
+    const BiquadCoefficients fast = BiquadFilter::designPeaking(kSampleRate, frequency, q, gainDb);
+    const double exact[] = {(1.0 + alpha * A) / a0, -2.0 * std::cos(w0) / a0,
+                            (1.0 - alpha * A) / a0, -2.0 * std::cos(w0) / a0,
+                            (1.0 - alpha / A) / a0};
+    const float designed[] = {fast.b0, fast.b1, fast.b2, fast.a1, fast.a2};
+    for (int k = 0; k < 5; k++) {
+        CHECK(std::fabs(designed[k] - exact[k]) <= 1e-6, "peaking coefficient %d: %g vs %g",
+              k, designed[k], exact[k]);
+    }
+}
+
+StageConfig peakingStage(float frequency, float gainDb) {
+    StageConfig stage = StageConfig::defaults(StageType::Peaking);
+    stage.id = 1;
+    stage.frequency = frequency;
+    stage.q = 1.0f;
+    stage.gainDb = gainDb;
+    return stage;
+}
+
+// Runs input through a plan of graph, changing stage to changed before
+// kChangeBurst; returns the output and sets *allocations to the heap
+// allocations made by configure() and process(). Both run on the audio
+// thread, so they must not log either; that is checked here.
+std::vector<float> runChange(DspGraph graph, const StageConfig &changed,
+                             const std::vector<float> &input, int64_t *allocations) {
+    auto plan = ExecutionPlan::compile(graph, kSampleRate, 1, kBurst, nullptr);
+    std::vector<float> output = input;
+    const long logsBefore = host_log_count();
+    const int64_t before = allocationCount();
+    for (int32_t burst = 0; burst < kBursts; burst++) {
+        if (burst == kChangeBurst) {
+            *graph.findStage(changed.id) = changed;
+            plan->configure(graph);
+        }
+        plan->process(output.data() + static_cast<size_t>(burst) * kBurst, kBurst, nullptr);
+    }
+    *allocations = allocationCount() - before;
+    const long logs = host_log_count() - logsBefore;
+    CHECK(logs == 0, "%ld messages logged while configuring and processing", logs);
+    return output;
+}
+
+// The stepped reference: one BiquadFilter whose coefficients change at once,
+// keeping its history
+std::vector<float> runStepped(const StageConfig &from, const StageConfig &to,
+                              const std::vector<float> &input) {
+    BiquadFilter filter;
+    filter.setCoefficients(BiquadFilter::designPeaking(kSampleRate, from.frequency, from.q,
+                                                       from.gainDb));
+    std::vector<float> output(input.size());
+    const size_t change = static_cast<size_t>(kChangeBurst) * kBurst;
+    filter.process(input.data(), output.data(), static_cast<int32_t>(change));
+    filter.setCoefficients(BiquadFilter::designPeaking(kSampleRate, to.frequency, to.q,
+                                                       to.gainDb));
+    filter.process(input.data() + change, output.data() + change,
+                   static_cast<int32_t>(kFrames - change));
+    return output;
+}
+
+void checkFilterSweep(const char *name, const StageConfig &from, const StageConfig &to,
+                      float toneFrequency) {
+    const std::vector<float> input = makeTone(toneFrequency, 0.1f);
+    DspGraph graph;
+    graph.insertStage(from);
+    int64_t allocations = 0;
+    const std::vector<float> glided = runChange(graph, to, input, &allocations);
+    const std::vector<float> stepped = runStepped(from, to, input);
+    CHECK(allocations == 0, "%s: %lld allocations while gliding", name,
+          static_cast<long long>(allocations));
+
+    // The roughness of the glide against the louder of the two steady states
+    // (a frequency sweep moves the tone's phase, so it may be a little
+    // rougher) and against the stepped change
+    const size_t change = static_cast<size_t>(kChangeBurst) * kBurst;
+    const size_t glideFrames = static_cast<size_t>(ExecutionPlan::kGlideMs * kSampleRate / 1000);
+    const float steady = std::max(maxRoughness(glided, change - 4800, change),
+                                  maxRoughness(glided, kFrames - 4800, kFrames));
+    const float glide = maxRoughness(glided, change, change + glideFrames + 480);
+    const float step = maxRoughness(stepped, change, change + 480);
+    printf("%-10s steady %.6f  glided %.6f  stepped %.6f\n", name, steady, glide, step);
+    CHECK(glide <= steady * 4.0f, "%s: glide roughness %g against steady %g", name, glide,
+          steady);
+    CHECK(step >= glide * 10.0f, "%s: the stepped change doesn't click (%g against %g)", name,
+          step, glide);
+
+    // After the glide the plan runs the filter the settings describe
+    const float settledPeak = peakOf(glided, kFrames - 4800, kFrames);
+    const float expectedPeak = peakOf(stepped, kFrames - 4800, kFrames);
+    CHECK(std::fabs(settledPeak - expectedPeak) <= 1e-5f, "%s: settled at peak %g, not %g",
+          name, settledPeak, expectedPeak);
+}
+
+// A gate threshold raised past a steady level, on DC so out/in is the gain
+void checkGateSweep() {
+    const float level = 0.05f;  // -26 dBFS
+    const std::vector<float> input(kFrames, level);
+    StageConfig from = StageConfig::defaults(StageType::NoiseGate);
+    from.id = 1;
+    from.thresholdDb = -40.0f;
+    StageConfig to = from;
+    to.thresholdDb = -10.0f;
+    DspGraph graph;
+    graph.insertStage(from);
+    int64_t allocations = 0;
+    const std::vector<float> glided = runChange(graph, to, input, &allocations);
+    CHECK(allocations == 0, "gate: %lld allocations while gliding",
+          static_cast<long long>(allocations));
+
+    NoiseGate gate;
+    gate.setThreshold(from.thresholdDb);
+    gate.setRatio(from.ratio);
+    gate.setAttack(from.attackMs, kSampleRate);
+    gate.setRelease(from.releaseMs, kSampleRate);
+    std::vector<float> stepped(kFrames);
+    const size_t change = static_cast<size_t>(kChangeBurst) * kBurst;
+    gate.process(input.data(), stepped.data(), static_cast<int32_t>(change));
+    gate.setThreshold(to.thresholdDb);
+    gate.process(input.data() + change, stepped.data() + change,
+                 static_cast<int32_t>(kFrames - change));
+
+    float glideStep = 0.0f;
+    float stepStep = 0.0f;
+    for (size_t i = change; i < kFrames; i++) {
+        glideStep = std::max(glideStep, std::fabs(glided[i] - glided[i - 1]) / level);
+        stepStep = std::max(stepStep, std::fabs(stepped[i] - stepped[i - 1]) / level);
+    }
+    printf("%-10s glided %.5f  stepped %.5f (largest gain change per sample)\n", "gate",
+           glideStep, stepStep);
+    CHECK(glideStep <= 0.005f, "gate: gain moved %g in one sample while gliding", glideStep);
+    CHECK(stepStep >= 0.1f, "gate: the stepped change doesn't step (%g)", stepStep);
+    CHECK(std::fabs(glided[kFrames - 1] - stepped[kFrames - 1]) <= 1e-6f,
+          "gate: settled at %g, not %g", glided[kFrames - 1], stepped[kFrames - 1]);
+}
+
+} // namespace
+
+int main() {
+    checkFastMath();
+    checkFilterSweep("gain", peakingStage(1000.0f, 0.0f), peakingStage(1000.0f, 12.0f),
+                     1000.0f);
+    checkFilterSweep("frequency", peakingStage(500.0f, 12.0f), peakingStage(2000.0f, 12.0f),
+                     1000.0f);
+    checkGateSweep();
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
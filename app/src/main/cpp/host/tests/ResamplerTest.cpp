@@ -0,0 +1,286 @@
+/**
+ * Sample-rate conversion test.
+ *
+ * PolyphaseResampler on its own: tones come out at the right amplitude and
+ * phase for 48 -> 16, 16 -> 48 and 44.1 -> 48 kHz, content above the new
+ * Nyquist frequency is rejected by over 60 dB, the output doesn't depend on
+ * how the input is split into blocks, getInputFramesNeeded() asks for just
+ * enough input, and every channel of a multichannel stream matches running
+ * that channel alone.
+ *
+ * Then in place: AudioRecorder with a 16 kHz target stores a third of the
+ * frames the device delivered, and AudioPlayer plays that 16 kHz file on a
+ * 48 kHz device exactly as the resampler converts it.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "AudioPlayer.h"
+#include "AudioRecorder.h"
+#include "filter/PolyphaseResampler.h"
+#include "filter/SampleConversion.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int32_t kDeviceRate = 48000;
+constexpr int32_t kVoiceRate = 16000;
+constexpr int32_t kFramesPerBurst = 192;
+constexpr float kAmplitude = 0.5f;
+
+std::vector<float> makeTone(double frequency, int32_t sampleRate, size_t frames) {
+    std::vector<float> tone(frames);
+    for (size_t i = 0; i < frames; i++) {
+        tone[i] = kAmplitude * static_cast<float>(
+                std::sin(2.0 * M_PI * frequency * static_cast<double>(i) / sampleRate));
+    }
+    return tone;
+}
+
+std::vector<float> makeNoise(size_t samples, uint32_t seed) {
+    std::vector<float> noise(samples);
+    for (float &s : noise) {
+        seed = seed * 1664525u + 1013904223u;
+        s = static_cast<float>(seed >> 8) / 16777216.0f - 0.5f;
+    }
+    return noise;
+}
+
+// Runs input through a fresh resampler in blocks of blockFrames
+std::vector<float> resample(int32_t inputRate, int32_t outputRate, int32_t channelCount,
+                            const std::vector<float> &input, int32_t blockFrames) {
+    PolyphaseResampler resampler;
+    CHECK(resampler.configure(inputRate, outputRate, channelCount, blockFrames),
+          "configure %d -> %d failed", inputRate, outputRate);
+    const auto frames = static_cast<int32_t>(input.size() / channelCount);
+    std::vector<float> output(
+            static_cast<size_t>(resampler.getMaxOutputFrames(frames)) * channelCount);
+    int32_t written = 0;
+    for (int32_t frame = 0; frame < frames; frame += blockFrames) {
+        int32_t count = std::min(blockFrames, frames - frame);
+        int32_t produced = resampler.process(input.data() + frame * channelCount, count,
+                                             output.data() + written * channelCount);
+        CHECK(produced <= resampler.getMaxOutputFrames(count), "%d frames from %d is too many",
+              produced, count);
+        written += produced;
+    }
+    output.resize(static_cast<size_t>(written) * channelCount);
+    return output;
+}
+
+// A tone must come out as the same tone at the new rate, delayed by the filter
+void checkTone(int32_t inputRate, int32_t outputRate, double frequency) {
+    const size_t frames = static_cast<size_t>(inputRate) / 2;
+    std::vector<float> output =
+            resample(inputRate, outputRate, 1, makeTone(frequency, inputRate, frames), 480);
+
+    PolyphaseResampler probe;
+    probe.configure(inputRate, outputRate, 1, 480);
+    const double delaySeconds = probe.getDelayFrames() / inputRate;
+    const double expectedFrames = static_cast<double>(frames) * outputRate / inputRate;
+    CHECK(std::fabs(static_cast<double>(output.size()) - expectedFrames) <= 1.0,
+          "%d -> %d: %zu frames, expected %.1f", inputRate, outputRate, output.size(),
+          expectedFrames);
+
+    // Skip the filter's start-up
+    const auto settled = static_cast<size_t>(2.0 * delaySeconds * outputRate) + 1;
+    double maxError = 0.0;
+    for (size_t i = settled; i < output.size(); i++) {
+        double t = static_cast<double>(i) / outputRate - delaySeconds;
+        double expected = kAmplitude * std::sin(2.0 * M_PI * frequency * t);
+        maxError = std::max(maxError, std::fabs(output[i] - expected));
+    }
+    CHECK(maxError < 1e-3, "%d -> %d: %.0f Hz tone off by %.2e", inputRate, outputRate,
+          frequency, maxError);
+    printf("%5d -> %5d Hz: %d taps/phase, delay %.2f ms, max error %.1f dB\n", inputRate,
+           outputRate, probe.getTapsPerPhase(), delaySeconds * 1000.0,
+           20.0 * std::log10(std::max(maxError, 1e-12) / kAmplitude));
+}
+
+// A tone above the output's Nyquist frequency must not alias into the output
+void checkAliasRejection() {
+    const double frequency = 10000.0;
+    std::vector<float> output = resample(kDeviceRate, kVoiceRate, 1,
+                                         makeTone(frequency, kDeviceRate, kDeviceRate / 2), 480);
+    double energy = 0.0;
+    const size_t settled = 200;
+    for (size_t i = settled; i < output.size(); i++) {
+        energy += static_cast<double>(output[i]) * output[i];
+    }
+    const double rms = std::sqrt(energy / static_cast<double>(output.size() - settled));
+    const double rejectionDb = 20.0 * std::log10(kAmplitude / std::sqrt(2.0) / rms);
+    CHECK(rejectionDb > 60.0, "10 kHz only rejected by %.1f dB at 48 -> 16 kHz", rejectionDb);
+    printf("10 kHz at 48 -> 16 kHz rejected by %.1f dB\n", rejectionDb);
+}
+
+// Blocks of any size, up to the configured maximum, give the same output
+void checkBlockIndependence() {
+    const std::vector<float> input = makeNoise(20000, 3);
+    const struct {
+        int32_t in;
+        int32_t out;
+    } kRatios[] = {{kDeviceRate, kVoiceRate}, {kVoiceRate, kDeviceRate}, {44100, kDeviceRate}};
+    for (const auto &ratio : kRatios) {
+        std::vector<float> whole = resample(ratio.in, ratio.out, 1, input, 20000);
+
+        PolyphaseResampler resampler;
+        resampler.configure(ratio.in, ratio.out, 1, 512);
+        std::vector<float> pieces(whole.size() + 8);
+        int32_t written = 0;
+        uint32_t seed = 11;
+        for (int32_t frame = 0; frame < static_cast<int32_t>(input.size());) {
+            seed = seed * 1664525u + 1013904223u;
+            int32_t count = std::min(static_cast<int32_t>(seed >> 23),
+                                     static_cast<int32_t>(input.size()) - frame);
+            written += resampler.process(input.data() + frame, count, pieces.data() + written);
+            frame += count;
+        }
+        pieces.resize(written);
+        CHECK(pieces == whole, "%d -> %d: output depends on the block sizes", ratio.in,
+              ratio.out);
+    }
+}
+
+// Feeding exactly getInputFramesNeeded(K) frames gives at least K frames, and
+// never more than one input frame's worth beyond that
+void checkPull(int32_t inputRate, int32_t outputRate) {
+    PolyphaseResampler resampler;
+    resampler.configure(inputRate, outputRate, 1, 4096);
+    const std::vector<float> input = makeNoise(200000, 5);
+    const int32_t perInputFrame = (outputRate + inputRate - 1) / inputRate;
+    std::vector<float> output(8192);
+    size_t consumed = 0;
+    for (int32_t block = 0; block < 200; block++) {
+        const int32_t wanted = 37 + (block * 53) % 300;
+        const int32_t needed = resampler.getInputFramesNeeded(wanted);
+        int32_t produced = resampler.process(input.data() + consumed, needed, output.data());
+        consumed += needed;
+        CHECK(produced >= wanted && produced < wanted + perInputFrame + 1,
+              "%d -> %d: asked for %d frames, %d input frames gave %d", inputRate, outputRate,
+              wanted, needed, produced);
+    }
+}
+
+// Each channel of an interleaved stream matches that channel resampled alone
+void checkChannels() {
+    constexpr int32_t kChannels = 4;
+    constexpr size_t kFrames = 9000;
+    std::vector<float> interleaved = makeNoise(kFrames * kChannels, 9);
+    std::vector<float> output = resample(kDeviceRate, kVoiceRate, kChannels, interleaved, 333);
+    for (int32_t c = 0; c < kChannels; c++) {
+        std::vector<float> channel(kFrames);
+        for (size_t i = 0; i < kFrames; i++) channel[i] = interleaved[i * kChannels + c];
+        std::vector<float> alone = resample(kDeviceRate, kVoiceRate, 1, channel, 333);
+        bool same = alone.size() * kChannels == output.size();
+        for (size_t i = 0; same && i < alone.size(); i++) {
+            same = alone[i] == output[i * kChannels + c];
+        }
+        CHECK(same, "channel %d differs from resampling it alone", c);
+    }
+}
+
+// Records a second of 48 kHz capture to a 16 kHz file, then plays it back on
+// the 48 kHz device
+void checkRecordAndPlay() {
+    oboe::StubDevice::configure(kDeviceRate, 1, kFramesPerBurst);
+    const size_t deviceFrames = kDeviceRate;
+    std::vector<int16_t> capture(deviceFrames);
+    std::vector<float> tone = makeTone(440.0, kDeviceRate, deviceFrames);
+    convertFloatToInt16(tone.data(), capture.data(), static_cast<int32_t>(deviceFrames));
+
+    const std::string path = tempPath("resampler-recording");
+    {
+        AudioRecorder recorder;
+        recorder.setStoragePath(path.c_str());
+        recorder.setTargetSampleRate(kVoiceRate);
+        CHECK(recorder.startRecording() == oboe::Result::OK, "startRecording failed");
+        CHECK(recorder.getFileSampleRate() == kVoiceRate, "file rate is %d",
+              recorder.getFileSampleRate());
+
+        oboe::AudioStreamBuilder builder;
+        builder.setDirection(oboe::Direction::Input)->setChannelCount(1)->setSampleRate(
+                kDeviceRate);
+        std::shared_ptr<oboe::AudioStream> stream;
+        builder.openStream(stream);
+        for (size_t frame = 0; frame + kFramesPerBurst <= deviceFrames;
+             frame += kFramesPerBurst) {
+            recorder.onAudioReady(stream.get(), capture.data() + frame, kFramesPerBurst);
+        }
+        recorder.stopRecording();
+    }
+
+    const std::vector<int16_t> recorded = readFile(path);
+    const size_t expectedFrames = deviceFrames * kVoiceRate / kDeviceRate;
+    CHECK(recorded.size() + 1 >= expectedFrames && recorded.size() <= expectedFrames + 1,
+          "recorded %zu frames at 16 kHz from %zu at 48 kHz", recorded.size(), deviceFrames);
+    printf("Recorded %zu device frames as %zu frames (%.1fx smaller)\n", deviceFrames,
+           recorded.size(), static_cast<double>(deviceFrames) / recorded.size());
+
+    // Playback has to produce exactly what the resampler makes of the file
+    std::vector<float> recordedFloat(recorded.size());
+    convertInt16ToFloat(recorded.data(), recordedFloat.data(),
+                        static_cast<int32_t>(recorded.size()));
+    std::vector<float> reference = resample(kVoiceRate, kDeviceRate, 1, recordedFloat, 4096);
+    std::vector<int16_t> expected(reference.size());
+    convertFloatToInt16(reference.data(), expected.data(), static_cast<int32_t>(expected.size()));
+
+    AudioPlayer player;
+    player.setFileSampleRate(kVoiceRate);
+    CHECK(player.startPlaybackFromFile(path.c_str()) == oboe::Result::OK,
+          "startPlaybackFromFile failed");
+    oboe::AudioStreamBuilder builder;
+    builder.setDirection(oboe::Direction::Output)
+            ->setFormat(oboe::AudioFormat::I16)
+            ->setChannelCount(1)
+            ->setSampleRate(kDeviceRate);
+    std::shared_ptr<oboe::AudioStream> stream;
+    builder.openStream(stream);
+
+    std::vector<int16_t> played;
+    std::vector<int16_t> burst(kFramesPerBurst);
+    for (int i = 0; i < 1000; i++) {
+        oboe::DataCallbackResult result =
+                player.onAudioReady(stream.get(), burst.data(), kFramesPerBurst);
+        played.insert(played.end(), burst.begin(), burst.end());
+        if (result == oboe::DataCallbackResult::Stop) break;
+    }
+    player.stopPlayback();
+
+    CHECK(played.size() >= expected.size(), "played %zu frames, the file resamples to %zu",
+          played.size(), expected.size());
+    size_t mismatches = 0;
+    for (size_t i = 0; i < std::min(played.size(), expected.size()); i++) {
+        mismatches += played[i] != expected[i];
+    }
+    CHECK(mismatches == 0, "%zu played samples differ from resampling the file", mismatches);
+    unlink(path.c_str());
+}
+
+} // namespace
+
+int main() {
+    checkTone(kDeviceRate, kVoiceRate, 1000.0);
+    checkTone(kDeviceRate, kVoiceRate, 6000.0);
+    checkTone(kVoiceRate, kDeviceRate, 1000.0);
+    checkTone(44100, kDeviceRate, 3000.0);
+    checkTone(kDeviceRate, 44100, 15000.0);
+    checkAliasRejection();
+    checkBlockIndependence();
+    checkPull(kVoiceRate, kDeviceRate);
+    checkPull(44100, kDeviceRate);
+    checkPull(kDeviceRate, kVoiceRate);
+    checkChannels();
+    checkRecordAndPlay();
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
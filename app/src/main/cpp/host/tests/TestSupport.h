@@ -0,0 +1,64 @@
+#ifndef OBOESAMPLE_TESTSUPPORT_H
+#define OBOESAMPLE_TESTSUPPORT_H
+
+/**
+ * What every host test shares: the CHECK macro and the failure count main()
+ * reports, temp files and reading raw PCM16 back, and the allocation count.
+ *
+ * allocationCount() comes from AllocationCounter.cpp, which replaces the
+ * global operator new; only tests that link it may call it.
+ */
+
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Failed CHECKs so far
+inline int gFailures = 0;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "FAILED %s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            gFailures++; \
+        } \
+    } while (0)
+
+// Creates a new empty file under /tmp named after name and returns its path
+inline std::string tempPath(const char *name) {
+    std::string path = std::string("/tmp/") + name + "-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    CHECK(fd >= 0, "could not create a temp file");
+    ::close(fd);
+    return path;
+}
+
+// The same path under /tmp for every call with the same test and name within
+// this process; nothing is created
+inline std::string processTempPath(const char *test, const char *name) {
+    return std::string("/tmp/") + test + "-" + std::to_string(getpid()) + "-" + name + ".raw";
+}
+
+// A raw PCM16 file's samples; empty if it can't be read
+inline std::vector<int16_t> readFile(const std::string &path) {
+    std::vector<int16_t> samples;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return samples;
+    int16_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, sizeof(int16_t), 4096, file)) > 0) {
+        samples.insert(samples.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return samples;
+}
+
+// Heap allocations made by any thread so far (AllocationCounter.cpp)
+int64_t allocationCount();
+
+#endif //OBOESAMPLE_TESTSUPPORT_H
@@ -0,0 +1,311 @@
+/**
+ * Voice activity test.
+ *
+ * The detector has to decide once per 10 ms frame, however the audio is cut
+ * into calls, hold speech for exactly its hangover after the last voiced
+ * frame, hear most of a speech-like signal as speech and none of noise,
+ * tones, a chord or silence. The suppressor built on it has to leave speech
+ * alone and take steady playback down by its aggressiveness, and through a
+ * ChainProcessor its decisions have to reach the VoiceActivity signal. The
+ * auto gain has to hold its gain while told there is no speech. Processing
+ * must never allocate.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "ChainProcessor.h"
+#include "DspGraph.h"
+#include "filter/AutoGain.h"
+#include "filter/PlaybackSuppressor.h"
+#include "filter/VoiceActivityDetector.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr int32_t kBurst = 192;
+constexpr size_t kFrames = kSampleRate * 4;
+
+// xorshift32 white noise in [-1, 1)
+std::vector<float> noise(float amplitude, uint32_t seed) {
+    std::vector<float> signal(kFrames);
+    for (auto &sample : signal) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        sample = amplitude * (static_cast<float>(seed) / 2147483648.0f - 1.0f);
+    }
+    return signal;
+}
+
+std::vector<float> tones(const std::vector<float> &frequencies, float amplitude) {
+    std::vector<float> signal(kFrames, 0.0f);
+    for (size_t i = 0; i < kFrames; i++) {
+        for (float frequency : frequencies) {
+            signal[i] += amplitude * static_cast<float>(
+                    std::sin(2.0 * M_PI * frequency * static_cast<double>(i) / kSampleRate));
+        }
+    }
+    return signal;
+}
+
+// Harmonics of a wandering pitch through three formants, in syllables of
+// ~200 ms with a pause every third one, over a little breath noise
+std::vector<float> speechLike() {
+    const float formants[3][3] = {{700.0f, 130.0f, 1.0f}, {1220.0f, 70.0f, 0.5f},
+                                  {2600.0f, 160.0f, 0.25f}};
+    std::vector<float> signal = noise(0.003f, 7);
+    double phase = 0.0;
+    for (size_t i = 0; i < kFrames; i++) {
+        const double t = static_cast<double>(i) / kSampleRate;
+        const double f0 = 140.0 + 30.0 * std::sin(2.0 * M_PI * 0.7 * t);
+        phase += 2.0 * M_PI * f0 / kSampleRate;
+        double voiced = 0.0;
+        for (int h = 1; h * f0 < 4000.0; h++) {
+            double weight = 0.0;
+            for (const auto &formant : formants) {
+                const double offset = (h * f0 - formant[0]) / formant[1];
+                weight += formant[2] / (1.0 + offset * offset);
+            }
+            voiced += weight / h * std::sin(h * phase);
+        }
+        const auto syllable = static_cast<int64_t>(t / 0.2);
+        const double position = t / 0.2 - static_cast<double>(syllable);
+        const double envelope = syllable % 3 == 2 ? 0.0
+                                                  : 0.5 - 0.5 * std::cos(2.0 * M_PI * position);
+        signal[i] += static_cast<float>(0.25 * envelope * voiced);
+    }
+    return signal;
+}
+
+double levelDb(const std::vector<float> &signal, size_t first, size_t last) {
+    double sum = 0.0;
+    for (size_t i = first; i < last; i++) sum += static_cast<double>(signal[i]) * signal[i];
+    return 10.0 * std::log10(std::max(sum / static_cast<double>(last - first), 1e-20));
+}
+
+// Share of the signal's frames the detector hears as speech
+double speechShare(const std::vector<float> &signal) {
+    VoiceActivityDetector detector(kSampleRate);
+    for (size_t i = 0; i < kFrames; i += kBurst) detector.process(signal.data() + i, kBurst);
+    return static_cast<double>(detector.getSpeechFrameCount()) /
+           static_cast<double>(detector.getFrameCount());
+}
+
+void checkFraming() {
+    // Calls of odd sizes complete a frame exactly every 10 ms
+    const std::vector<float> speech = speechLike();
+    VoiceActivityDetector detector(kSampleRate);
+    CHECK(detector.getFrameSize() == kSampleRate / 100, "frame of %d samples",
+          detector.getFrameSize());
+    int64_t completed = 0;
+    size_t offset = 0;
+    const int32_t sizes[] = {1, 37, 480, 479, 961, 192};
+    const int64_t before = allocationCount();
+    for (int call = 0; offset < kFrames; call++) {
+        const auto count = static_cast<int32_t>(std::min<size_t>(sizes[call % 6],
+                                                                 kFrames - offset));
+        const int32_t expected = (detector.getFrameSize() - detector.getSamplesToDecision() +
+                                  count) / detector.getFrameSize();
+        const int32_t frames = detector.process(speech.data() + offset, count);
+        CHECK(frames == expected, "%d samples completed %d frames, not %d", count, frames,
+              expected);
+        completed += frames;
+        offset += static_cast<size_t>(count);
+    }
+    CHECK(allocationCount() == before, "the detector allocated");
+    CHECK(completed == static_cast<int64_t>(kFrames) / detector.getFrameSize() &&
+          detector.getFrameCount() == completed, "%lld frames decided",
+          static_cast<long long>(detector.getFrameCount()));
+}
+
+void checkDecisions() {
+    const double speech = speechShare(speechLike());
+    printf("speech share: speech %.2f", speech);
+    CHECK(speech >= 0.6 && speech <= 0.98, "speech heard as speech %.2f of the time", speech);
+
+    const struct {
+        const char *name;
+        std::vector<float> signal;
+    } others[] = {
+            {"white", noise(0.1f, 1)},
+            {"tone", tones({440.0f}, 0.25f)},
+            {"chord", tones({261.6f, 329.6f, 392.0f, 523.3f}, 0.1f)},
+            {"silence", std::vector<float>(kFrames, 0.0f)},
+    };
+    for (const auto &other : others) {
+        const double share = speechShare(other.signal);
+        printf("  %s %.2f", other.name, share);
+        CHECK(share == 0.0, "%s heard as speech %.2f of the time", other.name, share);
+    }
+    printf("\n");
+}
+
+void checkHangover() {
+    // Speech holds for kHangoverFrames after each voiced frame, so across
+    // syllables and into the silence after them
+    std::vector<float> signal = speechLike();
+    std::fill(signal.begin() + kFrames / 2, signal.end(), 0.0f);
+    VoiceActivityDetector detector(kSampleRate);
+    const int32_t frameSize = detector.getFrameSize();
+    int64_t lastVoiced = -1000;
+    int64_t mismatches = 0;
+    for (int64_t frame = 0; (frame + 1) * frameSize <= static_cast<int64_t>(kFrames); frame++) {
+        detector.process(signal.data() + frame * frameSize, frameSize);
+        if (detector.getFeatures().voiced) lastVoiced = frame;
+        const bool expected = frame - lastVoiced < VoiceActivityDetector::kHangoverFrames;
+        mismatches += detector.isSpeech() != expected;
+    }
+    CHECK(mismatches == 0, "%lld frames break the hangover", static_cast<long long>(mismatches));
+    CHECK(!detector.isSpeech(), "still speech after 2 s of silence");
+}
+
+void checkSuppressor() {
+    const float aggressiveness = 0.8f;
+    const std::vector<float> speech = speechLike();
+    const std::vector<float> playback = tones({440.0f}, 0.25f);
+    PlaybackSuppressor suppressor(kSampleRate);
+    suppressor.setEnabled(true);
+    suppressor.setAggressiveness(aggressiveness);
+
+    std::vector<float> speechOut(kFrames);
+    std::vector<float> playbackOut(kFrames);
+    const int64_t before = allocationCount();
+    for (size_t i = 0; i < kFrames; i += kBurst) {
+        suppressor.process(speech.data() + i, speechOut.data() + i, kBurst);
+    }
+    suppressor.reset();
+    float largestStep = 0.0f;
+    float gain = suppressor.getGain();
+    for (size_t i = 0; i < kFrames; i++) {
+        playbackOut[i] = suppressor.process(playback[i]);
+        largestStep = std::max(largestStep, std::fabs(suppressor.getGain() - gain));
+        gain = suppressor.getGain();
+    }
+    CHECK(allocationCount() == before, "the suppressor allocated");
+
+    const double speechGain = levelDb(speechOut, 0, kFrames) - levelDb(speech, 0, kFrames);
+    const double playbackGain = levelDb(playbackOut, kFrames / 2, kFrames) -
+                                levelDb(playback, kFrames / 2, kFrames);
+    const double expected = 20.0 * std::log10(1.0 - aggressiveness);
+    printf("suppressor: speech %.2f dB  playback %.2f dB  largest gain step %.4f\n",
+           speechGain, playbackGain, largestStep);
+    CHECK(std::fabs(speechGain) <= 0.5, "speech changed by %.2f dB", speechGain);
+    CHECK(std::fabs(playbackGain - expected) <= 0.1, "playback changed by %.2f dB, not %.2f",
+          playbackGain, expected);
+    // The gain never steps: the fastest it moves is the attack envelope's
+    // first sample over the whole range
+    CHECK(largestStep <= aggressiveness * 1.5f / (PlaybackSuppressor::kAttackMs * 48.0f),
+          "the gain stepped by %g", largestStep);
+
+    // At aggressiveness 0 the audio passes untouched, but the detector still runs
+    suppressor.reset();
+    suppressor.setAggressiveness(0.0f);
+    bool untouched = true;
+    for (size_t i = 0; i < kFrames; i += kBurst) {
+        suppressor.process(playback.data() + i, playbackOut.data() + i, kBurst);
+    }
+    for (size_t i = 0; i < kFrames; i++) untouched &= playbackOut[i] == playback[i];
+    CHECK(untouched, "aggressiveness 0 changed the audio");
+    CHECK(suppressor.getDetector().getFrameCount() > 0, "the detector didn't run");
+}
+
+void checkAutoGainHold() {
+    // Quiet speech-level audio the AGC would bring up, unless told it isn't speech
+    const std::vector<float> quiet = noise(0.01f, 3);
+    for (bool voice : {true, false}) {
+        AutoGain autoGain;
+        autoGain.prepare(kSampleRate, 1);
+        autoGain.setRelease(100.0f);
+        autoGain.setVoiceActive(voice);
+        std::vector<float> out(kFrames);
+        for (size_t i = 0; i < kFrames; i += kBurst) {
+            autoGain.process(quiet.data() + i, out.data() + i, kBurst);
+        }
+        printf("auto gain, voice %d: %.2f dB\n", voice, autoGain.getGainDb());
+        if (voice) {
+            CHECK(autoGain.getGainDb() > 6.0f, "the AGC didn't bring speech up (%.2f dB)",
+                  autoGain.getGainDb());
+        } else {
+            CHECK(autoGain.getGainDb() == 0.0f, "the AGC moved (%.2f dB) without speech",
+                  autoGain.getGainDb());
+        }
+    }
+}
+
+void checkChainSignal() {
+    DspGraph graph;
+    StageConfig suppressor = StageConfig::defaults(StageType::PlaybackSuppressor);
+    suppressor.id = 1;
+    graph.insertStage(suppressor);
+    StageConfig autoGain = StageConfig::defaults(StageType::AutoGain);
+    autoGain.id = 2;
+    graph.insertStage(autoGain);
+
+    // Two suppressors still make one decision per block
+    DspGraph twoSuppressors = graph;
+    suppressor.id = 3;
+    twoSuppressors.insertStage(suppressor);
+
+    const std::vector<float> speech = speechLike();
+    const std::vector<float> tone = tones({440.0f}, 0.25f);
+    const struct {
+        const char *name;
+        const DspGraph &graph;
+        const std::vector<float> &input;
+        bool speech;
+    } cases[] = {
+            {"speech", graph, speech, true},
+            {"tone", graph, tone, false},
+            {"speech, two suppressors", twoSuppressors, speech, true},
+    };
+    for (const auto &c : cases) {
+        ChainProcessor chain;
+        chain.prepare(kSampleRate, 2, kBurst, c.graph);
+        // The same audio on both channels
+        std::vector<float> buffer(static_cast<size_t>(kBurst) * 2);
+        const int64_t before = allocationCount();
+        bool anySpeech = false;
+        for (size_t i = 0; i < kFrames; i += kBurst) {
+            for (int32_t f = 0; f < kBurst; f++) {
+                buffer[2 * f] = buffer[2 * f + 1] = c.input[i + f];
+            }
+            chain.update();
+            chain.process(buffer.data(), kBurst);
+            anySpeech |= chain.getVoiceActivity().isSpeech();
+        }
+        CHECK(allocationCount() == before, "the chain allocated");
+
+        const VoiceActivity::Snapshot voice = chain.getVoiceActivity().snapshot();
+        printf("chain %s: %lld frames, speech share %.2f\n", c.name,
+               static_cast<long long>(voice.frames), voice.speechShare());
+        CHECK(voice.frames == static_cast<int64_t>(kFrames), "%s: %lld frames published",
+              c.name, static_cast<long long>(voice.frames));
+        if (c.speech) {
+            CHECK(anySpeech && voice.speechShare() >= 0.6f, "%s: speech share %.2f", c.name,
+                  voice.speechShare());
+        } else {
+            CHECK(!anySpeech && voice.speechFrames == 0, "%s: heard as speech", c.name);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    checkFraming();
+    checkDecisions();
+    checkHangover();
+    checkSuppressor();
+    checkAutoGainHold();
+    checkChainSignal();
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+/**
+ * Worker thread scheduling test.
+ *
+ * A WorkerThread has to come up with its name, the nice value or SCHED_FIFO
+ * priority it asked for (or, where FIFO is refused, report the fallback it
+ * really got), and a core mask within the class it asked for. sleepFor() has
+ * to count every wake-up. Once a data callback reports its core, workers must
+ * leave that core, both when they start and when the callback moves while
+ * they run, unless it is the only core they have. Last, the file writer's
+ * thread must show up through its stats.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "AudioFileWriter.h"
+#include "WorkerThread.h"
+#include "TestSupport.h"
+
+namespace {
+
+constexpr int kSleeps = 40;
+constexpr auto kSleep = std::chrono::milliseconds(2);
+
+// Cores this process may use, as a mask
+uint64_t allowedCores() {
+    cpu_set_t set;
+    uint64_t mask = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int core = 0; core < 64; core++) {
+            if (CPU_ISSET(core, &set)) mask |= uint64_t(1) << core;
+        }
+    }
+    return mask;
+}
+
+void pinCallingThread(int core) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+void checkNice() {
+    ThreadScheduling scheduling;
+    scheduling.nice = 5;  // lowering priority is always allowed
+    scheduling.avoidCallbackCores = false;
+
+    WorkerThread worker;
+    char name[16] = {};
+    worker.start("TestWorker", [&] {
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        for (int i = 0; i < kSleeps; i++) {
+            WorkerThread::sleepFor(kSleep);
+        }
+    }, scheduling);
+    worker.join();
+
+    WorkerThread::Stats stats = worker.getStats();
+    char summary[256];
+    stats.formatSummary(summary, sizeof(summary));
+    printf("nice worker: %s\n", summary);
+    CHECK(std::string(name) == "TestWorker", "thread named '%s'", name);
+    CHECK(!stats.running, "still reported running after join");
+    CHECK(!stats.fifo && stats.priority == 5, "asked for nice 5, got %s %d",
+          stats.fifo ? "FIFO" : "nice", stats.priority);
+    CHECK(stats.wakeUps == kSleeps, "%lld wake-ups recorded, slept %d times",
+          static_cast<long long>(stats.wakeUps), kSleeps);
+    CHECK(stats.wakeLatencyMaxNs >= stats.meanWakeLatencyNs(), "max latency below mean");
+    const uint64_t machine = WorkerThread::getCoreMask(CoreSelection::Any);
+    CHECK(stats.coreMask != 0 && (stats.coreMask & ~machine) == 0,
+          "core mask 0x%llx outside the machine's cores 0x%llx",
+          static_cast<unsigned long long>(stats.coreMask),
+          static_cast<unsigned long long>(machine));
+}
+
+// FIFO may or may not be granted here; either way the stats must say which
+void checkFifo() {
+    ThreadScheduling scheduling;
+    scheduling.fifo = true;
+    scheduling.fifoPriority = 3;
+    scheduling.nice = 2;
+
+    WorkerThread worker;
+    int policy = -1;
+    worker.start("TestFifo", [&] {
+        policy = sched_getscheduler(0);
+        WorkerThread::sleepFor(kSleep);
+    }, scheduling);
+    worker.join();
+
+    WorkerThread::Stats stats = worker.getStats();
+    printf("FIFO worker: %s %d\n", stats.fifo ? "granted, priority" : "refused, nice",
+           stats.priority);
+    CHECK(stats.fifo == (policy == SCHED_FIFO), "reports %s but runs with policy %d",
+          stats.fifo ? "FIFO" : "SCHED_OTHER", policy);
+    CHECK(stats.fifo ? stats.priority == 3 : stats.priority == 2,
+          "priority %d doesn't match the request", stats.priority);
+}
+
+// As many recorder callbacks as it takes for its core to be looked up
+void runCallbacks() {
+    for (uint32_t i = 0; i < WorkerThread::kCpuSamplePeriod; i++) {
+        WorkerThread::noteCallbackCpu(CallbackStream::Recorder);
+    }
+}
+
+void checkCallbackAvoidance() {
+    const uint64_t allowed = allowedCores();
+    std::vector<int> cores;
+    for (int core = 0; core < 64; core++) {
+        if (allowed & (uint64_t(1) << core)) cores.push_back(core);
+    }
+
+    // Pretend this thread is the recorder callback, on the first core
+    pinCallingThread(cores[0]);
+    std::this_thread::yield();
+    runCallbacks();
+
+    ThreadScheduling scheduling;
+    scheduling.nice = 0;
+    std::atomic<bool> moved{false};
+    std::atomic<bool> stop{false};
+    WorkerThread worker;
+    worker.start("TestAvoid", [&] {
+        while (!stop.load()) {
+            WorkerThread::sleepFor(kSleep);
+        }
+    }, scheduling);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    const uint64_t first = uint64_t(1) << cores[0];
+    WorkerThread::Stats stats = worker.getStats();
+    if (cores.size() > 1) {
+        CHECK((stats.coreMask & first) == 0, "worker mask 0x%llx includes the callback core %d",
+              static_cast<unsigned long long>(stats.coreMask), cores[0]);
+
+        // The callback moves to the second core: the worker has to follow
+        const uint64_t second = uint64_t(1) << cores[1];
+        pinCallingThread(cores[1]);
+        std::this_thread::yield();
+        runCallbacks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        stats = worker.getStats();
+        CHECK((stats.coreMask & second) == 0 && (stats.coreMask & first) != 0,
+              "after the callback moved, worker mask is 0x%llx",
+              static_cast<unsigned long long>(stats.coreMask));
+        moved = true;
+    } else {
+        // A single core can't be given up
+        CHECK(stats.coreMask == first, "single-core worker mask is 0x%llx",
+              static_cast<unsigned long long>(stats.coreMask));
+    }
+    stop = true;
+    worker.join();
+    printf("callback avoidance on %zu cores: worker mask 0x%llx%s\n", cores.size(),
+           static_cast<unsigned long long>(worker.getStats().coreMask),
+           moved ? " (followed the callback)" : "");
+
+    // Back to every core for the rest of the test
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core : cores) CPU_SET(core, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+void checkWriterThread() {
+    char path[] = "/tmp/worker-thread-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0, "could not create a temp file");
+    ::close(fd);
+
+    AudioFileWriter writer;
+    CHECK(writer.open(path, 48000, 1, FileFormat::Pcm16), "writer open failed");
+    std::vector<int16_t> silence(4800);
+    writer.write(silence.data(), static_cast<int32_t>(silence.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    WorkerThread::Stats stats = writer.getThreadStats();
+    CHECK(stats.running && stats.wakeUps > 0, "writer thread %s, %lld wake-ups",
+          stats.running ? "running" : "not running", static_cast<long long>(stats.wakeUps));
+    writer.close();
+    CHECK(!writer.getThreadStats().running, "writer thread still running after close");
+    unlink(path);
+}
+
+} // namespace
+
+int main() {
+    checkNice();
+    checkFifo();
+    checkCallbackAvoidance();
+    checkWriterThread();
+
+    if (gFailures == 0) {
+        printf("PASSED\n");
+    }
+    return gFailures == 0 ? 0 : 1;
+}
@@ -1,7 +1,11 @@
 #include <jni.h>
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include "AudioRecorder.h"
 #include "AudioPlayer.h"
+#include "FullDuplexEngine.h"
+#include "OfflineProcessor.h"
 #include <android/log.h>
 
 #define LOG_TAG "NativeLib"
@@ -10,7 +14,37 @@
 
 static AudioRecorder sRecorder;
 static AudioPlayer sPlayer;
+static FullDuplexEngine sDuplex;
+
+// What the player renders, fed to the recorder's echo canceller
+static FarEndReference sFarEndReference;
 static std::string sCurrentRecordingPath;
+static FileFormat sRecordingFormat = FileFormat::Pcm16;
+
+// Rate the last recording was written at: the recorder stores at its target
+// rate, the full-duplex engine at the device rate. 0 until either has
+// recorded.
+static int32_t sLastFileSampleRate = 0;
+
+// AudioEngine.FORMAT_* to FileFormat
+static FileFormat toFileFormat(jint format) {
+    switch (format) {
+        case 1:
+            return FileFormat::Float32;
+        case 2:
+            return FileFormat::Lossless;
+        default:
+            return FileFormat::Pcm16;
+    }
+}
+
+// The full-duplex engine runs the recorder's graph; edits made while it runs
+// are passed on
+static void syncDuplexGraph() {
+    if (sDuplex.isRunning()) {
+        sDuplex.setGraph(sRecorder.getGraph());
+    }
+}
 
 // Basic audio operations
 extern "C" {
@@ -22,6 +56,24 @@ Java_com_example_oboesample_AudioEngine_setRecordingPath(JNIEnv *env, jobject, j
     env->ReleaseStringUTFChars(path, pathPtr);
 }
 
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_setRecordingFormat(JNIEnv *env, jobject, jint format) {
+    sRecordingFormat = toFileFormat(format);
+    sRecorder.setFileFormat(sRecordingFormat);
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_setRecordingSampleRate(JNIEnv *env, jobject,
+                                                               jint sampleRate) {
+    sRecorder.setTargetSampleRate(sampleRate);
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_setFloatCaptureEnabled(JNIEnv *env, jobject,
+                                                               jboolean enabled) {
+    sRecorder.setFloatCaptureEnabled(enabled);
+}
+
 JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_setAudioSource(JNIEnv *env, jobject, jint sourceType) {
     oboe::InputPreset preset;
@@ -60,7 +112,10 @@ Java_com_example_oboesample_AudioEngine_setAndroidAECEnabled(JNIEnv *env, jobjec
 
 JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_startRecording(JNIEnv *env, jobject) {
-    sRecorder.startRecording();
+    sRecorder.setFarEndReference(&sFarEndReference);
+    if (sRecorder.startRecording() == oboe::Result::OK) {
+        sLastFileSampleRate = sRecorder.getFileSampleRate();
+    }
 }
 
 JNIEXPORT void JNICALL
@@ -71,6 +126,10 @@ Java_com_example_oboesample_AudioEngine_stopRecording(JNIEnv *env, jobject) {
 JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_playRecording(JNIEnv *env, jobject) {
     if (!sCurrentRecordingPath.empty()) {
+        sPlayer.setFarEndReference(&sFarEndReference);
+        sPlayer.setFileFormat(sRecordingFormat);
+        sPlayer.setFileSampleRate(sLastFileSampleRate > 0 ? sLastFileSampleRate
+                                                          : sRecorder.getFileSampleRate());
         sPlayer.startPlaybackFromFile(sCurrentRecordingPath.c_str());
     } else {
         LOGE("No recording path set for playback!");
@@ -82,17 +141,161 @@ Java_com_example_oboesample_AudioEngine_stopPlayback(JNIEnv *env, jobject) {
     sPlayer.stopPlayback();
 }
 
+// Records and monitors on one callback clock; instead of startRecording(),
+// not alongside it. Records to the recording path in the recording format, at
+// the device rate, through the recorder's processing graph.
+JNIEXPORT jboolean JNICALL
+Java_com_example_oboesample_AudioEngine_startFullDuplex(JNIEnv *env, jobject,
+                                                        jboolean monitoring) {
+    sDuplex.setStoragePath(sCurrentRecordingPath.c_str());
+    sDuplex.setFileFormat(sRecordingFormat);
+    sDuplex.setGraph(sRecorder.getGraph());
+    sDuplex.setMonitoringEnabled(monitoring);
+    if (sDuplex.start() != oboe::Result::OK) {
+        return false;
+    }
+    sLastFileSampleRate = sDuplex.getSampleRate();
+    return true;
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_stopFullDuplex(JNIEnv *env, jobject) {
+    sDuplex.stop();
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_setMonitoring(JNIEnv *env, jobject, jboolean enabled,
+                                                      jfloat gainDb) {
+    sDuplex.setMonitorGain(std::pow(10.0f, gainDb / 20.0f));
+    sDuplex.setMonitoringEnabled(enabled);
+}
+
+// Frames between an input frame being read and it being monitored, on the
+// shared clock (device latency not included)
+JNIEXPORT jint JNICALL
+Java_com_example_oboesample_AudioEngine_getFullDuplexLatencyFrames(JNIEnv *env, jobject) {
+    return sDuplex.getLatencyFrames();
+}
+
+// Reprocesses a recording with the recorder's current settings, faster than
+// real time. Raw input is taken to be in the recording format at the rate
+// recordings are stored at and the recorder's channel count. Blocks until done; returns how
+// many times faster than real time it ran, or -1 on failure.
+JNIEXPORT jdouble JNICALL
+Java_com_example_oboesample_AudioEngine_processRecording(JNIEnv *env, jobject, jstring inputPath,
+                                                         jstring outputPath, jint outputFormat) {
+    const char *inputPtr = env->GetStringUTFChars(inputPath, nullptr);
+    const char *outputPtr = env->GetStringUTFChars(outputPath, nullptr);
+    std::string input = inputPtr;
+    std::string output = outputPtr;
+    env->ReleaseStringUTFChars(inputPath, inputPtr);
+    env->ReleaseStringUTFChars(outputPath, outputPtr);
+
+    OfflineProcessor processor;
+    processor.setGraph(sRecorder.getGraph());
+    processor.setRawInputFormat(sRecordingFormat, sRecorder.getFileSampleRate(),
+                                sRecorder.getChannelCount());
+    processor.setOutputFormat(toFileFormat(outputFormat));
+    OfflineProcessor::Result result = processor.process(input, output);
+    if (!result.ok) {
+        LOGE("Offline processing of %s failed", input.c_str());
+        return -1.0;
+    }
+    return result.speedFactor();
+}
+
+// Callback metrics, laid out as the METRIC_* indices in AudioEngine.kt: the
+// summary fields, then the processing-time histogram counts
+JNIEXPORT jdoubleArray JNICALL
+Java_com_example_oboesample_AudioEngine_getCallbackMetrics(JNIEnv *env, jobject, jint stream) {
+    CallbackMetrics::Snapshot metrics = stream == 1 ? sPlayer.getCallbackMetrics()
+                                        : stream == 2 ? sDuplex.getCallbackMetrics()
+                                                      : sRecorder.getCallbackMetrics();
+    constexpr int kSummaryFields = 12;
+    jdouble values[kSummaryFields + CallbackMetrics::kNumBuckets] = {
+            static_cast<jdouble>(metrics.callbacks),
+            static_cast<jdouble>(metrics.meanProcessingNs()),
+            static_cast<jdouble>(metrics.percentileNs(50.0)),
+            static_cast<jdouble>(metrics.percentileNs(99.0)),
+            static_cast<jdouble>(metrics.processingMaxNs),
+            static_cast<jdouble>(metrics.meanPeriodNs()),
+            static_cast<jdouble>(metrics.periodMaxNs),
+            static_cast<jdouble>(metrics.lastBudgetNs),
+            metrics.meanUtilization(),
+            metrics.maxUtilization,
+            static_cast<jdouble>(metrics.overruns),
+            static_cast<jdouble>(metrics.xRunCount),
+    };
+    for (int b = 0; b < CallbackMetrics::kNumBuckets; b++) {
+        values[kSummaryFields + b] = static_cast<jdouble>(metrics.histogram[b]);
+    }
+
+    jdoubleArray result = env->NewDoubleArray(kSummaryFields + CallbackMetrics::kNumBuckets);
+    if (result != nullptr) {
+        env->SetDoubleArrayRegion(result, 0, kSummaryFields + CallbackMetrics::kNumBuckets,
+                                  values);
+    }
+    return result;
+}
+
+// Scheduling for the writer, decoder and read-ahead threads started from now
+// on. priority is the SCHED_FIFO priority if fifo, else the nice value; cores
+// is a CoreSelection.
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_setWorkerThreadScheduling(JNIEnv *env, jobject,
+                                                                  jboolean fifo, jint priority,
+                                                                  jint cores,
+                                                                  jboolean avoidCallbackCores) {
+    ThreadScheduling scheduling = WorkerThread::getDefaultScheduling();
+    scheduling.fifo = fifo;
+    if (fifo) {
+        scheduling.fifoPriority = priority;
+    } else {
+        scheduling.nice = priority;
+    }
+    scheduling.cores = static_cast<CoreSelection>(std::clamp(cores, 0, 2));
+    scheduling.avoidCallbackCores = avoidCallbackCores;
+    WorkerThread::setDefaultScheduling(scheduling);
+}
+
+// Worker thread statistics, laid out as the THREAD_* indices in AudioEngine.kt
+JNIEXPORT jdoubleArray JNICALL
+Java_com_example_oboesample_AudioEngine_getWorkerThreadStats(JNIEnv *env, jobject, jint stream) {
+    WorkerThread::Stats stats = stream == 1 ? sPlayer.getSourceThreadStats()
+                                : stream == 2 ? sDuplex.getWriterThreadStats()
+                                              : sRecorder.getWriterThreadStats();
+    constexpr int kFields = 9;
+    jdouble values[kFields] = {
+            stats.running ? 1.0 : 0.0,
+            stats.fifo ? 1.0 : 0.0,
+            static_cast<jdouble>(stats.priority),
+            static_cast<jdouble>(stats.coreMask),
+            static_cast<jdouble>(stats.wakeUps),
+            static_cast<jdouble>(stats.meanWakeLatencyNs()),
+            static_cast<jdouble>(stats.wakeLatencyMaxNs),
+            static_cast<jdouble>(stats.migrations),
+            static_cast<jdouble>(stats.involuntarySwitches),
+    };
+    jdoubleArray result = env->NewDoubleArray(kFields);
+    if (result != nullptr) {
+        env->SetDoubleArrayRegion(result, 0, kFields, values);
+    }
+    return result;
+}
+
 // Bandpass filter
 JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_setBandpassFilterEnabled(JNIEnv *env, jobject,
                                                                  jboolean enabled) {
     sRecorder.setBandpassFilterEnabled(enabled);
+    syncDuplexGraph();
 }
 
 JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_configureBandpassFilter(JNIEnv *env, jobject,
                                                                 jfloat centerFreq, jfloat Q) {
     sRecorder.configureBandpassFilter(centerFreq, Q);
+    syncDuplexGraph();
 }
 
 // High shelf filter
@@ -100,6 +303,7 @@ JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_setHighShelfFilterEnabled(JNIEnv *env, jobject,
                                                                   jboolean enabled) {
     sRecorder.setHighShelfFilterEnabled(enabled);
+    syncDuplexGraph();
 }
 
 JNIEXPORT void JNICALL
@@ -107,6 +311,7 @@ Java_com_example_oboesample_AudioEngine_configureHighShelfFilter(JNIEnv *env, jo
                                                                  jfloat centerFreq, jfloat Q,
                                                                  jfloat gainDb) {
     sRecorder.configureHighShelfFilter(centerFreq, Q, gainDb);
+    syncDuplexGraph();
 }
 
 // Peaking filter
@@ -114,6 +319,7 @@ JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_setPeakingFilterEnabled(JNIEnv *env, jobject,
                                                                 jboolean enabled) {
     sRecorder.setPeakingFilterEnabled(enabled);
+    syncDuplexGraph();
 }
 
 JNIEXPORT void JNICALL
@@ -121,6 +327,7 @@ Java_com_example_oboesample_AudioEngine_configurePeakingFilter(JNIEnv *env, jobj
                                                                jfloat centerFreq, jfloat Q,
                                                                jfloat gainDb) {
     sRecorder.configurePeakingFilter(centerFreq, Q, gainDb);
+    syncDuplexGraph();
 }
 
 // Noise gate
@@ -128,6 +335,7 @@ JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_setNoiseGateEnabled(JNIEnv *env, jobject,
                                                             jboolean enabled) {
     sRecorder.setNoiseGateEnabled(enabled);
+    syncDuplexGraph();
 }
 
 JNIEXPORT void JNICALL
@@ -135,6 +343,7 @@ Java_com_example_oboesample_AudioEngine_configureNoiseGate(JNIEnv *env, jobject,
                                                            jfloat ratio, jfloat attackMs,
                                                            jfloat releaseMs) {
     sRecorder.configureNoiseGate(thresholdDb, ratio, attackMs, releaseMs);
+    syncDuplexGraph();
 }
 
 // Noise reduction
@@ -142,12 +351,14 @@ JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_setNoiseReductionEnabled(JNIEnv *env, jobject,
                                                                  jboolean enabled) {
     sRecorder.setNoiseReductionEnabled(enabled);
+    syncDuplexGraph();
 }
 
 JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_configureNoiseReduction(JNIEnv *env, jobject,
                                                                 jfloat amount) {
     sRecorder.configureNoiseReduction(amount);
+    syncDuplexGraph();
 }
 
 // Echo canceller
@@ -155,12 +366,35 @@ JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_setEchoCancellerEnabled(JNIEnv *env, jobject,
                                                                 jboolean enabled) {
     sRecorder.setEchoCancellerEnabled(enabled);
+    syncDuplexGraph();
 }
 
 JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_configureEchoCanceller(JNIEnv *env, jobject, jfloat delayMs,
                                                                jfloat suppressionAmount) {
     sRecorder.configureEchoCanceller(delayMs, suppressionAmount);
+    syncDuplexGraph();
+}
+
+// Automatic gain control and limiter
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_setAutoGainEnabled(JNIEnv *env, jobject,
+                                                           jboolean enabled) {
+    sRecorder.setAutoGainEnabled(enabled);
+    syncDuplexGraph();
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_configureAutoGain(JNIEnv *env, jobject, jfloat targetDb,
+                                                          jfloat maxGainDb) {
+    sRecorder.configureAutoGain(targetDb, maxGainDb);
+    syncDuplexGraph();
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_configureLimiter(JNIEnv *env, jobject, jfloat ceilingDb) {
+    sRecorder.configureLimiter(ceilingDb);
+    syncDuplexGraph();
 }
 
 // Playback suppressor (NEW)
@@ -168,11 +402,100 @@ JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_setPlaybackSuppressorEnabled(JNIEnv *env, jobject,
                                                                      jboolean enabled) {
     sRecorder.setPlaybackSuppressorEnabled(enabled);
+    syncDuplexGraph();
 }
 
 JNIEXPORT void JNICALL
 Java_com_example_oboesample_AudioEngine_configurePlaybackSuppressor(JNIEnv *env, jobject,
                                                                     jfloat aggressiveness) {
     sRecorder.configurePlaybackSuppressor(aggressiveness);
+    syncDuplexGraph();
+}
+
+// The suppressor's voice activity as [speech, probability, speech share], as
+// VOICE_* in AudioEngine.kt. Only the recorder and the full-duplex stream have one.
+JNIEXPORT jfloatArray JNICALL
+Java_com_example_oboesample_AudioEngine_getVoiceActivity(JNIEnv *env, jobject, jint stream) {
+    VoiceActivity::Snapshot voice = stream == 2 ? sDuplex.getVoiceActivity()
+                                  : stream == 0 ? sRecorder.getVoiceActivity()
+                                                : VoiceActivity::Snapshot();
+    const jfloat values[] = {voice.speech ? 1.0f : 0.0f, voice.probability,
+                             voice.speechShare()};
+    jfloatArray result = env->NewFloatArray(3);
+    if (result != nullptr) {
+        env->SetFloatArrayRegion(result, 0, 3, values);
+    }
+    return result;
+}
+
+// Processing graph: stages by id, in processing order
+JNIEXPORT jint JNICALL
+Java_com_example_oboesample_AudioEngine_addProcessingStage(JNIEnv *env, jobject, jint type,
+                                                           jint position) {
+    if (type < 0 || type >= kNumStageTypes) {
+        LOGE("Unknown stage type %d", type);
+        return -1;
+    }
+    const auto result = sRecorder.addStage(static_cast<StageType>(type), position);
+    syncDuplexGraph();
+    return result;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_oboesample_AudioEngine_removeProcessingStage(JNIEnv *env, jobject, jint id) {
+    const auto result = sRecorder.removeStage(id);
+    syncDuplexGraph();
+    return result;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_oboesample_AudioEngine_moveProcessingStage(JNIEnv *env, jobject, jint id,
+                                                            jint position) {
+    const auto result = sRecorder.moveStage(id, position);
+    syncDuplexGraph();
+    return result;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_oboesample_AudioEngine_setProcessingStageEnabled(JNIEnv *env, jobject, jint id,
+                                                                  jboolean enabled) {
+    const auto result = sRecorder.setStageEnabled(id, enabled);
+    syncDuplexGraph();
+    return result;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_oboesample_AudioEngine_setProcessingStageParam(JNIEnv *env, jobject, jint id,
+                                                                jint param, jfloat value) {
+    if (param < 0 || param > static_cast<jint>(StageParam::CeilingDb)) {
+        LOGE("Unknown stage parameter %d", param);
+        return false;
+    }
+    const auto result = sRecorder.setStageParam(id, static_cast<StageParam>(param), value);
+    syncDuplexGraph();
+    return result;
+}
+
+// Stage ids in processing order, then their types, as one array of 2 * n
+JNIEXPORT jintArray JNICALL
+Java_com_example_oboesample_AudioEngine_getProcessingStages(JNIEnv *env, jobject) {
+    const DspGraph graph = sRecorder.getGraph();
+    const int32_t count = graph.size();
+    jint values[2 * DspGraph::kMaxStages];
+    for (int32_t i = 0; i < count; i++) {
+        values[i] = graph.stage(i).id;
+        values[count + i] = static_cast<jint>(graph.stage(i).type);
+    }
+    jintArray result = env->NewIntArray(2 * count);
+    if (result != nullptr) {
+        env->SetIntArrayRegion(result, 0, 2 * count, values);
+    }
+    return result;
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_oboesample_AudioEngine_resetProcessingGraph(JNIEnv *env, jobject) {
+    sRecorder.resetGraph();
+    syncDuplexGraph();
 }
 }
\ No newline at end of file
@@ -17,6 +17,19 @@ object AudioEngine {
     external fun setRecordingPath(path: String)
     external fun setAudioSource(sourceType: Int)
 
+    // Recording file formats
+    const val FORMAT_PCM16 = 0
+    const val FORMAT_FLOAT32 = 1
+    const val FORMAT_LOSSLESS = 2  // Compressed; playback detects it itself
+
+    // How recordings are stored, and whether the device is captured as float
+    external fun setRecordingFormat(format: Int)
+    external fun setFloatCaptureEnabled(enabled: Boolean)
+
+    // Rate recordings are stored at, e.g. 16000 for voice; the device rate is
+    // resampled to it. 0 keeps the device rate. Playback resamples back.
+    external fun setRecordingSampleRate(sampleRate: Int)
+
     // NEW: Enable/disable Android's built-in Acoustic Echo Canceler
     external fun setAndroidAECEnabled(enabled: Boolean)
 
@@ -25,6 +38,73 @@ object AudioEngine {
     external fun playRecording()
     external fun stopPlayback()
 
+    // Records and monitors on one callback clock, instead of startRecording():
+    // the input is read from the output stream's callback, so what is heard
+    // and recorded is sample-aligned with what plays, and the echo canceller
+    // gets the exact far end. Uses the recording path, format and filter
+    // settings. Returns false if the streams couldn't be opened together.
+    external fun startFullDuplex(monitoring: Boolean): Boolean
+    external fun stopFullDuplex()
+    external fun setMonitoring(enabled: Boolean, gainDb: Float)
+    // Fixed input-to-output latency in frames, not counting the device's own
+    external fun getFullDuplexLatencyFrames(): Int
+
+    // Runs the current filter settings over an existing recording as fast as
+    // the CPU allows, writing outputFormat (FORMAT_*) to outputPath. Blocks
+    // until done, so call it off the main thread. Returns how many times faster
+    // than real time it ran, or -1 on failure.
+    external fun processRecording(inputPath: String, outputPath: String, outputFormat: Int): Double
+
+    // Callback timing of the recorder, player or full-duplex stream. Times are in ns,
+    // utilization is processing time / callback duration. The histogram of
+    // processing times follows from METRIC_HISTOGRAM: bucket 0 is under 1 us,
+    // then 4 buckets per octave (1, 1.25, 1.5, 1.75, 2, 2.5 ... us).
+    const val STREAM_RECORDER = 0
+    const val STREAM_PLAYER = 1
+    const val STREAM_DUPLEX = 2
+
+    const val METRIC_CALLBACKS = 0
+    const val METRIC_MEAN_NS = 1
+    const val METRIC_P50_NS = 2
+    const val METRIC_P99_NS = 3
+    const val METRIC_MAX_NS = 4
+    const val METRIC_MEAN_PERIOD_NS = 5
+    const val METRIC_MAX_PERIOD_NS = 6
+    const val METRIC_BUDGET_NS = 7
+    const val METRIC_MEAN_UTILIZATION = 8
+    const val METRIC_MAX_UTILIZATION = 9
+    const val METRIC_OVERRUNS = 10
+    const val METRIC_XRUNS = 11
+    const val METRIC_HISTOGRAM = 12
+
+    external fun getCallbackMetrics(stream: Int): DoubleArray
+
+    // Scheduling of the threads around the callbacks (file writer, decoder,
+    // read-ahead) started from now on. priority is the SCHED_FIFO priority
+    // (1-99) if fifo, else a nice value; the system may refuse FIFO, in which
+    // case the nice value is used. cores is one of CORES_*.
+    const val CORES_ANY = 0
+    const val CORES_LITTLE = 1
+    const val CORES_BIG = 2
+
+    external fun setWorkerThreadScheduling(fifo: Boolean, priority: Int, cores: Int,
+                                           avoidCallbackCores: Boolean)
+
+    // What the recorder's writer thread, or the player's source thread,
+    // actually got: policy, priority, core mask, and how late its wake-ups
+    // were (ns)
+    const val THREAD_RUNNING = 0
+    const val THREAD_FIFO = 1
+    const val THREAD_PRIORITY = 2
+    const val THREAD_CORE_MASK = 3
+    const val THREAD_WAKE_UPS = 4
+    const val THREAD_MEAN_WAKE_LATENCY_NS = 5
+    const val THREAD_MAX_WAKE_LATENCY_NS = 6
+    const val THREAD_MIGRATIONS = 7
+    const val THREAD_INVOLUNTARY_SWITCHES = 8
+
+    external fun getWorkerThreadStats(stream: Int): DoubleArray
+
     // Bandpass filter (voice isolation)
     external fun setBandpassFilterEnabled(enabled: Boolean)
     external fun configureBandpassFilter(centerFreq: Float, Q: Float)
@@ -52,4 +132,61 @@ object AudioEngine {
     // Playback suppressor (fallback if Android AEC doesn't work)
     external fun setPlaybackSuppressorEnabled(enabled: Boolean)
     external fun configurePlaybackSuppressor(aggressiveness: Float)
+
+    // What the suppressor's voice activity detector hears on the recorder or
+    // full-duplex stream (STREAM_*): whether it is speech now (1 or 0), the
+    // recent speech probability, and the share of the recording that was speech
+    const val VOICE_SPEECH = 0
+    const val VOICE_PROBABILITY = 1
+    const val VOICE_SPEECH_SHARE = 2
+
+    external fun getVoiceActivity(stream: Int): FloatArray
+
+    // Automatic gain control (target level in dBFS, most gain in dB) and the
+    // look-ahead limiter after it (peak ceiling in dBFS); adds about 6 ms of latency
+    external fun setAutoGainEnabled(enabled: Boolean)
+    external fun configureAutoGain(targetDb: Float, maxGainDb: Float)
+    external fun configureLimiter(ceilingDb: Float)
+
+    // Processing graph: the stages the recorder runs, in order. It starts as
+    // the classic chain (the stages the setters above control, ids
+    // STAGE_* + 1); any type can be added any number of times, and stages are
+    // then removed, moved, enabled and configured by id. Stages that stay in
+    // the graph keep their state across edits.
+    const val STAGE_PLAYBACK_SUPPRESSOR = 0
+    const val STAGE_ECHO_CANCELLER = 1
+    const val STAGE_NOISE_REDUCTION = 2
+    const val STAGE_NOISE_GATE = 3
+    const val STAGE_BANDPASS = 4
+    const val STAGE_PEAKING = 5
+    const val STAGE_HIGH_SHELF = 6
+    const val STAGE_AUTO_GAIN = 7
+
+    // Stage settings; each type reads only the ones that apply to it
+    const val PARAM_AMOUNT = 0
+    const val PARAM_DELAY_MS = 1
+    const val PARAM_THRESHOLD_DB = 2
+    const val PARAM_RATIO = 3
+    const val PARAM_ATTACK_MS = 4
+    const val PARAM_RELEASE_MS = 5
+    const val PARAM_FREQUENCY = 6
+    const val PARAM_Q = 7
+    const val PARAM_GAIN_DB = 8
+    const val PARAM_TARGET_DB = 9
+    const val PARAM_MAX_GAIN_DB = 10
+    const val PARAM_CEILING_DB = 11
+
+    // Adds a stage with default settings before position (-1: at the end);
+    // returns its id, or -1 if the graph is full
+    external fun addProcessingStage(type: Int, position: Int): Int
+    external fun removeProcessingStage(id: Int): Boolean
+    external fun moveProcessingStage(id: Int, position: Int): Boolean
+    external fun setProcessingStageEnabled(id: Int, enabled: Boolean): Boolean
+    external fun setProcessingStageParam(id: Int, param: Int, value: Float): Boolean
+
+    // The n stage ids in order, followed by their n types
+    external fun getProcessingStages(): IntArray
+
+    // Back to the classic chain
+    external fun resetProcessingGraph()
 }
\ No newline at end of file
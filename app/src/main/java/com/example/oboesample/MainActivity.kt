@@ -124,6 +124,11 @@ class MainActivity : AppCompatActivity() {
         AudioEngine.configureNoiseGate(-40f, 4.0f, 5.0f, 50.0f)
         AudioEngine.configureNoiseReduction(0.5f)
         AudioEngine.configureEchoCanceller(50.0f, 0.7f)
+
+        // Level the recording to about -18 dBFS with peaks held under -1 dBFS
+        AudioEngine.configureAutoGain(-18f, 12f)
+        AudioEngine.configureLimiter(-1f)
+        AudioEngine.setAutoGainEnabled(true)
     }
 
     // --- NEW: Volume Control Functions ---